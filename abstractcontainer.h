@@ -4,6 +4,7 @@
 #include "./statusprovider.h"
 #include "./exceptions.h"
 #include "./tagtarget.h"
+#include "./nativecopyhelper.h"
 
 #include <c++utilities/io/binaryreader.h>
 #include <c++utilities/io/binarywriter.h>
@@ -41,6 +42,7 @@ public:
     uint64 startOffset() const;
     IoUtilities::BinaryReader &reader();
     IoUtilities::BinaryWriter &writer();
+    NativeCopyHelper &nativeCopyHelper();
 
     void parseHeader();
     void parseTags();
@@ -125,6 +127,7 @@ private:
     std::iostream *m_stream;
     IoUtilities::BinaryReader m_reader;
     IoUtilities::BinaryWriter m_writer;
+    NativeCopyHelper m_nativeCopyHelper;
 };
 
 /*!
@@ -169,6 +172,18 @@ inline IoUtilities::BinaryWriter &AbstractContainer::writer()
     return m_writer;
 }
 
+/*!
+ * \brief Returns the helper used to copy media data when rewriting the file.
+ *
+ * Implementations of internalMakeFile() open the helper with the backup stream and the output stream when rewriting
+ * the file so copying elements (see GenericFileElement::copyEntirely()) does not need to pass the data through
+ * user space.
+ */
+inline NativeCopyHelper &AbstractContainer::nativeCopyHelper()
+{
+    return m_nativeCopyHelper;
+}
+
 /*!
  * \brief Returns an indication whether the header has been parsed yet.
  */
@@ -0,0 +1,355 @@
+#include "./adtsframescanner.h"
+
+#include "../mp4/mp4ids.h"
+
+#include "../basicfileinfo.h"
+#include "../exceptions.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/catchiofailure.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace ChronoUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/// \brief The size of the fixed and variable ADTS header (without CRC).
+static constexpr size_t headerSize = 7;
+
+/// \brief The header bits which must not change between the frames of a stream (sync word, ID, layer, protection,
+///        profile, sampling frequency index and channel configuration).
+static constexpr uint64 constantHeaderMask = (0x3FFFFFull << 34) | (0x7ull << 30);
+
+/*!
+ * \class Media::AdtsFrameScanner
+ * \brief The AdtsFrameScanner class determines the exact frame count, duration and bitrate of an ADTS stream by
+ *        walking all frames.
+ *
+ * ADTS streams provide no information about their length so AdtsStream::internalParseHeader() can only estimate the
+ * duration from the first frame. This class walks the frame headers instead (the audio data itself is not decoded):
+ * Frames are located by searching the sync word (using SSE2 if available, see findSync()) and are only accepted if the
+ * header is valid and followed by another consistent header. Subsequent frames are found using the frame length
+ * denoted by the header. Invalid data between frames is skipped (with a warning).
+ *
+ * Big files are split into ranges which are scanned by several threads. When the results are merged, ranges whose
+ * first frame does not continue the preceding range are scanned again starting at the end of the preceding range.
+ * Threads read directly from the memory mapping if the file is mapped and open their own stream otherwise (see
+ * RangeWorkers).
+ *
+ * Besides the statistics, a seek table with an entry every seekPointInterval() frames is determined.
+ *
+ * \sa AdtsStream::scanFrames()
+ */
+
+/*!
+ * \brief Constructs a new scanner for the frames between \a startOffset and \a endOffset of the specified \a fileInfo.
+ * \remarks The \a endOffset should exclude trailing tags (eg. ID3v1).
+ */
+AdtsFrameScanner::AdtsFrameScanner(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset) :
+    m_fileInfo(fileInfo),
+    m_startOffset(startOffset),
+    m_endOffset(max(startOffset, endOffset)),
+    m_threadCount(0),
+    m_seekPointInterval(64),
+    m_frameCount(0),
+    m_sampleCount(0),
+    m_dataSize(0),
+    m_samplingFrequency(0),
+    m_maxBitrate(0.0)
+{}
+
+/*!
+ * \brief Constructs an empty result.
+ */
+AdtsFrameScanner::RangeResult::RangeResult() :
+    firstFrameOffset(0),
+    endOffset(0),
+    endsWithFrame(false),
+    firstHeader(0),
+    frameCount(0),
+    sampleCount(0),
+    dataSize(0),
+    maxBitrate(0.0)
+{}
+
+/*!
+ * \brief Returns the index of the first sync word (12 set bits followed by the layer bits which must be zero) within
+ *        the specified \a data of \a size bytes.
+ * \returns Returns \a size if no sync word could be found. A sync word is only found if both of its bytes are within
+ *          the specified range.
+ */
+size_t AdtsFrameScanner::findSync(const char *data, size_t size)
+{
+    size_t index = 0;
+#if defined(__SSE2__)
+    // compare 16 bytes at once: the first byte must be 0xFF and the following byte must match 1111x00x
+    const __m128i allSet = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i secondMask = _mm_set1_epi8(static_cast<char>(0xF6));
+    const __m128i secondValue = _mm_set1_epi8(static_cast<char>(0xF0));
+    for(; size - index > 16; index += 16) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index + 1));
+        const int matches = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, allSet), _mm_cmpeq_epi8(_mm_and_si128(second, secondMask), secondValue)));
+        if(matches) {
+            return index + static_cast<size_t>(__builtin_ctz(static_cast<unsigned int>(matches)));
+        }
+    }
+#endif
+    for(; index + 1 < size; ++index) {
+        if(static_cast<byte>(data[index]) == 0xFF && (static_cast<byte>(data[index + 1]) & 0xF6) == 0xF0) {
+            return index;
+        }
+    }
+    return size;
+}
+
+/*!
+ * \brief Returns the 56 bits of the fixed and variable header of the frame at the specified \a data.
+ * \remarks The \a data must provide at least 7 bytes.
+ */
+uint64 AdtsFrameScanner::readHeader(const char *data)
+{
+    return (static_cast<uint64>(BE::toUInt32(data)) << 24) | (static_cast<uint64>(BE::toUInt16(data + 4)) << 8) | static_cast<byte>(data[6]);
+}
+
+/*!
+ * \brief Returns the size (including the header) of the frame with the specified \a header or zero if the header is
+ *        invalid.
+ */
+uint32 AdtsFrameScanner::frameSize(uint64 header)
+{
+    const uint32 size = (header >> 13) & 0x1FFF;
+    if(((header >> 41) & 0x7FFB) != 0x7FF8 || !frameSamplingFrequency(header) || size < headerSize + ((header >> 40) & 0x1 ? 0 : 2)) {
+        return 0;
+    }
+    return size;
+}
+
+/*!
+ * \brief Returns the number of samples of the frame with the specified \a header (1024 per raw data block).
+ */
+uint32 AdtsFrameScanner::frameSampleCount(uint64 header)
+{
+    return 1024 * ((header & 0x3) + 1);
+}
+
+/*!
+ * \brief Returns the sampling frequency denoted by the specified frame \a header or zero if the header is invalid.
+ */
+uint32 AdtsFrameScanner::frameSamplingFrequency(uint64 header)
+{
+    const auto samplingFrequencyIndex = static_cast<size_t>((header >> 34) & 0xF);
+    return samplingFrequencyIndex < sizeof(mpeg4SamplingFrequencyTable) / sizeof(*mpeg4SamplingFrequencyTable)
+            ? mpeg4SamplingFrequencyTable[samplingFrequencyIndex] : 0;
+}
+
+/*!
+ * \brief Scans all frames and determines the statistics and the seek table.
+ *
+ * Problems are added as notifications. IO errors while scanning are added as critical notifications; the frames
+ * scanned so far are taken into account.
+ */
+void AdtsFrameScanner::scan()
+{
+    static const string context("scanning ADTS frames");
+    invalidateStatus();
+    m_frameCount = m_sampleCount = m_dataSize = 0;
+    m_samplingFrequency = 0;
+    m_maxBitrate = 0.0;
+    m_seekTable.clear();
+
+    // scan ranges using several threads
+    const RangeWorkers workers(m_fileInfo, m_startOffset, m_endOffset, m_threadCount);
+    const size_t rangeCount = workers.rangeCount();
+    vector<RangeResult> results(rangeCount);
+    NotificationList workerNotifications;
+    workers.run([&] (RangeReader &reader, size_t rangeIndex) {
+        scanRange(reader, workers.rangeBegin(rangeIndex), workers.rangeBegin(rangeIndex + 1), false, results[rangeIndex]);
+    }, context, workerNotifications);
+    addNotifications(workerNotifications);
+
+    // merge results; re-scan ranges which do not continue where the preceding range ends
+    try {
+        RangeReader reader = workers.reader();
+        const RangeResult *previous = nullptr;
+        uint64 firstHeader = 0;
+        for(size_t rangeIndex = 0; rangeIndex != rangeCount; ++rangeIndex) {
+            RangeResult &result = results[rangeIndex];
+            if(previous && previous->endsWithFrame && (!result.frameCount || result.firstFrameOffset != previous->endOffset)) {
+                const uint64 end = workers.rangeBegin(rangeIndex + 1);
+                result = RangeResult();
+                if(previous->endOffset < end) {
+                    scanRange(reader, previous->endOffset, end, true, result);
+                } else {
+                    // the frames of the preceding range already cover this range
+                    result.endOffset = previous->endOffset;
+                    result.endsWithFrame = true;
+                }
+            }
+            addNotifications(result.notifications);
+            if(result.frameCount) {
+                if(!firstHeader) {
+                    firstHeader = result.firstHeader;
+                    m_samplingFrequency = frameSamplingFrequency(firstHeader);
+                } else if((firstHeader & constantHeaderMask) != (result.firstHeader & constantHeaderMask)) {
+                    addNotification(NotificationType::Warning, argsToString("The profile, sampling frequency or channel configuration changes at ", result.firstFrameOffset, '.'), context);
+                }
+                for(const AdtsSeekPoint &seekPoint : result.seekPoints) {
+                    m_seekTable.emplace_back(AdtsSeekPoint{seekPoint.offset, m_sampleCount + seekPoint.sampleIndex});
+                }
+                m_frameCount += result.frameCount;
+                m_sampleCount += result.sampleCount;
+                m_dataSize += result.dataSize;
+                m_maxBitrate = max(m_maxBitrate, result.maxBitrate);
+            }
+            previous = &result;
+        }
+    } catch(...) {
+        addNotification(NotificationType::Critical, catchIoFailure(), context);
+    }
+    if(!m_frameCount) {
+        addNotification(NotificationType::Critical, "No ADTS frames found.", context);
+    }
+}
+
+/*!
+ * \brief Returns the duration determined by the last scan.
+ */
+TimeSpan AdtsFrameScanner::duration() const
+{
+    return m_samplingFrequency ? TimeSpan::fromSeconds(static_cast<double>(m_sampleCount) / m_samplingFrequency) : TimeSpan();
+}
+
+/*!
+ * \brief Returns the average bitrate (in kbit/s) determined by the last scan.
+ */
+double AdtsFrameScanner::averageBitrate() const
+{
+    return m_sampleCount && m_samplingFrequency
+            ? static_cast<double>(m_dataSize) * 0.008 / (static_cast<double>(m_sampleCount) / m_samplingFrequency)
+            : 0.0;
+}
+
+/*!
+ * \brief Scans the frames starting within the range from \a begin to \a end.
+ *
+ * If \a synchronized is set, \a begin is expected to be the start of a frame. Otherwise the range is scanned from the
+ * first frame found within it (see findFrame()).
+ *
+ * \remarks This method is called by the workers and must not alter the scanner.
+ */
+void AdtsFrameScanner::scanRange(RangeReader &reader, uint64 begin, uint64 end, bool synchronized, RangeResult &result) const
+{
+    static const string context("scanning ADTS frames");
+    uint64 offset = begin, invalidDataOffset = begin;
+    uint64 expectedHeader = 0;
+    result.endOffset = begin;
+    while(offset < end) {
+        if(!synchronized) {
+            const uint64 frameOffset = findFrame(reader, offset, end);
+            if(frameOffset >= end) {
+                break;
+            }
+            if(frameOffset != invalidDataOffset && (result.frameCount || invalidDataOffset == m_startOffset)) {
+                result.notifications.emplace_back(NotificationType::Warning, argsToString("Skipped ", frameOffset - invalidDataOffset, " bytes of invalid data at ", invalidDataOffset, '.'), context);
+            }
+            offset = frameOffset;
+            synchronized = true;
+        }
+        const uint64 header = m_endOffset - offset >= headerSize ? readHeader(reader.read(offset, headerSize)) : 0;
+        const uint32 size = frameSize(header);
+        if(!size || size > m_endOffset - offset || (expectedHeader && (header & constantHeaderMask) != expectedHeader)) {
+            // no (consistent) frame where one is expected -> search for the next frame
+            result.endsWithFrame = synchronized = false;
+            expectedHeader = 0;
+            invalidDataOffset = offset++;
+            continue;
+        }
+        if(!expectedHeader) {
+            expectedHeader = header & constantHeaderMask;
+            if(result.frameCount && expectedHeader != (result.firstHeader & constantHeaderMask)) {
+                result.notifications.emplace_back(NotificationType::Warning, argsToString("The profile, sampling frequency or channel configuration changes at ", offset, '.'), context);
+            }
+        }
+        if(!result.frameCount) {
+            result.firstFrameOffset = offset;
+            result.firstHeader = header;
+        }
+        if(result.frameCount % m_seekPointInterval == 0) {
+            result.seekPoints.emplace_back(AdtsSeekPoint{offset, result.sampleCount});
+        }
+        const uint32 sampleCount = frameSampleCount(header);
+        ++result.frameCount;
+        result.sampleCount += sampleCount;
+        result.dataSize += size;
+        // bitrate of the frame in kbit/s
+        result.maxBitrate = max(result.maxBitrate, static_cast<double>(size) * 0.008 * frameSamplingFrequency(header) / sampleCount);
+        result.endOffset = offset += size;
+        result.endsWithFrame = true;
+    }
+}
+
+/*!
+ * \brief Returns the offset of the first frame starting at or after \a offset and before \a end.
+ *
+ * A frame is only considered found if its header is followed by another consistent frame header (or the end of the
+ * stream). This prevents synchronizing to sync words which are part of the frame data.
+ *
+ * \returns Returns \a end if no frame could be found.
+ */
+uint64 AdtsFrameScanner::findFrame(RangeReader &reader, uint64 offset, uint64 end) const
+{
+    while(offset < end && m_endOffset - offset >= headerSize) {
+        // the sync word must start before the end of the range but might end after it
+        const size_t available = static_cast<size_t>(min<uint64>(RangeReader::bufferSize, m_endOffset - offset));
+        const size_t searchSize = static_cast<size_t>(min<uint64>(available, end - offset + 1));
+        const char *const data = reader.read(offset, available);
+        const size_t index = findSync(data, searchSize);
+        if(index == searchSize) {
+            // keep the last byte since it might be the first byte of a sync word
+            offset += max<size_t>(searchSize - 1, 1);
+            continue;
+        }
+        if(isFrameSequence(reader, offset + index)) {
+            return offset + index;
+        }
+        offset += index + 1;
+    }
+    return end;
+}
+
+/*!
+ * \brief Returns whether a valid frame header at the specified \a offset is followed by another consistent frame
+ *        header or the end of the stream.
+ */
+bool AdtsFrameScanner::isFrameSequence(RangeReader &reader, uint64 offset) const
+{
+    if(m_endOffset - offset < headerSize) {
+        return false;
+    }
+    const uint64 header = readHeader(reader.read(offset, headerSize));
+    const uint32 size = frameSize(header);
+    if(!size || size > m_endOffset - offset) {
+        return false;
+    }
+    const uint64 nextOffset = offset + size;
+    if(nextOffset == m_endOffset) {
+        return true;
+    }
+    if(m_endOffset - nextOffset < headerSize) {
+        return false;
+    }
+    const uint64 nextHeader = readHeader(reader.read(nextOffset, headerSize));
+    return frameSize(nextHeader) && (header & constantHeaderMask) == (nextHeader & constantHeaderMask);
+}
+
+}
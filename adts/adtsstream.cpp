@@ -4,9 +4,12 @@
 
 #include "../exceptions.h"
 
+#include <c++utilities/chrono/timespan.h>
+
 #include <string>
 
 using namespace std;
+using namespace ChronoUtilities;
 
 namespace Media {
 
@@ -35,6 +38,40 @@ void AdtsStream::internalParseHeader()
     m_channelCount = Mpeg4ChannelConfigs::channelCount(m_channelConfig = m_firstFrame.mpeg4ChannelConfig());
     byte sampleRateIndex = m_firstFrame.mpeg4SamplingFrequencyIndex();
     m_samplingFrequency = sampleRateIndex < sizeof(mpeg4SamplingFrequencyTable) ? mpeg4SamplingFrequencyTable[sampleRateIndex] : 0;
+    // estimate bitrate and duration from the first frame (see scanFrames() for exact values)
+    if(m_samplingFrequency) {
+        m_bitrate = static_cast<double>(m_firstFrame.totalSize()) * 0.008 * m_samplingFrequency / (1024.0 * m_firstFrame.frameCount());
+        m_duration = TimeSpan::fromSeconds(static_cast<double>(m_size) / (m_bitrate * 125.0));
+    }
+}
+
+/*!
+ * \brief Determines the exact sample count, duration and bitrate by walking all frames of the stream.
+ *
+ * The header must have been parsed before. The frames between the start offset and the end of the stream (excluding
+ * an ID3v1 tag) of the specified \a fileInfo are scanned using \a threadCount threads (zero means the number of
+ * hardware threads). This also determines the seekTable().
+ *
+ * Problems are added as notifications. The values determined when parsing the header are kept if no frames could be
+ * found.
+ *
+ * \sa AdtsFrameScanner
+ */
+void AdtsStream::scanFrames(BasicFileInfo &fileInfo, size_t threadCount)
+{
+    AdtsFrameScanner scanner(fileInfo, m_startOffset, m_startOffset + m_size);
+    scanner.setThreadCount(threadCount);
+    scanner.scan();
+    addNotifications(scanner);
+    if(!scanner.frameCount()) {
+        return;
+    }
+    m_sampleCount = scanner.sampleCount();
+    m_size = scanner.dataSize();
+    m_duration = scanner.duration();
+    m_bitrate = scanner.averageBitrate();
+    m_maxBitrate = scanner.maxBitrate();
+    m_seekTable = scanner.seekTable();
 }
 
 } // namespace Media
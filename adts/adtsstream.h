@@ -2,11 +2,16 @@
 #define MEDIA_ADTSSTREAM_H
 
 #include "./adtsframe.h"
+#include "./adtsframescanner.h"
 
 #include "../abstracttrack.h"
 
+#include <vector>
+
 namespace Media {
 
+class BasicFileInfo;
+
 class TAG_PARSER_EXPORT AdtsStream : public AbstractTrack
 {
 public:
@@ -14,12 +19,15 @@ public:
     ~AdtsStream();
 
     TrackType type() const;
+    void scanFrames(BasicFileInfo &fileInfo, std::size_t threadCount = 0);
+    const std::vector<AdtsSeekPoint> &seekTable() const;
 
 protected:
     void internalParseHeader();
 
 private:
     AdtsFrame m_firstFrame;
+    std::vector<AdtsSeekPoint> m_seekTable;
 };
 
 /*!
@@ -39,6 +47,15 @@ inline TrackType AdtsStream::type() const
     return TrackType::AdtsStream;
 }
 
+/*!
+ * \brief Returns the seek table determined by the last call of scanFrames().
+ * \sa AdtsFrameScanner::seekTable()
+ */
+inline const std::vector<AdtsSeekPoint> &AdtsStream::seekTable() const
+{
+    return m_seekTable;
+}
+
 } // namespace Media
 
 #endif // MEDIA_ADTSSTREAM_H
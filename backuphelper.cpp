@@ -1,5 +1,6 @@
 #include "./backuphelper.h"
 #include "./mediafileinfo.h"
+#include "./nativecopyhelper.h"
 
 #include <c++utilities/conversion/stringconversion.h>
 #include <c++utilities/conversion/stringbuilder.h>
@@ -10,6 +11,12 @@
 #else
 # include <sys/stat.h>
 #endif
+#ifdef PLATFORM_LINUX
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <linux/fs.h>
+#endif
 
 #include <string>
 #include <fstream>
@@ -44,6 +51,75 @@ string &backupDirectory()
     return backupDir;
 }
 
+/*!
+ * \brief Returns the strategy used to create backup files.
+ *
+ * By default, the original file is renamed (BackupStrategy::Rename). When using BackupStrategy::Reflink, the
+ * original file is cloned instead if the file system supports reflinks (eg. Btrfs and XFS). Cloning takes constant
+ * time and no extra space and keeps the original file (including its inode, permissions and hard links) in place.
+ * If cloning is not supported, createBackupFile() falls back to renaming automatically.
+ */
+BackupStrategy &backupStrategy()
+{
+    static BackupStrategy strategy = BackupStrategy::Rename;
+    return strategy;
+}
+
+/*!
+ * \brief Creates a reflink (copy-on-write clone) of the file at \a sourcePath at \a targetPath.
+ *
+ * The file at \a targetPath must not exist yet. It is created with the permissions of the source file.
+ *
+ * \returns Returns whether the clone could be created. This is never the case if the file system or the
+ *          platform does not support reflinks or if \a sourcePath and \a targetPath are on different file
+ *          systems.
+ */
+bool cloneFile(const std::string &sourcePath, const std::string &targetPath)
+{
+#if defined(PLATFORM_LINUX) && defined(FICLONE)
+    const int sourceFd = ::open(sourcePath.data(), O_RDONLY | O_CLOEXEC);
+    if(sourceFd < 0) {
+        return false;
+    }
+    struct stat sourceStat;
+    if(fstat(sourceFd, &sourceStat)) {
+        ::close(sourceFd);
+        return false;
+    }
+    const int targetFd = ::open(targetPath.data(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, sourceStat.st_mode & 07777);
+    if(targetFd < 0) {
+        ::close(sourceFd);
+        return false;
+    }
+    const bool cloned = ::ioctl(targetFd, FICLONE, sourceFd) == 0;
+    ::close(targetFd);
+    ::close(sourceFd);
+    if(!cloned) {
+        std::remove(targetPath.data());
+    }
+    return cloned;
+#else
+    VAR_UNUSED(sourcePath)
+    VAR_UNUSED(targetPath)
+    return false;
+#endif
+}
+
+/*!
+ * \brief Copies the entire contents of \a inputStream to \a outputStream.
+ * \remarks The streams must be open and associated with the files at \a inputPath and \a outputPath. Used by
+ *          createBackupFile() and restoreOriginalFileFromBackupFile() when neither renaming nor cloning is possible.
+ */
+void copyFile(NativeFileStream &inputStream, const std::string &inputPath, NativeFileStream &outputStream, const std::string &outputPath)
+{
+    inputStream.seekg(0, ios_base::end);
+    const auto size = static_cast<uint64>(inputStream.tellg());
+    inputStream.seekg(0);
+    NativeCopyHelper copyHelper;
+    copyHelper.open(inputStream, inputPath, outputStream, outputPath);
+    copyHelper.copy(inputStream, outputStream, size);
+}
+
 /*!
  * \brief Restores the original file from the specified backup file.
  * \param originalPath Specifies the path to the original file.
@@ -57,7 +133,7 @@ string &backupDirectory()
  * currently open.
  *
  * If moving isn't possible (eg. \a originalPath and \a backupPath refer to different partitions) the backup
- * file will be restored by copying.
+ * file will be restored by cloning (if supported) or copying.
  *
  * \throws Throws std::ios_base::failure on failure.
  * \todo Implement callback for progress updates (copy).
@@ -80,15 +156,16 @@ void restoreOriginalFileFromBackupFile(const std::string &originalPath, const st
     }
     // remove original file and restore backup
     std::remove(originalPath.c_str());
-    if(std::rename(backupPath.c_str(), originalPath.c_str()) != 0) { // restore backup
-        // unable to move the file
+    if(std::rename(backupPath.c_str(), originalPath.c_str()) != 0 // restore backup
+            && !cloneFile(backupPath, originalPath)) {
+        // unable to move or clone the file
         try { // to copy
             // need to open all streams again
             backupStream.exceptions(ios_base::failbit | ios_base::badbit);
             originalStream.exceptions(ios_base::failbit | ios_base::badbit);
             backupStream.open(backupPath, ios_base::in | ios_base::binary);
             originalStream.open(originalPath, ios_base::out | ios_base::binary);
-            originalStream << backupStream.rdbuf();
+            copyFile(backupStream, backupPath, originalStream, originalPath);
             // TODO: callback for progress updates
         } catch(...) {
             catchIoFailure();
@@ -111,8 +188,9 @@ void restoreOriginalFileFromBackupFile(const std::string &originalPath, const st
  *
  * The specified \a originalStream is closed before performing the move operation.
  *
- * If moving isn't possible (eg. \a originalPath and \a backupPath refer to different partitions) the backup
- * file will be created by copying.
+ * If backupStrategy() is BackupStrategy::Reflink, the backup file is created by cloning the original file if
+ * supported. Otherwise the original file is moved. If moving isn't possible (eg. \a originalPath and \a backupPath
+ * refer to different partitions) the backup file will be created by cloning (if supported) or copying.
  *
  * The original file can now be rewritten to apply changes. When this operation fails
  * the created backup file can be restored using restoreOriginalFileFromBackupFile().
@@ -188,9 +266,12 @@ void createBackupFile(const std::string &originalPath, std::string &backupPath,
     if(originalStream.is_open()) {
         originalStream.close();
     }
-    // rename original file
-    if(std::rename(originalPath.c_str(), backupPath.c_str()) != 0) {
-        // can't rename/move the file
+    // clone original file if preferred; otherwise rename original file
+    const bool preferReflink = backupStrategy() == BackupStrategy::Reflink;
+    if(!(preferReflink && cloneFile(originalPath, backupPath))
+            && std::rename(originalPath.c_str(), backupPath.c_str()) != 0
+            && (preferReflink || !cloneFile(originalPath, backupPath))) {
+        // can't clone or rename/move the file
         try { // to copy
             backupStream.exceptions(ios_base::failbit | ios_base::badbit);
             originalStream.exceptions(ios_base::failbit | ios_base::badbit);
@@ -202,7 +283,7 @@ void createBackupFile(const std::string &originalPath, std::string &backupPath,
             // ensure originalStream is opened with read permissions
             originalStream.open(originalPath, ios_base::in | ios_base::binary);
             // do the actual copying
-            backupStream << originalStream.rdbuf();
+            copyFile(originalStream, originalPath, backupStream, backupPath);
             // streams are closed in the next try-block
             // TODO: callback for progress updates
         } catch(...) {
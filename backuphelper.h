@@ -11,7 +11,18 @@ class MediaFileInfo;
 
 namespace BackupHelper {
 
+/*!
+ * \brief The BackupStrategy enum specifies how createBackupFile() creates backup files.
+ */
+enum class BackupStrategy
+{
+    Rename, /**< the original file is renamed (moved) to the backup location */
+    Reflink /**< the original file is cloned to the backup location if the file system supports reflinks; otherwise it is renamed */
+};
+
 TAG_PARSER_EXPORT std::string &backupDirectory();
+TAG_PARSER_EXPORT BackupStrategy &backupStrategy();
+TAG_PARSER_EXPORT bool cloneFile(const std::string &sourcePath, const std::string &targetPath);
 TAG_PARSER_EXPORT void restoreOriginalFileFromBackupFile(const std::string &originalPath, const std::string &backupPath, IoUtilities::NativeFileStream &originalStream, IoUtilities::NativeFileStream &backupStream);
 TAG_PARSER_EXPORT void createBackupFile(const std::string &originalPath, std::string &backupPath, IoUtilities::NativeFileStream &originalStream, IoUtilities::NativeFileStream &backupStream);
 TAG_PARSER_EXPORT void handleFailureAfterFileModified(MediaFileInfo &mediaFileInfo, const std::string &backupPath, IoUtilities::NativeFileStream &outputStream, IoUtilities::NativeFileStream &backupStream, const std::string &context = "making file");
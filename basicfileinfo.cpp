@@ -1,5 +1,13 @@
 #include "./basicfileinfo.h"
 
+#include <limits>
+
+#ifdef PLATFORM_UNIX
+# include <sys/mman.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
 using namespace std;
 
 /*!
@@ -23,7 +31,13 @@ namespace Media {
 BasicFileInfo::BasicFileInfo(const std::string &path) :
     m_path(path),
     m_size(0),
-    m_readOnly(false)
+    m_mappedData(nullptr),
+    m_mappedSize(0),
+    m_byteSource(nullptr),
+    m_fileBuffer(nullptr),
+    m_readOnly(false),
+    m_memoryMappingEnabled(false),
+    m_readCacheEnabled(false)
 {
     m_file.exceptions(ios_base::failbit | ios_base::badbit);
 }
@@ -54,28 +68,144 @@ void BasicFileInfo::open(bool readOnly)
  * \brief Opens a std::fstream for the current file. Closes a possibly already opened stream and
  *        clears all flags before.
  * \param readOnly Indicates whether the stream should be opend as read-only.
+ * \remarks If a byte source is assigned, the stream is always read-only.
  * \throws Throws std::ios_base::failure when an IO error occurs.
  */
 void BasicFileInfo::reopen(bool readOnly)
 {
     invalidated();
+    if(m_byteSource) {
+        // let stream() read from the byte source
+        m_readOnly = true;
+        m_byteSourceBuffer = make_unique<ByteSourceStreamBuffer>(*m_byteSource);
+        m_fileBuffer = static_cast<ios &>(m_file).rdbuf(m_byteSourceBuffer.get());
+        m_size = m_byteSource->size();
+        return;
+    }
     m_file.open(m_path, (m_readOnly = readOnly) ? ios_base::in | ios_base::binary : ios_base::in | ios_base::out | ios_base::binary);
     m_file.seekg(0, ios_base::end);
     m_size = static_cast<uint64>(m_file.tellg());
     m_file.seekg(0, ios_base::beg);
+    if(m_memoryMappingEnabled && m_readOnly) {
+        map();
+    }
+    updateReadCache();
 }
 
 /*!
  * \brief A possibly opened std::fstream will be closed. All flags of the stream will be cleared.
+ * \remarks A possibly existing memory mapping is discarded and the read cache is deactivated as well.
  */
 void BasicFileInfo::close()
 {
+    unmap();
+    m_readCache.setStream(nullptr, 0);
+    if(m_byteSourceBuffer) {
+        static_cast<ios &>(m_file).rdbuf(m_fileBuffer);
+        m_byteSourceBuffer.reset();
+    }
     if(isOpen()) {
         m_file.close();
     }
     m_file.clear();
 }
 
+/*!
+ * \brief Sets whether the file should be memory mapped when opened as read-only.
+ *
+ * When enabled, parsers (eg. the GenericFileElement implementations and OggIterator) read directly from the mapped
+ * memory instead of seeking and reading on stream(). This avoids several system calls per element when parsing
+ * large element trees.
+ *
+ * The file is only mapped when opened as read-only because modifications written to stream() might be buffered
+ * and hence would not be visible through the mapping. If mapping fails, stream() is silently used instead.
+ *
+ * By default, memory mapping is disabled.
+ *
+ * \remarks If the file is already open, the change is applied immediately.
+ * \sa isMemoryMappingEnabled(), isMemoryMapped()
+ */
+void BasicFileInfo::setMemoryMappingEnabled(bool enabled)
+{
+    if((m_memoryMappingEnabled = enabled)) {
+        if(m_file.is_open() && m_readOnly && !m_mappedData) {
+            map();
+        }
+    } else {
+        unmap();
+    }
+}
+
+/*!
+ * \brief Sets whether the read cache should be used when the file is opened as read-only.
+ *
+ * When enabled, parsers (eg. the GenericFileElement implementations and OggIterator) read through readCache() instead
+ * of seeking and reading on stream() for every element header. So walking through sibling and child elements is
+ * mostly served from memory.
+ *
+ * Like the memory mapping, the read cache is only used when the file is opened as read-only. If the file is memory
+ * mapped as well, the mapping is preferred.
+ *
+ * By default, the read cache is disabled.
+ *
+ * \remarks If the file is already open, the change is applied immediately.
+ * \sa isReadCacheEnabled(), readCache(), fetchData()
+ */
+void BasicFileInfo::setReadCacheEnabled(bool enabled)
+{
+    m_readCacheEnabled = enabled;
+    updateReadCache();
+}
+
+/*!
+ * \brief Returns a pointer to \a count bytes of the file contents starting at the specified \a offset.
+ *
+ * The data is taken directly from the memory mapping if possible. Otherwise it is read into the specified \a buffer
+ * using the byte source (if assigned), the read cache (if active) or stream().
+ *
+ * \returns Returns a pointer to the requested data which is either a pointer into the memory mapping or \a buffer.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \sa mappedData(), readCache()
+ */
+const char *BasicFileInfo::fetchData(uint64 offset, std::size_t count, char *buffer)
+{
+    if(const char *data = mappedData(offset, count)) {
+        return data;
+    }
+    if(m_byteSourceBuffer) {
+        m_byteSource->readAt(offset, buffer, count);
+    } else if(m_readCache.isActive()) {
+        m_readCache.read(offset, buffer, count);
+    } else {
+        m_file.seekg(static_cast<streamoff>(offset));
+        m_file.read(buffer, static_cast<streamsize>(count));
+    }
+    return buffer;
+}
+
+/*!
+ * \brief Assigns a byte source to read data from instead of the file at path().
+ *
+ * This allows parsing data which is not present as a local file, eg. objects of a blob store which are fetched using
+ * range requests. When opened, stream() reads from the specified \a source and size() returns the size of the source.
+ * Parsers (eg. the GenericFileElement implementations and OggIterator) read element headers directly via
+ * ByteSource::readAt(). Wrap the source using a CachingByteSource to coalesce these small reads into few requests.
+ *
+ * The path is still used to determine the file name and extension. Memory mapping and the read cache are not used
+ * while a byte source is assigned and the stream is always read-only.
+ *
+ * A possibly opened stream will be closed and invalidated() will be called. Pass nullptr to read from the file again.
+ *
+ * \remarks The \a source is not taken ownership of and must outlive the assignment.
+ */
+void BasicFileInfo::setByteSource(ByteSource *source)
+{
+    if(source != m_byteSource) {
+        invalidated();
+        m_byteSource = source;
+    }
+}
+
 /*!
  * \brief Invalidates the file info manually.
  */
@@ -221,4 +351,56 @@ void BasicFileInfo::invalidated()
     close();
 }
 
+/*!
+ * \brief Maps the current file into memory.
+ * \remarks Leaves the file unmapped if mapping is not supported or fails; stream() is used in this case.
+ */
+void BasicFileInfo::map()
+{
+    unmap();
+#ifdef PLATFORM_UNIX
+    if(!m_size || m_size > numeric_limits<size_t>::max()) {
+        return;
+    }
+    const int fd = ::open(m_path.data(), O_RDONLY);
+    if(fd < 0) {
+        return;
+    }
+    void *const data = ::mmap(nullptr, static_cast<size_t>(m_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(data != MAP_FAILED) {
+        m_mappedData = static_cast<const char *>(data);
+        m_mappedSize = m_size;
+    }
+#endif
+}
+
+/*!
+ * \brief Activates or deactivates the read cache according to the current settings.
+ */
+void BasicFileInfo::updateReadCache()
+{
+    if(m_readCacheEnabled && m_readOnly && m_file.is_open()) {
+        if(m_readCache.stream() != &m_file || m_readCache.streamSize() != m_size) {
+            m_readCache.setStream(&m_file, m_size);
+        }
+    } else {
+        m_readCache.setStream(nullptr, 0);
+    }
+}
+
+/*!
+ * \brief Discards a possibly existing memory mapping.
+ */
+void BasicFileInfo::unmap()
+{
+#ifdef PLATFORM_UNIX
+    if(m_mappedData) {
+        ::munmap(const_cast<char *>(m_mappedData), static_cast<size_t>(m_mappedSize));
+    }
+#endif
+    m_mappedData = nullptr;
+    m_mappedSize = 0;
+}
+
 }
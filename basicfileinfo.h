@@ -2,6 +2,8 @@
 #define BASICFILEINFO_H
 
 #include "./global.h"
+#include "./blockcache.h"
+#include "./bytesource.h"
 
 #include <c++utilities/conversion/types.h>
 #include <c++utilities/io/nativefilestream.h>
@@ -29,6 +31,23 @@ public:
     IoUtilities::NativeFileStream &stream();
     const IoUtilities::NativeFileStream &stream() const;
 
+    // methods to control memory mapping
+    bool isMemoryMappingEnabled() const;
+    void setMemoryMappingEnabled(bool enabled);
+    bool isMemoryMapped() const;
+    const char *mappedData(uint64 offset, uint64 count) const;
+
+    // methods to control read cache
+    bool isReadCacheEnabled() const;
+    void setReadCacheEnabled(bool enabled);
+    BlockCache &readCache();
+    const BlockCache &readCache() const;
+    const char *fetchData(uint64 offset, std::size_t count, char *buffer);
+
+    // methods to control byte source
+    ByteSource *byteSource() const;
+    void setByteSource(ByteSource *source);
+
     // methods to get, set path (components)
     const std::string &path() const;
     void setPath(const std::string &path);
@@ -50,20 +69,34 @@ protected:
     virtual void invalidated();
 
 private:
+    void map();
+    void unmap();
+    void updateReadCache();
+
     std::string m_path;
     IoUtilities::NativeFileStream m_file;
     uint64 m_size;
+    const char *m_mappedData;
+    uint64 m_mappedSize;
+    BlockCache m_readCache;
+    ByteSource *m_byteSource;
+    std::unique_ptr<ByteSourceStreamBuffer> m_byteSourceBuffer;
+    std::streambuf *m_fileBuffer;
     bool m_readOnly;
+    bool m_memoryMappingEnabled;
+    bool m_readCacheEnabled;
 };
 
 /*!
  * \brief Indicates whether a std::fstream is open for the current file.
  *
- * \sa stream()
+ * If a byte source is assigned, this indicates whether the stream() reads from it.
+ *
+ * \sa stream(), setByteSource()
  */
 inline bool BasicFileInfo::isOpen() const
 {
-    return m_file.is_open();
+    return m_file.is_open() || m_byteSourceBuffer;
 }
 
 /*!
@@ -90,6 +123,77 @@ inline const IoUtilities::NativeFileStream &BasicFileInfo::stream() const
     return m_file;
 }
 
+/*!
+ * \brief Returns whether memory mapping is enabled.
+ * \sa setMemoryMappingEnabled()
+ */
+inline bool BasicFileInfo::isMemoryMappingEnabled() const
+{
+    return m_memoryMappingEnabled;
+}
+
+/*!
+ * \brief Returns whether the current file is actually memory mapped.
+ * \remarks Even when memory mapping is enabled, the file is only mapped when opened as read-only and mapping succeeded.
+ * \sa setMemoryMappingEnabled()
+ */
+inline bool BasicFileInfo::isMemoryMapped() const
+{
+    return m_mappedData != nullptr;
+}
+
+/*!
+ * \brief Returns a pointer to \a count bytes of the file contents starting at the specified \a offset.
+ * \returns Returns nullptr if the file is not memory mapped or the specified range exceeds the mapping. The
+ *          caller is expected to fall back to reading from stream() in this case.
+ * \remarks The returned pointer is only valid until the file is closed, reopened or the size or path is reported to
+ *          have changed.
+ */
+inline const char *BasicFileInfo::mappedData(uint64 offset, uint64 count) const
+{
+    return m_mappedData && offset <= m_mappedSize && count <= m_mappedSize - offset ? m_mappedData + offset : nullptr;
+}
+
+/*!
+ * \brief Returns whether the read cache is enabled.
+ * \sa setReadCacheEnabled()
+ */
+inline bool BasicFileInfo::isReadCacheEnabled() const
+{
+    return m_readCacheEnabled;
+}
+
+/*!
+ * \brief Returns the read cache.
+ *
+ * The returned object allows to configure the block size and the capacity and to query the hit and miss counters.
+ *
+ * \sa setReadCacheEnabled()
+ */
+inline BlockCache &BasicFileInfo::readCache()
+{
+    return m_readCache;
+}
+
+/*!
+ * \brief Returns the read cache.
+ * \sa setReadCacheEnabled()
+ */
+inline const BlockCache &BasicFileInfo::readCache() const
+{
+    return m_readCache;
+}
+
+/*!
+ * \brief Returns the byte source data is read from instead of the file at path().
+ * \returns Returns nullptr if data is read from the file (the default).
+ * \sa setByteSource()
+ */
+inline ByteSource *BasicFileInfo::byteSource() const
+{
+    return m_byteSource;
+}
+
 /*!
  * \brief Returns the path of the current file.
  *
@@ -114,19 +218,25 @@ inline uint64 BasicFileInfo::size() const
 
 /*!
  * \brief Call this function to report that the size changed.
- * \remarks Should be called after writing/truncating the stream().
+ * \remarks Should be called after writing/truncating the stream(). Discards a possibly existing memory mapping
+ *          and deactivates the read cache.
  */
 inline void BasicFileInfo::reportSizeChanged(uint64 newSize)
 {
+    unmap();
+    m_readCache.setStream(nullptr, 0);
     m_size = newSize;
 }
 
 /*!
  * \brief Call this function to report that the path changed.
- * \remarks Should be called after associating another file to the stream() manually.
+ * \remarks Should be called after associating another file to the stream() manually. Discards a possibly existing
+ *          memory mapping and deactivates the read cache.
  */
 inline void BasicFileInfo::reportPathChanged(const std::string &newPath)
 {
+    unmap();
+    m_readCache.setStream(nullptr, 0);
     m_path = newPath;
 }
 
@@ -0,0 +1,159 @@
+#include "./blockcache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::BlockCache
+ * \brief The BlockCache class provides a read-ahead cache for small reads at arbitrary offsets of a stream.
+ *
+ * The stream is divided into blocks of blockSize() bytes which are aligned to multiples of the block size.
+ * When data is read, the affected blocks are read entirely from the stream and kept in memory. So subsequent
+ * reads within the same blocks (eg. when walking through sibling and child elements) are served from memory
+ * without seeking and reading on the stream again.
+ *
+ * At most capacity() blocks are kept in memory. If the capacity is exceeded, the least recently used
+ * block is discarded.
+ *
+ * The hits() and misses() counters allow to tune the block size and the capacity.
+ *
+ * \remarks
+ * - The cache is not aware of modifications of the stream. Hence it must be cleared when the stream is
+ *   modified.
+ * - The read position of the stream is altered when reading from the cache.
+ */
+
+/*!
+ * \brief Constructs a new cache with the specified \a blockSize and \a capacity.
+ * \remarks No stream is assigned initially. Use setStream() to assign a stream.
+ */
+BlockCache::BlockCache(std::size_t blockSize, std::size_t capacity) :
+    m_stream(nullptr),
+    m_streamSize(0),
+    m_blockSize(max<size_t>(blockSize, 1)),
+    m_capacity(capacity),
+    m_hits(0),
+    m_misses(0)
+{}
+
+/*!
+ * \brief Assigns the specified \a stream of \a streamSize bytes.
+ *
+ * Blocks are never read beyond \a streamSize. Pass nullptr to deactivate the cache.
+ *
+ * \remarks Clears all cached blocks.
+ */
+void BlockCache::setStream(istream *stream, uint64 streamSize)
+{
+    m_stream = stream;
+    m_streamSize = stream ? streamSize : 0;
+    clear();
+}
+
+/*!
+ * \brief Sets the block size in byte.
+ *
+ * A larger block size reduces the number of reads on slow (eg. spinning) disks. A smaller block size
+ * reduces the amount of data read unnecessarily when parsing sparsely distributed elements.
+ *
+ * \remarks Clears all cached blocks.
+ */
+void BlockCache::setBlockSize(std::size_t blockSize)
+{
+    m_blockSize = max<size_t>(blockSize, 1);
+    clear();
+}
+
+/*!
+ * \brief Sets the maximum number of blocks kept in memory.
+ * \remarks A capacity of zero causes all reads to bypass the cache.
+ */
+void BlockCache::setCapacity(std::size_t capacity)
+{
+    m_capacity = capacity;
+    while(m_blocks.size() > m_capacity) {
+        evict();
+    }
+}
+
+/*!
+ * \brief Discards all cached blocks.
+ * \remarks Does not reset the hit and miss counters.
+ */
+void BlockCache::clear()
+{
+    m_index.clear();
+    m_blocks.clear();
+}
+
+/*!
+ * \brief Reads \a count bytes at the specified \a offset into the specified \a buffer.
+ *
+ * Reads larger than the block size and reads exceeding the stream size bypass the cache and are
+ * directly performed on the stream.
+ *
+ * \remarks The cache must be active.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void BlockCache::read(uint64 offset, char *buffer, std::size_t count)
+{
+    if(!m_capacity || count > m_blockSize || offset > m_streamSize || count > m_streamSize - offset) {
+        ++m_misses;
+        m_stream->seekg(static_cast<streamoff>(offset));
+        m_stream->read(buffer, static_cast<streamsize>(count));
+        return;
+    }
+    while(count) {
+        const Block &block = this->block(offset / m_blockSize);
+        const size_t offsetInBlock = static_cast<size_t>(offset % m_blockSize);
+        const size_t bytesFromBlock = min(count, block.size - offsetInBlock);
+        memcpy(buffer, block.data.get() + offsetInBlock, bytesFromBlock);
+        buffer += bytesFromBlock;
+        offset += bytesFromBlock;
+        count -= bytesFromBlock;
+    }
+}
+
+/*!
+ * \brief Returns the block with the specified \a index reading it from the stream if not cached yet.
+ * \remarks Marks the block as most recently used.
+ */
+const BlockCache::Block &BlockCache::block(uint64 index)
+{
+    const auto cached = m_index.find(index);
+    if(cached != m_index.end()) {
+        ++m_hits;
+        m_blocks.splice(m_blocks.begin(), m_blocks, cached->second);
+        return m_blocks.front();
+    }
+    ++m_misses;
+    if(m_blocks.size() >= m_capacity) {
+        evict();
+    }
+    const uint64 blockOffset = index * m_blockSize;
+    const size_t size = static_cast<size_t>(min<uint64>(m_blockSize, m_streamSize - blockOffset));
+    auto data = make_unique<char[]>(size);
+    m_stream->seekg(static_cast<streamoff>(blockOffset));
+    m_stream->read(data.get(), static_cast<streamsize>(size));
+    m_blocks.push_front(Block{index, size, move(data)});
+    m_index[index] = m_blocks.begin();
+    return m_blocks.front();
+}
+
+/*!
+ * \brief Discards the least recently used block.
+ */
+void BlockCache::evict()
+{
+    if(!m_blocks.empty()) {
+        m_index.erase(m_blocks.back().index);
+        m_blocks.pop_back();
+    }
+}
+
+}
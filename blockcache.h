@@ -0,0 +1,137 @@
+#ifndef MEDIA_BLOCKCACHE_H
+#define MEDIA_BLOCKCACHE_H
+
+#include "./global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT BlockCache
+{
+public:
+    BlockCache(std::size_t blockSize = 0x1000, std::size_t capacity = 0x40);
+    BlockCache(const BlockCache &) = delete;
+    BlockCache &operator=(const BlockCache &) = delete;
+
+    std::istream *stream() const;
+    uint64 streamSize() const;
+    void setStream(std::istream *stream, uint64 streamSize);
+    bool isActive() const;
+    std::size_t blockSize() const;
+    void setBlockSize(std::size_t blockSize);
+    std::size_t capacity() const;
+    void setCapacity(std::size_t capacity);
+    std::size_t blockCount() const;
+    uint64 hits() const;
+    uint64 misses() const;
+    void resetCounters();
+    void clear();
+    void read(uint64 offset, char *buffer, std::size_t count);
+
+private:
+    /// \brief The Block struct holds the data of a cached block.
+    struct Block
+    {
+        uint64 index;
+        std::size_t size;
+        std::unique_ptr<char[]> data;
+    };
+
+    const Block &block(uint64 index);
+    void evict();
+
+    std::istream *m_stream;
+    uint64 m_streamSize;
+    std::size_t m_blockSize;
+    std::size_t m_capacity;
+    std::list<Block> m_blocks;
+    std::unordered_map<uint64, std::list<Block>::iterator> m_index;
+    uint64 m_hits;
+    uint64 m_misses;
+};
+
+/*!
+ * \brief Returns the stream the cached data is read from.
+ * \remarks Returns nullptr if no stream is assigned (the cache is inactive in this case).
+ */
+inline std::istream *BlockCache::stream() const
+{
+    return m_stream;
+}
+
+/*!
+ * \brief Returns the size of the stream (which has been specified when assigning the stream).
+ */
+inline uint64 BlockCache::streamSize() const
+{
+    return m_streamSize;
+}
+
+/*!
+ * \brief Returns whether a stream is assigned so the cache can be used.
+ */
+inline bool BlockCache::isActive() const
+{
+    return m_stream != nullptr;
+}
+
+/*!
+ * \brief Returns the block size in byte.
+ */
+inline std::size_t BlockCache::blockSize() const
+{
+    return m_blockSize;
+}
+
+/*!
+ * \brief Returns the maximum number of blocks kept in memory.
+ */
+inline std::size_t BlockCache::capacity() const
+{
+    return m_capacity;
+}
+
+/*!
+ * \brief Returns the number of blocks currently kept in memory.
+ */
+inline std::size_t BlockCache::blockCount() const
+{
+    return m_blocks.size();
+}
+
+/*!
+ * \brief Returns the number of block lookups which could be served from memory.
+ * \sa misses(), resetCounters()
+ */
+inline uint64 BlockCache::hits() const
+{
+    return m_hits;
+}
+
+/*!
+ * \brief Returns the number of block lookups which required reading from the stream.
+ * \remarks Reads bypassing the cache (see read()) are counted as misses as well.
+ * \sa hits(), resetCounters()
+ */
+inline uint64 BlockCache::misses() const
+{
+    return m_misses;
+}
+
+/*!
+ * \brief Resets the hit and miss counters.
+ */
+inline void BlockCache::resetCounters()
+{
+    m_hits = m_misses = 0;
+}
+
+}
+
+#endif // MEDIA_BLOCKCACHE_H
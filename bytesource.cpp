@@ -0,0 +1,276 @@
+#include "./bytesource.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ios>
+#include <limits>
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::ByteSource
+ * \brief The ByteSource class is the interface for sources of data which can be parsed without being present
+ *        as a local file, eg. objects of a blob store which are read using range requests.
+ *
+ * A source only needs to provide its size() and random access via readAt(). To parse a source, assign it to
+ * a MediaFileInfo using BasicFileInfo::setByteSource(). Sources with high latency should be wrapped using a
+ * CachingByteSource.
+ */
+
+/*!
+ * \brief Destroys the source.
+ */
+ByteSource::~ByteSource()
+{}
+
+/*!
+ * \class Media::CachingByteSource
+ * \brief The CachingByteSource class wraps another ByteSource and coalesces small reads into few range requests.
+ *
+ * Parsers read lots of small element headers at nearby offsets. Forwarding each of these reads as a range request
+ * to a remote source would be very slow. Hence requests are extended to at least minimumRequestSize() bytes and the
+ * received data is cached. Received ranges which adjoin each other are merged so reads spanning several requests can
+ * be served from the cache as well. Missing parts of a read are requested at once; a request never overlaps data which
+ * is already cached.
+ *
+ * At most capacity() bytes are kept in memory. If the capacity is exceeded, the ranges farthest away from the requested
+ * offset are discarded first.
+ *
+ * \remarks The underlying source is assumed to be immutable.
+ */
+
+/*!
+ * \brief Constructs a new cache for the specified \a source.
+ */
+CachingByteSource::CachingByteSource(ByteSource &source, std::size_t minimumRequestSize, uint64 capacity) :
+    m_source(source),
+    m_minimumRequestSize(minimumRequestSize),
+    m_capacity(capacity),
+    m_cachedSize(0),
+    m_requestCount(0),
+    m_bytesRequested(0)
+{}
+
+/*!
+ * \brief Sets the maximum number of bytes kept in memory.
+ * \remarks Reads larger than the capacity are still possible; in this case the entire cache is used for that read.
+ */
+void CachingByteSource::setCapacity(uint64 capacity)
+{
+    m_capacity = capacity;
+    while(m_cachedSize > m_capacity) {
+        evict(0);
+    }
+}
+
+/*!
+ * \brief Discards all cached data.
+ * \remarks Does not reset the request counters.
+ */
+void CachingByteSource::clear()
+{
+    m_ranges.clear();
+    m_cachedSize = 0;
+}
+
+/*!
+ * \brief Reads \a count bytes at the specified \a offset into the specified \a buffer.
+ *
+ * Cached parts are copied from memory; missing parts are requested from the underlying source.
+ *
+ * \throws Throws std::ios_base::failure when the range exceeds size() or the underlying source fails.
+ */
+void CachingByteSource::readAt(uint64 offset, char *buffer, std::size_t count)
+{
+    const uint64 size = this->size();
+    if(offset > size || count > size - offset) {
+        throw ios_base::failure("Attempt to read beyond the end of the byte source.");
+    }
+    while(count) {
+        // find range containing offset
+        auto range = m_ranges.upper_bound(offset);
+        if(range != m_ranges.begin() && offset < (--range)->first + range->second.size()) {
+            const size_t offsetInRange = static_cast<size_t>(offset - range->first);
+            const size_t bytesFromRange = min(count, range->second.size() - offsetInRange);
+            memcpy(buffer, range->second.data() + offsetInRange, bytesFromRange);
+            buffer += bytesFromRange;
+            offset += bytesFromRange;
+            count -= bytesFromRange;
+        } else {
+            request(offset, count);
+        }
+    }
+}
+
+/*!
+ * \brief Requests data starting at the specified \a offset from the underlying source.
+ *
+ * At least \a count or minimumRequestSize() bytes are requested. The request stops at the next cached range and is
+ * merged with the adjoining ranges afterwards.
+ *
+ * \remarks The specified \a offset must not be cached yet.
+ */
+void CachingByteSource::request(uint64 offset, std::size_t count)
+{
+    // determine end of request
+    const auto nextRange = m_ranges.upper_bound(offset);
+    const uint64 end = min<uint64>({
+        offset + max(count, m_minimumRequestSize),
+        nextRange != m_ranges.end() ? nextRange->first : numeric_limits<uint64>::max(),
+        size()
+    });
+    const size_t requestSize = static_cast<size_t>(end - offset);
+
+    // make room for the requested data
+    while(m_cachedSize && m_cachedSize + requestSize > m_capacity) {
+        evict(offset);
+    }
+
+    // request data
+    string data(requestSize, '\0');
+    m_source.readAt(offset, &data[0], requestSize);
+    ++m_requestCount;
+    m_bytesRequested += requestSize;
+    m_cachedSize += requestSize;
+
+    // merge with adjoining ranges
+    auto range = m_ranges.emplace(offset, move(data)).first;
+    if(range != m_ranges.begin()) {
+        auto previous = prev(range);
+        if(previous->first + previous->second.size() == offset) {
+            previous->second.append(range->second);
+            m_ranges.erase(range);
+            range = previous;
+        }
+    }
+    auto following = next(range);
+    if(following != m_ranges.end() && range->first + range->second.size() == following->first) {
+        range->second.append(following->second);
+        m_ranges.erase(following);
+    }
+}
+
+/*!
+ * \brief Discards the range farthest away from the specified \a offset.
+ */
+void CachingByteSource::evict(uint64 offset)
+{
+    if(m_ranges.empty()) {
+        return;
+    }
+    const auto first = m_ranges.begin(), last = prev(m_ranges.end());
+    const auto victim = (offset - min(offset, first->first)) > (last->first - min(last->first, offset)) ? first : last;
+    m_cachedSize -= victim->second.size();
+    m_ranges.erase(victim);
+}
+
+/*!
+ * \class Media::ByteSourceStreamBuffer
+ * \brief The ByteSourceStreamBuffer class allows reading from a ByteSource using a std::istream.
+ *
+ * This way parsers which operate on streams (eg. tag and track parsers) can read from a ByteSource as well. The
+ * buffer is read-only; attempts to write fail.
+ */
+
+/*!
+ * \brief Constructs a new buffer for the specified \a source reading \a bufferSize bytes at once.
+ */
+ByteSourceStreamBuffer::ByteSourceStreamBuffer(ByteSource &source, std::size_t bufferSize) :
+    m_source(source),
+    m_buffer(make_unique<char[]>(max<size_t>(bufferSize, 1))),
+    m_bufferSize(max<size_t>(bufferSize, 1)),
+    m_bufferOffset(0)
+{
+    setg(m_buffer.get(), m_buffer.get(), m_buffer.get());
+}
+
+/*!
+ * \brief Reads the next chunk from the source.
+ */
+ByteSourceStreamBuffer::int_type ByteSourceStreamBuffer::underflow()
+{
+    const uint64 position = this->position(), size = m_source.size();
+    if(position >= size) {
+        return traits_type::eof();
+    }
+    const size_t count = static_cast<size_t>(min<uint64>(m_bufferSize, size - position));
+    m_source.readAt(position, m_buffer.get(), count);
+    m_bufferOffset = position;
+    setg(m_buffer.get(), m_buffer.get(), m_buffer.get() + count);
+    return traits_type::to_int_type(*gptr());
+}
+
+/*!
+ * \brief Reads \a count bytes into the specified \a buffer.
+ * \remarks Reads not smaller than the buffer size are forwarded directly to the source.
+ */
+streamsize ByteSourceStreamBuffer::xsgetn(char_type *buffer, streamsize count)
+{
+    if(count < static_cast<streamsize>(m_bufferSize)) {
+        return streambuf::xsgetn(buffer, count);
+    }
+    // take buffered data
+    const streamsize buffered = min<streamsize>(count, egptr() - gptr());
+    memcpy(buffer, gptr(), static_cast<size_t>(buffered));
+    gbump(static_cast<int>(buffered));
+    // read remaining data directly
+    const uint64 position = this->position(), size = m_source.size();
+    const size_t remaining = static_cast<size_t>(min<uint64>(static_cast<uint64>(count - buffered), size - min(position, size)));
+    m_source.readAt(position, buffer + buffered, remaining);
+    m_bufferOffset = position + remaining;
+    setg(m_buffer.get(), m_buffer.get(), m_buffer.get());
+    return buffered + static_cast<streamsize>(remaining);
+}
+
+/*!
+ * \brief Returns the number of bytes available until the end of the source.
+ */
+streamsize ByteSourceStreamBuffer::showmanyc()
+{
+    const uint64 position = this->position(), size = m_source.size();
+    return position < size ? static_cast<streamsize>(size - position) : -1;
+}
+
+/*!
+ * \brief Sets the read position; positions correspond to offsets within the source.
+ */
+ByteSourceStreamBuffer::pos_type ByteSourceStreamBuffer::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    if(!(which & ios_base::in)) {
+        return pos_type(off_type(-1));
+    }
+    switch(dir) {
+    case ios_base::cur:
+        off += static_cast<off_type>(position());
+        break;
+    case ios_base::end:
+        off += static_cast<off_type>(m_source.size());
+        break;
+    default:
+        ;
+    }
+    if(off < 0 || static_cast<uint64>(off) > m_source.size()) {
+        return pos_type(off_type(-1));
+    }
+    const uint64 position = static_cast<uint64>(off);
+    if(position >= m_bufferOffset && position <= m_bufferOffset + static_cast<uint64>(egptr() - eback())) {
+        // keep buffered data
+        setg(eback(), eback() + (position - m_bufferOffset), egptr());
+    } else {
+        m_bufferOffset = position;
+        setg(m_buffer.get(), m_buffer.get(), m_buffer.get());
+    }
+    return pos_type(off);
+}
+
+/*!
+ * \brief Sets the read position to the specified absolute \a pos.
+ */
+ByteSourceStreamBuffer::pos_type ByteSourceStreamBuffer::seekpos(pos_type pos, ios_base::openmode which)
+{
+    return seekoff(off_type(pos), ios_base::beg, which);
+}
+
+}
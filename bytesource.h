@@ -0,0 +1,194 @@
+#ifndef MEDIA_BYTESOURCE_H
+#define MEDIA_BYTESOURCE_H
+
+#include "./global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <map>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT ByteSource
+{
+public:
+    virtual ~ByteSource();
+
+    /*!
+     * \brief Returns the total number of bytes provided by the source.
+     */
+    virtual uint64 size() const = 0;
+
+    /*!
+     * \brief Reads \a count bytes at the specified \a offset into the specified \a buffer.
+     * \throws Throws std::ios_base::failure when the data can not be read entirely.
+     */
+    virtual void readAt(uint64 offset, char *buffer, std::size_t count) = 0;
+};
+
+class TAG_PARSER_EXPORT CachingByteSource : public ByteSource
+{
+public:
+    CachingByteSource(ByteSource &source, std::size_t minimumRequestSize = 0x10000, uint64 capacity = 0x1000000);
+    CachingByteSource(const CachingByteSource &) = delete;
+    CachingByteSource &operator=(const CachingByteSource &) = delete;
+
+    ByteSource &source() const;
+    uint64 size() const override;
+    void readAt(uint64 offset, char *buffer, std::size_t count) override;
+    std::size_t minimumRequestSize() const;
+    void setMinimumRequestSize(std::size_t minimumRequestSize);
+    uint64 capacity() const;
+    void setCapacity(uint64 capacity);
+    uint64 cachedSize() const;
+    std::size_t rangeCount() const;
+    uint64 requestCount() const;
+    uint64 bytesRequested() const;
+    void resetCounters();
+    void clear();
+
+private:
+    void request(uint64 offset, std::size_t count);
+    void evict(uint64 offset);
+
+    ByteSource &m_source;
+    std::map<uint64, std::string> m_ranges;
+    std::size_t m_minimumRequestSize;
+    uint64 m_capacity;
+    uint64 m_cachedSize;
+    uint64 m_requestCount;
+    uint64 m_bytesRequested;
+};
+
+/*!
+ * \brief Returns the underlying source.
+ */
+inline ByteSource &CachingByteSource::source() const
+{
+    return m_source;
+}
+
+/*!
+ * \brief Returns the size of the underlying source.
+ */
+inline uint64 CachingByteSource::size() const
+{
+    return m_source.size();
+}
+
+/*!
+ * \brief Returns the minimum number of bytes requested from the underlying source at once.
+ *
+ * Small reads are extended to this size so subsequent reads of nearby data (eg. the headers of sibling
+ * elements) are served from the cache.
+ */
+inline std::size_t CachingByteSource::minimumRequestSize() const
+{
+    return m_minimumRequestSize;
+}
+
+/*!
+ * \brief Sets the minimum number of bytes requested from the underlying source at once.
+ * \sa minimumRequestSize()
+ */
+inline void CachingByteSource::setMinimumRequestSize(std::size_t minimumRequestSize)
+{
+    m_minimumRequestSize = minimumRequestSize;
+}
+
+/*!
+ * \brief Returns the maximum number of bytes kept in memory.
+ */
+inline uint64 CachingByteSource::capacity() const
+{
+    return m_capacity;
+}
+
+/*!
+ * \brief Returns the number of bytes currently kept in memory.
+ */
+inline uint64 CachingByteSource::cachedSize() const
+{
+    return m_cachedSize;
+}
+
+/*!
+ * \brief Returns the number of distinct ranges currently kept in memory.
+ * \remarks Adjacent ranges are merged so this is usually much less than requestCount().
+ */
+inline std::size_t CachingByteSource::rangeCount() const
+{
+    return m_ranges.size();
+}
+
+/*!
+ * \brief Returns the number of range requests made to the underlying source.
+ */
+inline uint64 CachingByteSource::requestCount() const
+{
+    return m_requestCount;
+}
+
+/*!
+ * \brief Returns the number of bytes requested from the underlying source.
+ */
+inline uint64 CachingByteSource::bytesRequested() const
+{
+    return m_bytesRequested;
+}
+
+/*!
+ * \brief Resets the request counters.
+ */
+inline void CachingByteSource::resetCounters()
+{
+    m_requestCount = m_bytesRequested = 0;
+}
+
+class TAG_PARSER_EXPORT ByteSourceStreamBuffer : public std::streambuf
+{
+public:
+    ByteSourceStreamBuffer(ByteSource &source, std::size_t bufferSize = 0x1000);
+    ByteSourceStreamBuffer(const ByteSourceStreamBuffer &) = delete;
+    ByteSourceStreamBuffer &operator=(const ByteSourceStreamBuffer &) = delete;
+
+    ByteSource &source() const;
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char_type *buffer, std::streamsize count) override;
+    std::streamsize showmanyc() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+
+private:
+    uint64 position() const;
+
+    ByteSource &m_source;
+    std::unique_ptr<char[]> m_buffer;
+    std::size_t m_bufferSize;
+    uint64 m_bufferOffset;
+};
+
+/*!
+ * \brief Returns the source the data is read from.
+ */
+inline ByteSource &ByteSourceStreamBuffer::source() const
+{
+    return m_source;
+}
+
+/*!
+ * \brief Returns the current read position.
+ */
+inline uint64 ByteSourceStreamBuffer::position() const
+{
+    return m_bufferOffset + static_cast<uint64>(gptr() - eback());
+}
+
+}
+
+#endif // MEDIA_BYTESOURCE_H
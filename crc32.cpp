@@ -0,0 +1,372 @@
+#include "./crc32.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <memory>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define TAG_PARSER_CRC32_X86
+# include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+# define TAG_PARSER_CRC32_ARM
+# include <sys/auxv.h>
+# include <asm/hwcap.h>
+#endif
+
+using namespace std;
+using namespace ConversionUtilities;
+
+namespace Media {
+
+/*!
+ * \class Media::Crc32
+ * \brief The Crc32 class computes CRC-32 checksums as used by Ogg pages and EBML "CRC-32" elements.
+ *
+ * Both variants use the same polynomial but differ in bit order, initial value and final XOR (see Crc32::Variant).
+ *
+ * The checksum is computed using the fastest implementation available on the current CPU which is determined
+ * once at runtime:
+ * - On x86 CPUs supporting PCLMULQDQ (and SSSE3), the data is folded 64 bytes at a time using carry-less
+ *   multiplication. The non-reflected Ogg variant is computed by reflecting the bits of the input.
+ * - On ARMv8 CPUs supporting the CRC32 extension, the CRC32X instruction processes 8 bytes at a time.
+ * - Otherwise, a table-driven implementation processing 8 bytes at a time (slicing-by-8) is used.
+ *
+ * All implementations yield the same results. The hardware accelerated implementations can be disabled using
+ * setHardwareAccelerationEnabled(), eg. for testing purposes.
+ */
+
+/// \brief The reflected representation of the CRC-32 polynomial 0x04C11DB7.
+static constexpr uint32 reflectedPolynomial = 0xEDB88320;
+
+/// \brief The normal representation of the CRC-32 polynomial.
+static constexpr uint32 normalPolynomial = 0x04C11DB7;
+
+/// \brief The private Crc32Tables struct holds the lookup tables used by the slicing-by-8 implementation.
+struct Crc32Tables
+{
+    Crc32Tables();
+
+    uint32 reflected[8][256];
+    uint32 normal[8][256];
+};
+
+/// \brief Computes the lookup tables.
+Crc32Tables::Crc32Tables()
+{
+    for(uint32 i = 0; i != 256; ++i) {
+        uint32 reflectedValue = i, normalValue = i << 24;
+        for(int bit = 0; bit != 8; ++bit) {
+            reflectedValue = reflectedValue & 1 ? (reflectedValue >> 1) ^ reflectedPolynomial : reflectedValue >> 1;
+            normalValue = normalValue & 0x80000000 ? (normalValue << 1) ^ normalPolynomial : normalValue << 1;
+        }
+        reflected[0][i] = reflectedValue;
+        normal[0][i] = normalValue;
+    }
+    for(size_t table = 1; table != 8; ++table) {
+        for(uint32 i = 0; i != 256; ++i) {
+            reflected[table][i] = (reflected[table - 1][i] >> 8) ^ reflected[0][reflected[table - 1][i] & 0xFF];
+            normal[table][i] = (normal[table - 1][i] << 8) ^ normal[0][normal[table - 1][i] >> 24];
+        }
+    }
+}
+
+/// \brief Returns the lookup tables (which are computed on the first call).
+static const Crc32Tables &crc32Tables()
+{
+    static const Crc32Tables tables;
+    return tables;
+}
+
+/// \brief Returns \a value with the order of its bits reversed.
+static inline uint32 reverseBits(uint32 value)
+{
+    value = ((value >> 1) & 0x55555555) | ((value & 0x55555555) << 1);
+    value = ((value >> 2) & 0x33333333) | ((value & 0x33333333) << 2);
+    value = ((value >> 4) & 0x0F0F0F0F) | ((value & 0x0F0F0F0F) << 4);
+    value = ((value >> 8) & 0x00FF00FF) | ((value & 0x00FF00FF) << 8);
+    return (value >> 16) | (value << 16);
+}
+
+/// \brief Updates the register \a state of a reflected CRC with the specified \a data using slicing-by-8.
+static uint32 updateReflectedPortable(uint32 state, const char *data, size_t size)
+{
+    const auto &table = crc32Tables().reflected;
+    for(; size >= 8; data += 8, size -= 8) {
+        const uint32 first = LE::toUInt32(data) ^ state, second = LE::toUInt32(data + 4);
+        state = table[7][first & 0xFF] ^ table[6][(first >> 8) & 0xFF] ^ table[5][(first >> 16) & 0xFF] ^ table[4][first >> 24]
+                ^ table[3][second & 0xFF] ^ table[2][(second >> 8) & 0xFF] ^ table[1][(second >> 16) & 0xFF] ^ table[0][second >> 24];
+    }
+    for(; size; ++data, --size) {
+        state = (state >> 8) ^ table[0][(state ^ static_cast<byte>(*data)) & 0xFF];
+    }
+    return state;
+}
+
+/// \brief Updates the register \a state of a non-reflected CRC with the specified \a data using slicing-by-8.
+static uint32 updateNormalPortable(uint32 state, const char *data, size_t size)
+{
+    const auto &table = crc32Tables().normal;
+    for(; size >= 8; data += 8, size -= 8) {
+        const uint32 first = BE::toUInt32(data) ^ state, second = BE::toUInt32(data + 4);
+        state = table[7][first >> 24] ^ table[6][(first >> 16) & 0xFF] ^ table[5][(first >> 8) & 0xFF] ^ table[4][first & 0xFF]
+                ^ table[3][second >> 24] ^ table[2][(second >> 16) & 0xFF] ^ table[1][(second >> 8) & 0xFF] ^ table[0][second & 0xFF];
+    }
+    for(; size; ++data, --size) {
+        state = (state << 8) ^ table[0][(state >> 24) ^ static_cast<byte>(*data)];
+    }
+    return state;
+}
+
+#ifdef TAG_PARSER_CRC32_X86
+
+/// \brief Loads 16 bytes of the specified \a data reflecting the bits of each byte if \a reflectInput is true.
+template<bool reflectInput>
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i loadBlock(const char *data)
+{
+    const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    if(!reflectInput) {
+        return value;
+    }
+    const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+    const __m128i reflectedNibbles = _mm_setr_epi8(0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF);
+    const __m128i low = _mm_shuffle_epi8(reflectedNibbles, _mm_and_si128(value, lowNibbles));
+    const __m128i high = _mm_shuffle_epi8(reflectedNibbles, _mm_and_si128(_mm_srli_epi16(value, 4), lowNibbles));
+    return _mm_or_si128(_mm_slli_epi16(low, 4), high);
+}
+
+/// \brief Folds the specified \a value using the specified \a constants into the \a next block.
+__attribute__((target("pclmul,ssse3")))
+static inline __m128i foldBlock(__m128i value, __m128i constants, __m128i next)
+{
+    const __m128i low = _mm_clmulepi64_si128(value, constants, 0x00);
+    const __m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(high, low), next);
+}
+
+/*!
+ * \brief Updates the register \a state of a reflected CRC with the specified \a data using carry-less multiplication.
+ *
+ * The folding constants are the ones for the reflected CRC-32 polynomial given in "Fast CRC Computation for Generic
+ * Polynomials Using PCLMULQDQ Instruction" (Intel, 2009).
+ *
+ * If \a reflectInput is true, the bits of each input byte are reflected before processing. This allows computing
+ * non-reflected checksums (see updateNormalPclmul()).
+ *
+ * \remarks The \a size must be at least 64 and a multiple of 16.
+ */
+template<bool reflectInput>
+__attribute__((target("pclmul,ssse3")))
+static uint32 foldPclmul(uint32 state, const char *data, size_t size)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01C6E41596, 0x0154442BD4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00CCAA009E, 0x01751997D0);
+    const __m128i k5k0 = _mm_set_epi64x(0x0000000000, 0x0163CD6124);
+    const __m128i polynomial = _mm_set_epi64x(0x01F7011641, 0x01DB710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    // fold blocks of 64 bytes in parallel
+    __m128i x1 = _mm_xor_si128(loadBlock<reflectInput>(data), _mm_cvtsi32_si128(static_cast<int>(state)));
+    __m128i x2 = loadBlock<reflectInput>(data + 0x10);
+    __m128i x3 = loadBlock<reflectInput>(data + 0x20);
+    __m128i x4 = loadBlock<reflectInput>(data + 0x30);
+    for(data += 64, size -= 64; size >= 64; data += 64, size -= 64) {
+        x1 = foldBlock(x1, k1k2, loadBlock<reflectInput>(data));
+        x2 = foldBlock(x2, k1k2, loadBlock<reflectInput>(data + 0x10));
+        x3 = foldBlock(x3, k1k2, loadBlock<reflectInput>(data + 0x20));
+        x4 = foldBlock(x4, k1k2, loadBlock<reflectInput>(data + 0x30));
+    }
+
+    // fold into 128 bits and continue with remaining blocks of 16 bytes
+    x1 = foldBlock(x1, k3k4, x2);
+    x1 = foldBlock(x1, k3k4, x3);
+    x1 = foldBlock(x1, k3k4, x4);
+    for(; size >= 16; data += 16, size -= 16) {
+        x1 = foldBlock(x1, k3k4, loadBlock<reflectInput>(data));
+    }
+
+    // fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5k0, 0x00), x2);
+
+    // reduce to 32 bits using Barrett reduction
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), polynomial, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), polynomial, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return static_cast<uint32>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+
+/// \brief Updates the register \a state of a reflected CRC using carry-less multiplication where possible.
+static uint32 updateReflectedPclmul(uint32 state, const char *data, size_t size)
+{
+    if(size >= 64) {
+        const size_t foldableSize = size & ~static_cast<size_t>(15);
+        state = foldPclmul<false>(state, data, foldableSize);
+        data += foldableSize;
+        size -= foldableSize;
+    }
+    return updateReflectedPortable(state, data, size);
+}
+
+/// \brief Updates the register \a state of a non-reflected CRC using carry-less multiplication where possible.
+static uint32 updateNormalPclmul(uint32 state, const char *data, size_t size)
+{
+    if(size >= 64) {
+        // a non-reflected CRC equals the reflected CRC of the reflected input (with reflected register)
+        const size_t foldableSize = size & ~static_cast<size_t>(15);
+        state = reverseBits(foldPclmul<true>(reverseBits(state), data, foldableSize));
+        data += foldableSize;
+        size -= foldableSize;
+    }
+    return updateNormalPortable(state, data, size);
+}
+
+#endif // TAG_PARSER_CRC32_X86
+
+#ifdef TAG_PARSER_CRC32_ARM
+
+/// \brief Updates the register \a state of a reflected CRC with the specified 8 bytes using the CRC32X instruction.
+static inline uint32 crc32x(uint32 state, uint64 value)
+{
+    __asm__(".arch_extension crc\n\tcrc32x %w0, %w0, %x1" : "+r"(state) : "r"(value));
+    return state;
+}
+
+/// \brief Updates the register \a state of a reflected CRC with the specified byte using the CRC32B instruction.
+static inline uint32 crc32b(uint32 state, uint32 value)
+{
+    __asm__(".arch_extension crc\n\tcrc32b %w0, %w0, %w1" : "+r"(state) : "r"(value));
+    return state;
+}
+
+/// \brief Returns \a value with the order of the bits within each byte reversed.
+static inline uint64 reverseBitsOfBytes(uint64 value)
+{
+    value = ((value >> 1) & 0x5555555555555555ul) | ((value & 0x5555555555555555ul) << 1);
+    value = ((value >> 2) & 0x3333333333333333ul) | ((value & 0x3333333333333333ul) << 2);
+    return ((value >> 4) & 0x0F0F0F0F0F0F0F0Ful) | ((value & 0x0F0F0F0F0F0F0F0Ful) << 4);
+}
+
+/// \brief Updates the register \a state of a reflected CRC using the CRC32 instructions.
+static uint32 updateReflectedArm(uint32 state, const char *data, size_t size)
+{
+    for(; size >= 8; data += 8, size -= 8) {
+        state = crc32x(state, LE::toUInt64(data));
+    }
+    for(; size; ++data, --size) {
+        state = crc32b(state, static_cast<byte>(*data));
+    }
+    return state;
+}
+
+/// \brief Updates the register \a state of a non-reflected CRC using the CRC32 instructions.
+static uint32 updateNormalArm(uint32 state, const char *data, size_t size)
+{
+    // a non-reflected CRC equals the reflected CRC of the reflected input (with reflected register)
+    state = reverseBits(state);
+    for(; size >= 8; data += 8, size -= 8) {
+        state = crc32x(state, reverseBitsOfBytes(LE::toUInt64(data)));
+    }
+    for(; size; ++data, --size) {
+        state = crc32b(state, static_cast<byte>(reverseBitsOfBytes(static_cast<byte>(*data))));
+    }
+    return reverseBits(state);
+}
+
+#endif // TAG_PARSER_CRC32_ARM
+
+/// \brief The private Crc32Implementation struct holds the functions of an implementation.
+struct Crc32Implementation
+{
+    const char *name;
+    uint32 (*updateNormal)(uint32 state, const char *data, size_t size);
+    uint32 (*updateReflected)(uint32 state, const char *data, size_t size);
+};
+
+/// \brief The table-driven implementation which is always available.
+static const Crc32Implementation portableImplementation = {"slicing-by-8", &updateNormalPortable, &updateReflectedPortable};
+
+/// \brief Returns the fastest implementation supported by the current CPU (which is determined on the first call).
+static const Crc32Implementation &hardwareImplementation()
+{
+#if defined(TAG_PARSER_CRC32_X86)
+    static const Crc32Implementation pclmulImplementation = {"PCLMULQDQ", &updateNormalPclmul, &updateReflectedPclmul};
+    static const bool supported = __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+    return supported ? pclmulImplementation : portableImplementation;
+#elif defined(TAG_PARSER_CRC32_ARM)
+    static const Crc32Implementation armImplementation = {"ARMv8 CRC32", &updateNormalArm, &updateReflectedArm};
+    static const bool supported = getauxval(AT_HWCAP) & HWCAP_CRC32;
+    return supported ? armImplementation : portableImplementation;
+#else
+    return portableImplementation;
+#endif
+}
+
+/// \brief Whether hardware acceleration is enabled.
+static atomic<bool> hardwareAccelerationEnabled(true);
+
+/// \brief Returns the implementation to be used.
+static const Crc32Implementation &implementation()
+{
+    return hardwareAccelerationEnabled.load(memory_order_relaxed) ? hardwareImplementation() : portableImplementation;
+}
+
+/*!
+ * \brief Updates the checksum with \a size bytes of the specified \a data.
+ */
+void Crc32::update(const char *data, std::size_t size)
+{
+    const Crc32Implementation &implementation = Media::implementation();
+    m_state = m_variant == Variant::Ebml
+            ? implementation.updateReflected(m_state, data, size)
+            : implementation.updateNormal(m_state, data, size);
+}
+
+/*!
+ * \brief Updates the checksum with the next \a size bytes of the specified \a stream.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void Crc32::update(std::istream &stream, uint64 size)
+{
+    const size_t bufferSize = static_cast<size_t>(min<uint64>(size, 0x10000));
+    auto buffer = make_unique<char[]>(bufferSize);
+    while(size) {
+        const size_t chunkSize = static_cast<size_t>(min<uint64>(size, bufferSize));
+        stream.read(buffer.get(), static_cast<streamsize>(chunkSize));
+        update(buffer.get(), chunkSize);
+        size -= chunkSize;
+    }
+}
+
+/*!
+ * \brief Returns the name of the implementation used to compute checksums.
+ */
+const char *Crc32::implementationName()
+{
+    return implementation().name;
+}
+
+/*!
+ * \brief Returns whether hardware acceleration is enabled (if supported by the CPU).
+ * \remarks Enabled by default.
+ */
+bool Crc32::isHardwareAccelerationEnabled()
+{
+    return hardwareAccelerationEnabled.load();
+}
+
+/*!
+ * \brief Sets whether hardware acceleration is enabled (if supported by the CPU).
+ * \remarks This setting affects all checksums computed in the process. It is mainly useful for testing.
+ */
+void Crc32::setHardwareAccelerationEnabled(bool enabled)
+{
+    hardwareAccelerationEnabled.store(enabled);
+}
+
+}
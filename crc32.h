@@ -0,0 +1,99 @@
+#ifndef MEDIA_CRC32_H
+#define MEDIA_CRC32_H
+
+#include "./global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <cstddef>
+#include <iosfwd>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT Crc32
+{
+public:
+    /*!
+     * \brief The Variant enum specifies the flavor of CRC-32.
+     */
+    enum class Variant
+    {
+        Ogg, /**< polynomial 0x04C11DB7, not reflected, initial value and final XOR 0 (used by Ogg pages) */
+        Ebml /**< polynomial 0x04C11DB7, reflected, initial value and final XOR 0xFFFFFFFF (used by EBML "CRC-32" elements) */
+    };
+
+    explicit Crc32(Variant variant);
+
+    Variant variant() const;
+    uint32 value() const;
+    void reset();
+    void update(const char *data, std::size_t size);
+    void update(std::istream &stream, uint64 size);
+
+    static uint32 compute(Variant variant, const char *data, std::size_t size);
+    static uint32 compute(Variant variant, std::istream &stream, uint64 size);
+    static const char *implementationName();
+    static bool isHardwareAccelerationEnabled();
+    static void setHardwareAccelerationEnabled(bool enabled);
+
+private:
+    Variant m_variant;
+    uint32 m_state;
+};
+
+/*!
+ * \brief Constructs a new checksum of the specified \a variant over no data.
+ */
+inline Crc32::Crc32(Variant variant) :
+    m_variant(variant),
+    m_state(variant == Variant::Ebml ? 0xFFFFFFFF : 0)
+{}
+
+/*!
+ * \brief Returns the variant of the checksum.
+ */
+inline Crc32::Variant Crc32::variant() const
+{
+    return m_variant;
+}
+
+/*!
+ * \brief Returns the checksum of the data passed to update() so far.
+ */
+inline uint32 Crc32::value() const
+{
+    return m_variant == Variant::Ebml ? ~m_state : m_state;
+}
+
+/*!
+ * \brief Resets the checksum so it covers no data.
+ */
+inline void Crc32::reset()
+{
+    m_state = m_variant == Variant::Ebml ? 0xFFFFFFFF : 0;
+}
+
+/*!
+ * \brief Returns the checksum of the specified \a variant over \a size bytes of the specified \a data.
+ */
+inline uint32 Crc32::compute(Variant variant, const char *data, std::size_t size)
+{
+    Crc32 crc(variant);
+    crc.update(data, size);
+    return crc.value();
+}
+
+/*!
+ * \brief Returns the checksum of the specified \a variant over the next \a size bytes of the specified \a stream.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+inline uint32 Crc32::compute(Variant variant, std::istream &stream, uint64 size)
+{
+    Crc32 crc(variant);
+    crc.update(stream, size);
+    return crc.value();
+}
+
+}
+
+#endif // MEDIA_CRC32_H
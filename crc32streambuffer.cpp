@@ -0,0 +1,180 @@
+#include "./crc32streambuffer.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::Crc32StreamBuffer
+ * \brief The Crc32StreamBuffer class computes CRC-32 checksums of the data written to a stream while it is written.
+ *
+ * The buffer installs itself as buffer of the specified stream and forwards all data to the original buffer of the
+ * stream. The checksums of all ranges begun via beginRange() and not ended yet are updated with the data passing
+ * through; hence ranges might be nested. This way checksums can be filled in after writing without reading the
+ * written data again.
+ *
+ * The data must be written sequentially while ranges are open. Determining the current write position is fine but
+ * seeking invalidates the checksums of open ranges.
+ *
+ * \remarks Data written to the stream by other means (eg. natively via NativeCopyHelper) is not considered.
+ */
+
+/*!
+ * \brief Installs a new buffer for the specified \a stream.
+ * \remarks The original buffer is restored when calling detach() or destroying the object.
+ */
+Crc32StreamBuffer::Crc32StreamBuffer(ostream &stream, std::size_t bufferSize) :
+    m_stream(&stream),
+    m_target(stream.rdbuf()),
+    m_buffer(make_unique<char[]>(max<size_t>(bufferSize, 1))),
+    m_bufferSize(max<size_t>(bufferSize, 1))
+{
+    setp(m_buffer.get(), m_buffer.get() + m_bufferSize);
+    m_stream->rdbuf(this);
+}
+
+/*!
+ * \brief Restores the original buffer of the stream if not done yet via detach().
+ * \remarks Pending data is discarded. So detach() must be called to finish writing regularly.
+ */
+Crc32StreamBuffer::~Crc32StreamBuffer()
+{
+    if(m_stream) {
+        m_stream->rdbuf(m_target);
+    }
+}
+
+/*!
+ * \brief Begins a new range; the checksum covers all data written until the range is ended.
+ */
+void Crc32StreamBuffer::beginRange(Crc32::Variant variant)
+{
+    updateRanges(pbase(), static_cast<size_t>(pptr() - pbase()));
+    setp(pptr(), epptr());
+    m_ranges.emplace_back(variant);
+}
+
+/*!
+ * \brief Ends the range begun last.
+ * \returns Returns the checksum of the data written since the range has been begun.
+ */
+uint32 Crc32StreamBuffer::endRange()
+{
+    updateRanges(pbase(), static_cast<size_t>(pptr() - pbase()));
+    setp(pptr(), epptr());
+    const uint32 value = m_ranges.back().value();
+    m_ranges.pop_back();
+    return value;
+}
+
+/*!
+ * \brief Writes pending data and restores the original buffer of the stream.
+ * \throws Throws std::ios_base::failure when an IO error occurs and exceptions are enabled for the stream.
+ */
+void Crc32StreamBuffer::detach()
+{
+    if(!m_stream) {
+        return;
+    }
+    const bool flushed = flushBuffer();
+    ostream *const stream = m_stream;
+    stream->rdbuf(m_target);
+    m_stream = nullptr;
+    if(!flushed) {
+        stream->setstate(ios_base::badbit);
+    }
+}
+
+/*!
+ * \brief Writes the buffered data and the specified \a ch.
+ */
+Crc32StreamBuffer::int_type Crc32StreamBuffer::overflow(int_type ch)
+{
+    if(!flushBuffer()) {
+        return traits_type::eof();
+    }
+    if(!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+/*!
+ * \brief Writes \a count bytes of the specified \a data.
+ * \remarks Writes not smaller than the buffer size are forwarded directly to the original buffer.
+ */
+streamsize Crc32StreamBuffer::xsputn(const char_type *data, streamsize count)
+{
+    if(count < static_cast<streamsize>(m_bufferSize)) {
+        return streambuf::xsputn(data, count);
+    }
+    if(!flushBuffer()) {
+        return 0;
+    }
+    const streamsize written = m_target->sputn(data, count);
+    updateRanges(data, static_cast<size_t>(written));
+    return written;
+}
+
+/*!
+ * \brief Writes the buffered data and synchronizes the original buffer.
+ */
+int Crc32StreamBuffer::sync()
+{
+    return flushBuffer() ? m_target->pubsync() : -1;
+}
+
+/*!
+ * \brief Sets the write position; only the current position can be determined without writing the buffered data.
+ */
+Crc32StreamBuffer::pos_type Crc32StreamBuffer::seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which)
+{
+    if(!(which & ios_base::out)) {
+        return pos_type(off_type(-1));
+    }
+    if(!off && dir == ios_base::cur) {
+        const pos_type position = m_target->pubseekoff(0, ios_base::cur, ios_base::out);
+        return position == pos_type(off_type(-1)) ? position : position + static_cast<off_type>(pptr() - m_buffer.get());
+    }
+    return flushBuffer() ? m_target->pubseekoff(off, dir, ios_base::out) : pos_type(off_type(-1));
+}
+
+/*!
+ * \brief Sets the write position to the specified \a pos.
+ */
+Crc32StreamBuffer::pos_type Crc32StreamBuffer::seekpos(pos_type pos, ios_base::openmode which)
+{
+    if(!(which & ios_base::out)) {
+        return pos_type(off_type(-1));
+    }
+    return flushBuffer() ? m_target->pubseekpos(pos, ios_base::out) : pos_type(off_type(-1));
+}
+
+/*!
+ * \brief Updates the checksums with the buffered data and writes it to the original buffer.
+ * \returns Returns whether all data could be written.
+ */
+bool Crc32StreamBuffer::flushBuffer()
+{
+    // the checksums have already been updated with the data before pbase() (see beginRange() and endRange())
+    updateRanges(pbase(), static_cast<size_t>(pptr() - pbase()));
+    const auto size = static_cast<streamsize>(pptr() - m_buffer.get());
+    const bool written = !size || m_target->sputn(m_buffer.get(), size) == size;
+    setp(m_buffer.get(), m_buffer.get() + m_bufferSize);
+    return written;
+}
+
+/*!
+ * \brief Updates the checksums of all open ranges with the specified \a data.
+ */
+void Crc32StreamBuffer::updateRanges(const char *data, std::size_t size)
+{
+    for(Crc32 &range : m_ranges) {
+        range.update(data, size);
+    }
+}
+
+}
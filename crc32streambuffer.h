@@ -0,0 +1,54 @@
+#ifndef MEDIA_CRC32STREAMBUFFER_H
+#define MEDIA_CRC32STREAMBUFFER_H
+
+#include "./crc32.h"
+
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT Crc32StreamBuffer : public std::streambuf
+{
+public:
+    Crc32StreamBuffer(std::ostream &stream, std::size_t bufferSize = 0x10000);
+    Crc32StreamBuffer(const Crc32StreamBuffer &) = delete;
+    Crc32StreamBuffer &operator=(const Crc32StreamBuffer &) = delete;
+    ~Crc32StreamBuffer();
+
+    std::size_t rangeCount() const;
+    void beginRange(Crc32::Variant variant = Crc32::Variant::Ebml);
+    uint32 endRange();
+    void detach();
+
+protected:
+    int_type overflow(int_type ch) override;
+    std::streamsize xsputn(const char_type *data, std::streamsize count) override;
+    int sync() override;
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which = std::ios_base::in | std::ios_base::out) override;
+
+private:
+    bool flushBuffer();
+    void updateRanges(const char *data, std::size_t size);
+
+    std::ostream *m_stream;
+    std::streambuf *m_target;
+    std::unique_ptr<char[]> m_buffer;
+    std::size_t m_bufferSize;
+    std::vector<Crc32> m_ranges;
+};
+
+/*!
+ * \brief Returns the number of ranges which have been begun but not ended yet.
+ */
+inline std::size_t Crc32StreamBuffer::rangeCount() const
+{
+    return m_ranges.size();
+}
+
+}
+
+#endif // MEDIA_CRC32STREAMBUFFER_H
@@ -0,0 +1,87 @@
+#include "./elementarena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::ElementArena
+ * \brief The ElementArena class provides memory for the elements of a container which is freed in bulk.
+ *
+ * Fully parsing a file might create millions of elements. Allocating each of them separately on the heap is slow
+ * and fragments memory. Besides, destroying a deep chain of elements owning each other recursively might exhaust the
+ * stack. Hence GenericContainer owns an arena from which the children and siblings of its elements are allocated. The
+ * elements only refer to each other and all of them are destroyed iteratively when the arena is cleared (see
+ * GenericContainer::reset()).
+ *
+ * Memory is obtained in blocks of blockSize() bytes. Requests which do not fit into a block get a dedicated block.
+ *
+ * \remarks
+ * - Memory of individual objects is never freed before the arena is cleared. So elements discarded by
+ *   GenericFileElement::clear() or GenericFileElement::reparse() remain allocated until then.
+ * - The arena is not thread-safe.
+ */
+
+/*!
+ * \brief Constructs a new arena which allocates memory in blocks of \a blockSize bytes.
+ * \remarks No memory is allocated until allocate() is called the first time.
+ */
+ElementArena::ElementArena(std::size_t blockSize) :
+    m_blockSize(max<size_t>(blockSize, 0x100)),
+    m_current(nullptr),
+    m_available(0)
+{}
+
+/*!
+ * \brief Destroys the arena and all objects living within it.
+ */
+ElementArena::~ElementArena()
+{
+    clear();
+}
+
+/*!
+ * \brief Returns a pointer to \a size bytes of uninitialized memory which is aligned to \a alignment.
+ * \remarks The memory remains valid until the arena is cleared or destroyed. Objects constructed within the memory
+ *          should be registered using registerObject() so they are destroyed in time.
+ */
+void *ElementArena::allocate(std::size_t size, std::size_t alignment)
+{
+    const size_t padding = (alignment - reinterpret_cast<uintptr_t>(m_current) % alignment) % alignment;
+    if(m_current && padding + size <= m_available) {
+        void *const memory = m_current + padding;
+        m_current += padding + size;
+        m_available -= padding + size;
+        return memory;
+    }
+    if(size + alignment > m_blockSize) {
+        // use dedicated block for large objects (inserted before the current block to keep using the current block)
+        auto block = make_unique<char[]>(size + alignment);
+        char *const memory = block.get() + (alignment - reinterpret_cast<uintptr_t>(block.get()) % alignment) % alignment;
+        m_blocks.insert(m_current ? m_blocks.end() - 1 : m_blocks.end(), move(block));
+        return memory;
+    }
+    m_blocks.emplace_back(make_unique<char[]>(m_blockSize));
+    m_current = m_blocks.back().get();
+    m_available = m_blockSize;
+    return allocate(size, alignment);
+}
+
+/*!
+ * \brief Destroys all objects living within the arena and frees all memory.
+ */
+void ElementArena::clear()
+{
+    for(auto object = m_objects.rbegin(), end = m_objects.rend(); object != end; ++object) {
+        object->destroy(object->object);
+    }
+    m_objects.clear();
+    m_blocks.clear();
+    m_current = nullptr;
+    m_available = 0;
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef MEDIA_ELEMENTARENA_H
+#define MEDIA_ELEMENTARENA_H
+
+#include "./global.h"
+
+#include <memory>
+#include <vector>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT ElementArena
+{
+public:
+    ElementArena(std::size_t blockSize = 0x10000);
+    ElementArena(const ElementArena &) = delete;
+    ElementArena &operator=(const ElementArena &) = delete;
+    ~ElementArena();
+
+    void *allocate(std::size_t size, std::size_t alignment);
+    template <typename ObjectType> void registerObject(ObjectType *object);
+    void clear();
+    std::size_t blockSize() const;
+    std::size_t blockCount() const;
+    std::size_t objectCount() const;
+
+private:
+    /// \brief The Object struct holds an object constructed within the arena and the function to destroy it.
+    struct Object
+    {
+        void *object;
+        void (*destroy)(void *object);
+    };
+
+    template <typename ObjectType> static void destroy(void *object);
+
+    std::size_t m_blockSize;
+    std::vector<std::unique_ptr<char[]> > m_blocks;
+    char *m_current;
+    std::size_t m_available;
+    std::vector<Object> m_objects;
+};
+
+/*!
+ * \brief Registers the specified \a object which has been constructed within memory obtained via allocate().
+ *
+ * The object will be destroyed when the arena is cleared or destroyed. Objects are destroyed in the reverse order
+ * of their registration.
+ */
+template <typename ObjectType>
+inline void ElementArena::registerObject(ObjectType *object)
+{
+    m_objects.emplace_back(Object{object, &ElementArena::destroy<ObjectType>});
+}
+
+/*!
+ * \brief Destroys the specified \a object of the specified \a ObjectType without freeing its memory.
+ */
+template <typename ObjectType>
+void ElementArena::destroy(void *object)
+{
+    static_cast<ObjectType *>(object)->~ObjectType();
+}
+
+/*!
+ * \brief Returns the size of the memory blocks allocated by the arena.
+ */
+inline std::size_t ElementArena::blockSize() const
+{
+    return m_blockSize;
+}
+
+/*!
+ * \brief Returns the number of memory blocks currently allocated by the arena.
+ */
+inline std::size_t ElementArena::blockCount() const
+{
+    return m_blocks.size();
+}
+
+/*!
+ * \brief Returns the number of objects currently living within the arena.
+ */
+inline std::size_t ElementArena::objectCount() const
+{
+    return m_objects.size();
+}
+
+}
+
+#endif // MEDIA_ELEMENTARENA_H
@@ -0,0 +1,390 @@
+#include "./flacframescanner.h"
+
+#include "../basicfileinfo.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/catchiofailure.h>
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace ChronoUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/// \brief The maximum size of a frame header (sync code and flags, UTF-8 coded number of up to 7 bytes, block size,
+///        sampling frequency and CRC-8).
+static constexpr size_t maxHeaderSize = 16;
+
+/// \brief The maximum number of frames which might be missing between two frames before a header is not considered
+///        to be the header of the next frame anymore.
+static constexpr uint64 maxMissingFrames = 1024;
+
+/// \brief The sampling frequencies denoted by the codes 1 to 11 of the frame header.
+static constexpr uint32 samplingFrequencyTable[] = {
+    88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000
+};
+
+/// \brief The private FlacCrcTables struct holds the lookup tables for the CRC-8 and the CRC-16 of FLAC frames.
+struct FlacCrcTables
+{
+    FlacCrcTables();
+
+    byte crc8[256];
+    uint16 crc16[8][256];
+};
+
+/// \brief Computes the lookup tables for the polynomials 0x07 (CRC-8) and 0x8005 (CRC-16).
+FlacCrcTables::FlacCrcTables()
+{
+    for(uint32 i = 0; i != 256; ++i) {
+        uint32 crc8Value = i, crc16Value = i << 8;
+        for(int bit = 0; bit != 8; ++bit) {
+            crc8Value = crc8Value & 0x80 ? (crc8Value << 1) ^ 0x07 : crc8Value << 1;
+            crc16Value = crc16Value & 0x8000 ? (crc16Value << 1) ^ 0x8005 : crc16Value << 1;
+        }
+        crc8[i] = static_cast<byte>(crc8Value);
+        crc16[0][i] = static_cast<uint16>(crc16Value);
+    }
+    for(size_t table = 1; table != 8; ++table) {
+        for(uint32 i = 0; i != 256; ++i) {
+            crc16[table][i] = static_cast<uint16>((crc16[table - 1][i] << 8) ^ crc16[0][crc16[table - 1][i] >> 8]);
+        }
+    }
+}
+
+/// \brief Returns the lookup tables (which are computed on the first call).
+static const FlacCrcTables &flacCrcTables()
+{
+    static const FlacCrcTables tables;
+    return tables;
+}
+
+/*!
+ * \class Media::FlacFrameScanner
+ * \brief The FlacFrameScanner class determines the exact sample count of a raw FLAC stream and verifies its frames
+ *        by walking all frames.
+ *
+ * FlacStream::internalParseHeader() only parses the metadata blocks. The total sample count of the
+ * "METADATA_BLOCK_STREAMINFO" might be zero (unknown) or wrong and corrupted frames are not noticed. This class walks
+ * the frames instead (the audio data itself is not decoded):
+ *
+ * FLAC frame headers do not denote the size of the frame. So the end of a frame is determined by searching the sync
+ * code of the next frame (using SSE2 if available, see findSync()). A sync code is only considered the start of the
+ * next frame if the header is valid (including its CRC-8, see readHeader()) and either the CRC-16 of the data up to
+ * the sync code matches or the header denotes the number of the next frame. The CRC-16 is computed while searching
+ * using a table-driven implementation processing 8 bytes at a time (see updateCrc16()). Frames whose CRC-16 does not
+ * match are counted as corrupted and reported as warning.
+ *
+ * Besides the statistics, a seek table suitable for the "METADATA_BLOCK_SEEKTABLE" with an entry every
+ * seekPointInterval() samples is determined.
+ *
+ * \sa FlacStream::scanFrames()
+ */
+
+/*!
+ * \brief Constructs a new scanner for the frames between \a startOffset and \a endOffset of the specified \a fileInfo.
+ * \remarks The \a startOffset should be the end of the metadata blocks and the \a endOffset should exclude trailing
+ *          tags (eg. ID3v1).
+ */
+FlacFrameScanner::FlacFrameScanner(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset) :
+    m_fileInfo(fileInfo),
+    m_startOffset(startOffset),
+    m_endOffset(max(startOffset, endOffset)),
+    m_defaultSamplingFrequency(0),
+    m_seekPointInterval(0),
+    m_frameCount(0),
+    m_corruptedFrameCount(0),
+    m_sampleCount(0),
+    m_firstFrameOffset(0),
+    m_dataSize(0),
+    m_samplingFrequency(0),
+    m_nextSeekPoint(0)
+{}
+
+/*!
+ * \brief Returns the index of the first sync code (0xFFF8 or 0xFFF9) within the specified \a data of \a size bytes.
+ * \returns Returns \a size if no sync code could be found. A sync code is only found if both of its bytes are within
+ *          the specified range.
+ */
+size_t FlacFrameScanner::findSync(const char *data, size_t size)
+{
+    size_t index = 0;
+#if defined(__SSE2__)
+    // compare 16 bytes at once: the first byte must be 0xFF and the following byte must match 1111100x
+    const __m128i allSet = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i secondMask = _mm_set1_epi8(static_cast<char>(0xFE));
+    const __m128i secondValue = _mm_set1_epi8(static_cast<char>(0xF8));
+    for(; size - index > 16; index += 16) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index + 1));
+        const int matches = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, allSet), _mm_cmpeq_epi8(_mm_and_si128(second, secondMask), secondValue)));
+        if(matches) {
+            return index + static_cast<size_t>(__builtin_ctz(static_cast<unsigned int>(matches)));
+        }
+    }
+#endif
+    for(; index + 1 < size; ++index) {
+        if(static_cast<byte>(data[index]) == 0xFF && (static_cast<byte>(data[index + 1]) & 0xFE) == 0xF8) {
+            return index;
+        }
+    }
+    return size;
+}
+
+/*!
+ * \brief Reads the frame header at the specified \a data of \a size bytes into \a header.
+ * \returns Returns the size of the header or zero if the \a data does not start with a valid header. A header is
+ *          only considered valid if no reserved values are used and its CRC-8 matches.
+ */
+byte FlacFrameScanner::readHeader(const char *data, size_t size, FlacFrameHeader &header)
+{
+    const auto *const bytes = reinterpret_cast<const byte *>(data);
+    if(size < 6 || bytes[0] != 0xFF || (bytes[1] & 0xFE) != 0xF8) {
+        return 0;
+    }
+    const byte blockSizeCode = bytes[2] >> 4, samplingFrequencyCode = bytes[2] & 0x0F;
+    const byte channelAssignment = bytes[3] >> 4, sampleSizeCode = (bytes[3] >> 1) & 0x07;
+    if(!blockSizeCode || samplingFrequencyCode == 0x0F || channelAssignment > 10 || sampleSizeCode == 3 || (bytes[3] & 0x01)) {
+        return 0;
+    }
+    header.variableBlockSize = bytes[1] & 0x01;
+    header.channelCount = channelAssignment < 8 ? channelAssignment + 1 : 2;
+
+    // read UTF-8 coded frame number (up to 31 bit) or sample number (up to 36 bit)
+    size_t index = 4;
+    const byte first = bytes[index++];
+    byte extraBytes = 0;
+    if(first & 0x80) {
+        for(byte mask = 0x40; first & mask; mask >>= 1) {
+            ++extraBytes;
+        }
+        if(!extraBytes || extraBytes > (header.variableBlockSize ? 6 : 5)) {
+            return 0;
+        }
+    }
+    header.number = first & (extraBytes ? 0x3F >> extraBytes : 0x7F);
+    for(; extraBytes; --extraBytes) {
+        if(index >= size || (bytes[index] & 0xC0) != 0x80) {
+            return 0;
+        }
+        header.number = (header.number << 6) | (bytes[index++] & 0x3F);
+    }
+
+    // read block size and sampling frequency which might be stored at the end of the header
+    const size_t extraSize = (blockSizeCode == 6 ? 1 : (blockSizeCode == 7 ? 2 : 0)) + (samplingFrequencyCode == 12 ? 1 : (samplingFrequencyCode > 12 ? 2 : 0));
+    if(index + extraSize >= size) {
+        return 0;
+    }
+    if(blockSizeCode == 1) {
+        header.blockSize = 192;
+    } else if(blockSizeCode < 6) {
+        header.blockSize = 576u << (blockSizeCode - 2);
+    } else if(blockSizeCode == 6) {
+        header.blockSize = bytes[index++] + 1u;
+    } else if(blockSizeCode == 7) {
+        header.blockSize = BE::toUInt16(data + index) + 1u;
+        index += 2;
+    } else {
+        header.blockSize = 256u << (blockSizeCode - 8);
+    }
+    if(!samplingFrequencyCode) {
+        header.samplingFrequency = 0;
+    } else if(samplingFrequencyCode < 12) {
+        header.samplingFrequency = samplingFrequencyTable[samplingFrequencyCode - 1];
+    } else if(samplingFrequencyCode == 12) {
+        header.samplingFrequency = bytes[index++] * 1000u;
+    } else {
+        header.samplingFrequency = BE::toUInt16(data + index) * (samplingFrequencyCode == 14 ? 10u : 1u);
+        index += 2;
+    }
+
+    // verify CRC-8 of the header
+    if(computeCrc8(data, index) != bytes[index]) {
+        return 0;
+    }
+    return header.size = static_cast<byte>(index + 1);
+}
+
+/*!
+ * \brief Returns the CRC-8 (polynomial 0x07, initial value 0) of the specified \a data as used by FLAC frame headers.
+ */
+byte FlacFrameScanner::computeCrc8(const char *data, size_t size)
+{
+    const auto &table = flacCrcTables().crc8;
+    byte crc = 0;
+    for(; size; ++data, --size) {
+        crc = table[crc ^ static_cast<byte>(*data)];
+    }
+    return crc;
+}
+
+/*!
+ * \brief Updates the specified \a crc with the specified \a data and returns the result.
+ *
+ * The CRC-16 (polynomial 0x8005, initial value 0) as used by FLAC frames is computed. The data is processed 8 bytes at
+ * a time (slicing-by-8). The CRC-16 over a complete frame (including its trailing CRC-16) is zero.
+ */
+uint16 FlacFrameScanner::updateCrc16(uint16 crc, const char *data, size_t size)
+{
+    const auto &table = flacCrcTables().crc16;
+    for(; size >= 8; data += 8, size -= 8) {
+        const uint32 first = BE::toUInt32(data) ^ (static_cast<uint32>(crc) << 16), second = BE::toUInt32(data + 4);
+        crc = table[7][first >> 24] ^ table[6][(first >> 16) & 0xFF] ^ table[5][(first >> 8) & 0xFF] ^ table[4][first & 0xFF]
+                ^ table[3][second >> 24] ^ table[2][(second >> 16) & 0xFF] ^ table[1][(second >> 8) & 0xFF] ^ table[0][second & 0xFF];
+    }
+    for(; size; ++data, --size) {
+        crc = static_cast<uint16>((crc << 8) ^ table[0][(crc >> 8) ^ static_cast<byte>(*data)]);
+    }
+    return crc;
+}
+
+/*!
+ * \brief Scans all frames and determines the statistics and the seek table.
+ *
+ * Problems are added as notifications. IO errors while scanning are added as critical notifications; the frames
+ * scanned so far are taken into account.
+ */
+void FlacFrameScanner::scan()
+{
+    static const string context("scanning FLAC frames");
+    invalidateStatus();
+    m_frameCount = m_corruptedFrameCount = m_sampleCount = m_firstFrameOffset = m_dataSize = m_nextSeekPoint = 0;
+    m_samplingFrequency = 0;
+    m_seekTable.clear();
+
+    try {
+        RangeReader reader(m_fileInfo.mappedData(0, m_endOffset), &m_fileInfo.stream(), m_endOffset);
+        FlacFrameHeader header, nextHeader;
+        uint16 crc = 0;
+
+        // synchronize to the first frame
+        uint64 offset = m_startOffset;
+        for(; ; ++offset) {
+            if((offset = findNextSync(reader, offset, crc)) >= m_endOffset) {
+                addNotification(NotificationType::Critical, "No FLAC frames found.", context);
+                return;
+            }
+            const size_t available = static_cast<size_t>(min<uint64>(maxHeaderSize, m_endOffset - offset));
+            if(readHeader(reader.read(offset, available), available, header)) {
+                break;
+            }
+        }
+        if(offset != m_startOffset) {
+            addNotification(NotificationType::Warning, argsToString("Skipped ", offset - m_startOffset, " bytes of invalid data at ", m_startOffset, '.'), context);
+        }
+        m_firstFrameOffset = offset;
+        m_samplingFrequency = header.samplingFrequency ? header.samplingFrequency : m_defaultSamplingFrequency;
+
+        // walk the frames; the CRC-16 is computed while searching the next frame
+        crc = updateCrc16(0, reader.read(offset, header.size), header.size);
+        for(uint64 searchOffset = offset + header.size; ; ) {
+            const uint64 nextOffset = findNextSync(reader, searchOffset, crc);
+            if(nextOffset >= m_endOffset) {
+                addFrame(offset, m_endOffset, header, !crc);
+                break;
+            }
+            const size_t available = static_cast<size_t>(min<uint64>(maxHeaderSize, m_endOffset - nextOffset));
+            const char *const data = reader.read(nextOffset, available);
+            if(!readHeader(data, available, nextHeader) || nextHeader.variableBlockSize != header.variableBlockSize || (crc && !isSuccessor(header, nextHeader))) {
+                // the sync code is part of the frame data
+                crc = updateCrc16(crc, data, 1);
+                searchOffset = nextOffset + 1;
+                continue;
+            }
+            addFrame(offset, nextOffset, header, !crc);
+            if(nextHeader.number != header.number + (header.variableBlockSize ? header.blockSize : 1)) {
+                addNotification(NotificationType::Warning, argsToString("The frame at ", nextOffset, " does not continue the preceding frame; frames might be missing."), context);
+            }
+            header = nextHeader;
+            offset = nextOffset;
+            crc = updateCrc16(0, data, header.size);
+            searchOffset = offset + header.size;
+        }
+    } catch(...) {
+        addNotification(NotificationType::Critical, catchIoFailure(), context);
+    }
+}
+
+/*!
+ * \brief Returns the duration determined by the last scan.
+ */
+TimeSpan FlacFrameScanner::duration() const
+{
+    return m_samplingFrequency ? TimeSpan::fromSeconds(static_cast<double>(m_sampleCount) / m_samplingFrequency) : TimeSpan();
+}
+
+/*!
+ * \brief Returns the average bitrate (in kbit/s) determined by the last scan.
+ */
+double FlacFrameScanner::averageBitrate() const
+{
+    return m_sampleCount && m_samplingFrequency
+            ? static_cast<double>(m_dataSize) * 0.008 / (static_cast<double>(m_sampleCount) / m_samplingFrequency)
+            : 0.0;
+}
+
+/*!
+ * \brief Returns the offset of the first sync code at or after \a offset.
+ *
+ * The specified \a crc is updated with the data between \a offset and the returned offset.
+ *
+ * \returns Returns the end offset if no sync code could be found.
+ */
+uint64 FlacFrameScanner::findNextSync(RangeReader &reader, uint64 offset, uint16 &crc) const
+{
+    while(offset < m_endOffset) {
+        const size_t available = static_cast<size_t>(min<uint64>(RangeReader::bufferSize, m_endOffset - offset));
+        const char *const data = reader.read(offset, available);
+        size_t index = findSync(data, available);
+        if(index == available && available != m_endOffset - offset) {
+            // keep the last byte since it might be the first byte of a sync code
+            crc = updateCrc16(crc, data, --index);
+            offset += index;
+            continue;
+        }
+        crc = updateCrc16(crc, data, index);
+        return offset + index;
+    }
+    return m_endOffset;
+}
+
+/*!
+ * \brief Returns whether \a nextHeader might be the header of the next frame after the frame with the specified
+ *        \a header considering that some frames might be missing.
+ */
+bool FlacFrameScanner::isSuccessor(const FlacFrameHeader &header, const FlacFrameHeader &nextHeader) const
+{
+    const uint64 step = header.variableBlockSize ? header.blockSize : 1;
+    const uint64 expectedNumber = header.number + step;
+    return nextHeader.number >= expectedNumber && nextHeader.number - expectedNumber <= maxMissingFrames * step;
+}
+
+/*!
+ * \brief Adds the frame with the specified \a header between \a offset and \a endOffset to the statistics.
+ */
+void FlacFrameScanner::addFrame(uint64 offset, uint64 endOffset, const FlacFrameHeader &header, bool crcValid)
+{
+    static const string context("scanning FLAC frames");
+    if(m_sampleCount >= m_nextSeekPoint) {
+        const uint64 interval = m_seekPointInterval ? m_seekPointInterval : 10 * static_cast<uint64>(m_samplingFrequency ? m_samplingFrequency : 44100);
+        m_seekTable.emplace_back(FlacSeekPoint{m_sampleCount, offset - m_firstFrameOffset, static_cast<uint16>(min<uint32>(header.blockSize, 0xFFFF))});
+        m_nextSeekPoint = (m_sampleCount / interval + 1) * interval;
+    }
+    if(!crcValid) {
+        ++m_corruptedFrameCount;
+        addNotification(NotificationType::Warning, argsToString("The CRC-16 of the frame at ", offset, " does not match; the frame is corrupted."), context);
+    }
+    ++m_frameCount;
+    m_sampleCount += header.blockSize;
+    m_dataSize += endOffset - offset;
+}
+
+}
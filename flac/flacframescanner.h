@@ -0,0 +1,182 @@
+#ifndef MEDIA_FLACFRAMESCANNER_H
+#define MEDIA_FLACFRAMESCANNER_H
+
+#include "../rangereader.h"
+#include "../statusprovider.h"
+
+#include <c++utilities/chrono/timespan.h>
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Media {
+
+class BasicFileInfo;
+
+/*!
+ * \brief The FlacSeekPoint struct holds a seek point as stored in the FLAC "METADATA_BLOCK_SEEKTABLE".
+ */
+struct TAG_PARSER_EXPORT FlacSeekPoint
+{
+    uint64 sampleNumber; /**< number of the first sample of the target frame */
+    uint64 offset; /**< offset of the target frame relative to the first frame */
+    uint16 sampleCount; /**< number of samples of the target frame */
+};
+
+/*!
+ * \brief The FlacFrameHeader struct holds the information of a FLAC "FRAME_HEADER".
+ */
+struct TAG_PARSER_EXPORT FlacFrameHeader
+{
+    bool variableBlockSize; /**< whether the number is a sample number (rather than a frame number) */
+    uint64 number; /**< frame number (fixed block size) or number of the first sample (variable block size) */
+    uint32 blockSize; /**< number of samples of the frame */
+    uint32 samplingFrequency; /**< sampling frequency in Hz (zero if the frequency of the "METADATA_BLOCK_STREAMINFO" applies) */
+    byte channelCount; /**< number of channels */
+    byte size; /**< size of the header in bytes (including the CRC-8) */
+};
+
+class TAG_PARSER_EXPORT FlacFrameScanner : public StatusProvider
+{
+public:
+    FlacFrameScanner(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset);
+
+    uint32 defaultSamplingFrequency() const;
+    void setDefaultSamplingFrequency(uint32 samplingFrequency);
+    uint32 seekPointInterval() const;
+    void setSeekPointInterval(uint32 seekPointInterval);
+    void scan();
+    uint64 frameCount() const;
+    uint64 corruptedFrameCount() const;
+    uint64 sampleCount() const;
+    uint64 firstFrameOffset() const;
+    uint64 dataSize() const;
+    uint32 samplingFrequency() const;
+    ChronoUtilities::TimeSpan duration() const;
+    double averageBitrate() const;
+    const std::vector<FlacSeekPoint> &seekTable() const;
+
+    static std::size_t findSync(const char *data, std::size_t size);
+    static byte readHeader(const char *data, std::size_t size, FlacFrameHeader &header);
+    static byte computeCrc8(const char *data, std::size_t size);
+    static uint16 updateCrc16(uint16 crc, const char *data, std::size_t size);
+
+private:
+    uint64 findNextSync(RangeReader &reader, uint64 offset, uint16 &crc) const;
+    bool isSuccessor(const FlacFrameHeader &header, const FlacFrameHeader &nextHeader) const;
+    void addFrame(uint64 offset, uint64 endOffset, const FlacFrameHeader &header, bool crcValid);
+
+    BasicFileInfo &m_fileInfo;
+    uint64 m_startOffset;
+    uint64 m_endOffset;
+    uint32 m_defaultSamplingFrequency;
+    uint32 m_seekPointInterval;
+    uint64 m_frameCount;
+    uint64 m_corruptedFrameCount;
+    uint64 m_sampleCount;
+    uint64 m_firstFrameOffset;
+    uint64 m_dataSize;
+    uint32 m_samplingFrequency;
+    uint64 m_nextSeekPoint;
+    std::vector<FlacSeekPoint> m_seekTable;
+};
+
+/*!
+ * \brief Returns the sampling frequency used for frames which refer to the "METADATA_BLOCK_STREAMINFO".
+ */
+inline uint32 FlacFrameScanner::defaultSamplingFrequency() const
+{
+    return m_defaultSamplingFrequency;
+}
+
+/*!
+ * \brief Sets the sampling frequency used for frames which refer to the "METADATA_BLOCK_STREAMINFO".
+ * \remarks Should be set to the sampling frequency denoted by the "METADATA_BLOCK_STREAMINFO" before scanning.
+ */
+inline void FlacFrameScanner::setDefaultSamplingFrequency(uint32 samplingFrequency)
+{
+    m_defaultSamplingFrequency = samplingFrequency;
+}
+
+/*!
+ * \brief Returns the number of samples between the entries of the seekTable().
+ * \remarks Zero (the default) means an entry is made every 10 seconds.
+ */
+inline uint32 FlacFrameScanner::seekPointInterval() const
+{
+    return m_seekPointInterval;
+}
+
+/*!
+ * \brief Sets the number of samples between the entries of the seekTable().
+ * \sa seekPointInterval()
+ */
+inline void FlacFrameScanner::setSeekPointInterval(uint32 seekPointInterval)
+{
+    m_seekPointInterval = seekPointInterval;
+}
+
+/*!
+ * \brief Returns the number of FLAC frames found by the last scan (including corrupted frames).
+ */
+inline uint64 FlacFrameScanner::frameCount() const
+{
+    return m_frameCount;
+}
+
+/*!
+ * \brief Returns the number of frames found by the last scan whose CRC-16 does not match.
+ */
+inline uint64 FlacFrameScanner::corruptedFrameCount() const
+{
+    return m_corruptedFrameCount;
+}
+
+/*!
+ * \brief Returns the number of samples of all frames found by the last scan.
+ */
+inline uint64 FlacFrameScanner::sampleCount() const
+{
+    return m_sampleCount;
+}
+
+/*!
+ * \brief Returns the offset of the first frame found by the last scan.
+ * \remarks The offsets of the seekTable() are relative to this offset.
+ */
+inline uint64 FlacFrameScanner::firstFrameOffset() const
+{
+    return m_firstFrameOffset;
+}
+
+/*!
+ * \brief Returns the number of bytes of all frames found by the last scan.
+ */
+inline uint64 FlacFrameScanner::dataSize() const
+{
+    return m_dataSize;
+}
+
+/*!
+ * \brief Returns the sampling frequency of the first frame found by the last scan or zero if no frames have been found.
+ */
+inline uint32 FlacFrameScanner::samplingFrequency() const
+{
+    return m_samplingFrequency;
+}
+
+/*!
+ * \brief Returns the seek table determined by the last scan.
+ *
+ * The table contains an entry for the first frame starting at or after each multiple of seekPointInterval() samples.
+ */
+inline const std::vector<FlacSeekPoint> &FlacFrameScanner::seekTable() const
+{
+    return m_seekTable;
+}
+
+}
+
+#endif // MEDIA_FLACFRAMESCANNER_H
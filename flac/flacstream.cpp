@@ -9,6 +9,7 @@
 
 #include "resources/config.h"
 
+#include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/io/copy.h>
 
 #include <sstream>
@@ -34,7 +35,8 @@ FlacStream::FlacStream(MediaFileInfo &mediaFileInfo, uint64 startOffset) :
     AbstractTrack(mediaFileInfo.stream(), startOffset),
     m_mediaFileInfo(mediaFileInfo),
     m_paddingSize(0),
-    m_streamOffset(0)
+    m_streamOffset(0),
+    m_corruptedFrameCount(0)
 {
     m_mediaType = MediaType::Audio;
 }
@@ -65,6 +67,46 @@ bool FlacStream::removeVorbisComment()
     }
 }
 
+/*!
+ * \brief Determines the exact sample count and duration and verifies the CRCs by walking all frames of the stream.
+ *
+ * The header must have been parsed before. The frames between streamOffset() and the end of the file (excluding an
+ * ID3v1 tag) are scanned. This also determines the seekTable() and the corruptedFrameCount().
+ *
+ * Problems are added as notifications. The values determined when parsing the header are kept if no frames could be
+ * found.
+ *
+ * \sa FlacFrameScanner
+ */
+void FlacStream::scanFrames()
+{
+    // exclude an ID3v1 tag at the end of the file
+    uint64 endOffset = m_mediaFileInfo.size();
+    if(endOffset >= static_cast<uint64>(m_streamOffset) + 128) {
+        m_istream->seekg(-128, ios_base::end);
+        if(m_reader.readUInt24BE() == 0x544147) {
+            endOffset -= 128;
+        }
+    }
+    FlacFrameScanner scanner(m_mediaFileInfo, m_streamOffset, endOffset);
+    scanner.setDefaultSamplingFrequency(m_samplingFrequency);
+    scanner.scan();
+    addNotifications(scanner);
+    if(!scanner.frameCount()) {
+        return;
+    }
+    static const string context("scanning FLAC frames");
+    if(m_sampleCount && m_sampleCount != scanner.sampleCount()) {
+        addNotification(NotificationType::Warning, argsToString("The total sample count denoted by \"METADATA_BLOCK_STREAMINFO\" (", m_sampleCount, ") does not match the actual sample count (", scanner.sampleCount(), ")."), context);
+    }
+    m_sampleCount = scanner.sampleCount();
+    m_size = scanner.dataSize();
+    m_duration = scanner.duration();
+    m_bitrate = scanner.averageBitrate();
+    m_corruptedFrameCount = scanner.corruptedFrameCount();
+    m_seekTable = scanner.seekTable();
+}
+
 void FlacStream::internalParseHeader()
 {
     static const string context("parsing raw FLAC header");
@@ -174,11 +216,14 @@ void FlacStream::internalParseHeader()
  *  - Vorbis comment is updated.
  *  - "METADATA_BLOCK_PICTURE" are updated.
  *  - Padding is skipped
+ *  - "METADATA_BLOCK_SEEKTABLE" is replaced by the seekTable() if \a regenerateSeekTable is set and the frames have
+ *    been scanned (see scanFrames())
  *
  * \returns Returns the start offset of the last "METADATA_BLOCK_HEADER" withing \a outputStream.
  */
-uint32 FlacStream::makeHeader(ostream &outputStream)
+uint32 FlacStream::makeHeader(ostream &outputStream, bool regenerateSeekTable)
 {
+    regenerateSeekTable = regenerateSeekTable && !m_seekTable.empty();
     istream &originalStream = m_mediaFileInfo.stream();
     originalStream.seekg(m_startOffset + 4);
     CopyHelper<512> copy;
@@ -202,6 +247,12 @@ uint32 FlacStream::makeHeader(ostream &outputStream)
         case FlacMetaDataBlockType::Padding:
             m_istream->seekg(header.dataSize(), ios_base::cur);
             break; // written separately/ignored
+        case FlacMetaDataBlockType::SeekTable:
+            if(regenerateSeekTable) {
+                m_istream->seekg(header.dataSize(), ios_base::cur);
+                break; // written separately
+            }
+            FALLTHROUGH;
         default:
             m_istream->seekg(-4, ios_base::cur);
             lastStartOffset = outputStream.tellp();
@@ -209,6 +260,12 @@ uint32 FlacStream::makeHeader(ostream &outputStream)
         }
     }
 
+    // write regenerated seek table
+    if(regenerateSeekTable) {
+        lastStartOffset = outputStream.tellp();
+        makeSeekTable(outputStream, m_seekTable, !m_vorbisComment);
+    }
+
     // write Vorbis comment
     if(m_vorbisComment) {
         // leave 4 bytes space for the "METADATA_BLOCK_HEADER"
@@ -250,6 +307,28 @@ uint32 FlacStream::makeHeader(ostream &outputStream)
     return lastStartOffset;
 }
 
+/*!
+ * \brief Writes a "METADATA_BLOCK_SEEKTABLE" with the specified \a seekTable to the specified \a stream.
+ */
+void FlacStream::makeSeekTable(ostream &stream, const vector<FlacSeekPoint> &seekTable, bool isLast)
+{
+    // make header
+    FlacMetaDataBlockHeader header;
+    header.setType(FlacMetaDataBlockType::SeekTable);
+    header.setLast(isLast);
+    header.setDataSize(static_cast<uint32>(seekTable.size() * 18));
+    header.makeHeader(stream);
+
+    // write seek points
+    char buffer[18];
+    for(const FlacSeekPoint &seekPoint : seekTable) {
+        BE::getBytes(seekPoint.sampleNumber, buffer);
+        BE::getBytes(seekPoint.offset, buffer + 8);
+        BE::getBytes(seekPoint.sampleCount, buffer + 16);
+        stream.write(buffer, sizeof(buffer));
+    }
+}
+
 /*!
  * \brief Writes padding of the specified \a size to the specified \a stream.
  * \remarks Size must be at least 4 bytes.
@@ -1,10 +1,13 @@
 #ifndef FLACSTREAM_H
 #define FLACSTREAM_H
 
+#include "./flacframescanner.h"
+
 #include "../abstracttrack.h"
 
 #include <iosfwd>
 #include <memory>
+#include <vector>
 
 namespace Media {
 
@@ -23,9 +26,13 @@ public:
     bool removeVorbisComment();
     uint32 paddingSize() const;
     uint32 streamOffset() const;
+    void scanFrames();
+    uint64 corruptedFrameCount() const;
+    const std::vector<FlacSeekPoint> &seekTable() const;
 
-    uint32 makeHeader(std::ostream &stream);
+    uint32 makeHeader(std::ostream &stream, bool regenerateSeekTable = false);
     static void makePadding(std::ostream &stream, uint32 size, bool isLast);
+    static void makeSeekTable(std::ostream &stream, const std::vector<FlacSeekPoint> &seekTable, bool isLast);
 
 protected:
     void internalParseHeader();
@@ -35,6 +42,8 @@ private:
     std::unique_ptr<VorbisComment> m_vorbisComment;
     uint32 m_paddingSize;
     uint32 m_streamOffset;
+    uint64 m_corruptedFrameCount;
+    std::vector<FlacSeekPoint> m_seekTable;
 };
 
 inline FlacStream::~FlacStream()
@@ -70,6 +79,25 @@ inline uint32 FlacStream::streamOffset() const
     return m_streamOffset;
 }
 
+/*!
+ * \brief Returns the number of corrupted frames found by the last call of scanFrames().
+ * \sa FlacFrameScanner::corruptedFrameCount()
+ */
+inline uint64 FlacStream::corruptedFrameCount() const
+{
+    return m_corruptedFrameCount;
+}
+
+/*!
+ * \brief Returns the seek table determined by the last call of scanFrames().
+ * \remarks The offsets are relative to the first frame (as in the "METADATA_BLOCK_SEEKTABLE").
+ * \sa FlacFrameScanner::seekTable()
+ */
+inline const std::vector<FlacSeekPoint> &FlacStream::seekTable() const
+{
+    return m_seekTable;
+}
+
 }
 
 #endif // FLACSTREAM_H
@@ -2,6 +2,7 @@
 #define MEDIA_GENERICCONTAINER_H
 
 #include "./abstractcontainer.h"
+#include "./elementarena.h"
 
 #include <algorithm>
 #include <memory>
@@ -31,6 +32,7 @@ public:
 
     void validateElementStructure(NotificationList &gatheredNotifications, uint64 *paddingSize = nullptr);
     FileInfoType &fileInfo() const;
+    ElementArena &elementArena();
     ElementType *firstElement() const;
     const std::vector<std::unique_ptr<ElementType> > &additionalElements() const;
     std::vector<std::unique_ptr<ElementType> > &additionalElements();
@@ -58,6 +60,7 @@ public:
     typedef ElementType elementType;
 
 protected:
+    ElementArena m_elementArena;
     std::unique_ptr<ElementType> m_firstElement;
     std::vector<std::unique_ptr<ElementType> > m_additionalElements;
     std::vector<std::unique_ptr<TagType> > m_tags;
@@ -116,6 +119,21 @@ inline FileInfoType &GenericContainer<FileInfoType, TagType, TrackType, ElementT
     return *m_fileInfo;
 }
 
+/*!
+ * \brief Returns the arena the children and siblings of the elements are allocated from.
+ *
+ * The elements of a fully parsed file are not allocated separately but within this arena. They are freed in bulk when
+ * the container is reset (see reset()) or destroyed.
+ *
+ * \remarks Element pointers obtained from the element tree (eg. via firstElement()) must not be used after resetting
+ *          the container.
+ */
+template <class FileInfoType, class TagType, class TrackType, class ElementType>
+inline ElementArena &GenericContainer<FileInfoType, TagType, TrackType, ElementType>::elementArena()
+{
+    return m_elementArena;
+}
+
 /*!
  * \brief Returns the first element of the file if available; otherwiese returns nullptr.
  *
@@ -370,6 +388,7 @@ void GenericContainer<FileInfoType, TagType, TrackType, ElementType>::reset()
     AbstractContainer::reset();
     m_firstElement.reset();
     m_additionalElements.clear();
+    m_elementArena.clear();
     m_tracks.clear();
     m_tags.clear();
 }
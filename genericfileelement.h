@@ -4,11 +4,13 @@
 #include "./notification.h"
 #include "./exceptions.h"
 #include "./statusprovider.h"
+#include "./elementarena.h"
 
 #include <c++utilities/conversion/types.h>
 #include <c++utilities/io/copy.h>
 
 #include <list>
+#include <algorithm>
 #include <initializer_list>
 #include <memory>
 #include <iostream>
@@ -149,6 +151,8 @@ public:
     std::iostream &stream();
     IoUtilities::BinaryReader &reader();
     IoUtilities::BinaryWriter &writer();
+    const char *mappedData(uint64 offset, uint64 count);
+    const char *fetchData(uint64 offset, std::size_t count, char *buffer);
     uint64 startOffset() const;
     uint64 relativeStartOffset() const;
     const identifierType &id() const;
@@ -197,6 +201,8 @@ public:
     implementationType *denoteFirstChild(uint32 offset);
 
 protected:
+    template <typename... Args> implementationType *createElement(Args &&...args);
+
     identifierType m_id;
     uint64 m_startOffset;
     uint64 m_maxSize;
@@ -204,12 +210,13 @@ protected:
     dataSizeType m_dataSize;
     uint32 m_sizeLength;
     implementationType* m_parent;
-    std::unique_ptr<implementationType> m_nextSibling;
-    std::unique_ptr<implementationType> m_firstChild;
+    implementationType* m_nextSibling;
+    implementationType* m_firstChild;
     std::unique_ptr<char[]> m_buffer;
 
 private:
     void copyInternal(std::ostream &targetStream, uint64 startOffset, uint64 bytesToCopy);
+    bool isReadingFromFileStream();
 
     containerType* m_container;
     bool m_parsed;
@@ -227,6 +234,8 @@ GenericFileElement<ImplementationType>::GenericFileElement(GenericFileElement<Im
     m_dataSize(0),
     m_sizeLength(0),
     m_parent(nullptr),
+    m_nextSibling(nullptr),
+    m_firstChild(nullptr),
     m_container(&container),
     m_parsed(false)
 {
@@ -251,6 +260,8 @@ GenericFileElement<ImplementationType>::GenericFileElement(GenericFileElement<Im
     m_dataSize(0),
     m_sizeLength(0),
     m_parent(&parent),
+    m_nextSibling(nullptr),
+    m_firstChild(nullptr),
     m_container(&parent.container()),
     m_parsed(false)
 {}
@@ -267,6 +278,8 @@ GenericFileElement<ImplementationType>::GenericFileElement(GenericFileElement<Im
     m_dataSize(0),
     m_sizeLength(0),
     m_parent(nullptr),
+    m_nextSibling(nullptr),
+    m_firstChild(nullptr),
     m_container(&container),
     m_parsed(false)
 {}
@@ -316,6 +329,38 @@ inline IoUtilities::BinaryWriter &GenericFileElement<ImplementationType>::writer
     return m_container->writer();
 }
 
+/*!
+ * \brief Returns a pointer to \a count bytes at the specified \a offset within the memory mapping of the related file.
+ * \returns Returns nullptr if the file is not memory mapped, the requested range is not mapped or the container does
+ *          currently not operate on the stream of the related file (eg. when writing a backup).
+ * \sa BasicFileInfo::setMemoryMappingEnabled()
+ */
+template <class ImplementationType>
+inline const char *GenericFileElement<ImplementationType>::mappedData(uint64 offset, uint64 count)
+{
+    return isReadingFromFileStream() ? m_container->fileInfo().mappedData(offset, count) : nullptr;
+}
+
+/*!
+ * \brief Returns a pointer to \a count bytes at the specified \a offset in the related stream.
+ *
+ * The data is taken directly from the memory mapping or read via the byte source or the read cache of the related file
+ * if possible (see BasicFileInfo::fetchData()). Otherwise it is read from stream() into the specified \a buffer.
+ *
+ * \returns Returns either a pointer into the memory mapping or \a buffer.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+template <class ImplementationType>
+const char *GenericFileElement<ImplementationType>::fetchData(uint64 offset, std::size_t count, char *buffer)
+{
+    if(isReadingFromFileStream()) {
+        return m_container->fileInfo().fetchData(offset, count, buffer);
+    }
+    stream().seekg(offset);
+    stream().read(buffer, count);
+    return buffer;
+}
+
 /*!
  * \brief Returns the start offset in the related stream.
  */
@@ -462,7 +507,7 @@ inline const typename GenericFileElement<ImplementationType>::implementationType
 /*!
  * \brief Returns the next sibling of the element.
  *
- * The current element keeps ownership over the returned element.
+ * The returned element is owned by the element arena of the container (see GenericContainer::elementArena()).
  * If no next sibling is present nullptr is returned.
  *
  * \remarks parse() needs to be called before.
@@ -470,13 +515,13 @@ inline const typename GenericFileElement<ImplementationType>::implementationType
 template <class ImplementationType>
 inline typename GenericFileElement<ImplementationType>::implementationType *GenericFileElement<ImplementationType>::nextSibling()
 {
-    return m_nextSibling.get();
+    return m_nextSibling;
 }
 
 /*!
  * \brief Returns the next sibling of the element.
  *
- * The current element keeps ownership over the returned element.
+ * The returned element is owned by the element arena of the container (see GenericContainer::elementArena()).
  * If no next sibling is present nullptr is returned.
  *
  * \remarks parse() needs to be called before.
@@ -484,13 +529,13 @@ inline typename GenericFileElement<ImplementationType>::implementationType *Gene
 template <class ImplementationType>
 inline const typename GenericFileElement<ImplementationType>::implementationType *GenericFileElement<ImplementationType>::nextSibling() const
 {
-    return m_nextSibling.get();
+    return m_nextSibling;
 }
 
 /*!
  * \brief Returns the first child of the element.
  *
- * The current element keeps ownership over the returned element.
+ * The returned element is owned by the element arena of the container (see GenericContainer::elementArena()).
  * If no childs are present nullptr is returned.
  *
  * \remarks parse() needs to be called before.
@@ -498,13 +543,13 @@ inline const typename GenericFileElement<ImplementationType>::implementationType
 template <class ImplementationType>
 inline typename GenericFileElement<ImplementationType>::implementationType *GenericFileElement<ImplementationType>::firstChild()
 {
-    return m_firstChild.get();
+    return m_firstChild;
 }
 
 /*!
  * \brief Returns the first child of the element.
  *
- * The current element keeps ownership over the returned element.
+ * The returned element is owned by the element arena of the container (see GenericContainer::elementArena()).
  * If no childs are present nullptr is returned.
  *
  * \remarks parse() needs to be called before.
@@ -512,7 +557,7 @@ inline typename GenericFileElement<ImplementationType>::implementationType *Gene
 template <class ImplementationType>
 inline const typename GenericFileElement<ImplementationType>::implementationType *GenericFileElement<ImplementationType>::firstChild() const
 {
-    return m_firstChild.get();
+    return m_firstChild;
 }
 
 /*!
@@ -823,6 +868,17 @@ void GenericFileElement<ImplementationType>::copyEntirely(std::ostream &targetSt
     copyInternal(targetStream, startOffset(), totalSize());
 }
 
+/*!
+ * \brief Returns whether the container currently reads from the stream of the related file.
+ * \remarks This is not the case when the container has been set to operate on another stream, eg. a backup stream
+ *          when rewriting the file. The memory mapping and the read cache of the file must not be used then.
+ */
+template <class ImplementationType>
+inline bool GenericFileElement<ImplementationType>::isReadingFromFileStream()
+{
+    return &m_container->stream() == static_cast<std::iostream *>(&m_container->fileInfo().stream());
+}
+
 /*!
  * \brief Buffers the element (header and data).
  * \remarks The element must have been parsed.
@@ -831,8 +887,12 @@ template <class ImplementationType>
 void GenericFileElement<ImplementationType>::makeBuffer()
 {
     m_buffer = std::make_unique<char[]>(totalSize());
-    container().stream().seekg(startOffset());
-    container().stream().read(m_buffer.get(), totalSize());
+    if(const char *data = mappedData(startOffset(), totalSize())) {
+        std::copy(data, data + totalSize(), m_buffer.get());
+    } else {
+        container().stream().seekg(startOffset());
+        container().stream().read(m_buffer.get(), totalSize());
+    }
 }
 
 /*!
@@ -893,8 +953,7 @@ void GenericFileElement<ImplementationType>::copyInternal(std::ostream &targetSt
     }
     auto &stream = container().stream();
     stream.seekg(startOffset); // seek to start offset
-    IoUtilities::CopyHelper<0x2000> copyHelper;
-    copyHelper.callbackCopy(stream, targetStream, bytesToCopy, std::bind(&GenericFileElement<ImplementationType>::isAborted, this), std::bind(&GenericFileElement<ImplementationType>::updatePercentage, this, std::placeholders::_1));
+    container().nativeCopyHelper().callbackCopy(stream, targetStream, bytesToCopy, std::bind(&GenericFileElement<ImplementationType>::isAborted, this), std::bind(&GenericFileElement<ImplementationType>::updatePercentage, this, std::placeholders::_1));
     if(isAborted()) {
         throw OperationAbortedException();
     }
@@ -908,11 +967,27 @@ template <class ImplementationType>
 typename GenericFileElement<ImplementationType>::implementationType *GenericFileElement<ImplementationType>::denoteFirstChild(uint32 relativeFirstChildOffset)
 {
     if(relativeFirstChildOffset + minimumElementSize() <= totalSize()) {
-        m_firstChild.reset(new implementationType(static_cast<implementationType &>(*this), startOffset() + relativeFirstChildOffset));
+        m_firstChild = createElement(static_cast<implementationType &>(*this), startOffset() + relativeFirstChildOffset);
     } else {
-        m_firstChild.reset();
+        m_firstChild = nullptr;
     }
-    return m_firstChild.get();
+    return m_firstChild;
+}
+
+/*!
+ * \brief Constructs a new element with the specified \a args within the element arena of the container.
+ *
+ * Implementations use this method to create children and siblings. The returned element lives until the container is
+ * reset or destroyed (see GenericContainer::elementArena()).
+ */
+template <class ImplementationType>
+template <typename... Args>
+typename GenericFileElement<ImplementationType>::implementationType *GenericFileElement<ImplementationType>::createElement(Args &&...args)
+{
+    ElementArena &arena = m_container->elementArena();
+    auto *const element = new(arena.allocate(sizeof(implementationType), alignof(implementationType))) implementationType(std::forward<Args>(args)...);
+    arena.registerObject(element);
+    return element;
 }
 
 /*!
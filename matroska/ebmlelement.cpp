@@ -15,6 +15,7 @@
 #include <sstream>
 #include <cstring>
 #include <memory>
+#include <algorithm>
 
 using namespace std;
 using namespace IoUtilities;
@@ -76,10 +77,14 @@ void EbmlElement::internalParse()
             addNotification(NotificationType::Critical, argsToString("The EBML element at ", startOffset(), " is truncated or does not exist."), context);
             throw TruncatedDataException();
         }
-        stream().seekg(startOffset());
+        // obtain header (directly from memory mapping or read cache if possible)
+        const uint64 headerBytesAvailable = min<uint64>(maxTotalSize(), GenericFileElement<implementationType>::maximumIdLengthSupported() + GenericFileElement<implementationType>::maximumSizeLengthSupported());
+        char headerBuf[GenericFileElement<implementationType>::maximumIdLengthSupported() + GenericFileElement<implementationType>::maximumSizeLengthSupported()];
+        const char *const header = fetchData(startOffset(), headerBytesAvailable, headerBuf);
+
         // read ID
         char buf[maximumIdLengthSupported() > maximumSizeLengthSupported() ? maximumIdLengthSupported() : maximumSizeLengthSupported()] = {0};
-        byte beg = static_cast<byte>(stream().peek()), mask = 0x80;
+        byte beg = static_cast<byte>(*header), mask = 0x80;
         m_idLength = 1;
         while(m_idLength <= GenericFileElement<implementationType>::maximumIdLengthSupported() && (beg & mask) == 0) {
             ++m_idLength;
@@ -97,11 +102,17 @@ void EbmlElement::internalParse()
             }
             continue; // try again
         }
-        reader().read(buf + (GenericFileElement<implementationType>::maximumIdLengthSupported() - m_idLength), m_idLength);
+        if(m_idLength >= headerBytesAvailable) {
+            if(!skipped) {
+                addNotification(NotificationType::Critical, "EBML header seems to be truncated.", parsingContext());
+            }
+            continue; // try again
+        }
+        memcpy(buf + (GenericFileElement<implementationType>::maximumIdLengthSupported() - m_idLength), header, m_idLength);
         m_id = BE::toUInt32(buf);
 
         // read size
-        beg = static_cast<byte>(stream().peek()), mask = 0x80;
+        beg = static_cast<byte>(header[m_idLength]), mask = 0x80;
         m_sizeLength = 1;
         if(beg == 0xFF) {
             // this indicates that the element size is unknown
@@ -124,9 +135,15 @@ void EbmlElement::internalParse()
                 }
                 continue; // try again
             }
+            if(m_idLength + m_sizeLength > headerBytesAvailable) { // header truncated
+                if(!skipped) {
+                    addNotification(NotificationType::Critical, "EBML header seems to be truncated.", parsingContext());
+                }
+                continue; // try again
+            }
             // read size into buffer
             memset(buf, 0, sizeof(dataSizeType)); // reset buffer
-            reader().read(buf + (GenericFileElement<implementationType>::maximumSizeLengthSupported() - m_sizeLength), m_sizeLength);
+            memcpy(buf + (GenericFileElement<implementationType>::maximumSizeLengthSupported() - m_sizeLength), header + m_idLength, m_sizeLength);
             *(buf + (GenericFileElement<implementationType>::maximumSizeLengthSupported() - m_sizeLength)) ^= mask; // xor the first byte in buffer which has been read from the file with mask
             m_dataSize = ConversionUtilities::BE::toUInt64(buf);
             // check if element is truncated
@@ -146,20 +163,20 @@ void EbmlElement::internalParse()
         // check if there's a first child
         const uint64 firstChildOffset = this->firstChildOffset();
         if(firstChildOffset && firstChildOffset < totalSize()) {
-            m_firstChild.reset(new EbmlElement(static_cast<EbmlElement &>(*this), startOffset() + firstChildOffset));
+            m_firstChild = createElement(static_cast<EbmlElement &>(*this), startOffset() + firstChildOffset);
         } else {
-            m_firstChild.reset();
+            m_firstChild = nullptr;
         }
 
         // check if there's a sibling
         if(totalSize() < maxTotalSize()) {
             if(parent()) {
-                m_nextSibling.reset(new EbmlElement(*(parent()), startOffset() + totalSize()));
+                m_nextSibling = createElement(*(parent()), startOffset() + totalSize());
             } else {
-                m_nextSibling.reset(new EbmlElement(container(), startOffset() + totalSize(), maxTotalSize() - totalSize()));
+                m_nextSibling = createElement(container(), startOffset() + totalSize(), maxTotalSize() - totalSize());
             }
         } else {
-            m_nextSibling.reset();
+            m_nextSibling = nullptr;
         }
 
         // no critical errors occured
@@ -180,8 +197,12 @@ void EbmlElement::internalParse()
  */
 std::string EbmlElement::readString()
 {
-    stream().seekg(dataOffset());
-    return reader().readString(dataSize());
+    if(const char *data = mappedData(dataOffset(), dataSize())) {
+        return string(data, dataSize());
+    }
+    string res(dataSize(), '\0');
+    fetchData(dataOffset(), dataSize(), &res[0]);
+    return res;
 }
 
 /*!
@@ -197,8 +218,7 @@ uint64 EbmlElement::readUInteger()
     if(i < 0) {
         i = 0;
     }
-    stream().seekg(dataOffset(), ios_base::beg);
-    stream().read(buff + i, sizeof(buff) - i);
+    memmove(buff + i, fetchData(dataOffset(), sizeof(buff) - i, buff + i), sizeof(buff) - i);
     return BE::toUInt64(buff);
 }
 
@@ -208,12 +228,12 @@ uint64 EbmlElement::readUInteger()
  */
 float64 EbmlElement::readFloat()
 {
-    stream().seekg(dataOffset());
+    char buff[sizeof(float64)];
     switch(dataSize()) {
     case sizeof(float32):
-        return reader().readFloat32BE();
+        return BE::toFloat32(fetchData(dataOffset(), sizeof(float32), buff));
     case sizeof(float64):
-        return reader().readFloat64BE();
+        return BE::toFloat64(fetchData(dataOffset(), sizeof(float64), buff));
     default:
         return 0.0;
     }
@@ -0,0 +1,104 @@
+#include "./ebmlreader.h"
+
+#include <algorithm>
+#include <istream>
+#include <limits>
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::EbmlReader
+ * \brief The EbmlReader class reads EBML element headers and integers directly from the memory mapping or a stream.
+ *
+ * Unlike EbmlElement, it does not create any objects for the elements it reads. Hence it is suitable for walking
+ * through a big number of elements (eg. the children of all clusters) once. Since a reader only uses the specified
+ * stream, several readers with their own streams can be used concurrently.
+ */
+
+/// \brief The maximum size of an element header (ID and size denotation) which is read at once.
+static constexpr size_t maximumElementHeaderSize = 12;
+
+/*!
+ * \brief Returns a pointer to \a count bytes at the specified \a offset which is valid until the next read.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+const char *EbmlReader::read(uint64 offset, std::size_t count)
+{
+    if(m_mappedData) {
+        return m_mappedData + offset;
+    }
+    if(m_buffer.size() < count) {
+        m_buffer.resize(count);
+    }
+    m_stream->seekg(static_cast<streamoff>(offset));
+    m_stream->read(&m_buffer[0], static_cast<streamsize>(count));
+    return m_buffer.data();
+}
+
+/*!
+ * \brief Reads the header of the element at the specified \a offset.
+ *
+ * The \a id is read including the length marker. The \a dataSize is std::numeric_limits<uint64>::max() if the size
+ * is unknown. It is not checked whether the data exceeds \a end.
+ *
+ * \returns Returns the size of the header or zero if the header is invalid or exceeds \a end.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+byte EbmlReader::readElementHeader(uint64 offset, uint64 end, uint64 &id, uint64 &dataSize)
+{
+    if(offset >= end || end - offset < 2) {
+        return 0;
+    }
+    const size_t headerSize = static_cast<size_t>(min<uint64>(end - offset, maximumElementHeaderSize));
+    const char *const header = read(offset, headerSize);
+    const byte idLength = readVariableSizeInteger(header, headerSize, id, true);
+    const byte sizeLength = idLength ? readVariableSizeInteger(header + idLength, headerSize - idLength, dataSize, false) : 0;
+    return sizeLength ? idLength + sizeLength : 0;
+}
+
+/*!
+ * \brief Reads the EBML variable-size integer in the specified \a data with \a available bytes.
+ *
+ * The length marker is kept if \a keepMarker is true (as done for IDs). If all value bits are set, \a value is set
+ * to std::numeric_limits<uint64>::max() (unknown size).
+ *
+ * \returns Returns the length of the integer or zero if it is invalid or truncated.
+ */
+byte EbmlReader::readVariableSizeInteger(const char *data, std::size_t available, uint64 &value, bool keepMarker)
+{
+    if(!available) {
+        return 0;
+    }
+    const byte first = static_cast<byte>(*data);
+    byte length = 1;
+    for(byte mask = 0x80; length <= 8 && !(first & mask); mask >>= 1, ++length);
+    if(length > 8 || length > available) {
+        return 0;
+    }
+    value = keepMarker ? first : (first & (0xFF >> length));
+    bool allOnes = value == static_cast<uint64>(0xFF >> length);
+    for(byte i = 1; i < length; ++i) {
+        value = (value << 8) | static_cast<byte>(data[i]);
+        allOnes &= static_cast<byte>(data[i]) == 0xFF;
+    }
+    if(!keepMarker && allOnes) {
+        value = numeric_limits<uint64>::max();
+    }
+    return length;
+}
+
+/*!
+ * \brief Returns the unsigned integer of the specified \a size stored in \a data.
+ */
+uint64 EbmlReader::readUInteger(const char *data, std::size_t size)
+{
+    uint64 value = 0;
+    for(const char *end = data + min<size_t>(size, 8); data != end; ++data) {
+        value = (value << 8) | static_cast<byte>(*data);
+    }
+    return value;
+}
+
+}
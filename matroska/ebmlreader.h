@@ -0,0 +1,51 @@
+#ifndef MEDIA_EBMLREADER_H
+#define MEDIA_EBMLREADER_H
+
+#include "../global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT EbmlReader
+{
+public:
+    EbmlReader(const char *mappedData, std::istream *stream);
+
+    const char *read(uint64 offset, std::size_t count);
+    byte readElementHeader(uint64 offset, uint64 end, uint64 &id, uint64 &dataSize);
+    uint64 readUInteger(uint64 offset, uint64 size);
+
+    static byte readVariableSizeInteger(const char *data, std::size_t available, uint64 &value, bool keepMarker);
+    static uint64 readUInteger(const char *data, std::size_t size);
+
+private:
+    const char *m_mappedData;
+    std::istream *m_stream;
+    std::string m_buffer;
+};
+
+/*!
+ * \brief Constructs a new reader; the \a stream is only used if no \a mappedData is specified.
+ */
+inline EbmlReader::EbmlReader(const char *mappedData, std::istream *stream) :
+    m_mappedData(mappedData),
+    m_stream(stream)
+{}
+
+/*!
+ * \brief Reads the unsigned integer of the specified \a size (at most 8 bytes are considered) at the specified \a offset.
+ */
+inline uint64 EbmlReader::readUInteger(uint64 offset, uint64 size)
+{
+    const auto count = static_cast<std::size_t>(size < 8 ? size : 8);
+    return readUInteger(read(offset, count), count);
+}
+
+}
+
+#endif // MEDIA_EBMLREADER_H
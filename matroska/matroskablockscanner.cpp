@@ -0,0 +1,389 @@
+#include "./matroskablockscanner.h"
+#include "./matroskacontainer.h"
+#include "./matroskaid.h"
+#include "./matroskatrack.h"
+#include "./ebmlelement.h"
+#include "./ebmlreader.h"
+
+#include "../mediafileinfo.h"
+#include "../exceptions.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/catchiofailure.h>
+#include <c++utilities/io/nativefilestream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace ChronoUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/*!
+ * \brief Constructs empty statistics.
+ */
+MatroskaBlockStatistics::MatroskaBlockStatistics() :
+    blockCount(0),
+    frameCount(0),
+    size(0)
+{}
+
+/*!
+ * \brief Returns the average bitrate in kbit/s or zero if the duration is unknown.
+ */
+double MatroskaBlockStatistics::bitrate() const
+{
+    return duration.totalTicks() > 0 ? size * 0.008 / duration.totalSeconds() : 0.0;
+}
+
+/// \brief The number of bytes read at the beginning of a block to obtain the block and lacing header in the first place.
+static constexpr size_t initialBlockHeaderSize = 0x100;
+
+/// \brief The number of clusters taken by a worker at once.
+static constexpr size_t clustersPerBatch = 0x10;
+
+/*!
+ * \class Media::MatroskaBlockScanner
+ * \brief The MatroskaBlockScanner class determines track statistics by scanning the blocks of a Matroska file.
+ *
+ * Matroska files only provide statistics like the size, frame count and bitrate of their tracks if the muxer wrote
+ * statistics tags (see MatroskaContainer::readTrackStatisticsFromTags()). This class determines them from the
+ * "SimpleBlock" and "Block" elements instead. Only the block and lacing headers are read; the frame data is skipped.
+ *
+ * The offsets of the clusters are determined by walking through the children of the "Segment" elements first. (The
+ * "Cues" element is not used because it is not required to reference every cluster.) Since clusters are independent
+ * of each other, they are scanned by several threads afterwards. Threads read directly from the memory mapping if the
+ * file is mapped and open their own stream otherwise.
+ *
+ * The duration of a track is determined by the timestamps of its frames. The duration of the last frame is taken from
+ * the "BlockDuration" element or the default duration of the track. For files with multiple segments the durations of
+ * all segments are summed up.
+ *
+ * \remarks The container must have been parsed (including the tracks) before scanning.
+ * \sa MatroskaContainer::readTrackStatisticsFromBlocks()
+ */
+
+/*!
+ * \brief Constructs a new scanner for the specified \a container.
+ */
+MatroskaBlockScanner::MatroskaBlockScanner(MatroskaContainer &container) :
+    m_container(container),
+    m_threadCount(0)
+{}
+
+/*!
+ * \brief Scans all blocks and determines the statistics().
+ *
+ * Problems are added as notifications. Blocks which can not be scanned are not taken into account.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs while determining the clusters.
+ * \throws Throws Media::Failure or a derived exception when the clusters can not be determined.
+ */
+void MatroskaBlockScanner::scan()
+{
+    static const string context("scanning Matroska blocks");
+    invalidateStatus();
+    m_statistics.clear();
+    determineClusters();
+    m_defaultDurations.clear();
+    for(const auto &track : m_container.tracks()) {
+        m_defaultDurations[track->trackNumber()] = track->defaultDuration();
+    }
+
+    // determine how to read clusters and how many threads to use
+    MediaFileInfo &fileInfo = m_container.fileInfo();
+    const char *const mappedData = fileInfo.mappedData(0, fileInfo.size());
+    size_t threadCount = m_threadCount ? m_threadCount : max<size_t>(thread::hardware_concurrency(), 1);
+    if(!mappedData && fileInfo.byteSource()) {
+        // the byte source can only be read using the stream of the file
+        threadCount = 1;
+    }
+    threadCount = max<size_t>(min(threadCount, (m_clusters.size() + clustersPerBatch - 1) / clustersPerBatch), 1);
+
+    // scan clusters; each worker takes batches of subsequent clusters until all clusters have been scanned
+    vector<ScanResult> results(threadCount);
+    atomic<size_t> nextCluster(0);
+    const auto worker = [&] (size_t workerIndex) {
+        ScanResult &result = results[workerIndex];
+        try {
+            unique_ptr<NativeFileStream> ownStream;
+            istream *stream = &m_container.stream();
+            if(!mappedData && workerIndex) {
+                ownStream = make_unique<NativeFileStream>();
+                ownStream->exceptions(ios_base::failbit | ios_base::badbit);
+                ownStream->open(fileInfo.path(), ios_base::in | ios_base::binary);
+                stream = ownStream.get();
+            }
+            EbmlReader reader(mappedData, stream);
+            for(size_t begin; (begin = nextCluster.fetch_add(clustersPerBatch)) < m_clusters.size(); ) {
+                for(size_t i = begin, end = min(begin + clustersPerBatch, m_clusters.size()); i != end; ++i) {
+                    try {
+                        scanCluster(reader, m_clusters[i], result);
+                    } catch(const Failure &) {
+                        result.notifications.emplace_back(NotificationType::Critical, argsToString("Unable to scan cluster at ", m_clusters[i].dataOffset, '.'), context);
+                    }
+                }
+            }
+        } catch(...) {
+            result.notifications.emplace_back(NotificationType::Critical, catchIoFailure(), context);
+        }
+    };
+    vector<thread> threads;
+    threads.reserve(threadCount - 1);
+    try {
+        for(size_t i = 1; i < threadCount; ++i) {
+            threads.emplace_back(worker, i);
+        }
+    } catch(const system_error &) {
+        // continue with the threads created so far
+    }
+    worker(0);
+    for(thread &thread : threads) {
+        thread.join();
+    }
+
+    // merge results of the workers
+    map<pair<size_t, uint64>, TrackRange> ranges;
+    for(const ScanResult &result : results) {
+        addNotifications(result.notifications);
+        for(const auto &workerRange : result.ranges) {
+            const auto range = ranges.find(workerRange.first);
+            if(range == ranges.end()) {
+                ranges.insert(workerRange);
+                continue;
+            }
+            range->second.blockCount += workerRange.second.blockCount;
+            range->second.frameCount += workerRange.second.frameCount;
+            range->second.size += workerRange.second.size;
+            range->second.start = min(range->second.start, workerRange.second.start);
+            range->second.end = max(range->second.end, workerRange.second.end);
+        }
+    }
+    for(const auto &range : ranges) {
+        MatroskaBlockStatistics &statistics = m_statistics[range.first.second];
+        statistics.blockCount += range.second.blockCount;
+        statistics.frameCount += range.second.frameCount;
+        statistics.size += range.second.size;
+        statistics.duration += TimeSpan((range.second.end - range.second.start) / 100);
+    }
+}
+
+/*!
+ * \brief Determines the clusters of all segments and the time scale of each segment.
+ */
+void MatroskaBlockScanner::determineClusters()
+{
+    static const string context("determining Matroska clusters");
+    m_clusters.clear();
+    m_timecodeScales.clear();
+    for(EbmlElement *segmentElement = m_container.firstElement(); segmentElement; segmentElement = segmentElement->nextSibling()) {
+        segmentElement->parse();
+        if(segmentElement->id() != MatroskaIds::Segment) {
+            continue;
+        }
+        const size_t segmentIndex = m_timecodeScales.size();
+        m_timecodeScales.push_back(1000000);
+        try {
+            for(EbmlElement *childElement = segmentElement->firstChild(); childElement; childElement = childElement->nextSibling()) {
+                childElement->parse();
+                switch(childElement->id()) {
+                case MatroskaIds::SegmentInfo:
+                    for(EbmlElement *infoElement = childElement->firstChild(); infoElement; infoElement = infoElement->nextSibling()) {
+                        infoElement->parse();
+                        if(infoElement->id() == MatroskaIds::TimeCodeScale) {
+                            m_timecodeScales.back() = infoElement->readUInteger();
+                        }
+                    }
+                    break;
+                case MatroskaIds::Cluster:
+                    m_clusters.emplace_back(Cluster{childElement->dataOffset(), childElement->dataSize(), segmentIndex});
+                    break;
+                default:
+                    ;
+                }
+            }
+        } catch(const Failure &) {
+            addNotification(NotificationType::Critical, argsToString("Unable to determine all clusters of the segment at ", segmentElement->startOffset(), '.'), context);
+        }
+    }
+}
+
+/*!
+ * \brief Scans the blocks of the specified \a cluster.
+ * \remarks This method is called by the workers and must not alter the scanner.
+ */
+void MatroskaBlockScanner::scanCluster(EbmlReader &reader, const Cluster &cluster, ScanResult &result) const
+{
+    static const string context("scanning Matroska cluster");
+    uint64 offset = cluster.dataOffset, end = cluster.dataOffset + cluster.dataSize;
+    int64 clusterTimecode = 0;
+    while(end - offset >= 2) {
+        uint64 id, size;
+        const byte headerSize = reader.readElementHeader(offset, end, id, size);
+        if(!headerSize) {
+            result.notifications.emplace_back(NotificationType::Critical, argsToString("Invalid element header at ", offset, '.'), context);
+            throw InvalidDataException();
+        }
+        const uint64 dataOffset = offset + headerSize;
+        if(id == MatroskaIds::Cluster) {
+            // a cluster within the data of a cluster indicates that the outer cluster has an unknown size
+            // -> continue with the data of the inner cluster
+            offset = dataOffset;
+            clusterTimecode = 0;
+            continue;
+        }
+        if(size > end - dataOffset) {
+            result.notifications.emplace_back(NotificationType::Critical, argsToString("The element at ", offset, " is truncated."), context);
+            throw TruncatedDataException();
+        }
+        switch(id) {
+        case MatroskaIds::Timecode:
+            clusterTimecode = static_cast<int64>(reader.readUInteger(dataOffset, size));
+            break;
+        case MatroskaIds::SimpleBlock:
+            scanBlock(reader, dataOffset, size, clusterTimecode, nullptr, cluster, result);
+            break;
+        case MatroskaIds::BlockGroup: {
+            // find "Block" and "BlockDuration" elements within the group
+            uint64 blockOffset = 0, blockSize = 0, blockDuration = 0;
+            bool hasBlockDuration = false;
+            for(uint64 childOffset = dataOffset, groupEnd = dataOffset + size; groupEnd - childOffset >= 2; ) {
+                uint64 childId, childSize;
+                const byte childHeaderSize = reader.readElementHeader(childOffset, groupEnd, childId, childSize);
+                const uint64 childDataOffset = childOffset + childHeaderSize;
+                if(!childHeaderSize || childSize > groupEnd - childDataOffset) {
+                    result.notifications.emplace_back(NotificationType::Critical, argsToString("The \"BlockGroup\" element at ", offset, " is invalid."), context);
+                    throw InvalidDataException();
+                }
+                switch(childId) {
+                case MatroskaIds::Block:
+                    blockOffset = childDataOffset;
+                    blockSize = childSize;
+                    break;
+                case MatroskaIds::BlockDuration:
+                    blockDuration = reader.readUInteger(childDataOffset, childSize);
+                    hasBlockDuration = true;
+                    break;
+                default:
+                    ;
+                }
+                childOffset = childDataOffset + childSize;
+            }
+            if(blockOffset) {
+                scanBlock(reader, blockOffset, blockSize, clusterTimecode, hasBlockDuration ? &blockDuration : nullptr, cluster, result);
+            }
+            break;
+        }
+        default:
+            ;
+        }
+        offset = dataOffset + size;
+    }
+}
+
+/*!
+ * \brief Scans the header of the block with the specified \a offset and \a size.
+ *
+ * The block duration is taken from \a blockDuration if specified and from the default duration of the track otherwise.
+ *
+ * \remarks This method is called by the workers and must not alter the scanner.
+ */
+void MatroskaBlockScanner::scanBlock(EbmlReader &reader, uint64 offset, uint64 size, int64 clusterTimecode, const uint64 *blockDuration, const Cluster &cluster, ScanResult &result) const
+{
+    static const string context("scanning Matroska block");
+    // read block header and lacing header; usually the first bytes of the block suffice
+    for(size_t available = static_cast<size_t>(min<uint64>(size, initialBlockHeaderSize)); ; available = static_cast<size_t>(size)) {
+        const char *const data = reader.read(offset, available);
+        uint64 trackNumber;
+        const byte trackNumberLength = EbmlReader::readVariableSizeInteger(data, available, trackNumber, false);
+        size_t headerSize = trackNumberLength + 3u;
+        if(!trackNumberLength || headerSize > available) {
+            if(available < size) {
+                continue;
+            }
+            result.notifications.emplace_back(NotificationType::Critical, argsToString("The header of the block at ", offset, " is truncated."), context);
+            throw TruncatedDataException();
+        }
+        const int64 relativeTimecode = BE::toInt16(data + trackNumberLength);
+        const byte flags = static_cast<byte>(data[trackNumberLength + 2]);
+        uint64 frameCount = 1;
+        bool lacingHeaderComplete = true;
+        if(flags & 0x06) {
+            // determine size of lacing header
+            if(headerSize >= available) {
+                lacingHeaderComplete = false;
+            } else {
+                frameCount = static_cast<byte>(data[headerSize++]) + 1u;
+                switch(flags & 0x06) {
+                case 0x02:
+                    // Xiph lacing: sizes of all frames except the last are encoded as sum of bytes; 0xFF means "continue"
+                    for(uint64 frame = 1; frame < frameCount && lacingHeaderComplete; ++frame) {
+                        for(;;) {
+                            if(headerSize >= available) {
+                                lacingHeaderComplete = false;
+                                break;
+                            }
+                            if(static_cast<byte>(data[headerSize++]) != 0xFF) {
+                                break;
+                            }
+                        }
+                    }
+                    break;
+                case 0x06:
+                    // EBML lacing: sizes of all frames except the last are encoded as variable-size integers
+                    for(uint64 frame = 1, frameSize; frame < frameCount; ++frame) {
+                        const byte frameSizeLength = EbmlReader::readVariableSizeInteger(data + headerSize, available - headerSize, frameSize, false);
+                        if(!frameSizeLength) {
+                            lacingHeaderComplete = false;
+                            break;
+                        }
+                        headerSize += frameSizeLength;
+                    }
+                    break;
+                default:
+                    // fixed-size lacing: no further header
+                    ;
+                }
+            }
+        }
+        if(!lacingHeaderComplete) {
+            if(available < size) {
+                continue;
+            }
+            result.notifications.emplace_back(NotificationType::Critical, argsToString("The lacing header of the block at ", offset, " is truncated."), context);
+            throw TruncatedDataException();
+        }
+
+        // update statistics of the track
+        const uint64 timecodeScale = m_timecodeScales[cluster.segmentIndex];
+        const int64 start = (clusterTimecode + relativeTimecode) * static_cast<int64>(timecodeScale);
+        uint64 duration = 0;
+        if(blockDuration) {
+            duration = *blockDuration * timecodeScale;
+        } else {
+            const auto defaultDuration = m_defaultDurations.find(trackNumber);
+            if(defaultDuration != m_defaultDurations.cend()) {
+                duration = defaultDuration->second * frameCount;
+            }
+        }
+        const int64 end = start + static_cast<int64>(duration);
+        const auto insertion = result.ranges.emplace(make_pair(cluster.segmentIndex, trackNumber), TrackRange{0, 0, 0, start, end});
+        TrackRange &range = insertion.first->second;
+        ++range.blockCount;
+        range.frameCount += frameCount;
+        range.size += size - headerSize;
+        range.start = min(range.start, start);
+        range.end = max(range.end, end);
+        return;
+    }
+}
+
+}
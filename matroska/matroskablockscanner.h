@@ -0,0 +1,116 @@
+#ifndef MEDIA_MATROSKABLOCKSCANNER_H
+#define MEDIA_MATROSKABLOCKSCANNER_H
+
+#include "../statusprovider.h"
+
+#include <c++utilities/chrono/timespan.h>
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace Media {
+
+class MatroskaContainer;
+class EbmlReader;
+
+/*!
+ * \brief The MatroskaBlockStatistics struct holds the statistics determined by the MatroskaBlockScanner for a track.
+ */
+struct TAG_PARSER_EXPORT MatroskaBlockStatistics
+{
+    MatroskaBlockStatistics();
+    double bitrate() const;
+
+    uint64 blockCount; /**< number of SimpleBlock and Block elements */
+    uint64 frameCount; /**< number of frames (a block might contain several laced frames) */
+    uint64 size; /**< number of bytes of the frames (excluding block and lacing headers) */
+    ChronoUtilities::TimeSpan duration; /**< time from the first frame until the end of the last frame */
+};
+
+class TAG_PARSER_EXPORT MatroskaBlockScanner : public StatusProvider
+{
+public:
+    MatroskaBlockScanner(MatroskaContainer &container);
+
+    std::size_t threadCount() const;
+    void setThreadCount(std::size_t threadCount);
+    void scan();
+    std::size_t clusterCount() const;
+    const std::map<uint64, MatroskaBlockStatistics> &statistics() const;
+
+private:
+    /// \brief The private Cluster struct holds the location of a cluster to be scanned.
+    struct Cluster
+    {
+        uint64 dataOffset;
+        uint64 dataSize;
+        std::size_t segmentIndex;
+    };
+    /// \brief The private TrackRange struct holds the statistics of a track within a segment.
+    struct TrackRange
+    {
+        uint64 blockCount;
+        uint64 frameCount;
+        uint64 size;
+        int64 start;
+        int64 end;
+    };
+    /// \brief The private ScanResult struct holds the results of a worker.
+    struct ScanResult
+    {
+        std::map<std::pair<std::size_t, uint64>, TrackRange> ranges;
+        NotificationList notifications;
+    };
+
+    void determineClusters();
+    void scanCluster(EbmlReader &reader, const Cluster &cluster, ScanResult &result) const;
+    void scanBlock(EbmlReader &reader, uint64 offset, uint64 size, int64 clusterTimecode, const uint64 *blockDuration, const Cluster &cluster, ScanResult &result) const;
+
+    MatroskaContainer &m_container;
+    std::size_t m_threadCount;
+    std::vector<Cluster> m_clusters;
+    std::vector<uint64> m_timecodeScales;
+    std::map<uint64, uint64> m_defaultDurations;
+    std::map<uint64, MatroskaBlockStatistics> m_statistics;
+};
+
+/*!
+ * \brief Returns the number of threads used for scanning.
+ * \remarks Zero (the default) means the number of hardware threads is used.
+ */
+inline std::size_t MatroskaBlockScanner::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the number of threads used for scanning.
+ * \sa threadCount()
+ */
+inline void MatroskaBlockScanner::setThreadCount(std::size_t threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+/*!
+ * \brief Returns the number of clusters found by the last scan.
+ */
+inline std::size_t MatroskaBlockScanner::clusterCount() const
+{
+    return m_clusters.size();
+}
+
+/*!
+ * \brief Returns the statistics determined by the last scan by track number.
+ */
+inline const std::map<uint64, MatroskaBlockStatistics> &MatroskaBlockScanner::statistics() const
+{
+    return m_statistics;
+}
+
+}
+
+#endif // MEDIA_MATROSKABLOCKSCANNER_H
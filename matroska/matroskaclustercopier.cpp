@@ -0,0 +1,116 @@
+#include "./matroskaclustercopier.h"
+#include "./matroskaid.h"
+#include "./ebmlelement.h"
+#include "./ebmlid.h"
+#include "./ebmlreader.h"
+
+#include "../nativecopyhelper.h"
+#include "../exceptions.h"
+#include "../statusprovider.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+
+#include <istream>
+#include <ostream>
+
+using namespace std;
+using namespace ConversionUtilities;
+
+namespace Media {
+
+/*!
+ * \class Media::MatroskaClusterCopier
+ * \brief The MatroskaClusterCopier class copies "Cluster"-elements when rewriting a Matroska file.
+ *
+ * When a cluster is added, only the headers of its children are read (using EbmlReader, so no EbmlElement objects are
+ * created) to determine the ranges which are copied as-is. "Void"- and "CRC-32"-elements are dropped and the
+ * "Position"-element is replaced by one denoting the new position. Since these elements are usually located at the
+ * beginning of the cluster, the blocks of a cluster usually form a single range which can be copied with one
+ * (native) copy operation instead of one seek and copy per block.
+ */
+
+/*!
+ * \brief Adds the cluster with the specified \a dataOffset and \a dataSize.
+ *
+ * The \a position is the new position of the cluster within the segment; it is required to compute the size of the
+ * "Position"-element. The \a childCallback is called for each child with the offset of the child relative to the
+ * data of the cluster in the source and the output (eg. to update relative offsets of cue points); it might be
+ * empty.
+ *
+ * If the data of a child exceeds the cluster, a warning is added to the specified \a statusProvider and the child is
+ * truncated to the end of the cluster (like EbmlElement does when parsing).
+ *
+ * \returns Returns the data size of the cluster in the output.
+ * \throws Throws InvalidDataException if the header of a child is invalid or truncated.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+uint64 MatroskaClusterCopier::addCluster(StatusProvider &statusProvider, EbmlReader &reader, uint64 dataOffset, uint64 dataSize, uint64 position, const std::function<void (uint64, uint64)> &childCallback)
+{
+    const size_t firstRange = m_ranges.size();
+    const uint64 end = dataOffset + dataSize;
+    uint64 newDataSize = 0, id, childDataSize;
+    for(uint64 offset = dataOffset; offset < end; ) {
+        const byte headerSize = reader.readElementHeader(offset, end, id, childDataSize);
+        if(!headerSize) {
+            throw InvalidDataException();
+        }
+        if(childDataSize > end - offset - headerSize) {
+            statusProvider.addNotification(NotificationType::Warning, "Data of EBML element seems to be truncated; only the data up to the end of the cluster is copied.", "copying Matroska cluster");
+            childDataSize = end - offset - headerSize;
+        }
+        if(childCallback) {
+            childCallback(offset - dataOffset, newDataSize);
+        }
+        const uint64 childSize = headerSize + childDataSize;
+        switch(id) {
+        case EbmlIds::Void:
+        case EbmlIds::Crc32:
+            break;
+        case MatroskaIds::Position:
+            m_ranges.push_back(MatroskaClusterRange{offset, 0});
+            newDataSize += 1 + 1 + EbmlElement::calculateUIntegerLength(position);
+            break;
+        default:
+            if(m_ranges.size() > firstRange && m_ranges.back().size && m_ranges.back().offset + m_ranges.back().size == offset) {
+                m_ranges.back().size += childSize;
+            } else {
+                m_ranges.push_back(MatroskaClusterRange{offset, childSize});
+            }
+            newDataSize += childSize;
+        }
+        offset += childSize;
+    }
+    m_clusters.push_back(MatroskaClusterLayout{newDataSize, firstRange, m_ranges.size() - firstRange});
+    return newDataSize;
+}
+
+/*!
+ * \brief Writes the cluster with the specified \a index to \a output reading its children from \a input.
+ * \param position Specifies the position of the cluster within the segment; must be the position specified when
+ *                 adding the cluster.
+ * \param copyHelper Specifies the helper used to copy the ranges.
+ * \param isAborted Specifies a function to check whether the operation has been aborted; might be empty.
+ * \remarks If the operation has been aborted, this method returns before the cluster has been written completely.
+ *          The caller is expected to check for that.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void MatroskaClusterCopier::copyCluster(std::size_t index, uint64 position, istream &input, ostream &output, NativeCopyHelper &copyHelper, const std::function<bool (void)> &isAborted)
+{
+    const MatroskaClusterLayout &cluster = m_clusters[index];
+    char buff[8];
+    BE::getBytes(static_cast<uint32>(MatroskaIds::Cluster), buff);
+    output.write(buff, 4);
+    const byte sizeLength = EbmlElement::makeSizeDenotation(cluster.dataSize, buff);
+    output.write(buff, sizeLength);
+    for(auto range = m_ranges.cbegin() + static_cast<ptrdiff_t>(cluster.firstRange), end = range + static_cast<ptrdiff_t>(cluster.rangeCount);
+        range != end && !(isAborted && isAborted()); ++range) {
+        if(range->size) {
+            input.seekg(static_cast<streamoff>(range->offset));
+            copyHelper.callbackCopy(input, output, range->size, isAborted, std::function<void (double)>());
+        } else {
+            EbmlElement::makeSimpleElement(output, MatroskaIds::Position, position);
+        }
+    }
+}
+
+}
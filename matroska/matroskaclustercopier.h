@@ -0,0 +1,87 @@
+#ifndef MEDIA_MATROSKACLUSTERCOPIER_H
+#define MEDIA_MATROSKACLUSTERCOPIER_H
+
+#include "../global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+namespace Media {
+
+class EbmlReader;
+class NativeCopyHelper;
+class StatusProvider;
+
+/*!
+ * \brief The MatroskaClusterRange struct holds a range of the children of a "Cluster"-element which is copied as-is.
+ * \remarks A range with a size of zero denotes the position of the "Position"-element to be written instead.
+ */
+struct TAG_PARSER_EXPORT MatroskaClusterRange
+{
+    uint64 offset; /**< offset of the range within the source */
+    uint64 size; /**< size of the range or zero for the "Position"-element */
+};
+
+/*!
+ * \brief The MatroskaClusterLayout struct holds the layout of a "Cluster"-element in the output.
+ */
+struct TAG_PARSER_EXPORT MatroskaClusterLayout
+{
+    uint64 dataSize; /**< data size of the cluster in the output */
+    std::size_t firstRange; /**< index of the first range of the cluster (see MatroskaClusterCopier::ranges()) */
+    std::size_t rangeCount; /**< number of ranges of the cluster */
+};
+
+class TAG_PARSER_EXPORT MatroskaClusterCopier
+{
+public:
+    MatroskaClusterCopier();
+
+    void clear();
+    uint64 addCluster(StatusProvider &statusProvider, EbmlReader &reader, uint64 dataOffset, uint64 dataSize, uint64 position, const std::function<void (uint64, uint64)> &childCallback);
+    const std::vector<MatroskaClusterLayout> &clusters() const;
+    const std::vector<MatroskaClusterRange> &ranges() const;
+    void copyCluster(std::size_t index, uint64 position, std::istream &input, std::ostream &output, NativeCopyHelper &copyHelper, const std::function<bool (void)> &isAborted);
+
+private:
+    std::vector<MatroskaClusterLayout> m_clusters;
+    std::vector<MatroskaClusterRange> m_ranges;
+};
+
+/*!
+ * \brief Constructs a new copier without any clusters.
+ */
+inline MatroskaClusterCopier::MatroskaClusterCopier()
+{}
+
+/*!
+ * \brief Removes all clusters added so far.
+ */
+inline void MatroskaClusterCopier::clear()
+{
+    m_clusters.clear();
+    m_ranges.clear();
+}
+
+/*!
+ * \brief Returns the layouts of the clusters added via addCluster().
+ */
+inline const std::vector<MatroskaClusterLayout> &MatroskaClusterCopier::clusters() const
+{
+    return m_clusters;
+}
+
+/*!
+ * \brief Returns the ranges of all clusters added via addCluster().
+ */
+inline const std::vector<MatroskaClusterRange> &MatroskaClusterCopier::ranges() const
+{
+    return m_ranges;
+}
+
+}
+
+#endif // MEDIA_MATROSKACLUSTERCOPIER_H
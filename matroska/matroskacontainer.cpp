@@ -4,10 +4,16 @@
 #include "./matroskacues.h"
 #include "./matroskaeditionentry.h"
 #include "./matroskaseekinfo.h"
+#include "./matroskablockscanner.h"
+#include "./matroskaindexvalidator.h"
+#include "./matroskaclustercopier.h"
+#include "./ebmlreader.h"
 
 #include "../mediafileinfo.h"
 #include "../exceptions.h"
 #include "../backuphelper.h"
+#include "../crc32.h"
+#include "../crc32streambuffer.h"
 
 #include "resources/config.h"
 
@@ -17,11 +23,12 @@
 
 #include <unistd.h>
 
+#include <algorithm>
 #include <functional>
 #include <initializer_list>
-#include <unordered_set>
 #include <memory>
 #include <limits>
+#include <sstream>
 
 using namespace std;
 using namespace std::placeholders;
@@ -84,193 +91,27 @@ void MatroskaContainer::reset()
 
 /*!
  * \brief Validates the file index (cue entries).
- * \remarks Checks only for cluster positions and missing, unknown or surplus elements.
+ *
+ * The clusters are verified using \a threadCount threads (zero means the number of hardware threads is used).
+ *
+ * \remarks Checks only for cluster and block positions, the "Position" and "PrevSize" elements of clusters and
+ *          missing, unknown or surplus elements.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws Media::OperationAbortedException when the validation has been aborted.
+ * \sa MatroskaIndexValidator
  */
-void MatroskaContainer::validateIndex()
+void MatroskaContainer::validateIndex(std::size_t threadCount)
 {
-    static const string context("validating Matroska file index (cues)");
-    bool cuesElementsFound = false;
-    if(m_firstElement) {
-        unordered_set<int> ids;
-        bool cueTimeFound = false, cueTrackPositionsFound = false;
-        unique_ptr<EbmlElement> clusterElement;
-        uint64 pos, prevClusterSize = 0, currentOffset = 0;
-        // iterate throught all segments
-        for(EbmlElement *segmentElement = m_firstElement->siblingById(MatroskaIds::Segment); segmentElement; segmentElement = segmentElement->siblingById(MatroskaIds::Segment)) {
-            segmentElement->parse();
-            // iterate throught all child elements of the segment (only "Cues"- and "Cluster"-elements are relevant for this method)
-            for(EbmlElement *segmentChildElement = segmentElement->firstChild(); segmentChildElement; segmentChildElement = segmentChildElement->nextSibling()) {
-                segmentChildElement->parse();
-                switch(segmentChildElement->id()) {
-                case EbmlIds::Void:
-                case EbmlIds::Crc32:
-                    break;
-                case MatroskaIds::Cues:
-                    cuesElementsFound = true;
-                    // parse childs of "Cues"-element ("CuePoint"-elements)
-                    for(EbmlElement *cuePointElement = segmentChildElement->firstChild(); cuePointElement; cuePointElement = cuePointElement->nextSibling()) {
-                        cuePointElement->parse();
-                        cueTimeFound = cueTrackPositionsFound = false; // to validate quantity of these elements
-                        switch(cuePointElement->id()) {
-                        case EbmlIds::Void:
-                        case EbmlIds::Crc32:
-                            break;
-                        case MatroskaIds::CuePoint:
-                            // parse childs of "CuePoint"-element
-                            for(EbmlElement *cuePointChildElement = cuePointElement->firstChild(); cuePointChildElement; cuePointChildElement = cuePointChildElement->nextSibling()) {
-                                cuePointChildElement->parse();
-                                switch(cuePointChildElement->id()) {
-                                case MatroskaIds::CueTime:
-                                    // validate uniqueness
-                                    if(cueTimeFound) {
-                                        addNotification(NotificationType::Warning, "\"CuePoint\"-element contains multiple \"CueTime\" elements.", context);
-                                    } else {
-                                        cueTimeFound = true;
-                                    }
-                                    break;
-                                case MatroskaIds::CueTrackPositions:
-                                    cueTrackPositionsFound = true;
-                                    ids.clear();
-                                    clusterElement.reset();
-                                    for(EbmlElement *subElement = cuePointChildElement->firstChild(); subElement; subElement = subElement->nextSibling()) {
-                                        subElement->parse();
-                                        switch(subElement->id()) {
-                                        case MatroskaIds::CueTrack:
-                                        case MatroskaIds::CueClusterPosition:
-                                        case MatroskaIds::CueRelativePosition:
-                                        case MatroskaIds::CueDuration:
-                                        case MatroskaIds::CueBlockNumber:
-                                        case MatroskaIds::CueCodecState:
-                                            // validate uniqueness
-                                            if(ids.count(subElement->id())) {
-                                                addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains multiple \"" % subElement->idToString() + "\" elements.", context);
-                                            } else {
-                                                ids.insert(subElement->id());
-                                            }
-                                            break;
-                                        case EbmlIds::Crc32:
-                                        case EbmlIds::Void:
-                                        case MatroskaIds::CueReference:
-                                            break;
-                                        default:
-                                            addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains unknown element \"" % subElement->idToString() + "\".", context);
-                                        }
-                                        switch(subElement->id()) {
-                                        case EbmlIds::Void:
-                                        case EbmlIds::Crc32:
-                                        case MatroskaIds::CueTrack:
-                                            break;
-                                        case MatroskaIds::CueClusterPosition:
-                                            // validate "Cluster" position denoted by "CueClusterPosition"-element
-                                            clusterElement = make_unique<EbmlElement>(*this, segmentElement->dataOffset() + subElement->readUInteger() - currentOffset);
-                                            try {
-                                            clusterElement->parse();
-                                            if(clusterElement->id() != MatroskaIds::Cluster) {
-                                                addNotification(NotificationType::Critical, "\"CueClusterPosition\" element at " % numberToString(subElement->startOffset()) + " does not point to \"Cluster\"-element (points to " + numberToString(clusterElement->startOffset()) + ").", context);
-                                            }
-                                        } catch(const Failure &) {
-                                                addNotifications(context, *clusterElement);
-                                            }
-                                            break;
-                                        case MatroskaIds::CueRelativePosition:
-                                            // read "Block" position denoted by "CueRelativePosition"-element (validate later since the "Cluster"-element is needed to validate)
-                                            pos = subElement->readUInteger();
-                                            break;
-                                        case MatroskaIds::CueDuration:
-                                            break;
-                                        case MatroskaIds::CueBlockNumber:
-                                            break;
-                                        case MatroskaIds::CueCodecState:
-                                            break;
-                                        case MatroskaIds::CueReference:
-                                            break;
-                                        default:
-                                            ;
-                                        }
-                                    }
-                                    // validate existence of mandatory elements
-                                    if(!ids.count(MatroskaIds::CueTrack)) {
-                                        addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element does not contain mandatory element \"CueTrack\".", context);
-                                    }
-                                    if(!clusterElement) {
-                                        addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element does not contain mandatory element \"CueClusterPosition\".", context);
-                                    } else {
-                                        if(ids.count(MatroskaIds::CueRelativePosition)) {
-                                            // validate "Block" position denoted by "CueRelativePosition"-element
-                                            EbmlElement referenceElement(*this, clusterElement->dataOffset() + pos);
-                                            try {
-                                                referenceElement.parse();
-                                                switch(referenceElement.id()) {
-                                                case MatroskaIds::SimpleBlock:
-                                                case MatroskaIds::Block:
-                                                case MatroskaIds::BlockGroup:
-                                                    break;
-                                                default:
-                                                    addNotification(NotificationType::Critical, "\"CueRelativePosition\" element does not point to \"Block\"-, \"BlockGroup\", or \"SimpleBlock\"-element (points to " % numberToString(referenceElement.startOffset()) + ").", context);
-                                                }
-                                            } catch(const Failure &) {
-                                                addNotifications(context, referenceElement);
-                                            }
-                                        }
-                                    }
-                                    break;
-                                case EbmlIds::Crc32:
-                                case EbmlIds::Void:
-                                    break;
-                                default:
-                                    addNotification(NotificationType::Warning, "\"CuePoint\"-element contains unknown element \"" % cuePointElement->idToString() + "\".", context);
-                                }
-                            }
-                            // validate existence of mandatory elements
-                            if(!cueTimeFound) {
-                                addNotification(NotificationType::Warning, "\"CuePoint\"-element does not contain mandatory element \"CueTime\".", context);
-                            }
-                            if(!cueTrackPositionsFound) {
-                                addNotification(NotificationType::Warning, "\"CuePoint\"-element does not contain mandatory element \"CueClusterPosition\".", context);
-                            }
-                            break;
-                        default:
-                            ;
-                        }
-                    }
-                    break;
-                case MatroskaIds::Cluster:
-                    // parse childs of "Cluster"-element
-                    for(EbmlElement *clusterElementChild = segmentChildElement->firstChild(); clusterElementChild; clusterElementChild = clusterElementChild->nextSibling()) {
-                        clusterElementChild->parse();
-                        switch(clusterElementChild->id()) {
-                        case EbmlIds::Void:
-                        case EbmlIds::Crc32:
-                            break;
-                        case MatroskaIds::Position:
-                            // validate position
-                            if((pos = clusterElementChild->readUInteger()) > 0 && (segmentChildElement->startOffset() - segmentElement->dataOffset() + currentOffset) != pos) {
-                                addNotification(NotificationType::Critical, argsToString("\"Position\"-element at ", clusterElementChild->startOffset(), " points to ", pos, " which is not the offset of the containing \"Cluster\"-element."), context);
-                            }
-                            break;
-                        case MatroskaIds::PrevSize:
-                            // validate prev size
-                            if((pos = clusterElementChild->readUInteger()) != prevClusterSize) {
-                                addNotification(NotificationType::Critical, argsToString("\"PrevSize\"-element at ", clusterElementChild->startOffset(), " should be ", prevClusterSize, " but is ", pos, "."), context);
-                            }
-                            break;
-                        default:
-                            ;
-                        }
-                    }
-                    prevClusterSize = segmentChildElement->totalSize();
-                    break;
-                default:
-                    ;
-                }
-            }
-            currentOffset += segmentElement->totalSize();
-        }
-    }
-    // add a warning when no index could be found
-    if(!cuesElementsFound) {
-        addNotification(NotificationType::Information, "No \"Cues\"-elements (index) found.", context);
+    MatroskaIndexValidator validator(*this);
+    validator.setThreadCount(threadCount);
+    validator.forwardStatusUpdateCalls(this);
+    try {
+        validator.validate();
+    } catch(...) {
+        addNotifications(validator);
+        throw;
     }
+    addNotifications(validator);
 }
 
 /*!
@@ -384,6 +225,9 @@ void MatroskaContainer::internalParseHeader()
     m_segmentCount = 0;
     uint64 currentOffset = 0;
     vector<MatroskaSeekInfo>::size_type seekInfosIndex = 0;
+    const bool useParseIndex = fileInfo().parseIndex().isIdentified() && !fileInfo().isForcingFullParse();
+    bool parseIndexUsed = false;
+    const EbmlElement *firstClusterElement = nullptr;
     // loop through all top level elements
     for(EbmlElement *topLevelElement = m_firstElement.get(); topLevelElement; topLevelElement = topLevelElement->nextSibling()) {
         try {
@@ -474,6 +318,15 @@ void MatroskaContainer::internalParseHeader()
                             break;
                         case MatroskaIds::Cluster:
                             // cluster reached
+                            if(!firstClusterElement) {
+                                firstClusterElement = subElement;
+                                // take elements after the first cluster from the parse index (instead of following
+                                // the "SeekHead" element or walking through all clusters) if possible
+                                if(useParseIndex && m_segmentCount == 1 && parseIndexedElements(*subElement)) {
+                                    parseIndexUsed = true;
+                                    goto finish;
+                                }
+                            }
                             // stop here if all relevant information has been gathered
                             for(auto i = m_seekInfos.cbegin() + seekInfosIndex, end = m_seekInfos.cend(); i != end; ++i, ++seekInfosIndex) {
                                 for(const auto &infoPair : (*i)->info()) {
@@ -556,11 +409,186 @@ void MatroskaContainer::internalParseHeader()
     }
     // finally parse the "Info"-element and fetch "EditionEntry"-elements
 finish:
+    if(!parseIndexUsed) {
+        updateParseIndex(firstClusterElement);
+    }
+    try {
+        parseSegmentInfo();
+    } catch(const Failure &) {
+        addNotification(NotificationType::Critical, "Unable to parse EBML (segment) \"Info\"-element.", context);
+    }
+}
+
+/*!
+ * \brief Takes the elements after the first cluster from the parse index of the file.
+ *
+ * This private method is called when parsing the header. The elements are only taken if the index has been recorded
+ * for the segment and the cluster of the specified \a firstClusterElement and all elements at the cached offsets have
+ * the cached IDs.
+ *
+ * \returns Returns whether the elements have been taken.
+ * \sa updateParseIndex()
+ */
+bool MatroskaContainer::parseIndexedElements(const EbmlElement &firstClusterElement)
+{
+    const ParseIndex &parseIndex = fileInfo().parseIndex();
+    const vector<uint64> *const segment = parseIndex.entry("matroska.segment");
+    const vector<uint64> *const elements = parseIndex.entry("matroska.elements");
+    if(!segment || !elements || segment->size() != 2
+            || segment->front() != firstClusterElement.parent()->startOffset()
+            || segment->back() != firstClusterElement.startOffset()) {
+        return false;
+    }
+    return takeElements(*elements);
+}
+
+/*!
+ * \brief Takes the level 1 elements at the specified offsets.
+ *
+ * The specified \a elements contain the ID and the offset of each element (alternating). The elements are only taken
+ * if all elements at the specified offsets have the specified IDs.
+ *
+ * \returns Returns whether the elements have been taken.
+ * \sa parseIndexedElements() and takeWrittenElements()
+ */
+bool MatroskaContainer::takeElements(const vector<uint64> &elements)
+{
+    if(elements.size() % 2) {
+        return false;
+    }
+
+    // parse all elements before taking any of them
+    vector<unique_ptr<EbmlElement> > indexedElements;
+    vector<unique_ptr<MatroskaSeekInfo> > seekInfos;
+    indexedElements.reserve(elements.size() / 2);
+    for(auto i = elements.cbegin(), end = elements.cend(); i != end; i += 2) {
+        const uint64 id = i[0], offset = i[1];
+        if(offset >= fileInfo().size()) {
+            return false;
+        }
+        auto element = make_unique<EbmlElement>(*this, offset);
+        try {
+            element->parse();
+            if(element->id() != id) {
+                return false;
+            }
+            if(id == MatroskaIds::SeekHead) {
+                seekInfos.emplace_back(make_unique<MatroskaSeekInfo>());
+                seekInfos.back()->parse(element.get());
+            }
+        } catch(const Failure &) {
+            return false;
+        }
+        indexedElements.emplace_back(move(element));
+    }
+
+    // take the elements
+    for(auto &seekInfo : seekInfos) {
+        addNotifications(*seekInfo);
+        m_seekInfos.emplace_back(move(seekInfo));
+    }
+    for(auto &element : indexedElements) {
+        switch(element->id()) {
+        case MatroskaIds::SegmentInfo:
+            m_segmentInfoElements.push_back(element.get());
+            break;
+        case MatroskaIds::Tracks:
+            m_tracksElements.push_back(element.get());
+            break;
+        case MatroskaIds::Tags:
+            m_tagsElements.push_back(element.get());
+            break;
+        case MatroskaIds::Chapters:
+            m_chaptersElements.push_back(element.get());
+            break;
+        case MatroskaIds::Attachments:
+            m_attachmentsElements.push_back(element.get());
+            break;
+        default:
+            ;
+        }
+        addNotifications(*element);
+        m_additionalElements.emplace_back(move(element));
+    }
+    return true;
+}
+
+/*!
+ * \brief Records the elements after the specified \a firstClusterElement in the parse index of the file.
+ *
+ * This private method is called when parsing the header. Nothing is recorded if the index is not used, there is no
+ * cluster, there are multiple segments or critical errors occurred.
+ *
+ * \sa parseIndexedElements()
+ */
+void MatroskaContainer::updateParseIndex(const EbmlElement *firstClusterElement)
+{
+    ParseIndex &parseIndex = fileInfo().parseIndex();
+    if(!parseIndex.isIdentified() || !firstClusterElement || m_segmentCount != 1 || hasCriticalNotifications()) {
+        return;
+    }
+    const uint64 clusterOffset = firstClusterElement->startOffset();
+    vector<uint64> elements;
+    for(const auto &seekInfo : m_seekInfos) {
+        if(seekInfo->seekHeadElement()->startOffset() > clusterOffset) {
+            elements.push_back(MatroskaIds::SeekHead);
+            elements.push_back(seekInfo->seekHeadElement()->startOffset());
+        }
+    }
+    for(const vector<EbmlElement *> *elementsOfType : {&m_segmentInfoElements, &m_tracksElements, &m_tagsElements, &m_chaptersElements, &m_attachmentsElements}) {
+        for(const EbmlElement *element : *elementsOfType) {
+            if(element->startOffset() > clusterOffset) {
+                elements.push_back(element->id());
+                elements.push_back(element->startOffset());
+            }
+        }
+    }
+    parseIndex.setEntry("matroska.segment", {firstClusterElement->parent()->startOffset(), clusterOffset});
+    parseIndex.setEntry("matroska.elements", move(elements));
+}
+
+/*!
+ * \brief Sets up the elements of the file which has just been written instead of reparsing its header.
+ *
+ * This private method is called after making the file unless verifying the output is enabled (see
+ * MediaFileInfo::isVerifyingOutput()). The specified \a elements contain the ID and the offset of each written
+ * element which is relevant when parsing the header (alternating, see takeElements()). Only these elements and the
+ * "SegmentInfo"-element are read; the level 1 elements of the segment are not walked.
+ *
+ * \returns Returns whether the elements have been taken. If not, the header must be reparsed.
+ * \remarks The values of the EBML header are kept since they have just been written.
+ */
+bool MatroskaContainer::takeWrittenElements(const vector<uint64> &elements)
+{
+    static const string context("parsing header of Matroska container");
+    const auto version = m_version, readVersion = m_readVersion, maxIdLength = m_maxIdLength, maxSizeLength = m_maxSizeLength;
+    const auto doctypeVersion = m_doctypeVersion, doctypeReadVersion = m_doctypeReadVersion;
+    const string doctype = m_doctype;
+    reset();
+    m_version = version;
+    m_readVersion = readVersion;
+    m_maxIdLength = maxIdLength;
+    m_maxSizeLength = maxSizeLength;
+    m_doctype = doctype;
+    m_doctypeVersion = doctypeVersion;
+    m_doctypeReadVersion = doctypeReadVersion;
+    m_firstElement = make_unique<EbmlElement>(*this, startOffset());
+    try {
+        m_firstElement->parse();
+    } catch(const Failure &) {
+        return false;
+    }
+    if(!takeElements(elements)) {
+        return false;
+    }
+    m_segmentCount = 1;
     try {
         parseSegmentInfo();
     } catch(const Failure &) {
         addNotification(NotificationType::Critical, "Unable to parse EBML (segment) \"Info\"-element.", context);
     }
+    m_headerParsed = true;
+    return true;
 }
 
 /*!
@@ -611,6 +639,38 @@ void MatroskaContainer::parseSegmentInfo()
     }
 }
 
+/*!
+ * \brief Determines track-specific statistics (size, frame count, duration and bitrate) by scanning the blocks.
+ *
+ * Unlike readTrackStatisticsFromTags(), this works for files without statistics tags. However, the headers of all
+ * blocks need to be read which takes some time for big files. Hence this method is never called implicitly. The
+ * clusters are scanned using \a threadCount threads (zero means the number of hardware threads is used).
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws Media::Failure or a derived exception when the clusters can not be determined.
+ * \sa MatroskaBlockScanner
+ */
+void MatroskaContainer::readTrackStatisticsFromBlocks(std::size_t threadCount)
+{
+    parseTracks();
+    MatroskaBlockScanner scanner(*this);
+    scanner.setThreadCount(threadCount);
+    try {
+        scanner.scan();
+    } catch(...) {
+        addNotifications(scanner);
+        throw;
+    }
+    addNotifications(scanner);
+    const auto &statistics = scanner.statistics();
+    for(const auto &track : tracks()) {
+        const auto trackStatistics = statistics.find(track->trackNumber());
+        if(trackStatistics != statistics.cend()) {
+            track->readStatisticsFromBlocks(trackStatistics->second);
+        }
+    }
+}
+
 /*!
  * \brief Reads track-specific statistics from tags.
  * \remarks Tags and tracks must have been parsed before calling this method.
@@ -793,8 +853,8 @@ struct SegmentData
     MatroskaCuePositionUpdater cuesUpdater;
     /// \brief size of the "SegmentInfo"-element
     uint64 infoDataSize;
-    /// \brief cluster sizes
-    vector<uint64> clusterSizes;
+    /// \brief used to copy "Cluster"-elements
+    MatroskaClusterCopier clusterCopier;
     /// \brief first "Cluster"-element (original file)
     EbmlElement *firstClusterElement;
     /// \brief end offset of last "Cluster"-element (original file)
@@ -860,11 +920,13 @@ void MatroskaContainer::internalMakeFile()
     // current write offset (used to calculate positions)
     uint64 currentPosition = 0;
     // holds the offsets of all CRC-32 elements and the length of the enclosing block
-    vector<tuple<uint64, uint64> > crc32Offsets;
+    vector<tuple<uint64, uint64, uint32> > crc32Offsets;
+    // -> IDs and offsets of the written level 1 elements which are relevant when parsing the header (see takeWrittenElements())
+    vector<uint64> writtenElements;
     // size length used to make size denotations
     byte sizeLength;
     // sizes and offsets for cluster calculation
-    uint64 clusterSize, clusterReadSize, clusterReadOffset;
+    uint64 clusterSize, clusterReadOffset;
 
     // define variables needed to manage file layout
     // -> use the preferred tag position by default (might be changed later if not forced)
@@ -946,6 +1008,11 @@ void MatroskaContainer::internalMakeFile()
         }
         trackHeaderSize = trackHeaderElementsSize ? 4 + EbmlElement::calculateSizeDenotationLength(trackHeaderElementsSize) + trackHeaderElementsSize : 0;
 
+        // update only the "Tags"- and "Attachments"-element if possible (avoids walking through all clusters)
+        if(!rewriteRequired && makeTagsInPlace(tagMaker, tagElementsSize, attachmentMaker, attachedFileElementsSize, trackHeaderMaker, trackHeaderElementsSize)) {
+            return;
+        }
+
 
         // inspect layout of original file
         //  - number of segments
@@ -1314,7 +1381,8 @@ nonRewriteCalculations:
                     }
 
                     // pretend writing "Cluster"-element
-                    segment.clusterSizes.clear();
+                    segment.clusterCopier.clear();
+                    EbmlReader clusterReader(fileInfo().mappedData(0, fileInfo().size()), &stream());
                     bool cuesInvalidated = false;
                     for(index = 0; level1Element; level1Element = level1Element->siblingById(MatroskaIds::Cluster), ++index) {
                         // update offset of "Cluster"-element in "Cues"-element
@@ -1325,26 +1393,13 @@ nonRewriteCalculations:
                             if(index == 0 && segment.seekInfo.push(index, MatroskaIds::Cluster, currentPosition + segment.totalDataSize)) {
                                 goto calculateSegmentSize;
                             } else {
-                                // add size of "Cluster"-element
-                                clusterSize = clusterReadSize = 0;
-                                for(level2Element = level1Element->firstChild(); level2Element; level2Element = level2Element->nextSibling()) {
-                                    level2Element->parse();
-                                    if(segment.cuesElement && segment.cuesUpdater.updateRelativeOffsets(clusterReadOffset, clusterReadSize, clusterSize) && newCuesPos == ElementPosition::BeforeData) {
+                                // add size of "Cluster"-element (only the headers of the children are read)
+                                clusterSize = segment.clusterCopier.addCluster(*this, clusterReader, level1Element->dataOffset(), level1Element->dataSize(), currentPosition + segment.totalDataSize,
+                                                                                      segment.cuesElement ? [&] (uint64 originalRelativeOffset, uint64 newRelativeOffset) {
+                                    if(segment.cuesUpdater.updateRelativeOffsets(clusterReadOffset, originalRelativeOffset, newRelativeOffset) && newCuesPos == ElementPosition::BeforeData) {
                                         cuesInvalidated = true;
                                     }
-                                    switch(level2Element->id()) {
-                                    case EbmlIds::Void:
-                                    case EbmlIds::Crc32:
-                                        break;
-                                    case MatroskaIds::Position:
-                                        clusterSize += 1 + 1 + EbmlElement::calculateUIntegerLength(currentPosition + segment.totalDataSize);
-                                        break;
-                                    default:
-                                        clusterSize += level2Element->totalSize();
-                                    }
-                                    clusterReadSize += level2Element->totalSize();
-                                }
-                                segment.clusterSizes.push_back(clusterSize);
+                                } : function<void (uint64, uint64)>());
                                 segment.totalDataSize += 4 + EbmlElement::calculateSizeDenotationLength(clusterSize) + clusterSize;
 
                             }
@@ -1458,6 +1513,10 @@ nonRewriteCalculations:
     NativeFileStream backupStream; // create a stream to open the backup/original file for the case rewriting the file is required
     BinaryWriter outputWriter(&outputStream);
     char buff[8]; // buffer used to make size denotations
+    // -> compute CRC-32 checksums while writing (the file is written sequentially when rewriting)
+    const bool computeCrc32WhileWriting = rewriteRequired && any_of(segmentData.cbegin(), segmentData.cend(), [] (const SegmentData &segment) {
+        return segment.hasCrc32;
+    });
 
     if(rewriteRequired) {
         if(fileInfo().saveFilePath().empty()) {
@@ -1487,6 +1546,10 @@ nonRewriteCalculations:
 
         // set backup stream as associated input stream since we need the original elements to write the new file
         setStream(backupStream);
+        // -> allow copying media data without passing it through user space (suspended within segments whose CRC-32
+        //    checksum is computed while writing)
+        nativeCopyHelper().open(backupStream, backupPath.empty() ? fileInfo().path() : backupPath,
+                                outputStream, fileInfo().saveFilePath().empty() ? fileInfo().path() : fileInfo().saveFilePath());
 
         // TODO: reduce code duplication
 
@@ -1509,6 +1572,8 @@ nonRewriteCalculations:
 
     // start actual writing
     try {
+        unique_ptr<Crc32StreamBuffer> crc32Buffer(computeCrc32WhileWriting ? make_unique<Crc32StreamBuffer>(outputStream) : nullptr);
+
         // write EBML header
         updateStatus("Writing EBML header ...");
         outputWriter.writeUInt32BE(EbmlIds::Header);
@@ -1546,6 +1611,8 @@ nonRewriteCalculations:
                 sizeLength = EbmlElement::makeSizeDenotation(segment.totalDataSize, buff);
                 outputStream.write(buff, sizeLength);
                 segment.newDataOffset = offset = outputStream.tellp(); // store segment data offset here
+                // native copying bypasses the buffer computing the CRC-32 checksum
+                nativeCopyHelper().setSuspended(segment.hasCrc32 && crc32Buffer);
 
                 // write CRC-32 element ...
                 if(segment.hasCrc32) {
@@ -1553,18 +1620,26 @@ nonRewriteCalculations:
                     *buff = EbmlIds::Crc32;
                     *(buff + 1) = 0x84; // length denotation: 4 byte
                     // set the value after writing the element
-                    crc32Offsets.emplace_back(outputStream.tellp(), segment.totalDataSize);
+                    crc32Offsets.emplace_back(outputStream.tellp(), segment.totalDataSize, 0);
                     outputStream.write(buff, 6);
+                    if(crc32Buffer) {
+                        crc32Buffer->beginRange();
+                    }
                 }
 
                 // write "SeekHead"-element (except there is no seek information for the current segment)
                 segment.seekInfo.invalidateNotifications();
+                const auto seekHeadOffset = static_cast<uint64>(outputStream.tellp());
                 segment.seekInfo.make(outputStream);
                 addNotifications(segment.seekInfo);
+                if(static_cast<uint64>(outputStream.tellp()) != seekHeadOffset) {
+                    writtenElements.insert(writtenElements.end(), {MatroskaIds::SeekHead, seekHeadOffset});
+                }
 
                 // write "SegmentInfo"-element
                 for(level1Element = level0Element->childById(MatroskaIds::SegmentInfo); level1Element; level1Element = level1Element->siblingById(MatroskaIds::SegmentInfo)) {
                     // -> write ID and size
+                    writtenElements.insert(writtenElements.end(), {MatroskaIds::SegmentInfo, static_cast<uint64>(outputStream.tellp())});
                     outputWriter.writeUInt32BE(MatroskaIds::SegmentInfo);
                     sizeLength = EbmlElement::makeSizeDenotation(segment.infoDataSize, buff);
                     outputStream.write(buff, sizeLength);
@@ -1596,6 +1671,7 @@ nonRewriteCalculations:
 
                 // write "Tracks"-element
                 if(trackHeaderElementsSize) {
+                    writtenElements.insert(writtenElements.end(), {MatroskaIds::Tracks, static_cast<uint64>(outputStream.tellp())});
                     outputWriter.writeUInt32BE(MatroskaIds::Tracks);
                     sizeLength = EbmlElement::makeSizeDenotation(trackHeaderElementsSize, buff);
                     outputStream.write(buff, sizeLength);
@@ -1607,6 +1683,7 @@ nonRewriteCalculations:
 
                 // write "Chapters"-element
                 for(level1Element = level0Element->childById(MatroskaIds::Chapters); level1Element; level1Element = level1Element->siblingById(MatroskaIds::Chapters)) {
+                    writtenElements.insert(writtenElements.end(), {MatroskaIds::Chapters, static_cast<uint64>(outputStream.tellp())});
                     level1Element->copyBuffer(outputStream);
                     level1Element->discardBuffer();
                 }
@@ -1614,6 +1691,7 @@ nonRewriteCalculations:
                 if(newTagPos == ElementPosition::BeforeData && segmentIndex == 0) {
                     // write "Tags"-element
                     if(tagsSize) {
+                        writtenElements.insert(writtenElements.end(), {MatroskaIds::Tags, static_cast<uint64>(outputStream.tellp())});
                         outputWriter.writeUInt32BE(MatroskaIds::Tags);
                         sizeLength = EbmlElement::makeSizeDenotation(tagElementsSize, buff);
                         outputStream.write(buff, sizeLength);
@@ -1624,6 +1702,7 @@ nonRewriteCalculations:
                     }
                     // write "Attachments"-element
                     if(attachmentsSize) {
+                        writtenElements.insert(writtenElements.end(), {MatroskaIds::Attachments, static_cast<uint64>(outputStream.tellp())});
                         outputWriter.writeUInt32BE(MatroskaIds::Attachments);
                         sizeLength = EbmlElement::makeSizeDenotation(attachedFileElementsSize, buff);
                         outputStream.write(buff, sizeLength);
@@ -1673,29 +1752,11 @@ nonRewriteCalculations:
                         throw OperationAbortedException();
                     }
                     updateStatus("Writing cluster ...", static_cast<double>(static_cast<uint64>(outputStream.tellp()) - offset) / segment.totalDataSize);
-                    // write "Cluster"-element
-                    auto clusterSizesIterator = segment.clusterSizes.cbegin();
-                    unsigned int index = 0;
-                    for(;level1Element; level1Element = level1Element->siblingById(MatroskaIds::Cluster), ++clusterSizesIterator, ++index) {
+                    // write "Cluster"-elements; the children are copied range-wise without parsing them again
+                    for(size_t index = 0, clusterCount = segment.clusterCopier.clusters().size(); index != clusterCount; ++index) {
                         // calculate position of cluster in segment
                         clusterSize = currentPosition + (static_cast<uint64>(outputStream.tellp()) - offset);
-                        // write header; checking whether clusterSizesIterator is valid shouldn't be necessary
-                        outputWriter.writeUInt32BE(MatroskaIds::Cluster);
-                        sizeLength = EbmlElement::makeSizeDenotation(*clusterSizesIterator, buff);
-                        outputStream.write(buff, sizeLength);
-                        // write childs
-                        for(level2Element = level1Element->firstChild(); level2Element; level2Element = level2Element->nextSibling()) {
-                            switch(level2Element->id()) {
-                            case EbmlIds::Void:
-                            case EbmlIds::Crc32:
-                                break;
-                            case MatroskaIds::Position:
-                                EbmlElement::makeSimpleElement(outputStream, MatroskaIds::Position, clusterSize);
-                                break;
-                            default:
-                                level2Element->copyEntirely(outputStream);
-                            }
-                        }
+                        segment.clusterCopier.copyCluster(index, clusterSize, stream(), outputStream, nativeCopyHelper(), bind(&MatroskaContainer::isAborted, this));
                         // update percentage, check whether the operation has been aborted
                         if(isAborted()) {
                             throw OperationAbortedException();
@@ -1748,6 +1809,7 @@ nonRewriteCalculations:
                 if(newTagPos == ElementPosition::AfterData && segmentIndex == lastSegmentIndex) {
                     // write "Tags"-element
                     if(tagsSize) {
+                        writtenElements.insert(writtenElements.end(), {MatroskaIds::Tags, static_cast<uint64>(outputStream.tellp())});
                         outputWriter.writeUInt32BE(MatroskaIds::Tags);
                         sizeLength = EbmlElement::makeSizeDenotation(tagElementsSize, buff);
                         outputStream.write(buff, sizeLength);
@@ -1758,6 +1820,7 @@ nonRewriteCalculations:
                     }
                     // write "Attachments"-element
                     if(attachmentsSize) {
+                        writtenElements.insert(writtenElements.end(), {MatroskaIds::Attachments, static_cast<uint64>(outputStream.tellp())});
                         outputWriter.writeUInt32BE(MatroskaIds::Attachments);
                         sizeLength = EbmlElement::makeSizeDenotation(attachedFileElementsSize, buff);
                         outputStream.write(buff, sizeLength);
@@ -1768,6 +1831,11 @@ nonRewriteCalculations:
                     }
                 }
 
+                // end CRC-32 checksum of the segment
+                if(segment.hasCrc32 && crc32Buffer) {
+                    get<2>(crc32Offsets.back()) = crc32Buffer->endRange();
+                }
+
                 // increase the current segment index
                 ++segmentIndex;
 
@@ -1783,8 +1851,14 @@ nonRewriteCalculations:
             }
         }
 
+        // write pending data
+        if(crc32Buffer) {
+            crc32Buffer->detach();
+        }
+
         // reparse what is written so far
         updateStatus("Reparsing output file ...");
+        nativeCopyHelper().close();
         if(rewriteRequired) {
             // report new size
             fileInfo().reportSizeChanged(outputStream.tellp());
@@ -1818,21 +1892,28 @@ nonRewriteCalculations:
                 fileInfo().reportSizeChanged(newSize);
             }
         }
-        reset();
-        try {
-            parseHeader();
-        } catch(const Failure &) {
-            addNotification(NotificationType::Critical, "Unable to reparse the header of the new file.", context);
-            throw;
+        if(fileInfo().isVerifyingOutput() || m_segmentCount != 1 || !takeWrittenElements(writtenElements)) {
+            reset();
+            try {
+                parseHeader();
+            } catch(const Failure &) {
+                addNotification(NotificationType::Critical, "Unable to reparse the header of the new file.", context);
+                throw;
+            }
         }
 
         // update CRC-32 checksums
         if(!crc32Offsets.empty()) {
             updateStatus("Updating CRC-32 checksums ...");
             for(const auto &crc32Offset : crc32Offsets) {
-                outputStream.seekg(get<0>(crc32Offset) + 6);
+                // the checksum has already been computed while writing if the file has been rewritten
+                uint32 crc = get<2>(crc32Offset);
+                if(!computeCrc32WhileWriting) {
+                    outputStream.seekg(get<0>(crc32Offset) + 6);
+                    crc = Crc32::compute(Crc32::Variant::Ebml, outputStream, get<1>(crc32Offset) - 6);
+                }
                 outputStream.seekp(get<0>(crc32Offset) + 2);
-                writer().writeUInt32LE(reader().readCrc32(get<1>(crc32Offset) - 6));
+                writer().writeUInt32LE(crc);
             }
         }
 
@@ -1843,8 +1924,397 @@ nonRewriteCalculations:
 
         // handle errors (which might have been occured after renaming/creating backup file)
     } catch(...) {
+        nativeCopyHelper().close();
         BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, outputStream, backupStream, context);
     }
 }
 
+/*!
+ * \brief Writes the "Tags"- and "Attachments"-element in-place if nothing else needs to be changed.
+ *
+ * This private method is called by internalMakeFile() before the layout of the whole file is calculated. The elements
+ * are only updated in-place if
+ * - there is only one "Segment"-element and it has no CRC-32 checksum,
+ * - the segment contains at most one "Tags"- and one "Attachments"-element which are only separated by
+ *   "Void"-elements,
+ * - the new elements fit into the space occupied by these elements and the subsequent "Void"-elements (considering
+ *   the min./max. padding) or the space is at the end of the file,
+ * - the "Tracks"-element and the title have not been changed,
+ * - the current position of the "Tags"- and "Cues"-element satisfies a forced position and
+ * - the "SeekHead"-elements can be updated without changing their size.
+ *
+ * In this case only the region of the "Tags"- and "Attachments"-element, the affected "SeekPosition"-elements, the
+ * "MuxingApp"- and "WritingApp"-elements, the CRC-32 checksums of the "SeekHead"- and "SegmentInfo"-elements and the
+ * size of the "Segment"-element (if the file is resized) are written. The "Cluster"-elements are not touched at all.
+ *
+ * If the space is at the end of the file, the file is resized. The remaining space is kept as padding if it is within
+ * the min./max. padding; otherwise the preferred padding is used (like when rewriting the file).
+ *
+ * The "MuxingApp"- and "WritingApp"-elements are only updated if the new value has the same size as the present value.
+ * Otherwise they are left untouched (an information is added in this case) since the "SegmentInfo"-element is not
+ * rewritten.
+ *
+ * \returns Returns whether the elements have been updated. If not, nothing has been written.
+ */
+bool MatroskaContainer::makeTagsInPlace(const vector<MatroskaTagMaker> &tagMaker, uint64 tagElementsSize,
+                                        const vector<MatroskaAttachmentMaker> &attachmentMaker, uint64 attachedFileElementsSize,
+                                        const vector<MatroskaTrackHeaderMaker> &trackHeaderMaker, uint64 trackHeaderElementsSize)
+{
+    static const string context("making Matroska container");
+    if(m_segmentCount != 1 || m_tagsElements.size() > 1 || m_attachmentsElements.size() > 1
+            || (m_tagsElements.empty() && m_attachmentsElements.empty())) {
+        return false;
+    }
+    // the position of the elements is not altered
+    if(fileInfo().forceTagPosition() && fileInfo().tagPosition() != ElementPosition::Keep
+            && (m_tagsElements.empty() || determineTagPosition() != fileInfo().tagPosition())) {
+        return false;
+    }
+    if(fileInfo().forceIndexPosition() && fileInfo().indexPosition() != ElementPosition::Keep
+            && determineIndexPosition() != fileInfo().indexPosition()) {
+        return false;
+    }
+    EbmlElement *const tagsElement = m_tagsElements.empty() ? nullptr : m_tagsElements.front();
+    EbmlElement *const attachmentsElement = m_attachmentsElements.empty() ? nullptr : m_attachmentsElements.front();
+    const uint64 tagsSize = tagElementsSize ? 4 + EbmlElement::calculateSizeDenotationLength(tagElementsSize) + tagElementsSize : 0;
+    const uint64 attachmentsSize = attachedFileElementsSize ? 4 + EbmlElement::calculateSizeDenotationLength(attachedFileElementsSize) + attachedFileElementsSize : 0;
+
+    // determine what needs to be written without modifying the file
+    EbmlElement *segmentElement;
+    uint64 regionStart, regionEnd, padding = 0, newSegmentDataSize;
+    bool resizeFile;
+    vector<pair<EbmlElement *, uint64> > seekPositions;
+    vector<EbmlElement *> appInfoElements, checksummedElements;
+    char buff[8];
+    byte segmentSizeLength;
+    bool appInfoUpdatable;
+    try {
+        // -> find the segment
+        for(segmentElement = firstElement(); segmentElement; segmentElement = segmentElement->nextSibling()) {
+            segmentElement->parse();
+            if(segmentElement->id() == MatroskaIds::Segment) {
+                break;
+            }
+        }
+        if(!segmentElement) {
+            return false;
+        }
+        if(EbmlElement *firstSegmentChild = segmentElement->firstChild()) {
+            firstSegmentChild->parse();
+            if(firstSegmentChild->id() == EbmlIds::Crc32) {
+                // the checksum would have to be computed over the whole segment
+                return false;
+            }
+        }
+
+        // -> determine the region occupied by the "Tags"- and "Attachments"-element and subsequent "Void"-elements
+        regionStart = min(tagsElement ? tagsElement->startOffset() : numeric_limits<uint64>::max(),
+                          attachmentsElement ? attachmentsElement->startOffset() : numeric_limits<uint64>::max());
+        const uint64 segmentEnd = segmentElement->endOffset();
+        bool tagsFound = !tagsElement, attachmentsFound = !attachmentsElement;
+        // (walk the siblings within the element tree so no elements are created which are not part of it)
+        regionEnd = regionStart;
+        for(EbmlElement *element = (tagsElement && tagsElement->startOffset() == regionStart) ? tagsElement : attachmentsElement;
+            element; element = element->nextSibling()) {
+            element->parse();
+            if(element->endOffset() > segmentEnd) {
+                return false;
+            }
+            if(element == tagsElement) {
+                tagsFound = true;
+            } else if(element == attachmentsElement) {
+                attachmentsFound = true;
+            } else if(element->id() != EbmlIds::Void) {
+                break;
+            }
+            regionEnd = element->endOffset();
+        }
+        if(!tagsFound || !attachmentsFound) {
+            return false;
+        }
+
+        // -> check whether the new elements fit
+        const uint64 regionSize = regionEnd - regionStart, newRegionSize = tagsSize + attachmentsSize;
+        newSegmentDataSize = segmentElement->dataSize();
+        if((resizeFile = (regionEnd == segmentEnd && segmentEnd == fileInfo().size()))) {
+            // the region is at the end of the file -> resize the file and update the size of the segment
+            // -> keep the remaining space as padding if it is ok according to the specifications; otherwise use the
+            //    preferred padding like when rewriting the file
+            padding = newRegionSize < regionSize ? regionSize - newRegionSize : 0;
+            if(padding == 1 || padding > fileInfo().maxPadding() || padding < fileInfo().minPadding()) {
+                padding = fileInfo().preferredPadding();
+            }
+            if(padding == 1) {
+                return false;
+            }
+            newSegmentDataSize = newSegmentDataSize - regionSize + newRegionSize + padding;
+            if((segmentSizeLength = EbmlElement::makeSizeDenotation(newSegmentDataSize, buff, segmentElement->sizeLength())) != segmentElement->sizeLength()) {
+                return false;
+            }
+        } else if(newRegionSize > regionSize || (padding = regionSize - newRegionSize) == 1
+                  || padding > fileInfo().maxPadding() || padding < fileInfo().minPadding()) {
+            return false;
+        }
+
+        // -> check whether the "Tracks"-element and the title are unchanged (they are not written)
+        if(m_tracksElements.size() > 1 || m_tracksElements.empty() != !trackHeaderElementsSize) {
+            return false;
+        }
+        if(trackHeaderElementsSize) {
+            EbmlElement *const tracksElement = m_tracksElements.front();
+            if(tracksElement->dataSize() != trackHeaderElementsSize) {
+                return false;
+            }
+            stringstream newTrackHeaders(ios_base::in | ios_base::out | ios_base::binary);
+            for(const auto &maker : trackHeaderMaker) {
+                maker.make(newTrackHeaders);
+            }
+            string trackHeaders(static_cast<size_t>(trackHeaderElementsSize), '\0');
+            stream().seekg(static_cast<streamoff>(tracksElement->dataOffset()));
+            stream().read(&trackHeaders[0], static_cast<streamsize>(trackHeaders.size()));
+            if(trackHeaders != newTrackHeaders.str()) {
+                return false;
+            }
+        }
+        // -> determine the "MuxingApp"- and "WritingApp"-elements which can be updated without changing their size
+        string title;
+        appInfoUpdatable = true;
+        for(EbmlElement *segmentInfoElement : m_segmentInfoElements) {
+            for(EbmlElement *child = segmentInfoElement->firstChild(); child; child = child->nextSibling()) {
+                child->parse();
+                switch(child->id()) {
+                case EbmlIds::Crc32:
+                    if(child == segmentInfoElement->firstChild()) {
+                        checksummedElements.push_back(segmentInfoElement);
+                    }
+                    break;
+                case MatroskaIds::Title:
+                    title = child->readString();
+                    break;
+                case MatroskaIds::MuxingApp:
+                case MatroskaIds::WrittingApp:
+                    if(child->dataSize() == appInfoElementDataSize) {
+                        appInfoElements.push_back(child);
+                    } else {
+                        appInfoUpdatable = false;
+                    }
+                    break;
+                default:
+                    ;
+                }
+            }
+        }
+        if(!m_titles.empty() && m_titles.front() != title) {
+            return false;
+        }
+        if(!appInfoUpdatable) {
+            appInfoElements.clear();
+        }
+
+        // -> determine the "SeekPosition"-elements to be updated
+        bool tagsSeekable = false, attachmentsSeekable = false;
+        for(const auto &seekInfo : m_seekInfos) {
+            EbmlElement *const seekHeadElement = seekInfo->seekHeadElement();
+            for(EbmlElement *seekElement = seekHeadElement->firstChild(); seekElement; seekElement = seekElement->nextSibling()) {
+                seekElement->parse();
+                if(seekElement->id() == EbmlIds::Crc32 && seekElement == seekHeadElement->firstChild()) {
+                    checksummedElements.push_back(seekHeadElement);
+                }
+                if(seekElement->id() != MatroskaIds::Seek) {
+                    continue;
+                }
+                EbmlElement *seekIdElement = nullptr, *seekPositionElement = nullptr;
+                for(EbmlElement *child = seekElement->firstChild(); child; child = child->nextSibling()) {
+                    child->parse();
+                    switch(child->id()) {
+                    case MatroskaIds::SeekID:
+                        seekIdElement = child;
+                        break;
+                    case MatroskaIds::SeekPosition:
+                        seekPositionElement = child;
+                        break;
+                    default:
+                        ;
+                    }
+                }
+                if(!seekIdElement || !seekPositionElement) {
+                    continue;
+                }
+                uint64 newPosition;
+                switch(seekIdElement->readUInteger()) {
+                case MatroskaIds::Tags:
+                    if(!tagsSize) {
+                        return false;
+                    }
+                    newPosition = regionStart - segmentElement->dataOffset();
+                    tagsSeekable = true;
+                    break;
+                case MatroskaIds::Attachments:
+                    if(!attachmentsSize) {
+                        return false;
+                    }
+                    newPosition = regionStart + tagsSize - segmentElement->dataOffset();
+                    attachmentsSeekable = true;
+                    break;
+                default:
+                    continue;
+                }
+                if(EbmlElement::makeUInteger(newPosition, buff, static_cast<byte>(seekPositionElement->dataSize())) > seekPositionElement->dataSize()) {
+                    return false;
+                }
+                seekPositions.emplace_back(seekPositionElement, newPosition);
+            }
+        }
+        // -> elements which have not been present before need to be added to the "SeekHead"-element
+        if(!m_seekInfos.empty() && ((tagsSize && !tagsElement && !tagsSeekable) || (attachmentsSize && !attachmentsElement && !attachmentsSeekable))) {
+            return false;
+        }
+    } catch(const Failure &) {
+        // just use the regular way to make the file
+        return false;
+    }
+
+    // make the region in memory before modifying the file (attachments might be read from the region)
+    updateStatus("Updating \"Tags\"- and \"Attachments\"-element in-place ...");
+    if(!appInfoUpdatable) {
+        addNotification(NotificationType::Information, "The \"MuxingApp\"- and \"WritingApp\"-element are left untouched because they can not be updated without changing the size of the \"SegmentInfo\"-element.", context);
+    }
+    stringstream region(ios_base::in | ios_base::out | ios_base::binary);
+    BinaryWriter regionWriter(&region);
+    byte sizeLength;
+    if(tagsSize) {
+        regionWriter.writeUInt32BE(MatroskaIds::Tags);
+        sizeLength = EbmlElement::makeSizeDenotation(tagElementsSize, buff);
+        region.write(buff, sizeLength);
+        for(const auto &maker : tagMaker) {
+            maker.make(region);
+        }
+    }
+    if(attachmentsSize) {
+        regionWriter.writeUInt32BE(MatroskaIds::Attachments);
+        sizeLength = EbmlElement::makeSizeDenotation(attachedFileElementsSize, buff);
+        region.write(buff, sizeLength);
+        for(const auto &maker : attachmentMaker) {
+            maker.make(region);
+        }
+    }
+    if(padding) {
+        uint64 voidLength;
+        if(padding < 64) {
+            sizeLength = 1;
+            *buff = static_cast<char>(voidLength = padding - 2) | 0x80;
+        } else {
+            sizeLength = 8;
+            BE::getBytes(static_cast<uint64>((voidLength = padding - 9) | 0x100000000000000), buff);
+        }
+        regionWriter.writeByte(EbmlIds::Void);
+        region.write(buff, sizeLength);
+        for(; voidLength; --voidLength) {
+            region.put(0);
+        }
+    }
+    const string regionData(region.str());
+    vector<uint64> writtenElements;
+    for(const auto &seekInfo : m_seekInfos) {
+        writtenElements.insert(writtenElements.end(), {MatroskaIds::SeekHead, seekInfo->seekHeadElement()->startOffset()});
+    }
+    for(const vector<EbmlElement *> *elementsOfType : {&m_segmentInfoElements, &m_tracksElements, &m_chaptersElements}) {
+        for(const EbmlElement *element : *elementsOfType) {
+            writtenElements.insert(writtenElements.end(), {element->id(), element->startOffset()});
+        }
+    }
+    if(tagsSize) {
+        writtenElements.insert(writtenElements.end(), {MatroskaIds::Tags, regionStart});
+    }
+    if(attachmentsSize) {
+        writtenElements.insert(writtenElements.end(), {MatroskaIds::Attachments, regionStart + tagsSize});
+    }
+    const uint64 segmentSizeOffset = segmentElement->startOffset() + segmentElement->idLength();
+    const bool segmentSizeChanged = newSegmentDataSize != segmentElement->dataSize();
+    vector<pair<uint64, uint64> > crc32Ranges;
+    for(EbmlElement *checksummedElement : checksummedElements) {
+        crc32Ranges.emplace_back(checksummedElement->firstChild()->startOffset(), checksummedElement->endOffset());
+    }
+    vector<uint64> appInfoOffsets;
+    for(EbmlElement *appInfoElement : appInfoElements) {
+        appInfoOffsets.push_back(appInfoElement->dataOffset());
+    }
+
+    // reopen original file to ensure it is opened for writing
+    NativeFileStream &outputStream = fileInfo().stream();
+    NativeFileStream backupStream;
+    BinaryWriter outputWriter(&outputStream);
+    try {
+        fileInfo().close();
+        outputStream.open(fileInfo().path(), ios_base::in | ios_base::out | ios_base::binary);
+    } catch(...) {
+        const char *what = catchIoFailure();
+        addNotification(NotificationType::Critical, "Opening the file with write permissions failed.", context);
+        throwIoFailure(what);
+    }
+
+    try {
+        // write the region, the "SeekPosition"-, "MuxingApp"- and "WritingApp"-elements and the segment size
+        outputStream.seekp(static_cast<streamoff>(regionStart));
+        outputStream.write(regionData.data(), static_cast<streamsize>(regionData.size()));
+        for(const uint64 appInfoOffset : appInfoOffsets) {
+            outputStream.seekp(static_cast<streamoff>(appInfoOffset));
+            outputStream.write(appInfo, static_cast<streamsize>(appInfoElementDataSize));
+        }
+        for(const auto &seekPosition : seekPositions) {
+            sizeLength = EbmlElement::makeUInteger(seekPosition.second, buff, static_cast<byte>(seekPosition.first->dataSize()));
+            outputStream.seekp(static_cast<streamoff>(seekPosition.first->dataOffset()));
+            outputStream.write(buff, sizeLength);
+        }
+        if(segmentSizeChanged) {
+            EbmlElement::makeSizeDenotation(newSegmentDataSize, buff, segmentSizeLength);
+            outputStream.seekp(static_cast<streamoff>(segmentSizeOffset));
+            outputStream.write(buff, segmentSizeLength);
+        }
+
+        // update CRC-32 checksums of the "SeekHead"- and "SegmentInfo"-elements
+        outputStream.flush();
+        for(const auto &crc32Range : crc32Ranges) {
+            outputStream.seekg(static_cast<streamoff>(crc32Range.first + 6));
+            const uint32 crc = Crc32::compute(Crc32::Variant::Ebml, outputStream, crc32Range.second - crc32Range.first - 6);
+            outputStream.seekp(static_cast<streamoff>(crc32Range.first + 2));
+            outputWriter.writeUInt32LE(crc);
+        }
+
+        // resize the file if the region is at the end
+        if(resizeFile) {
+            const uint64 newSize = regionStart + regionData.size();
+            if(newSize < fileInfo().size()) {
+                outputStream.close();
+                if(truncate(fileInfo().path().c_str(), static_cast<off_t>(newSize)) == 0) {
+                    fileInfo().reportSizeChanged(newSize);
+                } else {
+                    addNotification(NotificationType::Critical, "Unable to truncate the file.", context);
+                }
+                outputStream.open(fileInfo().path(), ios_base::in | ios_base::out | ios_base::binary);
+            } else {
+                fileInfo().reportSizeChanged(newSize);
+            }
+        }
+
+        // take the elements (which have not been moved) or reparse the header to verify the output
+        updateStatus("Reparsing output file ...");
+        if(fileInfo().isVerifyingOutput() || !takeWrittenElements(writtenElements)) {
+            reset();
+            try {
+                parseHeader();
+            } catch(const Failure &) {
+                addNotification(NotificationType::Critical, "Unable to reparse the header of the new file.", context);
+                throw;
+            }
+        }
+
+        updatePercentage(1.0);
+        outputStream.flush();
+    } catch(...) {
+        BackupHelper::handleFailureAfterFileModified(fileInfo(), string(), outputStream, backupStream, context);
+    }
+    return true;
+}
+
 }
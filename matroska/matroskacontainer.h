@@ -28,7 +28,8 @@ public:
     MatroskaContainer(MediaFileInfo &stream, uint64 startOffset);
     ~MatroskaContainer();
 
-    void validateIndex();
+    void validateIndex(std::size_t threadCount = 0);
+    void readTrackStatisticsFromBlocks(std::size_t threadCount = 0);
     uint64 maxIdLength() const;
     uint64 maxSizeLength() const;
     const std::vector<std::unique_ptr<MatroskaSeekInfo> > &seekInfos() const;
@@ -60,7 +61,14 @@ protected:
 
 private:
     void parseSegmentInfo();
+    bool parseIndexedElements(const EbmlElement &firstClusterElement);
+    bool takeElements(const std::vector<uint64> &elements);
+    bool takeWrittenElements(const std::vector<uint64> &elements);
+    void updateParseIndex(const EbmlElement *firstClusterElement);
     void readTrackStatisticsFromTags();
+    bool makeTagsInPlace(const std::vector<MatroskaTagMaker> &tagMaker, uint64 tagElementsSize,
+                         const std::vector<MatroskaAttachmentMaker> &attachmentMaker, uint64 attachedFileElementsSize,
+                         const std::vector<MatroskaTrackHeaderMaker> &trackHeaderMaker, uint64 trackHeaderElementsSize);
 
     uint64 m_maxIdLength;
     uint64 m_maxSizeLength;
@@ -1,8 +1,16 @@
 #include "./matroskacues.h"
 #include "./matroskacontainer.h"
+#include "./ebmlreader.h"
+
+#include "../mediafileinfo.h"
+#include "../exceptions.h"
 
 #include <c++utilities/conversion/binaryconversion.h>
 
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
 using namespace std;
 using namespace ConversionUtilities;
 
@@ -29,7 +37,69 @@ namespace Media {
  * \brief The MatroskaCuePositionUpdater class helps to rewrite the "Cues"-element with shifted positions.
  *
  * This class is used when rewriting a Matroska file to save changed tag information.
+ *
+ * The "Cues"-element of big files might contain hundreds of thousands of tiny elements. Hence the data of the
+ * "Cues"-element is read into a single buffer and walked using EbmlReader instead of creating an EbmlElement (and a
+ * buffer) for each child. The structure is kept as a flat list of items: runs of unchanged elements which are copied
+ * from the buffer, headers of master elements and the offsets which might be updated. The offsets are kept in arrays
+ * sorted by their initial value so updateOffsets() and updateRelativeOffsets() can use a binary search.
+ */
+
+/// \brief The index of the "Cues"-element within the master elements.
+static constexpr size_t cuesElementIndex = 0;
+/// \brief The index denoting the absence of an element/offset (eg. the parent of the "Cues"-element).
+static constexpr size_t noIndex = numeric_limits<size_t>::max();
+
+/*!
+ * \brief Reads the header of the child at \a offset within the buffered "Cues"-element.
+ * \returns Returns the end offset of the child; \a id and \a dataOffset are set accordingly.
+ * \throws Throws InvalidDataException if the header is invalid or the child exceeds its parent ending at \a end.
+ */
+static uint64 readChild(EbmlReader &reader, uint64 offset, uint64 end, uint64 &id, uint64 &dataOffset)
+{
+    uint64 dataSize;
+    const byte headerSize = reader.readElementHeader(offset, end, id, dataSize);
+    if(!headerSize || dataSize > end - offset - headerSize) {
+        throw InvalidDataException();
+    }
+    dataOffset = offset + headerSize;
+    return dataOffset + dataSize;
+}
+
+/*!
+ * \brief Sorts the specified \a entries using \a compare.
+ * \returns Returns the new index for each previous index.
  */
+template<typename Entry, typename Compare>
+static vector<size_t> sortEntries(vector<Entry> &entries, Compare compare)
+{
+    vector<size_t> order(entries.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [&entries, &compare] (size_t lhs, size_t rhs) {
+        return compare(entries[lhs], entries[rhs]);
+    });
+    vector<Entry> sortedEntries;
+    sortedEntries.reserve(entries.size());
+    vector<size_t> newIndices(entries.size());
+    for(size_t newIndex = 0; newIndex != order.size(); ++newIndex) {
+        sortedEntries.push_back(entries[order[newIndex]]);
+        newIndices[order[newIndex]] = newIndex;
+    }
+    entries.swap(sortedEntries);
+    return newIndices;
+}
+
+/*!
+ * \brief Writes an element with the specified (single byte) \a id holding the specified unsigned integer \a value to \a buff.
+ * \returns Returns the position after the written element.
+ */
+static char *makeUIntegerElement(byte id, uint64 value, char *buff)
+{
+    *buff = static_cast<char>(id);
+    const byte length = EbmlElement::makeUInteger(value, buff + 2);
+    buff[1] = static_cast<char>(0x80 | length);
+    return buff + 2 + length;
+}
 
 /*!
  * \brief Returns how many bytes will be written when calling the make() method.
@@ -38,7 +108,7 @@ namespace Media {
 uint64 MatroskaCuePositionUpdater::totalSize() const
 {
     if(m_cuesElement) {
-        uint64 size = m_sizes.at(m_cuesElement);
+        const uint64 size = m_elements[cuesElementIndex].size;
         return 4 + EbmlElement::calculateSizeDenotationLength(size) + size;
     } else {
         return 0;
@@ -53,106 +123,191 @@ void MatroskaCuePositionUpdater::parse(EbmlElement *cuesElement)
 {
     static const string context("parsing \"Cues\"-element");
     clear();
-    uint64 cuesElementSize = 0, cuePointElementSize, cueTrackPositionsElementSize, cueReferenceElementSize, pos, relPos, statePos;
-    EbmlElement *cueRelativePositionElement, *cueClusterPositionElement;
-    for(EbmlElement *cuePointElement = cuesElement->firstChild(); cuePointElement; cuePointElement = cuePointElement->nextSibling()) {
-        // parse childs of "Cues"-element which must be "CuePoint"-elements
-        cuePointElement->parse();
-        switch(cuePointElement->id()) {
-        case EbmlIds::Void:
-        case EbmlIds::Crc32:
-            break;
-        case MatroskaIds::CuePoint:
-            cuePointElementSize = 0;
-            for(EbmlElement *cuePointChild = cuePointElement->firstChild(); cuePointChild; cuePointChild = cuePointChild->nextSibling()) {
-                // parse childs of "CuePoint"-element
-                cuePointChild->parse();
-                switch(cuePointChild->id()) {
-                case EbmlIds::Void:
-                case EbmlIds::Crc32:
-                    break;
-                case MatroskaIds::CueTime:
-                    cuePointChild->makeBuffer();
-                    cuePointElementSize += cuePointChild->totalSize();
-                    break;
-                case MatroskaIds::CueTrackPositions:
-                    cueTrackPositionsElementSize = 0;
-                    cueRelativePositionElement = cueClusterPositionElement = nullptr;
-                    for(EbmlElement *cueTrackPositionsChild = cuePointChild->firstChild(); cueTrackPositionsChild; cueTrackPositionsChild = cueTrackPositionsChild->nextSibling()) {
-                        // parse childs of "CueTrackPositions"-element
-                        cueTrackPositionsChild->parse();                        
-                        switch(cueTrackPositionsChild->id()) {
-                        case MatroskaIds::CueTrack:
-                        case MatroskaIds::CueDuration:
-                        case MatroskaIds::CueBlockNumber:
-                            cueTrackPositionsChild->makeBuffer();
-                            cueTrackPositionsElementSize += cueTrackPositionsChild->totalSize();
-                            break;
-                        case MatroskaIds::CueRelativePosition:
-                            relPos = (cueRelativePositionElement = cueTrackPositionsChild)->readUInteger();
-                            break;
-                        case MatroskaIds::CueClusterPosition:
-                            pos = (cueClusterPositionElement = cueTrackPositionsChild)->readUInteger();
-                            cueTrackPositionsElementSize += 2 + EbmlElement::calculateUIntegerLength(pos);
-                            m_offsets.emplace(cueTrackPositionsChild, pos);
-                            break;
-                        case MatroskaIds::CueCodecState:
-                            statePos = cueTrackPositionsChild->readUInteger();
-                            cueTrackPositionsElementSize += 2 + EbmlElement::calculateUIntegerLength(statePos);
-                            m_offsets.emplace(cueTrackPositionsChild, statePos);
-                            break;
-                        case MatroskaIds::CueReference:
-                            cueReferenceElementSize = 0;
-                            for(EbmlElement *cueReferenceChild = cueTrackPositionsChild->firstChild(); cueReferenceChild; cueReferenceChild = cueReferenceChild->nextSibling()) {
-                                // parse childs of "CueReference"-element
-                                cueReferenceChild->parse();
-                                switch(cueReferenceChild->id()) {
-                                case EbmlIds::Void:
-                                case EbmlIds::Crc32:
-                                    break;
-                                case MatroskaIds::CueRefTime:
-                                case MatroskaIds::CueRefNumber:
-                                    cueReferenceChild->makeBuffer();
-                                    cueReferenceElementSize += cueReferenceChild->totalSize();
-                                    break;
-                                case MatroskaIds::CueRefCluster:
-                                case MatroskaIds::CueRefCodecState:
-                                    statePos = cueReferenceChild->readUInteger();
-                                    cueReferenceElementSize += 2 + EbmlElement::calculateUIntegerLength(statePos);
-                                    m_offsets.emplace(cueReferenceChild, statePos);
-                                    break;
-                                default:
-                                    addNotification(NotificationType::Warning, "\"CueReference\"-element contains a element which is not known to the parser. It will be ignored.", context);
+    // read the data of the "Cues"-element at once
+    cuesElement->parse();
+    if(cuesElement->dataSize() > numeric_limits<size_t>::max()) {
+        addNotification(NotificationType::Critical, "\"Cues\"-element is too big to be processed.", context);
+        throw InvalidDataException();
+    }
+    m_buffer.resize(static_cast<size_t>(cuesElement->dataSize()));
+    cuesElement->stream().seekg(static_cast<streamoff>(cuesElement->dataOffset()));
+    cuesElement->stream().read(m_buffer.data(), static_cast<streamsize>(m_buffer.size()));
+    // walk through the children within the buffer
+    EbmlReader reader(m_buffer.data(), nullptr);
+    uint64 id, cuesEnd = m_buffer.size(), cuePointEnd, cuePointChildEnd, cueTrackPositionsChildEnd, cueReferenceChildEnd;
+    uint64 cuePointDataOffset, cuePointChildDataOffset, cueTrackPositionsChildDataOffset, cueReferenceChildDataOffset;
+    uint64 pos, relPos;
+    bool hasPos;
+    size_t cuePointIndex, cueTrackPositionsIndex, cueReferenceIndex, relativeOffsetItemIndex;
+    m_elements.push_back(MasterElement{0, noIndex});
+    try {
+        for(uint64 cuePointOffset = 0; cuePointOffset < cuesEnd; cuePointOffset = cuePointEnd) {
+            // parse childs of "Cues"-element which must be "CuePoint"-elements
+            cuePointEnd = readChild(reader, cuePointOffset, cuesEnd, id, cuePointDataOffset);
+            switch(id) {
+            case EbmlIds::Void:
+            case EbmlIds::Crc32:
+                break;
+            case MatroskaIds::CuePoint:
+                cuePointIndex = addElement(MatroskaIds::CuePoint, cuesElementIndex);
+                for(uint64 cuePointChildOffset = cuePointDataOffset; cuePointChildOffset < cuePointEnd; cuePointChildOffset = cuePointChildEnd) {
+                    // parse childs of "CuePoint"-element
+                    cuePointChildEnd = readChild(reader, cuePointChildOffset, cuePointEnd, id, cuePointChildDataOffset);
+                    switch(id) {
+                    case EbmlIds::Void:
+                    case EbmlIds::Crc32:
+                        break;
+                    case MatroskaIds::CueTime:
+                        addCopy(cuePointChildOffset, cuePointChildEnd - cuePointChildOffset, cuePointIndex);
+                        break;
+                    case MatroskaIds::CueTrackPositions:
+                        cueTrackPositionsIndex = addElement(MatroskaIds::CueTrackPositions, cuePointIndex);
+                        relativeOffsetItemIndex = noIndex;
+                        hasPos = false;
+                        for(uint64 cueTrackPositionsChildOffset = cuePointChildDataOffset; cueTrackPositionsChildOffset < cuePointChildEnd; cueTrackPositionsChildOffset = cueTrackPositionsChildEnd) {
+                            // parse childs of "CueTrackPositions"-element
+                            cueTrackPositionsChildEnd = readChild(reader, cueTrackPositionsChildOffset, cuePointChildEnd, id, cueTrackPositionsChildDataOffset);
+                            switch(id) {
+                            case MatroskaIds::CueTrack:
+                            case MatroskaIds::CueDuration:
+                            case MatroskaIds::CueBlockNumber:
+                                addCopy(cueTrackPositionsChildOffset, cueTrackPositionsChildEnd - cueTrackPositionsChildOffset, cueTrackPositionsIndex);
+                                break;
+                            case MatroskaIds::CueRelativePosition:
+                                // the relative offset can only be added when the "CueClusterPosition"-element is known
+                                relPos = reader.readUInteger(cueTrackPositionsChildDataOffset, cueTrackPositionsChildEnd - cueTrackPositionsChildDataOffset);
+                                relativeOffsetItemIndex = m_items.size();
+                                m_items.push_back(Item{ItemType::RelativeOffset, MatroskaIds::CueRelativePosition, noIndex, 0});
+                                break;
+                            case MatroskaIds::CueClusterPosition:
+                                pos = reader.readUInteger(cueTrackPositionsChildDataOffset, cueTrackPositionsChildEnd - cueTrackPositionsChildDataOffset);
+                                hasPos = true;
+                                addOffset(MatroskaIds::CueClusterPosition, pos, cueTrackPositionsIndex);
+                                break;
+                            case MatroskaIds::CueCodecState:
+                                addOffset(MatroskaIds::CueCodecState, reader.readUInteger(cueTrackPositionsChildDataOffset, cueTrackPositionsChildEnd - cueTrackPositionsChildDataOffset), cueTrackPositionsIndex);
+                                break;
+                            case MatroskaIds::CueReference:
+                                cueReferenceIndex = addElement(MatroskaIds::CueReference, cueTrackPositionsIndex);
+                                for(uint64 cueReferenceChildOffset = cueTrackPositionsChildDataOffset; cueReferenceChildOffset < cueTrackPositionsChildEnd; cueReferenceChildOffset = cueReferenceChildEnd) {
+                                    // parse childs of "CueReference"-element
+                                    cueReferenceChildEnd = readChild(reader, cueReferenceChildOffset, cueTrackPositionsChildEnd, id, cueReferenceChildDataOffset);
+                                    switch(id) {
+                                    case EbmlIds::Void:
+                                    case EbmlIds::Crc32:
+                                        break;
+                                    case MatroskaIds::CueRefTime:
+                                    case MatroskaIds::CueRefNumber:
+                                        addCopy(cueReferenceChildOffset, cueReferenceChildEnd - cueReferenceChildOffset, cueReferenceIndex);
+                                        break;
+                                    case MatroskaIds::CueRefCluster:
+                                    case MatroskaIds::CueRefCodecState:
+                                        addOffset(static_cast<byte>(id), reader.readUInteger(cueReferenceChildDataOffset, cueReferenceChildEnd - cueReferenceChildDataOffset), cueReferenceIndex);
+                                        break;
+                                    default:
+                                        addNotification(NotificationType::Warning, "\"CueReference\"-element contains a element which is not known to the parser. It will be ignored.", context);
+                                    }
                                 }
+                                finishElement(cueReferenceIndex);
+                                break;
+                            default:
+                                addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains a element which is not known to the parser. It will be ignored.", context);
                             }
-                            cueTrackPositionsElementSize += 1 + EbmlElement::calculateSizeDenotationLength(cueReferenceElementSize) + cueReferenceElementSize;
-                            m_sizes.emplace(cueTrackPositionsChild, cueReferenceElementSize);
-                            break;
-                        default:
-                            addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains a element which is not known to the parser. It will be ignored.", context);
                         }
+                        if(!hasPos) {
+                            addNotification(NotificationType::Critical, "\"CueTrackPositions\"-element does not contain mandatory \"CueClusterPosition\"-element.", context);
+                        } else if(relativeOffsetItemIndex != noIndex) {
+                            m_items[relativeOffsetItemIndex].index = m_relativeOffsets.size();
+                            m_relativeOffsets.push_back(RelativeOffset{MatroskaReferenceOffsetPair(pos, relPos), cueTrackPositionsIndex});
+                            m_elements[cueTrackPositionsIndex].size += 2 + EbmlElement::calculateUIntegerLength(relPos);
+                        }
+                        finishElement(cueTrackPositionsIndex);
+                        break;
+                    default:
+                        addNotification(NotificationType::Warning, "\"CuePoint\"-element contains a element which is not a \"CueTime\"- or a \"CueTrackPositions\"-element. It will be ignored.", context);
                     }
-                    if(!cueClusterPositionElement) {
-                        addNotification(NotificationType::Critical, "\"CueTrackPositions\"-element does not contain mandatory \"CueClusterPosition\"-element.", context);
-                    } else if(cueRelativePositionElement) {
-                        cueTrackPositionsElementSize += 2 + EbmlElement::calculateUIntegerLength(relPos);
-                        m_relativeOffsets.emplace(piecewise_construct, forward_as_tuple(cueRelativePositionElement), forward_as_tuple(pos, relPos));
-                    }
-                    cuePointElementSize += 1 + EbmlElement::calculateSizeDenotationLength(cueTrackPositionsElementSize) + cueTrackPositionsElementSize;
-                    m_sizes.emplace(cuePointChild, cueTrackPositionsElementSize);
-                    break;
-                default:
-                    addNotification(NotificationType::Warning, "\"CuePoint\"-element contains a element which is not a \"CueTime\"- or a \"CueTrackPositions\"-element. It will be ignored.", context);
                 }
+                finishElement(cuePointIndex);
+                break;
+            default:
+                addNotification(NotificationType::Warning, "\"Cues\"-element contains a element which is not a \"CuePoint\"-element. It will be ignored.", context);
+            }
+        }
+    } catch(const InvalidDataException &) {
+        addNotification(NotificationType::Critical, "\"Cues\"-element contains an invalid or truncated element.", context);
+        clear();
+        throw;
+    }
+
+    // sort the offsets by their initial value so they can be looked up using a binary search
+    const vector<size_t> newOffsetIndices = sortEntries(m_offsets, [] (const Offset &lhs, const Offset &rhs) {
+        return lhs.value.initialValue() < rhs.value.initialValue();
+    });
+    const vector<size_t> newRelativeOffsetIndices = sortEntries(m_relativeOffsets, [] (const RelativeOffset &lhs, const RelativeOffset &rhs) {
+        return make_pair(lhs.value.referenceOffset(), lhs.value.initialValue()) < make_pair(rhs.value.referenceOffset(), rhs.value.initialValue());
+    });
+    for(Item &item : m_items) {
+        switch(item.type) {
+        case ItemType::Offset:
+            item.index = newOffsetIndices[item.index];
+            break;
+        case ItemType::RelativeOffset:
+            if(item.index != noIndex) {
+                item.index = newRelativeOffsetIndices[item.index];
             }
-            cuesElementSize += 1 + EbmlElement::calculateSizeDenotationLength(cuePointElementSize) + cuePointElementSize;
-            m_sizes.emplace(cuePointElement, cuePointElementSize);
             break;
         default:
-            addNotification(NotificationType::Warning, "\"Cues\"-element contains a element which is not a \"CuePoint\"-element. It will be ignored.", context);
+            ;
         }
     }
-    m_sizes.emplace(m_cuesElement = cuesElement, cuesElementSize);
+    m_cuesElement = cuesElement;
+}
+
+/*!
+ * \brief Adds the unchanged element at \a offset within the buffer with the specified (total) \a size to the master element with \a parentIndex.
+ * \remarks The element is merged with the previously added item if it directly follows it within the buffer.
+ */
+void MatroskaCuePositionUpdater::addCopy(uint64 offset, uint64 size, size_t parentIndex)
+{
+    if(!m_items.empty() && m_items.back().type == ItemType::Copy && m_items.back().index + m_items.back().size == offset) {
+        m_items.back().size += static_cast<size_t>(size);
+    } else {
+        m_items.push_back(Item{ItemType::Copy, 0, static_cast<size_t>(offset), static_cast<size_t>(size)});
+    }
+    m_elements[parentIndex].size += size;
+}
+
+/*!
+ * \brief Adds an element with the specified \a id holding the specified offset \a value to the master element with \a parentIndex.
+ */
+void MatroskaCuePositionUpdater::addOffset(byte id, uint64 value, size_t parentIndex)
+{
+    m_items.push_back(Item{ItemType::Offset, id, m_offsets.size(), 0});
+    m_offsets.push_back(Offset{MatroskaOffsetStates(value), parentIndex});
+    m_elements[parentIndex].size += 2 + EbmlElement::calculateUIntegerLength(value);
+}
+
+/*!
+ * \brief Adds a master element with the specified \a id to the master element with \a parentIndex.
+ * \returns Returns the index of the added master element.
+ * \remarks The finishElement() method must be called after all children have been added.
+ */
+size_t MatroskaCuePositionUpdater::addElement(byte id, size_t parentIndex)
+{
+    const size_t elementIndex = m_elements.size();
+    m_items.push_back(Item{ItemType::Element, id, elementIndex, 0});
+    m_elements.push_back(MasterElement{0, parentIndex});
+    return elementIndex;
+}
+
+/*!
+ * \brief Adds the total size of the master element with \a elementIndex to the size of its parent.
+ * \remarks All master elements written by this class have a single byte ID.
+ */
+void MatroskaCuePositionUpdater::finishElement(size_t elementIndex)
+{
+    const MasterElement &element = m_elements[elementIndex];
+    m_elements[element.parentIndex].size += 1 + EbmlElement::calculateSizeDenotationLength(element.size) + element.size;
 }
 
 /*!
@@ -162,10 +317,12 @@ void MatroskaCuePositionUpdater::parse(EbmlElement *cuesElement)
 bool MatroskaCuePositionUpdater::updateOffsets(uint64 originalOffset, uint64 newOffset)
 {
     bool updated = false;
-    for(auto &offset : m_offsets) {
-        if(offset.second.initialValue() == originalOffset && offset.second.currentValue() != newOffset) {
-            updated = updateSize(offset.first->parent(), static_cast<int>(EbmlElement::calculateUIntegerLength(newOffset)) - static_cast<int>(EbmlElement::calculateUIntegerLength(offset.second.currentValue()))) || updated;
-            offset.second.update(newOffset);
+    for(auto offset = lower_bound(m_offsets.begin(), m_offsets.end(), originalOffset, [] (const Offset &entry, uint64 value) {
+            return entry.value.initialValue() < value;
+        }), end = m_offsets.end(); offset != end && offset->value.initialValue() == originalOffset; ++offset) {
+        if(offset->value.currentValue() != newOffset) {
+            updated = updateSize(offset->parentIndex, static_cast<int>(EbmlElement::calculateUIntegerLength(newOffset)) - static_cast<int>(EbmlElement::calculateUIntegerLength(offset->value.currentValue()))) || updated;
+            offset->value.update(newOffset);
         }
     }
     return updated;
@@ -178,48 +335,43 @@ bool MatroskaCuePositionUpdater::updateOffsets(uint64 originalOffset, uint64 new
 bool MatroskaCuePositionUpdater::updateRelativeOffsets(uint64 referenceOffset, uint64 originalRelativeOffset, uint64 newRelativeOffset)
 {
     bool updated = false;
-    for(auto &offset : m_relativeOffsets) {
-        if(offset.second.referenceOffset() == referenceOffset && offset.second.initialValue() == originalRelativeOffset && offset.second.currentValue() != newRelativeOffset) {
-            updated = updateSize(offset.first->parent(), static_cast<int>(EbmlElement::calculateUIntegerLength(newRelativeOffset)) - static_cast<int>(EbmlElement::calculateUIntegerLength(offset.second.currentValue()))) || updated;
-            offset.second.update(newRelativeOffset);
+    const auto key = make_pair(referenceOffset, originalRelativeOffset);
+    for(auto offset = lower_bound(m_relativeOffsets.begin(), m_relativeOffsets.end(), key, [] (const RelativeOffset &entry, const pair<uint64, uint64> &value) {
+            return make_pair(entry.value.referenceOffset(), entry.value.initialValue()) < value;
+        }), end = m_relativeOffsets.end(); offset != end && offset->value.referenceOffset() == referenceOffset && offset->value.initialValue() == originalRelativeOffset; ++offset) {
+        if(offset->value.currentValue() != newRelativeOffset) {
+            updated = updateSize(offset->parentIndex, static_cast<int>(EbmlElement::calculateUIntegerLength(newRelativeOffset)) - static_cast<int>(EbmlElement::calculateUIntegerLength(offset->value.currentValue()))) || updated;
+            offset->value.update(newRelativeOffset);
         }
     }
     return updated;
 }
 
 /*!
- * \brief Updates the sizes for the specified \a element by adding the specified \a shift value.
+ * \brief Updates the sizes for the master element with the specified \a elementIndex and its parents by adding the specified \a shift value.
  * \returns Returns whether the size of the "Cues"-element has been altered.
  */
-bool MatroskaCuePositionUpdater::updateSize(EbmlElement *element, int shift)
+bool MatroskaCuePositionUpdater::updateSize(size_t elementIndex, int shift)
 {
-    if(!shift) {
-        // shift is gone
-        return false;
-    }
-    if(!element) {
-        // there was no parent (shouldn't happen in a normal file structure since the Segment element should
-        // be parent of the Cues element)
-        return shift;
-    }
-    try {
-        // get size info
-        uint64 &size = m_sizes.at(element);
+    // the parent of the "Cues"-element is out of the scope of the cue position updater (likely the Segment element)
+    for(; shift && elementIndex != noIndex; ) {
+        MasterElement &element = m_elements[elementIndex];
         // calculate new size
-        const uint64 newSize = shift > 0 ? size + static_cast<uint64>(shift) : size - static_cast<uint64>(-shift);
+        const uint64 newSize = shift > 0 ? element.size + static_cast<uint64>(shift) : element.size - static_cast<uint64>(-shift);
         // shift parent
-        const bool updated = updateSize(element->parent(), shift + static_cast<int>(EbmlElement::calculateSizeDenotationLength(newSize)) - static_cast<int>(EbmlElement::calculateSizeDenotationLength(size)));
+        shift += static_cast<int>(EbmlElement::calculateSizeDenotationLength(newSize)) - static_cast<int>(EbmlElement::calculateSizeDenotationLength(element.size));
         // apply new size
-        size = newSize;
-        return updated;
-    } catch(const out_of_range &) {
-        // the element is out of the scope of the cue position updater (likely the Segment element)
-        return shift;
+        element.size = newSize;
+        elementIndex = element.parentIndex;
     }
+    return shift;
 }
 
 /*!
  * \brief Writes the previously parsed "Cues"-element with updates positions to the specified \a stream.
+ *
+ * The element is assembled from the buffer of the original "Cues"-element (patched with the updated positions and
+ * sizes) and written at once.
  */
 void MatroskaCuePositionUpdater::make(ostream &stream)
 {
@@ -228,115 +380,37 @@ void MatroskaCuePositionUpdater::make(ostream &stream)
         addNotification(NotificationType::Warning, "No cues written; the cues of the source file could not be parsed correctly.", context);
         return;
     }
-    // temporary variables
-    char buff[8];
-    byte len;
+    vector<char> buffer(static_cast<size_t>(totalSize()));
+    char *out = buffer.data();
     // write "Cues"-element
-    try {
-        BE::getBytes(static_cast<uint32>(MatroskaIds::Cues), buff);
-        stream.write(buff, 4);
-        len = EbmlElement::makeSizeDenotation(m_sizes[m_cuesElement], buff);
-        stream.write(buff, len);
-        // loop through original elements and write (a updated version) of them
-        for(EbmlElement *cuePointElement = m_cuesElement->firstChild(); cuePointElement; cuePointElement = cuePointElement->nextSibling()) {
-            cuePointElement->parse();
-            switch(cuePointElement->id()) {
-            case EbmlIds::Void:
-            case EbmlIds::Crc32:
-                break;
-            case MatroskaIds::CuePoint:
-                // write "CuePoint"-element
-                stream.put(MatroskaIds::CuePoint);
-                len = EbmlElement::makeSizeDenotation(m_sizes[cuePointElement], buff);
-                stream.write(buff, len);
-                for(EbmlElement *cuePointChild = cuePointElement->firstChild(); cuePointChild; cuePointChild = cuePointChild->nextSibling()) {
-                    cuePointChild->parse();
-                    switch(cuePointChild->id()) {
-                    case EbmlIds::Void:
-                    case EbmlIds::Crc32:
-                        break;
-                    case MatroskaIds::CueTime:
-                        // write "CueTime"-element
-                        cuePointChild->copyBuffer(stream);
-                        cuePointChild->discardBuffer();
-                        //cuePointChild->copyEntirely(stream);
-                        break;
-                    case MatroskaIds::CueTrackPositions:
-                        // write "CueTrackPositions"-element
-                        stream.put(MatroskaIds::CueTrackPositions);
-                        len = EbmlElement::makeSizeDenotation(m_sizes[cuePointChild], buff);
-                        stream.write(buff, len);
-                        for(EbmlElement *cueTrackPositionsChild = cuePointChild->firstChild(); cueTrackPositionsChild; cueTrackPositionsChild = cueTrackPositionsChild->nextSibling()) {
-                            cueTrackPositionsChild->parse();
-                            switch(cueTrackPositionsChild->id()) {
-                            case MatroskaIds::CueTrack:
-                            case MatroskaIds::CueDuration:
-                            case MatroskaIds::CueBlockNumber:
-                                // write unchanged childs of "CueTrackPositions"-element
-                                cueTrackPositionsChild->copyBuffer(stream);
-                                cueTrackPositionsChild->discardBuffer();
-                                //cueTrackPositionsChild->copyEntirely(stream);
-                                break;
-                            case MatroskaIds::CueRelativePosition:
-                                try {
-                                    EbmlElement::makeSimpleElement(stream, cueTrackPositionsChild->id(), m_relativeOffsets.at(cueTrackPositionsChild).currentValue());
-                                } catch(const out_of_range &) {
-                                    // we were not able parse the relative offset because the absolute offset is missing
-                                    // continue anyways
-                                }
-                                break;
-                            case MatroskaIds::CueClusterPosition:
-                            case MatroskaIds::CueCodecState:
-                                // write "CueClusterPosition"/"CueCodecState"-element
-                                EbmlElement::makeSimpleElement(stream, cueTrackPositionsChild->id(), m_offsets.at(cueTrackPositionsChild).currentValue());
-                                break;
-                            case MatroskaIds::CueReference:
-                                // write "CueReference"-element
-                                stream.put(MatroskaIds::CueRefTime);
-                                len = EbmlElement::makeSizeDenotation(m_sizes[cueTrackPositionsChild], buff);
-                                stream.write(buff, len);
-                                for(EbmlElement *cueReferenceChild = cueTrackPositionsChild->firstChild(); cueReferenceChild; cueReferenceChild = cueReferenceChild->nextSibling()) {
-                                    cueReferenceChild->parse();
-                                    switch(cueReferenceChild->id()) {
-                                    case EbmlIds::Void:
-                                    case EbmlIds::Crc32:
-                                        break;
-                                    case MatroskaIds::CueRefTime:
-                                    case MatroskaIds::CueRefNumber:
-                                        // write unchanged childs of "CueReference"-element
-                                        cueReferenceChild->copyBuffer(stream);
-                                        cueReferenceChild->discardBuffer();
-                                        cueReferenceChild->copyEntirely(stream);
-                                        break;
-                                    case MatroskaIds::CueRefCluster:
-                                    case MatroskaIds::CueRefCodecState:
-                                        // write "CueRefCluster"/"CueRefCodecState"-element
-                                        EbmlElement::makeSimpleElement(stream, cueReferenceChild->id(), m_offsets.at(cueReferenceChild).currentValue());
-                                        break;
-                                    default:
-                                        addNotification(NotificationType::Warning, "\"CueReference\"-element contains a element which is not known to the parser. It will be ignored.", context);
-                                    }
-                                }
-                                break;
-                            default:
-                                addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains a element which is not known to the parser. It will be ignored.", context);
-                            }
-                        }
-                        break;
-                    default:
-                        addNotification(NotificationType::Warning, "\"CuePoint\"-element contains a element which is not a \"CueTime\"- or a \"CueTrackPositions\"-element. It will be ignored.", context);
-                    }
-                }
-                break;
-            default:
-                addNotification(NotificationType::Warning, "\"Cues\"-element contains a element which is not a \"CuePoint\"-element. It will be ignored.", context);
+    BE::getBytes(static_cast<uint32>(MatroskaIds::Cues), out);
+    out += 4;
+    out += EbmlElement::makeSizeDenotation(m_elements[cuesElementIndex].size, out);
+    // write the items in the original order
+    for(const Item &item : m_items) {
+        switch(item.type) {
+        case ItemType::Copy:
+            // write unchanged elements
+            out = copy(m_buffer.data() + item.index, m_buffer.data() + item.index + item.size, out);
+            break;
+        case ItemType::Element:
+            // write header of "CuePoint"/"CueTrackPositions"/"CueReference"-element
+            *out++ = static_cast<char>(item.id);
+            out += EbmlElement::makeSizeDenotation(m_elements[item.index].size, out);
+            break;
+        case ItemType::Offset:
+            // write "CueClusterPosition"/"CueCodecState"/"CueRefCluster"/"CueRefCodecState"-element
+            out = makeUIntegerElement(item.id, m_offsets[item.index].value.currentValue(), out);
+            break;
+        case ItemType::RelativeOffset:
+            // write "CueRelativePosition"-element; skip it if the relative offset could not be parsed because the absolute offset is missing
+            if(item.index != noIndex) {
+                out = makeUIntegerElement(item.id, m_relativeOffsets[item.index].value.currentValue(), out);
             }
+            break;
         }
-    } catch(const out_of_range &) {
-        addNotification(NotificationType::Critical, "Unable to write the file index because the index of the original file could not be parsed correctly.", context);
-        throw InvalidDataException();
     }
+    stream.write(buffer.data(), static_cast<streamsize>(out - buffer.data()));
 }
 
 } // namespace Media
-
@@ -3,8 +3,9 @@
 
 #include "./ebmlelement.h"
 
-#include <map>
+#include <cstddef>
 #include <ostream>
+#include <vector>
 
 namespace Media {
 
@@ -74,12 +75,48 @@ public:
     void clear();
 
 private:
-    bool updateSize(EbmlElement *element, int shift);
+    /// \brief The ItemType enum specifies how an item is written by make().
+    enum class ItemType : byte {
+        Copy, /**< unchanged elements copied from the buffer */
+        Element, /**< header of a master element (its size might have changed) */
+        Offset, /**< element holding an offset */
+        RelativeOffset /**< element holding a relative offset */
+    };
+    /// \brief The Item struct describes a part of the "Cues"-element to be written by make().
+    struct Item {
+        ItemType type;
+        byte id; /**< ID of the element (not used for ItemType::Copy) */
+        std::size_t index; /**< offset within the buffer or index of the master element/offset */
+        std::size_t size; /**< number of bytes to copy from the buffer (only used for ItemType::Copy) */
+    };
+    /// \brief The MasterElement struct holds the (updated) data size of a master element.
+    struct MasterElement {
+        uint64 size;
+        std::size_t parentIndex;
+    };
+    /// \brief The Offset struct holds an offset and the index of the master element containing it.
+    struct Offset {
+        MatroskaOffsetStates value;
+        std::size_t parentIndex;
+    };
+    /// \brief The RelativeOffset struct holds a relative offset and the index of the master element containing it.
+    struct RelativeOffset {
+        MatroskaReferenceOffsetPair value;
+        std::size_t parentIndex;
+    };
+
+    void addCopy(uint64 offset, uint64 size, std::size_t parentIndex);
+    void addOffset(byte id, uint64 value, std::size_t parentIndex);
+    std::size_t addElement(byte id, std::size_t parentIndex);
+    void finishElement(std::size_t elementIndex);
+    bool updateSize(std::size_t elementIndex, int shift);
 
     EbmlElement *m_cuesElement;
-    std::map<EbmlElement *, MatroskaOffsetStates> m_offsets;
-    std::map<EbmlElement *, MatroskaReferenceOffsetPair> m_relativeOffsets;
-    std::map<EbmlElement *, uint64> m_sizes;
+    std::vector<char> m_buffer;
+    std::vector<Item> m_items;
+    std::vector<MasterElement> m_elements;
+    std::vector<Offset> m_offsets;
+    std::vector<RelativeOffset> m_relativeOffsets;
 };
 
 /*!
@@ -107,8 +144,11 @@ inline EbmlElement *MatroskaCuePositionUpdater::cuesElement() const
 inline void MatroskaCuePositionUpdater::clear()
 {
     m_cuesElement = nullptr;
+    m_buffer.clear();
+    m_items.clear();
+    m_elements.clear();
     m_offsets.clear();
-    m_sizes.clear();
+    m_relativeOffsets.clear();
 }
 
 } // namespace Media
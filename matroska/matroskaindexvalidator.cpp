@@ -0,0 +1,445 @@
+#include "./matroskaindexvalidator.h"
+#include "./matroskacontainer.h"
+#include "./matroskaid.h"
+#include "./ebmlelement.h"
+#include "./ebmlreader.h"
+
+#include "../mediafileinfo.h"
+#include "../exceptions.h"
+
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/catchiofailure.h>
+#include <c++utilities/io/nativefilestream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <system_error>
+#include <thread>
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/// \brief The context of notifications added by the MatroskaIndexValidator.
+static const char *const validationContext = "validating Matroska file index (cues)";
+
+/// \brief The relative position of CueReference elements without "CueRelativePosition" element.
+static constexpr uint64 noRelativePosition = numeric_limits<uint64>::max();
+
+/// \brief The number of clusters taken by a worker at once.
+static constexpr size_t clustersPerBatch = 0x40;
+
+/*!
+ * \brief Adds a notification about the specified \a reference not pointing to a cluster to the specified \a notifications.
+ */
+void MatroskaIndexValidator::addInvalidClusterPosition(NotificationList &notifications, const CueReference &reference)
+{
+    notifications.emplace_back(NotificationType::Critical, argsToString("\"CueClusterPosition\" element at ", reference.elementOffset, " does not point to \"Cluster\"-element (points to ", reference.clusterOffset, ")."), validationContext);
+}
+
+/*!
+ * \brief Returns whether the reference is located before the \a other reference.
+ * \remarks References without relative position are located after all references to the same cluster.
+ */
+bool MatroskaIndexValidator::CueReference::operator<(const CueReference &other) const
+{
+    return clusterOffset != other.clusterOffset ? clusterOffset < other.clusterOffset : relativePosition < other.relativePosition;
+}
+
+/*!
+ * \class Media::MatroskaIndexValidator
+ * \brief The MatroskaIndexValidator class validates the index ("Cues" elements) of a Matroska file.
+ *
+ * The validator checks for missing, unknown and surplus elements within the "Cues" elements, whether the positions
+ * denoted by "CueClusterPosition" elements point to clusters and whether the positions denoted by
+ * "CueRelativePosition" elements point to blocks. Besides, the "Position" and "PrevSize" elements of the clusters are
+ * validated.
+ *
+ * Instead of seeking to each position denoted by the index, the positions are sorted and verified within a single
+ * forward pass over the clusters. The index and the clusters are read using EbmlReader so no element objects are
+ * created for their children. The clusters are split into batches of subsequent clusters which are verified by
+ * several threads. Threads read directly from the memory mapping if the file is mapped and open their own stream
+ * otherwise. The progress is reported via updatePercentage().
+ *
+ * To keep the number of reads low, the children of a cluster are only read until the first block if no position
+ * denoted by the index points into the cluster. (The "Position" and "PrevSize" elements precede the blocks.)
+ *
+ * \sa MatroskaContainer::validateIndex()
+ */
+
+/*!
+ * \brief Constructs a new validator for the specified \a container.
+ */
+MatroskaIndexValidator::MatroskaIndexValidator(MatroskaContainer &container) :
+    m_container(container),
+    m_threadCount(0),
+    m_hasIndex(false)
+{}
+
+/*!
+ * \brief Validates the index.
+ *
+ * Problems are added as notifications. Notifications of a previous validation are cleared.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs while reading the index.
+ * \throws Throws Media::OperationAbortedException when the validation has been aborted.
+ */
+void MatroskaIndexValidator::validate()
+{
+    invalidateStatus();
+    invalidateNotifications();
+    updateStatus("Validating index ...", 0.0);
+    collect();
+    if(!m_hasIndex) {
+        addNotification(NotificationType::Information, "No \"Cues\"-elements (index) found.", validationContext);
+    }
+    sort(m_references.begin(), m_references.end());
+
+    // determine how to read clusters and how many threads to use
+    MediaFileInfo &fileInfo = m_container.fileInfo();
+    const char *const mappedData = fileInfo.mappedData(0, fileInfo.size());
+    const size_t batchCount = (m_clusters.size() + clustersPerBatch - 1) / clustersPerBatch;
+    size_t threadCount = m_threadCount ? m_threadCount : max<size_t>(thread::hardware_concurrency(), 1);
+    if(!mappedData && fileInfo.byteSource()) {
+        // the byte source can only be read using the stream of the file
+        threadCount = 1;
+    }
+    threadCount = max<size_t>(min(threadCount, batchCount), 1);
+
+    // verify clusters; each worker takes batches of subsequent clusters until all clusters have been verified
+    // -> notifications are stored per batch so they can be added in the order of the file
+    vector<NotificationList> batchNotifications(batchCount), workerNotifications(threadCount);
+    atomic<size_t> nextBatch(0), verifiedClusters(0);
+    atomic<bool> aborted(false);
+    const auto worker = [&] (size_t workerIndex) {
+        try {
+            unique_ptr<NativeFileStream> ownStream;
+            istream *stream = &m_container.stream();
+            if(!mappedData && workerIndex) {
+                ownStream = make_unique<NativeFileStream>();
+                ownStream->exceptions(ios_base::failbit | ios_base::badbit);
+                ownStream->open(fileInfo.path(), ios_base::in | ios_base::binary);
+                stream = ownStream.get();
+            }
+            EbmlReader reader(mappedData, stream);
+            for(size_t batch; !aborted.load() && (batch = nextBatch.fetch_add(1)) < batchCount; ) {
+                NotificationList &notifications = batchNotifications[batch];
+                const size_t clusterBegin = batch * clustersPerBatch, clusterEnd = min(clusterBegin + clustersPerBatch, m_clusters.size());
+
+                // determine the references within the batch (the first and last batch also take invalid references
+                // before the first and after the last cluster)
+                const CueReference *const references = m_references.data(), *const referencesEnd = references + m_references.size();
+                const auto referenceBefore = [&] (size_t clusterIndex) {
+                    return lower_bound(references, referencesEnd, CueReference{m_clusters[clusterIndex].startOffset, 0, 0});
+                };
+                const CueReference *reference = clusterBegin ? referenceBefore(clusterBegin) : references;
+                const CueReference *const referenceEnd = clusterEnd < m_clusters.size() ? referenceBefore(clusterEnd) : referencesEnd;
+
+                for(size_t i = clusterBegin; i != clusterEnd; ++i) {
+                    const Cluster &cluster = m_clusters[i];
+                    for(; reference != referenceEnd && reference->clusterOffset < cluster.startOffset; ++reference) {
+                        addInvalidClusterPosition(notifications, *reference);
+                    }
+                    const CueReference *clusterReferenceEnd = reference;
+                    for(; clusterReferenceEnd != referenceEnd && clusterReferenceEnd->clusterOffset == cluster.startOffset; ++clusterReferenceEnd);
+                    verifyCluster(reader, cluster, reference, clusterReferenceEnd, notifications);
+                    reference = clusterReferenceEnd;
+                }
+                for(; reference != referenceEnd; ++reference) {
+                    addInvalidClusterPosition(notifications, *reference);
+                }
+
+                verifiedClusters += clusterEnd - clusterBegin;
+                if(!workerIndex) {
+                    // only the calling thread reports the progress and checks whether the validation has been aborted
+                    updatePercentage(static_cast<double>(verifiedClusters.load()) / m_clusters.size());
+                    if(isAborted()) {
+                        aborted.store(true);
+                    }
+                }
+            }
+        } catch(...) {
+            workerNotifications[workerIndex].emplace_back(NotificationType::Critical, catchIoFailure(), validationContext);
+            aborted.store(true);
+        }
+    };
+    vector<thread> threads;
+    threads.reserve(threadCount - 1);
+    try {
+        for(size_t i = 1; i < threadCount; ++i) {
+            threads.emplace_back(worker, i);
+        }
+    } catch(const system_error &) {
+        // continue with the threads created so far
+    }
+    worker(0);
+    for(thread &thread : threads) {
+        thread.join();
+    }
+
+    if(m_clusters.empty()) {
+        // no cluster at all -> none of the references points to a cluster
+        batchNotifications.emplace_back();
+        for(const CueReference &reference : m_references) {
+            addInvalidClusterPosition(batchNotifications.back(), reference);
+        }
+    }
+    for(const NotificationList &notifications : batchNotifications) {
+        addNotifications(notifications);
+    }
+    for(const NotificationList &notifications : workerNotifications) {
+        addNotifications(notifications);
+    }
+    if(isAborted()) {
+        throw OperationAbortedException();
+    }
+    updatePercentage(1.0);
+}
+
+/*!
+ * \brief Collects the clusters of all segments and the positions denoted by the "Cues" elements.
+ */
+void MatroskaIndexValidator::collect()
+{
+    m_hasIndex = false;
+    m_references.clear();
+    m_clusters.clear();
+    MediaFileInfo &fileInfo = m_container.fileInfo();
+    EbmlReader reader(fileInfo.mappedData(0, fileInfo.size()), &m_container.stream());
+    for(EbmlElement *segmentElement = m_container.firstElement(); segmentElement; segmentElement = segmentElement->nextSibling()) {
+        segmentElement->parse();
+        if(segmentElement->id() != MatroskaIds::Segment) {
+            continue;
+        }
+        uint64 previousClusterSize = 0;
+        try {
+            for(EbmlElement *childElement = segmentElement->firstChild(); childElement; childElement = childElement->nextSibling()) {
+                childElement->parse();
+                switch(childElement->id()) {
+                case MatroskaIds::Cues:
+                    m_hasIndex = true;
+                    try {
+                        parseCues(reader, childElement->dataOffset(), childElement->dataOffset() + childElement->dataSize(), segmentElement->dataOffset());
+                    } catch(const Failure &) {
+                        // the problem has already been reported; continue with the next element
+                    }
+                    break;
+                case MatroskaIds::Cluster:
+                    m_clusters.emplace_back(Cluster{childElement->startOffset(), childElement->dataOffset(), childElement->dataSize(), segmentElement->dataOffset(), previousClusterSize});
+                    previousClusterSize = childElement->totalSize();
+                    break;
+                default:
+                    ;
+                }
+            }
+        } catch(const Failure &) {
+            addNotification(NotificationType::Critical, argsToString("Unable to determine all clusters of the segment at ", segmentElement->startOffset(), '.'), validationContext);
+        }
+    }
+}
+
+/*!
+ * \brief Parses the "CuePoint" elements between \a offset and \a end.
+ * \throws Throws Media::InvalidDataException when an element header is invalid.
+ */
+void MatroskaIndexValidator::parseCues(EbmlReader &reader, uint64 offset, uint64 end, uint64 segmentDataOffset)
+{
+    for(uint64 id, size, dataOffset; offset < end; offset = dataOffset + size) {
+        const byte headerSize = reader.readElementHeader(offset, end, id, size);
+        if(!headerSize || size > end - offset - headerSize) {
+            addNotification(NotificationType::Critical, argsToString("The element at ", offset, " within the \"Cues\"-element is invalid."), validationContext);
+            throw InvalidDataException();
+        }
+        dataOffset = offset + headerSize;
+        if(id != MatroskaIds::CuePoint) {
+            continue;
+        }
+
+        // parse childs of "CuePoint"-element
+        bool cueTimeFound = false, cueTrackPositionsFound = false;
+        for(uint64 childOffset = dataOffset, childEnd = dataOffset + size, childId, childSize, childDataOffset; childOffset < childEnd; childOffset = childDataOffset + childSize) {
+            const byte childHeaderSize = reader.readElementHeader(childOffset, childEnd, childId, childSize);
+            if(!childHeaderSize || childSize > childEnd - childOffset - childHeaderSize) {
+                addNotification(NotificationType::Critical, argsToString("The element at ", childOffset, " within the \"CuePoint\"-element is invalid."), validationContext);
+                throw InvalidDataException();
+            }
+            childDataOffset = childOffset + childHeaderSize;
+            switch(childId) {
+            case MatroskaIds::CueTime:
+                // validate uniqueness
+                if(cueTimeFound) {
+                    addNotification(NotificationType::Warning, "\"CuePoint\"-element contains multiple \"CueTime\" elements.", validationContext);
+                } else {
+                    cueTimeFound = true;
+                }
+                break;
+            case MatroskaIds::CueTrackPositions:
+                cueTrackPositionsFound = true;
+                parseCueTrackPositions(reader, childDataOffset, childDataOffset + childSize, segmentDataOffset);
+                break;
+            case EbmlIds::Crc32:
+            case EbmlIds::Void:
+                break;
+            default:
+                addNotification(NotificationType::Warning, "\"CuePoint\"-element contains unknown element \"" % string(matroskaIdName(static_cast<uint32>(childId))) + "\".", validationContext);
+            }
+        }
+
+        // validate existence of mandatory elements
+        if(!cueTimeFound) {
+            addNotification(NotificationType::Warning, "\"CuePoint\"-element does not contain mandatory element \"CueTime\".", validationContext);
+        }
+        if(!cueTrackPositionsFound) {
+            addNotification(NotificationType::Warning, "\"CuePoint\"-element does not contain mandatory element \"CueClusterPosition\".", validationContext);
+        }
+    }
+}
+
+/*!
+ * \brief Parses the childs of the "CueTrackPositions" element between \a offset and \a end and stores the denoted
+ *        position.
+ * \throws Throws Media::InvalidDataException when an element header is invalid.
+ */
+void MatroskaIndexValidator::parseCueTrackPositions(EbmlReader &reader, uint64 offset, uint64 end, uint64 segmentDataOffset)
+{
+    byte foundElements = 0;
+    CueReference reference{0, noRelativePosition, 0};
+    for(uint64 id, size, dataOffset; offset < end; offset = dataOffset + size) {
+        const byte headerSize = reader.readElementHeader(offset, end, id, size);
+        if(!headerSize || size > end - offset - headerSize) {
+            addNotification(NotificationType::Critical, argsToString("The element at ", offset, " within the \"CueTrackPositions\"-element is invalid."), validationContext);
+            throw InvalidDataException();
+        }
+        dataOffset = offset + headerSize;
+        byte element = 0;
+        switch(id) {
+        case MatroskaIds::CueTrack:
+            element = 0x01;
+            break;
+        case MatroskaIds::CueClusterPosition:
+            element = 0x02;
+            reference.clusterOffset = segmentDataOffset + reader.readUInteger(dataOffset, size);
+            reference.elementOffset = offset;
+            break;
+        case MatroskaIds::CueRelativePosition:
+            // read "Block" position denoted by "CueRelativePosition"-element (validate later since the "Cluster"-element is needed to validate)
+            element = 0x04;
+            reference.relativePosition = reader.readUInteger(dataOffset, size);
+            break;
+        case MatroskaIds::CueDuration:
+            element = 0x08;
+            break;
+        case MatroskaIds::CueBlockNumber:
+            element = 0x10;
+            break;
+        case MatroskaIds::CueCodecState:
+            element = 0x20;
+            break;
+        case EbmlIds::Crc32:
+        case EbmlIds::Void:
+        case MatroskaIds::CueReference:
+            break;
+        default:
+            addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains unknown element \"" % string(matroskaIdName(static_cast<uint32>(id))) + "\".", validationContext);
+        }
+        // validate uniqueness
+        if(element & foundElements) {
+            addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element contains multiple \"" % string(matroskaIdName(static_cast<uint32>(id))) + "\" elements.", validationContext);
+        }
+        foundElements |= element;
+    }
+
+    // validate existence of mandatory elements
+    if(!(foundElements & 0x01)) {
+        addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element does not contain mandatory element \"CueTrack\".", validationContext);
+    }
+    if(!(foundElements & 0x02)) {
+        addNotification(NotificationType::Warning, "\"CueTrackPositions\"-element does not contain mandatory element \"CueClusterPosition\".", validationContext);
+    } else {
+        m_references.emplace_back(reference);
+    }
+}
+
+/*!
+ * \brief Verifies the specified \a cluster and the relative positions of the references from \a reference to
+ *        \a referenceEnd (which all point to the \a cluster and are sorted).
+ * \remarks This method is called by the workers and must not alter the validator.
+ */
+void MatroskaIndexValidator::verifyCluster(EbmlReader &reader, const Cluster &cluster, const CueReference *reference, const CueReference *referenceEnd, NotificationList &notifications) const
+{
+    // references without relative position are sorted to the end and need no further validation
+    for(; referenceEnd != reference && (referenceEnd - 1)->relativePosition == noRelativePosition; --referenceEnd);
+    const auto addInvalidReferences = [&] (uint64 endOffset) {
+        for(; reference != referenceEnd && cluster.dataOffset + reference->relativePosition < endOffset; ++reference) {
+            notifications.emplace_back(NotificationType::Critical, argsToString("\"CueRelativePosition\" element of \"CueTrackPositions\"-element at ", reference->elementOffset, " does not point to \"Block\"-, \"BlockGroup\", or \"SimpleBlock\"-element (points to ", cluster.dataOffset + reference->relativePosition, ")."), validationContext);
+        }
+    };
+    const auto addValidReferences = [&] (uint64 elementOffset) {
+        for(; reference != referenceEnd && cluster.dataOffset + reference->relativePosition == elementOffset; ++reference);
+    };
+
+    const uint64 fileSize = m_container.fileInfo().size();
+    const uint64 end = cluster.dataSize < fileSize - min(cluster.dataOffset, fileSize) ? cluster.dataOffset + cluster.dataSize : fileSize;
+    bool blockFound = false;
+    for(uint64 offset = cluster.dataOffset, id, size, dataOffset; offset < end && (reference != referenceEnd || !blockFound); offset = dataOffset + size) {
+        const byte headerSize = reader.readElementHeader(offset, end, id, size);
+        if(!headerSize) {
+            notifications.emplace_back(NotificationType::Critical, argsToString("The element header at ", offset, " within the \"Cluster\"-element is invalid."), validationContext);
+            break;
+        }
+        dataOffset = offset + headerSize;
+        if(id == MatroskaIds::Cluster) {
+            // a cluster within the data of a cluster indicates that the outer cluster has an unknown size
+            break;
+        }
+        size = min(size, end - dataOffset);
+
+        switch(id) {
+        case MatroskaIds::Position: {
+            // validate position
+            const uint64 position = reader.readUInteger(dataOffset, size);
+            if(position > 0 && cluster.startOffset - cluster.segmentDataOffset != position) {
+                notifications.emplace_back(NotificationType::Critical, argsToString("\"Position\"-element at ", offset, " points to ", position, " which is not the offset of the containing \"Cluster\"-element."), validationContext);
+            }
+            break;
+        }
+        case MatroskaIds::PrevSize: {
+            // validate prev size
+            const uint64 previousSize = reader.readUInteger(dataOffset, size);
+            if(previousSize != cluster.previousSize) {
+                notifications.emplace_back(NotificationType::Critical, argsToString("\"PrevSize\"-element at ", offset, " should be ", cluster.previousSize, " but is ", previousSize, "."), validationContext);
+            }
+            break;
+        }
+        case MatroskaIds::SimpleBlock:
+            blockFound = true;
+            addValidReferences(offset);
+            break;
+        case MatroskaIds::BlockGroup:
+            blockFound = true;
+            addValidReferences(offset);
+            // references might also point to the "Block" element within the group
+            for(uint64 childOffset = dataOffset, childEnd = dataOffset + size, childId, childSize, childHeaderSize; reference != referenceEnd && cluster.dataOffset + reference->relativePosition < childEnd; childOffset += childHeaderSize + childSize) {
+                if(!(childHeaderSize = reader.readElementHeader(childOffset, childEnd, childId, childSize))) {
+                    break;
+                }
+                addInvalidReferences(childOffset);
+                if(childId == MatroskaIds::Block) {
+                    addValidReferences(childOffset);
+                }
+                childSize = min(childSize, childEnd - childOffset - childHeaderSize);
+            }
+            break;
+        default:
+            ;
+        }
+        addInvalidReferences(dataOffset + size);
+    }
+    addInvalidReferences(numeric_limits<uint64>::max());
+}
+
+}
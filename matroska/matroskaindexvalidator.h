@@ -0,0 +1,103 @@
+#ifndef MEDIA_MATROSKAINDEXVALIDATOR_H
+#define MEDIA_MATROSKAINDEXVALIDATOR_H
+
+#include "../statusprovider.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <vector>
+
+namespace Media {
+
+class MatroskaContainer;
+class EbmlReader;
+
+class TAG_PARSER_EXPORT MatroskaIndexValidator : public StatusProvider
+{
+public:
+    MatroskaIndexValidator(MatroskaContainer &container);
+
+    std::size_t threadCount() const;
+    void setThreadCount(std::size_t threadCount);
+    void validate();
+    bool hasIndex() const;
+    std::size_t cueReferenceCount() const;
+    std::size_t clusterCount() const;
+
+private:
+    /// \brief The private CueReference struct holds a position denoted by a "CueTrackPositions" element.
+    struct CueReference
+    {
+        uint64 clusterOffset;
+        uint64 relativePosition;
+        uint64 elementOffset;
+        bool operator<(const CueReference &other) const;
+    };
+    /// \brief The private Cluster struct holds the location of a cluster and the expected "PrevSize" value.
+    struct Cluster
+    {
+        uint64 startOffset;
+        uint64 dataOffset;
+        uint64 dataSize;
+        uint64 segmentDataOffset;
+        uint64 previousSize;
+    };
+
+    void collect();
+    void parseCues(EbmlReader &reader, uint64 offset, uint64 end, uint64 segmentDataOffset);
+    void parseCueTrackPositions(EbmlReader &reader, uint64 offset, uint64 end, uint64 segmentDataOffset);
+    void verifyCluster(EbmlReader &reader, const Cluster &cluster, const CueReference *reference, const CueReference *referenceEnd, NotificationList &notifications) const;
+    static void addInvalidClusterPosition(NotificationList &notifications, const CueReference &reference);
+
+    MatroskaContainer &m_container;
+    std::size_t m_threadCount;
+    bool m_hasIndex;
+    std::vector<CueReference> m_references;
+    std::vector<Cluster> m_clusters;
+};
+
+/*!
+ * \brief Returns the number of threads used for verifying clusters.
+ * \remarks Zero (the default) means the number of hardware threads is used.
+ */
+inline std::size_t MatroskaIndexValidator::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the number of threads used for verifying clusters.
+ * \sa threadCount()
+ */
+inline void MatroskaIndexValidator::setThreadCount(std::size_t threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+/*!
+ * \brief Returns whether the last validation found at least one "Cues" element.
+ */
+inline bool MatroskaIndexValidator::hasIndex() const
+{
+    return m_hasIndex;
+}
+
+/*!
+ * \brief Returns the number of cluster positions denoted by the "Cues" elements found by the last validation.
+ */
+inline std::size_t MatroskaIndexValidator::cueReferenceCount() const
+{
+    return m_references.size();
+}
+
+/*!
+ * \brief Returns the number of clusters found by the last validation.
+ */
+inline std::size_t MatroskaIndexValidator::clusterCount() const
+{
+    return m_clusters.size();
+}
+
+}
+
+#endif // MEDIA_MATROSKAINDEXVALIDATOR_H
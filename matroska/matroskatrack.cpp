@@ -3,6 +3,7 @@
 #include "./matroskacontainer.h"
 #include "./matroskaid.h"
 #include "./matroskatag.h"
+#include "./matroskablockscanner.h"
 
 #include "../avi/bitmapinfoheader.h"
 
@@ -13,6 +14,7 @@
 #include "../mp4/mp4ids.h"
 #include "../mp4/mp4track.h"
 
+#include "../mediafileinfo.h"
 #include "../mediaformat.h"
 #include "../exceptions.h"
 
@@ -36,7 +38,8 @@ namespace Media {
  */
 MatroskaTrack::MatroskaTrack(EbmlElement &trackElement) :
     AbstractTrack(trackElement.stream(), trackElement.startOffset()),
-    m_trackElement(&trackElement)
+    m_trackElement(&trackElement),
+    m_defaultDuration(0)
 {}
 
 /*!
@@ -277,6 +280,24 @@ void MatroskaTrack::readStatisticsFromTags(const std::vector<std::unique_ptr<Mat
     }
 }
 
+/*!
+ * \brief Reads track-specific statistics from the specified \a statistics determined by the MatroskaBlockScanner.
+ * \remarks The size, frame count and bitrate are only assigned if blocks have been found; the duration only if it
+ *          could be determined.
+ */
+void MatroskaTrack::readStatisticsFromBlocks(const MatroskaBlockStatistics &statistics)
+{
+    if(!statistics.blockCount) {
+        return;
+    }
+    m_size = statistics.size;
+    m_sampleCount = statistics.frameCount;
+    if(!statistics.duration.isNull()) {
+        m_duration = statistics.duration;
+        m_bitrate = statistics.bitrate();
+    }
+}
+
 void MatroskaTrack::internalParseHeader()
 {
     static const string context("parsing header of Matroska track");
@@ -294,7 +315,6 @@ void MatroskaTrack::internalParseHeader()
             addNotification(NotificationType::Critical, "Unable to parse track information element.", context);
             break;
         }
-        uint32 defaultDuration = 0;
         switch(trackInfoElement->id()) {
         case MatroskaIds::TrackType:
             switch(trackInfoElement->readUInteger()) {
@@ -427,15 +447,15 @@ void MatroskaTrack::internalParseHeader()
             m_lacing = trackInfoElement->readUInteger();
             break;
         case MatroskaIds::DefaultDuration:
-            defaultDuration = trackInfoElement->readUInteger();
+            m_defaultDuration = trackInfoElement->readUInteger();
             break;
         default:
             ;
         }
         switch(m_mediaType) {
         case MediaType::Video:
-            if(!m_fps && defaultDuration) {
-                m_fps = 1000000000.0 / defaultDuration;
+            if(!m_fps && m_defaultDuration) {
+                m_fps = 1000000000.0 / m_defaultDuration;
             }
             break;
         default:
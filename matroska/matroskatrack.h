@@ -9,6 +9,7 @@ class EbmlElement;
 class MatroskaContainer;
 class MatroskaTrack;
 class MatroskaTag;
+struct MatroskaBlockStatistics;
 
 class TAG_PARSER_EXPORT MatroskaTrackHeaderMaker
 {
@@ -57,6 +58,8 @@ public:
 
     static MediaFormat codecIdToMediaFormat(const std::string &codecId);
     void readStatisticsFromTags(const std::vector<std::unique_ptr<MatroskaTag> > &tags);
+    void readStatisticsFromBlocks(const MatroskaBlockStatistics &statistics);
+    uint64 defaultDuration() const;
     MatroskaTrackHeaderMaker prepareMakingHeader() const;
     void makeHeader(std::ostream &stream) const;
 
@@ -68,8 +71,17 @@ private:
     void assignPropertyFromTagValue(const std::unique_ptr<MatroskaTag> &tag, const char *fieldId, PropertyType &integer, const ConversionFunction &conversionFunction);
 
     EbmlElement *m_trackElement;
+    uint64 m_defaultDuration;
 };
 
+/*!
+ * \brief Returns the default duration of the frames of the track in nanoseconds or zero if not specified.
+ */
+inline uint64 MatroskaTrack::defaultDuration() const
+{
+    return m_defaultDuration;
+}
+
 /*!
  * \brief Prepares making header.
  * \returns Returns a MatroskaTrackHeaderMaker object which can be used to actually make the track
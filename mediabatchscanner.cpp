@@ -0,0 +1,152 @@
+#include "./mediabatchscanner.h"
+#include "./mediafileinfo.h"
+#include "./exceptions.h"
+
+#include <c++utilities/io/catchiofailure.h>
+
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+using namespace std;
+using namespace IoUtilities;
+
+namespace Media {
+
+/*!
+ * \class Media::MediaBatchScanner
+ * \brief The MediaBatchScanner class parses many files concurrently.
+ *
+ * Scanning is done by several threads. Every thread takes the next unscanned file from the list, parses the parts()
+ * of it using a MediaFileInfo and passes the result to the callback. Since files are taken one by one, a thread
+ * which is busy with a large file does not hold back the remaining files.
+ *
+ * The MediaFileInfo objects (including their notifications) are only accessed by the thread scanning the file. The
+ * callback invocations are serialized, so the callback does not need to be thread-safe itself.
+ *
+ * \remarks
+ * - The number of threads is limited by threadCount() and maximumOpenFiles().
+ * - Each file is parsed using a single thread (see MediaFileInfo::setThreadCount()).
+ */
+
+/*!
+ * \brief Constructs a new scanner which parses the specified \a parts of the files.
+ */
+MediaBatchScanner::MediaBatchScanner(ParsingParts parts) :
+    m_parts(parts),
+    m_threadCount(0),
+    m_maximumOpenFiles(0x40),
+    m_aborted(false),
+    m_filesScanned(0)
+{}
+
+/*!
+ * \brief Returns the number of threads which would be used to scan \a fileCount files.
+ */
+std::size_t MediaBatchScanner::workerCount(std::size_t fileCount) const
+{
+    const size_t threadCount = m_threadCount ? m_threadCount : max<size_t>(thread::hardware_concurrency(), 1);
+    return min({threadCount, max<size_t>(m_maximumOpenFiles, 1), max<size_t>(fileCount, 1)});
+}
+
+/*!
+ * \brief Scans the files with the specified \a paths.
+ *
+ * The \a callback is called for each file after parsing with the index of the file within \a paths and the
+ * MediaFileInfo holding the parsing results and notifications. The file is already closed at this point. The
+ * MediaFileInfo is destroyed after the callback returns. The order of the invocations is unspecified.
+ *
+ * Failures and IO errors which occur when parsing a file are added as notification to the related MediaFileInfo
+ * and do not affect the scanning of other files.
+ *
+ * This method blocks until all files have been scanned or the scan has been aborted.
+ *
+ * \throws Rethrows the first exception thrown by the \a callback (or unexpected exceptions like std::bad_alloc). The
+ *         scan is aborted in this case.
+ * \sa abort()
+ */
+void MediaBatchScanner::scan(const std::vector<string> &paths, const CallbackType &callback)
+{
+    m_aborted.store(false);
+    m_filesScanned.store(0);
+
+    atomic<size_t> nextIndex(0);
+    mutex callbackMutex;
+    exception_ptr exception;
+    const auto worker = [&] {
+        for(size_t index; !m_aborted.load() && (index = nextIndex++) < paths.size(); ) {
+            try {
+                MediaFileInfo fileInfo(paths[index]);
+                scanFile(fileInfo);
+                ++m_filesScanned;
+                lock_guard<mutex> lock(callbackMutex);
+                if(!exception) {
+                    callback(index, fileInfo);
+                }
+            } catch(...) {
+                lock_guard<mutex> lock(callbackMutex);
+                if(!exception) {
+                    exception = current_exception();
+                }
+                m_aborted.store(true);
+            }
+        }
+    };
+
+    // scan files using additional threads; the current thread is used as well
+    vector<thread> threads;
+    const size_t workerCount = this->workerCount(paths.size());
+    threads.reserve(workerCount - 1);
+    try {
+        for(size_t i = 1; i < workerCount; ++i) {
+            threads.emplace_back(worker);
+        }
+    } catch(const system_error &) {
+        // continue with the threads created so far
+    }
+    worker();
+    for(thread &thread : threads) {
+        thread.join();
+    }
+    if(exception) {
+        rethrow_exception(exception);
+    }
+}
+
+/*!
+ * \brief Parses the parts() of the file specified by \a fileInfo and closes the file afterwards.
+ */
+void MediaBatchScanner::scanFile(MediaFileInfo &fileInfo) const
+{
+    static const string context("scanning file");
+    fileInfo.setIndexCacheDirectory(m_indexCacheDirectory);
+    // the files are already parsed concurrently
+    fileInfo.setThreadCount(1);
+    try {
+        fileInfo.open(true);
+        if(m_parts != ParsingParts::None) {
+            fileInfo.parseContainerFormat();
+        }
+        if((m_parts & ParsingParts::Tracks) != ParsingParts::None) {
+            fileInfo.parseTracks();
+        }
+        if((m_parts & ParsingParts::Tags) != ParsingParts::None) {
+            fileInfo.parseTags();
+        }
+        if((m_parts & ParsingParts::Chapters) != ParsingParts::None) {
+            fileInfo.parseChapters();
+        }
+        if((m_parts & ParsingParts::Attachments) != ParsingParts::None) {
+            fileInfo.parseAttachments();
+        }
+    } catch(const Failure &) {
+        fileInfo.addNotification(NotificationType::Critical, "Unable to parse the file.", context);
+    } catch(...) {
+        fileInfo.addNotification(NotificationType::Critical, catchIoFailure(), context);
+    }
+    fileInfo.close();
+}
+
+}
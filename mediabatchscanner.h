@@ -0,0 +1,187 @@
+#ifndef MEDIA_MEDIABATCHSCANNER_H
+#define MEDIA_MEDIABATCHSCANNER_H
+
+#include "./global.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Media {
+
+class MediaFileInfo;
+
+/*!
+ * \brief The ParsingParts enum specifies the parts of a file which should be parsed.
+ * \remarks The values might be combined using the bitwise or operator.
+ */
+enum class ParsingParts : unsigned int
+{
+    None = 0x00, /**< only the file is opened */
+    ContainerFormat = 0x01, /**< MediaFileInfo::parseContainerFormat() is called */
+    Tracks = 0x02, /**< MediaFileInfo::parseTracks() is called */
+    Tags = 0x04, /**< MediaFileInfo::parseTags() is called */
+    Chapters = 0x08, /**< MediaFileInfo::parseChapters() is called */
+    Attachments = 0x10, /**< MediaFileInfo::parseAttachments() is called */
+    Everything = 0x1F /**< equivalent to MediaFileInfo::parseEverything() */
+};
+
+/*!
+ * \brief Combines the specified parts.
+ */
+constexpr ParsingParts operator |(ParsingParts lhs, ParsingParts rhs)
+{
+    return static_cast<ParsingParts>(static_cast<unsigned int>(lhs) | static_cast<unsigned int>(rhs));
+}
+
+/*!
+ * \brief Returns the parts present in both \a lhs and \a rhs.
+ */
+constexpr ParsingParts operator &(ParsingParts lhs, ParsingParts rhs)
+{
+    return static_cast<ParsingParts>(static_cast<unsigned int>(lhs) & static_cast<unsigned int>(rhs));
+}
+
+class TAG_PARSER_EXPORT MediaBatchScanner
+{
+public:
+    typedef std::function<void (std::size_t index, MediaFileInfo &fileInfo)> CallbackType;
+
+    MediaBatchScanner(ParsingParts parts = ParsingParts::Everything);
+    MediaBatchScanner(const MediaBatchScanner &) = delete;
+    MediaBatchScanner &operator=(const MediaBatchScanner &) = delete;
+
+    ParsingParts parts() const;
+    void setParts(ParsingParts parts);
+    std::size_t threadCount() const;
+    void setThreadCount(std::size_t threadCount);
+    std::size_t maximumOpenFiles() const;
+    void setMaximumOpenFiles(std::size_t maximumOpenFiles);
+    const std::string &indexCacheDirectory() const;
+    void setIndexCacheDirectory(const std::string &indexCacheDirectory);
+    std::size_t workerCount(std::size_t fileCount) const;
+    void scan(const std::vector<std::string> &paths, const CallbackType &callback);
+    void abort();
+    bool isAborted() const;
+    std::size_t filesScanned() const;
+
+private:
+    void scanFile(MediaFileInfo &fileInfo) const;
+
+    ParsingParts m_parts;
+    std::size_t m_threadCount;
+    std::size_t m_maximumOpenFiles;
+    std::string m_indexCacheDirectory;
+    std::atomic<bool> m_aborted;
+    std::atomic<std::size_t> m_filesScanned;
+};
+
+/*!
+ * \brief Returns the parts of the files which are parsed.
+ */
+inline ParsingParts MediaBatchScanner::parts() const
+{
+    return m_parts;
+}
+
+/*!
+ * \brief Sets the parts of the files which should be parsed.
+ * \remarks The container format is always parsed when any other part is requested.
+ */
+inline void MediaBatchScanner::setParts(ParsingParts parts)
+{
+    m_parts = parts;
+}
+
+/*!
+ * \brief Returns the number of threads used for scanning.
+ * \remarks Zero (the default) means the number of hardware threads is used.
+ */
+inline std::size_t MediaBatchScanner::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the number of threads used for scanning.
+ * \sa threadCount()
+ */
+inline void MediaBatchScanner::setThreadCount(std::size_t threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+/*!
+ * \brief Returns the maximum number of files which are open at the same time.
+ */
+inline std::size_t MediaBatchScanner::maximumOpenFiles() const
+{
+    return m_maximumOpenFiles;
+}
+
+/*!
+ * \brief Sets the maximum number of files which are open at the same time.
+ *
+ * Each thread opens only one file at a time. Hence this limits the number of threads used for scanning. Values less
+ * than one are treated as one.
+ */
+inline void MediaBatchScanner::setMaximumOpenFiles(std::size_t maximumOpenFiles)
+{
+    m_maximumOpenFiles = maximumOpenFiles;
+}
+
+/*!
+ * \brief Returns the directory used to cache parse indices of the scanned files.
+ * \sa MediaFileInfo::indexCacheDirectory()
+ */
+inline const std::string &MediaBatchScanner::indexCacheDirectory() const
+{
+    return m_indexCacheDirectory;
+}
+
+/*!
+ * \brief Sets the directory used to cache parse indices of the scanned files.
+ *
+ * Scanning unchanged files again is much faster when caching is enabled. An empty string (the default) disables
+ * caching.
+ *
+ * \sa MediaFileInfo::setIndexCacheDirectory()
+ */
+inline void MediaBatchScanner::setIndexCacheDirectory(const std::string &indexCacheDirectory)
+{
+    m_indexCacheDirectory = indexCacheDirectory;
+}
+
+/*!
+ * \brief Aborts a scan in progress.
+ *
+ * Files being scanned are finished (including the callback invocation) but no further files are scanned.
+ *
+ * \remarks This method is thread-safe and might be called from the callback as well.
+ */
+inline void MediaBatchScanner::abort()
+{
+    m_aborted.store(true);
+}
+
+/*!
+ * \brief Returns whether the current or last scan has been aborted.
+ */
+inline bool MediaBatchScanner::isAborted() const
+{
+    return m_aborted.load();
+}
+
+/*!
+ * \brief Returns the number of files scanned in the current or last scan.
+ * \remarks This method is thread-safe.
+ */
+inline std::size_t MediaBatchScanner::filesScanned() const
+{
+    return m_filesScanned.load();
+}
+
+}
+
+#endif // MEDIA_MEDIABATCHSCANNER_H
@@ -4,6 +4,7 @@
 #include "./signature.h"
 #include "./abstracttrack.h"
 #include "./backuphelper.h"
+#include "./nativecopyhelper.h"
 
 #include "./id3/id3v1tag.h"
 #include "./id3/id3v2tag.h"
@@ -11,6 +12,7 @@
 #include "./wav/waveaudiostream.h"
 
 #include "./mpegaudio/mpegaudioframestream.h"
+#include "./mpegaudio/mpegaudioxingheadermaker.h"
 
 #include "./adts/adtsstream.h"
 
@@ -43,6 +45,7 @@
 #include <system_error>
 #include <functional>
 #include <memory>
+#include <streambuf>
 
 using namespace std;
 using namespace std::placeholders;
@@ -86,7 +89,11 @@ MediaFileInfo::MediaFileInfo() :
     m_chaptersParsingStatus(ParsingStatus::NotParsedYet),
     m_attachmentsParsingStatus(ParsingStatus::NotParsedYet),
     m_forceFullParse(MEDIAINFO_CPP_FORCE_FULL_PARSE),
+    m_threadCount(0),
     m_forceRewrite(true),
+    m_verifyOutput(false),
+    m_regenerateXingHeader(false),
+    m_regenerateFlacSeekTable(false),
     m_minPadding(0),
     m_maxPadding(0),
     m_preferredPadding(0),
@@ -112,7 +119,11 @@ MediaFileInfo::MediaFileInfo(const string &path) :
     m_chaptersParsingStatus(ParsingStatus::NotParsedYet),
     m_attachmentsParsingStatus(ParsingStatus::NotParsedYet),
     m_forceFullParse(MEDIAINFO_CPP_FORCE_FULL_PARSE),
+    m_threadCount(0),
     m_forceRewrite(true),
+    m_verifyOutput(false),
+    m_regenerateXingHeader(false),
+    m_regenerateFlacSeekTable(false),
     m_minPadding(0),
     m_maxPadding(0),
     m_preferredPadding(0),
@@ -154,6 +165,7 @@ void MediaFileInfo::parseContainerFormat()
     static const string context("parsing file header");
     open(); // ensure the file is open
     m_containerFormat = ContainerFormat::Unknown;
+    loadParseIndex();
 
     // file size
     m_paddingSize = 0;
@@ -238,7 +250,7 @@ startParsingSignature:
                     // validating the element structure of Matroska files takes too long when
                     // parsing big files so do this only when explicitely desired
                     container->validateElementStructure(notifications, &m_paddingSize);
-                    container->validateIndex();
+                    container->validateIndex(m_threadCount);
                 }
             } catch(const Failure &) {
                 m_containerParsingStatus = ParsingStatus::CriticalFailure;
@@ -275,6 +287,7 @@ startParsingSignature:
             m_containerParsingStatus = ParsingStatus::Ok;
         }
     }
+    saveParseIndex();
 }
 
 /*!
@@ -322,6 +335,22 @@ void MediaFileInfo::parseTracks()
             case ContainerFormat::Flac:
                 // FLAC streams might container padding
                 m_paddingSize += static_cast<FlacStream *>(m_singleTrack.get())->paddingSize();
+                // walk all frames to determine the exact duration and to verify the CRCs if a full parse is forced
+                if(isForcingFullParse()) {
+                    static_cast<FlacStream *>(m_singleTrack.get())->scanFrames();
+                }
+                break;
+            case ContainerFormat::MpegAudioFrames:
+                // walk all frames to determine the exact duration and bitrate if a full parse is forced
+                if(isForcingFullParse()) {
+                    static_cast<MpegAudioFrameStream *>(m_singleTrack.get())->scanFrames(*this, m_threadCount);
+                }
+                break;
+            case ContainerFormat::Adts:
+                // walk all frames to determine the exact duration and bitrate if a full parse is forced
+                if(isForcingFullParse()) {
+                    static_cast<AdtsStream *>(m_singleTrack.get())->scanFrames(*this, m_threadCount);
+                }
                 break;
             default:
                 ;
@@ -335,8 +364,51 @@ void MediaFileInfo::parseTracks()
         addNotification(NotificationType::Critical, "Unable to parse tracks.", context);
         m_tracksParsingStatus = ParsingStatus::CriticalFailure;
     }
+    saveParseIndex();
 }
 
+/// \brief The private MappedStreamBuffer class is used in MediaFileInfo::parseTags() to read tags directly from the memory mapping of the file.
+class MappedStreamBuffer : public std::streambuf
+{
+public:
+    /// \brief Constructs a new buffer for the specified \a data of \a size bytes.
+    MappedStreamBuffer(const char *data, uint64 size)
+    {
+        char *const begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    /// \brief Sets the read position; positions correspond to offsets within the mapped data.
+    pos_type seekoff(off_type off, ios_base::seekdir dir, ios_base::openmode which) override
+    {
+        if(!(which & ios_base::in)) {
+            return pos_type(off_type(-1));
+        }
+        switch(dir) {
+        case ios_base::cur:
+            off += gptr() - eback();
+            break;
+        case ios_base::end:
+            off += egptr() - eback();
+            break;
+        default:
+            ;
+        }
+        if(off < 0 || off > egptr() - eback()) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + off, egptr());
+        return pos_type(off);
+    }
+
+    /// \brief Sets the read position to the specified absolute \a pos.
+    pos_type seekpos(pos_type pos, ios_base::openmode which) override
+    {
+        return seekoff(off_type(pos), ios_base::beg, which);
+    }
+};
+
 /*!
  * \brief Parses the tag(s) of the current file.
  *
@@ -371,12 +443,18 @@ void MediaFileInfo::parseTags()
         }
     }
     // the offsets of the ID3v2 tags have already been parsed when parsing the container format
+    // -> read them directly from the memory mapping if possible
+    const char *const mappedFile = mappedData(0, size());
+    MappedStreamBuffer mappedBuffer(mappedFile, mappedFile ? size() : 0);
+    istream mappedStream(&mappedBuffer);
+    mappedStream.exceptions(ios_base::failbit | ios_base::badbit);
+    istream &id3v2Stream = mappedFile ? mappedStream : static_cast<istream &>(stream());
     m_id3v2Tags.clear();
     for(const auto offset : m_actualId3v2TagOffsets) {
         auto id3v2Tag = make_unique<Id3v2Tag>();
-        stream().seekg(offset, ios_base::beg);
+        id3v2Stream.seekg(offset, ios_base::beg);
         try {
-            id3v2Tag->parse(stream(), size() - offset);
+            id3v2Tag->parse(id3v2Stream, size() - offset);
             m_paddingSize += id3v2Tag->paddingSize();
         } catch(const NoDataFoundException &) {
             continue;
@@ -404,6 +482,7 @@ void MediaFileInfo::parseTags()
         // do not override error status here
         m_tagsParsingStatus = ParsingStatus::Ok;
     }
+    saveParseIndex();
 }
 
 /*!
@@ -635,9 +714,14 @@ bool MediaFileInfo::createAppropriateTags(bool treatUnknownFilesAsMp3Files, TagU
  * \throws Throws Media::Failure or a derived exception when a making error occurs.
  *
  * \remarks Tags and tracks need to be parsed without errors before this method can be called.
+ *          Changes can not be applied when a byte source is assigned (see setByteSource()).
  *          All previous parsing results are cleared (using clearParsingResults()). Hence
  *          the file must be reparsed. All related objects (tags, tracks, ...) might get invalidated.
  *          This includes notifications of these objects as well.
+ * \remarks Matroska/WebM files are an exception: the container has already set up the header of the new file (see
+ *          isVerifyingOutput()), so it is kept and only the tracks, tags, chapters and attachments need to be parsed
+ *          again. The results of other containers are still cleared because OggContainer does not set up the
+ *          header of the new file and the padding of MP4 files is only determined when parsing the container format.
  *
  * \sa clearParsingResults()
  */
@@ -645,6 +729,10 @@ void MediaFileInfo::applyChanges()
 {   
     static const string context("making file");
     addNotification(NotificationType::Information, "Changes are about to be applied.", context);
+    if(byteSource()) {
+        addNotification(NotificationType::Critical, "Changes can not be applied to data read from a byte source.", context);
+        throw NotImplementedException();
+    }
     bool previousParsingSuccessful = true;
     switch(tagsParsingStatus()) {
     case ParsingStatus::Ok:
@@ -665,6 +753,9 @@ void MediaFileInfo::applyChanges()
     if(!previousParsingSuccessful) {
         throw InvalidDataException();
     }
+    if(m_regenerateFlacSeekTable && m_containerFormat != ContainerFormat::Flac) {
+        addNotification(NotificationType::Warning, "Regenerating the seek table is only supported for raw FLAC files and will be skipped.", context);
+    }
     if(m_container) { // container object takes care
         // ID3 tags can not be applied in this case -> add warnings if ID3 tags have been assigned
         if(hasId3v1Tag()) {
@@ -683,6 +774,12 @@ void MediaFileInfo::applyChanges()
             clearParsingResults();
             throw;
         }
+        if(m_containerFormat == ContainerFormat::Matroska || m_containerFormat == ContainerFormat::Webm) {
+            // the container has taken the written elements (or reparsed the header of the new file)
+            // -> keep it so the new file does not need to be parsed from scratch
+            clearContentParsingResults();
+            return;
+        }
     } else { // implementation if no container object is present
         // assume the file is a MP3 file
         try {
@@ -1367,21 +1464,7 @@ void MediaFileInfo::clearParsingResults()
     m_containerParsingStatus = ParsingStatus::NotParsedYet;
     m_containerFormat = ContainerFormat::Unknown;
     m_containerOffset = 0;
-    m_paddingSize = 0;
-    m_tracksParsingStatus = ParsingStatus::NotParsedYet;
-    m_tagsParsingStatus = ParsingStatus::NotParsedYet;
-    m_chaptersParsingStatus = ParsingStatus::NotParsedYet;
-    m_attachmentsParsingStatus = ParsingStatus::NotParsedYet;
-    if(m_id3v1Tag) {
-        transferNotifications(*m_id3v1Tag);
-        m_id3v1Tag.reset();
-    }
-    for(auto &id3v2Tag : m_id3v2Tags) {
-        transferNotifications(*id3v2Tag);
-    }
-    m_id3v2Tags.clear();
-    m_actualId3v2TagOffsets.clear();
-    m_actualExistingId3v1Tag = false;
+    clearContentParsingResults();
     if(m_container) {
         transferNotifications(*m_container);
         for(size_t i = 0, count = m_container->trackCount(); i != count; ++i) {
@@ -1404,6 +1487,32 @@ void MediaFileInfo::clearParsingResults()
     }
 }
 
+/*!
+ * \brief Clears the parsing results of the tracks, tags, chapters and attachments but keeps the detected container.
+ *
+ * This private method is used by clearParsingResults() and by applyChanges() if the container has already set up
+ * the header of the new file.
+ */
+void MediaFileInfo::clearContentParsingResults()
+{
+    m_paddingSize = 0;
+    m_tracksParsingStatus = ParsingStatus::NotParsedYet;
+    m_tagsParsingStatus = ParsingStatus::NotParsedYet;
+    m_chaptersParsingStatus = ParsingStatus::NotParsedYet;
+    m_attachmentsParsingStatus = ParsingStatus::NotParsedYet;
+    if(m_id3v1Tag) {
+        transferNotifications(*m_id3v1Tag);
+        m_id3v1Tag.reset();
+    }
+    for(auto &id3v2Tag : m_id3v2Tags) {
+        transferNotifications(*id3v2Tag);
+    }
+    m_id3v2Tags.clear();
+    m_actualId3v2TagOffsets.clear();
+    m_actualExistingId3v1Tag = false;
+    m_parseIndex.clear();
+}
+
 /*!
  * \brief Merges the assigned ID3v2 tags into a single ID3v2 tag.
  *
@@ -1601,14 +1710,56 @@ void MediaFileInfo::invalidated()
     clearParsingResults();
 }
 
+/*!
+ * \brief Loads the parse index of the file from indexCacheDirectory().
+ *
+ * This private method is called when parsing the container format. Nothing is loaded if caching is disabled or the
+ * file is read from a byte source. IO errors are added as warnings because the file can still be parsed regularly.
+ */
+void MediaFileInfo::loadParseIndex()
+{
+    static const string context("loading parse index");
+    m_parseIndex.clear();
+    if(m_indexCacheDirectory.empty() || byteSource()) {
+        return;
+    }
+    try {
+        m_parseIndex.identify(path(), stream(), size());
+        m_parseIndex.load(m_indexCacheDirectory);
+    } catch(...) {
+        addNotification(NotificationType::Warning, catchIoFailure(), context);
+    }
+}
+
+/*!
+ * \brief Saves the parse index of the file to indexCacheDirectory() if it has been modified.
+ *
+ * This private method is called after parsing the container format, the tracks and the tags because container
+ * implementations might update the index when parsing their header.
+ */
+void MediaFileInfo::saveParseIndex()
+{
+    static const string context("saving parse index");
+    if(m_indexCacheDirectory.empty() || !m_parseIndex.isIdentified() || !m_parseIndex.isModified()) {
+        return;
+    }
+    try {
+        m_parseIndex.save(m_indexCacheDirectory);
+    } catch(...) {
+        addNotification(NotificationType::Warning, catchIoFailure(), context);
+    }
+}
+
 /*!
  * \brief Internally used to save chanings of MP3/FLAC files and any other files which might have ID3 tags.
  */
 void MediaFileInfo::makeMp3File()
 {
     static const string context("making MP3/FLAC file");
+    // the Xing header is regenerated when copying the MPEG audio frames so rewriting is required in this case
+    const bool regenerateXingHeader = m_regenerateXingHeader && m_containerFormat == ContainerFormat::MpegAudioFrames;
     // there's no need to rewrite the complete file if there are no ID3v2 tags present or to be written
-    if(!isForcingRewrite() && m_id3v2Tags.empty() && m_actualId3v2TagOffsets.empty() && m_saveFilePath.empty() && m_containerFormat != ContainerFormat::Flac) {
+    if(!isForcingRewrite() && !regenerateXingHeader && m_id3v2Tags.empty() && m_actualId3v2TagOffsets.empty() && m_saveFilePath.empty() && m_containerFormat != ContainerFormat::Flac) {
         if(m_actualExistingId3v1Tag) {
             // there is currently an ID3v1 tag at the end of the file
             if(m_id3v1Tag) {
@@ -1678,7 +1829,15 @@ void MediaFileInfo::makeMp3File()
 
         if(flacStream) {
             // if it is a raw FLAC stream, make FLAC metadata
-            startOfLastMetaDataBlock = flacStream->makeHeader(flacMetaData);
+            if(m_regenerateFlacSeekTable && flacStream->seekTable().empty()) {
+                // walk the frames to determine the seek table (unless already done when parsing)
+                updateStatus("Scanning FLAC frames ...");
+                flacStream->scanFrames();
+                if(flacStream->seekTable().empty()) {
+                    addNotification(NotificationType::Warning, "Unable to regenerate the seek table because no FLAC frames could be found; the present seek table is kept.", context);
+                }
+            }
+            startOfLastMetaDataBlock = flacStream->makeHeader(flacMetaData, m_regenerateFlacSeekTable);
             tagsSize += flacMetaData.tellp();
             streamOffset = flacStream->streamOffset();
         } else {
@@ -1687,7 +1846,7 @@ void MediaFileInfo::makeMp3File()
         }
 
         // check whether rewrite is required
-        bool rewriteRequired = isForcingRewrite() || !m_saveFilePath.empty() || (tagsSize > streamOffset);
+        bool rewriteRequired = isForcingRewrite() || regenerateXingHeader || !m_saveFilePath.empty() || (tagsSize > streamOffset);
         uint32 padding = 0;
         if(!rewriteRequired) {
             // rewriting is not forced and new tag is not too big for available space
@@ -1820,9 +1979,26 @@ void MediaFileInfo::makeMp3File()
                 default:
                     updateStatus("Writing frames ...");
                 }
-                backupStream.seekg(streamOffset);
-                CopyHelper<0x4000> copyHelper;
-                copyHelper.callbackCopy(backupStream, stream(), mediaDataSize, bind(&StatusProvider::isAborted, this), bind(&StatusProvider::updatePercentage, this, _1));
+                bool xingHeaderWritten = false;
+                if(regenerateXingHeader) {
+                    // walk the frames while copying them to write a Xing header with an accurate TOC
+                    MpegAudioXingHeaderMaker xingHeaderMaker;
+                    xingHeaderMaker.forwardStatusUpdateCalls(this);
+                    try {
+                        xingHeaderMaker.prepare(backupStream, streamOffset, mediaDataSize);
+                        xingHeaderMaker.make(backupStream, outputStream);
+                        xingHeaderWritten = true;
+                    } catch(const Failure &) {
+                        // nothing to do: the stream is just copied as-is
+                    }
+                    addNotifications(xingHeaderMaker);
+                }
+                if(!xingHeaderWritten) {
+                    backupStream.seekg(streamOffset);
+                    NativeCopyHelper copyHelper;
+                    copyHelper.open(backupStream, backupPath.empty() ? path() : backupPath, outputStream, m_saveFilePath.empty() ? path() : m_saveFilePath);
+                    copyHelper.callbackCopy(backupStream, outputStream, mediaDataSize, bind(&StatusProvider::isAborted, this), bind(&StatusProvider::updatePercentage, this, _1));
+                }
                 updatePercentage(1.0);
             } else {
                 // just skip actual stream data
@@ -5,6 +5,7 @@
 #include "./statusprovider.h"
 #include "./basicfileinfo.h"
 #include "./abstractcontainer.h"
+#include "./parseindex.h"
 
 #include <vector>
 #include <unordered_set>
@@ -142,8 +143,16 @@ public:
     void setSaveFilePath(const std::string &saveFilePath);
     bool isForcingFullParse() const;
     void setForceFullParse(bool forceFullParse);
+    size_t threadCount() const;
+    void setThreadCount(size_t threadCount);
     bool isForcingRewrite() const;
     void setForceRewrite(bool forceRewrite);
+    bool isVerifyingOutput() const;
+    void setVerifyOutput(bool verifyOutput);
+    bool isRegeneratingXingHeader() const;
+    void setRegenerateXingHeader(bool regenerateXingHeader);
+    bool isRegeneratingFlacSeekTable() const;
+    void setRegenerateFlacSeekTable(bool regenerateFlacSeekTable);
     size_t minPadding() const;
     void setMinPadding(size_t minPadding);
     size_t maxPadding() const;
@@ -158,6 +167,9 @@ public:
     void setIndexPosition(ElementPosition indexPosition);
     bool forceIndexPosition() const;
     void setForceIndexPosition(bool forceTagPosition);
+    const std::string &indexCacheDirectory() const;
+    void setIndexCacheDirectory(const std::string &indexCacheDirectory);
+    ParseIndex &parseIndex();
 
 protected:
     virtual void invalidated();
@@ -167,6 +179,9 @@ private:
     // currently only the makeMp3File() methods is present; corresponding methods for
     // other formats are outsourced to container classes
     void makeMp3File();
+    void clearContentParsingResults();
+    void loadParseIndex();
+    void saveParseIndex();
 
     // fields related to the container
     ParsingStatus m_containerParsingStatus;
@@ -176,6 +191,7 @@ private:
     bool m_actualExistingId3v1Tag;
     std::list<std::streamoff> m_actualId3v2TagOffsets;
     std::unique_ptr<AbstractContainer> m_container;
+    ParseIndex m_parseIndex;
 
     // fields related to the tracks
     ParsingStatus m_tracksParsingStatus;
@@ -193,7 +209,11 @@ private:
     // fields specifying object behaviour
     std::string m_saveFilePath;
     bool m_forceFullParse;
+    size_t m_threadCount;
     bool m_forceRewrite;
+    bool m_verifyOutput;
+    bool m_regenerateXingHeader;
+    bool m_regenerateFlacSeekTable;
     size_t m_minPadding;
     size_t m_maxPadding;
     size_t m_preferredPadding;
@@ -201,6 +221,7 @@ private:
     bool m_forceTagPosition;
     ElementPosition m_indexPosition;
     bool m_forceIndexPosition;
+    std::string m_indexCacheDirectory;
 };
 
 /*!
@@ -400,7 +421,9 @@ inline AbstractContainer *MediaFileInfo::container() const
  * \brief Returns an indication whether forcing a full parse is enabled.
  *
  * If enabled the parser will analyse the file structure as deep as possible.
- * This might cause long parsing times for big files.
+ * This might cause long parsing times for big files. For instance, all frames of
+ * MPEG audio, ADTS and raw FLAC files are walked (see MpegAudioFrameStream::scanFrames(), AdtsStream::scanFrames()
+ * and FlacStream::scanFrames()).
  *
  * \sa setForceFullParse()
  */
@@ -419,6 +442,29 @@ inline void MediaFileInfo::setForceFullParse(bool forceFullParse)
     m_forceFullParse = forceFullParse;
 }
 
+/*!
+ * \brief Returns the number of threads used by parsing steps which support multi-threading.
+ *
+ * This applies to the steps done when a full parse is forced, eg. validating the index of Matroska files (see
+ * MatroskaContainer::validateIndex()) and walking the frames of MPEG audio and ADTS files. Zero means the number of
+ * hardware threads is used.
+ *
+ * The default is zero. MediaBatchScanner sets it to one since it already parses several files concurrently.
+ */
+inline size_t MediaFileInfo::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the number of threads used by parsing steps which support multi-threading.
+ * \sa threadCount()
+ */
+inline void MediaFileInfo::setThreadCount(size_t threadCount)
+{
+    m_threadCount = threadCount;
+}
+
 /*!
  * \brief Returns whether forcing rewriting (when applying changes) is enabled.
  */
@@ -435,6 +481,79 @@ inline void MediaFileInfo::setForceRewrite(bool forceRewrite)
     m_forceRewrite = forceRewrite;
 }
 
+/*!
+ * \brief Returns whether the header of the output is reparsed after applying changes.
+ *
+ * If disabled, containers which know the offsets of the elements they have just written take these elements
+ * directly instead of reparsing the header of the new file (currently only MatroskaContainer does so). The container
+ * is kept by applyChanges() in this case, so parsing the new file afterwards starts from the taken elements. Enabling
+ * this is only useful to verify the output.
+ *
+ * This is disabled by default.
+ */
+inline bool MediaFileInfo::isVerifyingOutput() const
+{
+    return m_verifyOutput;
+}
+
+/*!
+ * \brief Sets whether the header of the output is reparsed after applying changes.
+ * \sa isVerifyingOutput()
+ */
+inline void MediaFileInfo::setVerifyOutput(bool verifyOutput)
+{
+    m_verifyOutput = verifyOutput;
+}
+
+/*!
+ * \brief Returns whether the Xing header of MPEG audio files is regenerated when applying changes.
+ *
+ * If enabled, the frames are walked while copying them and a Xing/Info frame with the accurate frame count, byte
+ * count and TOC is written (see MpegAudioXingHeaderMaker). This allows players to compute the duration and to seek
+ * quickly even if the existing Xing header is missing or broken. Files are always rewritten in this case.
+ *
+ * The default is false.
+ */
+inline bool MediaFileInfo::isRegeneratingXingHeader() const
+{
+    return m_regenerateXingHeader;
+}
+
+/*!
+ * \brief Sets whether the Xing header of MPEG audio files is regenerated when applying changes.
+ * \sa isRegeneratingXingHeader()
+ */
+inline void MediaFileInfo::setRegenerateXingHeader(bool regenerateXingHeader)
+{
+    m_regenerateXingHeader = regenerateXingHeader;
+}
+
+/*!
+ * \brief Returns whether the seek table of raw FLAC files is regenerated when applying changes.
+ *
+ * If enabled, the frames are walked when applying changes (unless already done when parsing, see
+ * FlacStream::scanFrames()) and the "METADATA_BLOCK_SEEKTABLE" is replaced by a seek table with an entry every
+ * 10 seconds. A rewrite is not required since the offsets of the seek points are relative to the first frame.
+ *
+ * This is only supported for raw FLAC files; a warning is added when applying changes to other files. A warning is
+ * also added and the present seek table is kept if no frames could be found.
+ *
+ * The default is false.
+ */
+inline bool MediaFileInfo::isRegeneratingFlacSeekTable() const
+{
+    return m_regenerateFlacSeekTable;
+}
+
+/*!
+ * \brief Sets whether the seek table of raw FLAC files is regenerated when applying changes.
+ * \sa isRegeneratingFlacSeekTable()
+ */
+inline void MediaFileInfo::setRegenerateFlacSeekTable(bool regenerateFlacSeekTable)
+{
+    m_regenerateFlacSeekTable = regenerateFlacSeekTable;
+}
+
 /*!
  * \brief Returns the minimum padding to be written before the data blocks when applying changes.
  *
@@ -596,6 +715,41 @@ inline void MediaFileInfo::setForceIndexPosition(bool forceIndexPosition)
     m_forceIndexPosition = forceIndexPosition;
 }
 
+/*!
+ * \brief Returns the directory used to cache parse indices.
+ *
+ * If not empty, the locations of relevant structures determined when parsing the file are saved within this directory
+ * and used to speed up parsing the same file again. An empty string (the default) disables caching.
+ *
+ * \sa ParseIndex
+ */
+inline const std::string &MediaFileInfo::indexCacheDirectory() const
+{
+    return m_indexCacheDirectory;
+}
+
+/*!
+ * \brief Sets the directory used to cache parse indices.
+ * \remarks The directory must exist. The setting is applied next time parsing.
+ * \sa indexCacheDirectory()
+ */
+inline void MediaFileInfo::setIndexCacheDirectory(const std::string &indexCacheDirectory)
+{
+    m_indexCacheDirectory = indexCacheDirectory;
+}
+
+/*!
+ * \brief Returns the parse index of the file.
+ *
+ * The index is loaded when parsing the container format if indexCacheDirectory() is set. Container implementations
+ * use it to locate relevant structures without walking the file and record the locations they determined. The index
+ * is only identified (see ParseIndex::isIdentified()) if caching is enabled.
+ */
+inline ParseIndex &MediaFileInfo::parseIndex()
+{
+    return m_parseIndex;
+}
+
 }
 
 #endif // MEDIAINFO_H
@@ -8,10 +8,12 @@
 #include "../exceptions.h"
 
 #include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/conversion/binaryconversion.h>
 #include <c++utilities/io/binaryreader.h>
 #include <c++utilities/io/binarywriter.h>
 
 #include <sstream>
+#include <algorithm>
 
 using namespace std;
 using namespace IoUtilities;
@@ -64,8 +66,11 @@ void Mp4Atom::internalParse()
         addNotification(NotificationType::Critical, "Atom is smaller than 8 byte and hence invalid. The remaining size within the parent atom is " % numberToString(maxTotalSize()) + ".", context);
         throw TruncatedDataException();
     }
-    stream().seekg(startOffset());
-    m_dataSize = reader().readUInt32BE();
+    // obtain header (directly from memory mapping or read cache if possible)
+    const uint64 headerBytesAvailable = min<uint64>(maxTotalSize(), 16);
+    char headerBuf[16];
+    const char *const header = fetchData(startOffset(), headerBytesAvailable, headerBuf);
+    m_dataSize = BE::toUInt32(header);
     if(m_dataSize == 0) {
         // atom size extends to rest of the file/enclosing container
         m_dataSize = maxTotalSize();
@@ -78,10 +83,14 @@ void Mp4Atom::internalParse()
         addNotification(NotificationType::Critical, "Atom is smaller than 8 byte and hence invalid.", context);
         throw TruncatedDataException();
     }
-    m_id = reader().readUInt32BE();
+    m_id = BE::toUInt32(header + 4);
     m_idLength = 4;
     if(m_dataSize == 1) { // atom denotes 64-bit size
-        m_dataSize = reader().readUInt64BE();
+        if(headerBytesAvailable < 16) {
+            addNotification(NotificationType::Critical, "Atom denoting 64-bit size is truncated.", parsingContext());
+            throw TruncatedDataException();
+        }
+        m_dataSize = BE::toUInt64(header + 8);
         m_sizeLength = 12; // 4 bytes indicate long size denotation + 8 bytes for actual size denotation
         if(dataSize() < 16 && m_dataSize != 1) {
             addNotification(NotificationType::Critical, "Atom denoting 64-bit size is smaller than 16 byte and hence invalid.", parsingContext());
@@ -99,19 +108,19 @@ void Mp4Atom::internalParse()
     Mp4Atom *child = nullptr;
     if(uint64 firstChildOffset = this->firstChildOffset()) {
         if(firstChildOffset + minimumElementSize() <= totalSize()) {
-            child = new Mp4Atom(static_cast<Mp4Atom &>(*this), startOffset() + firstChildOffset);
+            child = createElement(static_cast<Mp4Atom &>(*this), startOffset() + firstChildOffset);
         }
     }
-    m_firstChild.reset(child);
+    m_firstChild = child;
     Mp4Atom *sibling = nullptr;
     if(totalSize() < maxTotalSize()) {
         if(parent()) {
-            sibling = new Mp4Atom(*(parent()), startOffset() + totalSize());
+            sibling = createElement(*(parent()), startOffset() + totalSize());
         } else {
-            sibling = new Mp4Atom(container(), startOffset() + totalSize(), maxTotalSize() - totalSize());
+            sibling = createElement(container(), startOffset() + totalSize(), maxTotalSize() - totalSize());
         }
     }
-    m_nextSibling.reset(sibling);
+    m_nextSibling = sibling;
 }
 
 /*!
@@ -0,0 +1,131 @@
+#include "./mp4chunkcopier.h"
+
+#include "../nativecopyhelper.h"
+
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::Mp4ChunkCopier
+ * \brief The Mp4ChunkCopier class copies the chunks of MP4 tracks when rewriting the media data chunk-by-chunk.
+ *
+ * The chunks are added in the order they will be stored in the output file (usually interleaved). The output offset
+ * of each chunk is determined immediately so the chunk offset tables can be updated before copying. Chunks which
+ * are stored contiguously in the source file are coalesced to runs so they can be copied using a single (native)
+ * copy operation instead of one seek and copy per chunk.
+ *
+ * Runs which are too small to be copied natively are gathered in a buffer: the runs of a batch are read ordered by
+ * their source offset (so the source is read sequentially where possible) and the buffer is written at once.
+ */
+
+/*!
+ * \brief Constructs a new copier for chunks which are going to be written starting at \a outputOffset.
+ */
+Mp4ChunkCopier::Mp4ChunkCopier(uint64 outputOffset) :
+    m_outputOffset(outputOffset),
+    m_totalSize(0),
+    m_chunkCount(0),
+    m_bufferSize(0x400000)
+{}
+
+/*!
+ * \brief Adds a chunk of \a size bytes located at \a sourceOffset within \a stream.
+ * \returns Returns the offset of the chunk within the output.
+ * \remarks The chunk is appended to the last run if it directly follows the chunk added before within the source.
+ */
+uint64 Mp4ChunkCopier::addChunk(istream *stream, uint64 sourceOffset, uint64 size)
+{
+    const uint64 outputOffset = m_outputOffset + m_totalSize;
+    if(!m_runs.empty() && m_runs.back().stream == stream && m_runs.back().sourceOffset + m_runs.back().size == sourceOffset) {
+        m_runs.back().size += size;
+        ++m_runs.back().chunkCount;
+    } else {
+        m_runs.push_back(Mp4ChunkRun{stream, sourceOffset, outputOffset, size, 1});
+    }
+    m_totalSize += size;
+    ++m_chunkCount;
+    return outputOffset;
+}
+
+/*!
+ * \brief Copies all chunks added via addChunk() to \a output.
+ *
+ * Writing starts at the current write position of \a output which is expected to be the output offset specified
+ * when constructing the copier.
+ *
+ * \param copyHelper Specifies the helper used to copy runs which are at least NativeCopyHelper::minimumSize() bytes
+ *                   long.
+ * \param isAborted Specifies a function to check whether the operation has been aborted; might be empty.
+ * \param callback Specifies a function to be called with the progress percentage; might be empty.
+ * \remarks If the operation has been aborted, this method returns before all data has been copied. The caller
+ *          is expected to check for that.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void Mp4ChunkCopier::copy(ostream &output, NativeCopyHelper &copyHelper, const std::function<bool (void)> &isAborted, const std::function<void (double)> &callback)
+{
+    uint64 bytesCopied = 0;
+    for(auto run = m_runs.cbegin(), end = m_runs.cend(); run != end && !(isAborted && isAborted()); ) {
+        if(run->size >= copyHelper.minimumSize() || run->size > m_bufferSize) {
+            // copy large runs directly
+            run->stream->seekg(static_cast<streamoff>(run->sourceOffset));
+            copyHelper.callbackCopy(*run->stream, output, run->size, isAborted, callback ? [&] (double percentage) {
+                callback((bytesCopied + percentage * run->size) / m_totalSize);
+            } : std::function<void (double)>());
+            bytesCopied += run->size;
+            ++run;
+        } else {
+            // gather small runs of the same stream in the buffer
+            auto batchEnd = run;
+            uint64 batchSize = 0;
+            for(; batchEnd != end && batchEnd->stream == run->stream && batchEnd->size < copyHelper.minimumSize()
+                && batchSize + batchEnd->size <= m_bufferSize; ++batchEnd) {
+                batchSize += batchEnd->size;
+            }
+            copyBatch(run, batchEnd, output);
+            bytesCopied += batchSize;
+            run = batchEnd;
+        }
+        if(callback) {
+            callback(static_cast<double>(bytesCopied) / m_totalSize);
+        }
+    }
+}
+
+/*!
+ * \brief Reads the runs from \a begin to \a end ordered by their source offset into the buffer and writes the buffer.
+ * \remarks All runs must belong to the same stream and fit into the buffer.
+ */
+void Mp4ChunkCopier::copyBatch(vector<Mp4ChunkRun>::const_iterator begin, vector<Mp4ChunkRun>::const_iterator end, ostream &output)
+{
+    const uint64 batchOffset = begin->outputOffset;
+    const auto batchSize = static_cast<size_t>((end - 1)->outputOffset + (end - 1)->size - batchOffset);
+    if(m_buffer.size() < batchSize) {
+        m_buffer.resize(min<size_t>(m_bufferSize, static_cast<size_t>(m_totalSize)));
+    }
+    m_batch.clear();
+    for(auto run = begin; run != end; ++run) {
+        m_batch.push_back(&*run);
+    }
+    sort(m_batch.begin(), m_batch.end(), [] (const Mp4ChunkRun *lhs, const Mp4ChunkRun *rhs) {
+        return lhs->sourceOffset < rhs->sourceOffset;
+    });
+    istream &input = *begin->stream;
+    uint64 readOffset = m_batch.front()->sourceOffset;
+    input.seekg(static_cast<streamoff>(readOffset));
+    for(const Mp4ChunkRun *run : m_batch) {
+        // avoid seeking if the run follows the previous one (seeking discards the buffer of the stream)
+        if(run->sourceOffset != readOffset) {
+            input.seekg(static_cast<streamoff>(run->sourceOffset));
+        }
+        input.read(m_buffer.data() + (run->outputOffset - batchOffset), static_cast<streamsize>(run->size));
+        readOffset = run->sourceOffset + run->size;
+    }
+    output.write(m_buffer.data(), static_cast<streamsize>(batchSize));
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef MEDIA_MP4CHUNKCOPIER_H
+#define MEDIA_MP4CHUNKCOPIER_H
+
+#include "../global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <functional>
+#include <iosfwd>
+#include <vector>
+
+namespace Media {
+
+class NativeCopyHelper;
+
+/*!
+ * \brief The Mp4ChunkRun struct holds consecutive chunks which are stored contiguously in the source and the output.
+ */
+struct TAG_PARSER_EXPORT Mp4ChunkRun
+{
+    std::istream *stream; /**< stream to read the chunks from */
+    uint64 sourceOffset; /**< offset of the first chunk within the stream */
+    uint64 outputOffset; /**< offset of the first chunk within the output */
+    uint64 size; /**< total size of the chunks */
+    std::size_t chunkCount; /**< number of chunks */
+};
+
+class TAG_PARSER_EXPORT Mp4ChunkCopier
+{
+public:
+    Mp4ChunkCopier(uint64 outputOffset);
+
+    std::size_t bufferSize() const;
+    void setBufferSize(std::size_t bufferSize);
+    uint64 addChunk(std::istream *stream, uint64 sourceOffset, uint64 size);
+    std::size_t chunkCount() const;
+    uint64 totalSize() const;
+    const std::vector<Mp4ChunkRun> &runs() const;
+    void copy(std::ostream &output, NativeCopyHelper &copyHelper, const std::function<bool (void)> &isAborted, const std::function<void (double)> &callback);
+
+private:
+    void copyBatch(std::vector<Mp4ChunkRun>::const_iterator begin, std::vector<Mp4ChunkRun>::const_iterator end, std::ostream &output);
+
+    uint64 m_outputOffset;
+    uint64 m_totalSize;
+    std::size_t m_chunkCount;
+    std::size_t m_bufferSize;
+    std::vector<Mp4ChunkRun> m_runs;
+    std::vector<char> m_buffer;
+    std::vector<const Mp4ChunkRun *> m_batch;
+};
+
+/*!
+ * \brief Returns the size of the buffer used to gather small runs before writing them.
+ */
+inline std::size_t Mp4ChunkCopier::bufferSize() const
+{
+    return m_bufferSize;
+}
+
+/*!
+ * \brief Sets the size of the buffer used to gather small runs before writing them.
+ * \remarks Must be set before calling copy().
+ */
+inline void Mp4ChunkCopier::setBufferSize(std::size_t bufferSize)
+{
+    m_bufferSize = bufferSize;
+}
+
+/*!
+ * \brief Returns the number of chunks added via addChunk().
+ */
+inline std::size_t Mp4ChunkCopier::chunkCount() const
+{
+    return m_chunkCount;
+}
+
+/*!
+ * \brief Returns the total size of the chunks added via addChunk().
+ */
+inline uint64 Mp4ChunkCopier::totalSize() const
+{
+    return m_totalSize;
+}
+
+/*!
+ * \brief Returns the runs the chunks added so far have been coalesced to.
+ */
+inline const std::vector<Mp4ChunkRun> &Mp4ChunkCopier::runs() const
+{
+    return m_runs;
+}
+
+}
+
+#endif // MEDIA_MP4CHUNKCOPIER_H
@@ -1,4 +1,5 @@
 #include "./mp4container.h"
+#include "./mp4chunkcopier.h"
 #include "./mp4ids.h"
 
 #include "../exceptions.h"
@@ -8,11 +9,12 @@
 #include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/io/binaryreader.h>
 #include <c++utilities/io/binarywriter.h>
-#include <c++utilities/io/copy.h>
 #include <c++utilities/io/catchiofailure.h>
 
 #include <unistd.h>
 
+#include <functional>
+#include <limits>
 #include <tuple>
 #include <numeric>
 #include <memory>
@@ -34,7 +36,8 @@ namespace Media {
  */
 Mp4Container::Mp4Container(MediaFileInfo &fileInfo, uint64 startOffset) :
     GenericContainer<MediaFileInfo, Mp4Tag, Mp4Track, Mp4Atom>(fileInfo, startOffset),
-    m_fragmented(false)
+    m_fragmented(false),
+    m_chunkOffsetPromotionThreshold(numeric_limits<uint32>::max())
 {}
 
 Mp4Container::~Mp4Container()
@@ -502,6 +505,29 @@ calculatePadding:
         }
     }
 
+    // promote "stco"-atoms to "co64"-atoms if the chunk offsets might exceed 32-bit (or the configured threshold) after rewriting the file
+    // -> the new file is not bigger than the original file plus the new movie atom (including the promoted tables) and the padding
+    bool promoteChunkOffsets = false;
+    if(rewriteRequired) {
+        uint64 maxFileSize = fileInfo().size() + movieAtomSize + newPadding;
+        for(const auto &track : tracks()) {
+            if(track->chunkOffsetSize() == 4) {
+                maxFileSize += 16 + static_cast<uint64>(track->chunkCount()) * 4;
+            }
+        }
+        promoteChunkOffsets = maxFileSize > m_chunkOffsetPromotionThreshold;
+    }
+    for(auto &track : tracks()) {
+        if(track->chunkOffsetSize() == 4 && track->isPromotingChunkOffsets() != promoteChunkOffsets) {
+            movieAtomSize -= track->requiredSize();
+            track->setPromoteChunkOffsets(promoteChunkOffsets);
+            movieAtomSize += track->requiredSize();
+        }
+    }
+    if(promoteChunkOffsets) {
+        addNotification(NotificationType::Information, "The chunk offsets might exceed 32-bit so \"stco\"-atoms are replaced by \"co64\"-atoms.", context);
+    }
+
     if(isAborted()) {
         throw OperationAbortedException();
     }
@@ -544,6 +570,9 @@ calculatePadding:
 
         // set backup stream as associated input stream since we need the original elements to write the new file
         setStream(backupStream);
+        // -> allow copying media data without passing it through user space
+        nativeCopyHelper().open(backupStream, backupPath.empty() ? fileInfo().path() : backupPath,
+                                outputStream, fileInfo().saveFilePath().empty() ? fileInfo().path() : fileInfo().saveFilePath());
 
         // TODO: reduce code duplication
 
@@ -695,7 +724,6 @@ calculatePadding:
                         // read chunk offset and chunk size table from the old file which are required to get chunks
                         updateStatus("Reading chunk offsets and sizes from the original file ...");
                         trackInfos.reserve(trackCount);
-                        uint64 totalChunkCount = 0;
                         uint64 totalMediaDataSize = 0;
                         for(auto &track : tracks()) {
                             if(isAborted()) {
@@ -712,8 +740,7 @@ calculatePadding:
                                 addNotification(NotificationType::Critical, "Chunks of track " % numberToString<uint64, string>(track->id()) + " could not be parsed correctly.", context);
                             }
 
-                            // increase total chunk count and size
-                            totalChunkCount += track->chunkCount();
+                            // increase total size
                             totalMediaDataSize += accumulate(chunkSizesTable.cbegin(), chunkSizesTable.cend(), 0ul);
                         }
 
@@ -722,43 +749,35 @@ calculatePadding:
                         Mp4Atom::addHeaderSize(totalMediaDataSize);
                         Mp4Atom::makeHeader(totalMediaDataSize, Mp4AtomIds::MediaData, outputWriter);
 
-                        // -> copy chunks
-                        CopyHelper<0x2000> copyHelper;
-                        uint64 chunkIndexWithinTrack = 0, totalChunksCopied = 0;
-                        bool anyChunksCopied;
+                        // -> determine the output layout (interleaving the chunks of the tracks) and update the chunk offset tables
+                        Mp4ChunkCopier chunkCopier(static_cast<uint64>(outputStream.tellp()));
+                        uint64 chunkIndexWithinTrack = 0;
+                        bool anyChunksAdded;
                         do {
-                            if(isAborted()) {
-                                throw OperationAbortedException();
-                            }
-
-                            // copy a chunk from each track
-                            anyChunksCopied = false;
+                            // add a chunk from each track
+                            anyChunksAdded = false;
                             for(size_t trackIndex = 0; trackIndex < trackCount; ++trackIndex) {
                                 // get source stream and tables for current track
                                 auto &trackInfo = trackInfos[trackIndex];
-                                istream &sourceStream = *get<0>(trackInfo);
                                 vector<uint64> &chunkOffsetTable = get<1>(trackInfo);
                                 const vector<uint64> &chunkSizesTable = get<2>(trackInfo);
 
                                 // still chunks to be copied (of this track)?
                                 if(chunkIndexWithinTrack < chunkOffsetTable.size() && chunkIndexWithinTrack < chunkSizesTable.size()) {
-                                    // copy chunk, update entry in chunk offset table
-                                    sourceStream.seekg(chunkOffsetTable[chunkIndexWithinTrack]);
-                                    chunkOffsetTable[chunkIndexWithinTrack] = outputStream.tellp();
-                                    copyHelper.copy(sourceStream, outputStream, chunkSizesTable[chunkIndexWithinTrack]);
-
-                                    // update counter / status
-                                    anyChunksCopied = true;
-                                    ++totalChunksCopied;
+                                    // add chunk, update entry in chunk offset table
+                                    chunkOffsetTable[chunkIndexWithinTrack] = chunkCopier.addChunk(get<0>(trackInfo), chunkOffsetTable[chunkIndexWithinTrack], chunkSizesTable[chunkIndexWithinTrack]);
+                                    anyChunksAdded = true;
                                 }
                             }
-
-                            // incrase chunk index within track, update progress percentage
-                            if(!(++chunkIndexWithinTrack % 10)) {
-                                updatePercentage(static_cast<double>(totalChunksCopied) / totalChunkCount);
-                            }
-
-                        } while(anyChunksCopied);
+                            ++chunkIndexWithinTrack;
+                        } while(anyChunksAdded);
+
+                        // -> copy chunks; chunks stored contiguously in the original file are copied at once
+                        updateStatus("Copying media data ...");
+                        chunkCopier.copy(outputStream, nativeCopyHelper(), bind(&Mp4Container::isAborted, this), bind(&Mp4Container::updatePercentage, this, placeholders::_1));
+                        if(isAborted()) {
+                            throw OperationAbortedException();
+                        }
                     }
 
                 } else {
@@ -784,6 +803,7 @@ calculatePadding:
 
         // reparse what is written so far
         updateStatus("Reparsing output file ...");
+        nativeCopyHelper().close();
         if(rewriteRequired) {
             // report new size
             fileInfo().reportSizeChanged(outputStream.tellp());
@@ -861,6 +881,7 @@ calculatePadding:
 
         // handle errors (which might have been occured after renaming/creating backup file)
     } catch(...) {
+        nativeCopyHelper().close();
         BackupHelper::handleFailureAfterFileModified(fileInfo(), backupPath, outputStream, backupStream, context);
     }
 }
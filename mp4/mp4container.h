@@ -27,6 +27,8 @@ public:
     void reset();
     ElementPosition determineTagPosition() const;
     ElementPosition determineIndexPosition() const;
+    uint64 chunkOffsetPromotionThreshold() const;
+    void setChunkOffsetPromotionThreshold(uint64 chunkOffsetPromotionThreshold);
 
 protected:
     void internalParseHeader();
@@ -38,6 +40,7 @@ private:
     void updateOffsets(const std::vector<int64> &oldMdatOffsets, const std::vector<int64> &newMdatOffsets);
 
     bool m_fragmented;
+    uint64 m_chunkOffsetPromotionThreshold;
 };
 
 inline bool Mp4Container::supportsTrackModifications() const
@@ -54,6 +57,29 @@ inline bool Mp4Container::isFragmented() const
     return m_fragmented;
 }
 
+/*!
+ * \brief Returns the file size above which "stco"-atoms are replaced by "co64"-atoms when rewriting the file.
+ *
+ * When rewriting the file, the chunk offsets are promoted if the new file might exceed this size. The default is the
+ * maximum of a 32-bit unsigned integer so chunk offsets are only promoted if they might not fit into 32-bit.
+ *
+ * \sa Mp4Track::setPromoteChunkOffsets()
+ */
+inline uint64 Mp4Container::chunkOffsetPromotionThreshold() const
+{
+    return m_chunkOffsetPromotionThreshold;
+}
+
+/*!
+ * \brief Sets the file size above which "stco"-atoms are replaced by "co64"-atoms when rewriting the file.
+ * \remarks Lowering the threshold is mainly useful for testing the promotion without huge files.
+ * \sa chunkOffsetPromotionThreshold()
+ */
+inline void Mp4Container::setChunkOffsetPromotionThreshold(uint64 chunkOffsetPromotionThreshold)
+{
+    m_chunkOffsetPromotionThreshold = chunkOffsetPromotionThreshold;
+}
+
 }
 
 #endif // MEDIA_MP4CONTAINER_H
@@ -0,0 +1,314 @@
+#include "./mp4sampletable.h"
+
+#include "../basicfileinfo.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+
+#include <algorithm>
+#include <istream>
+
+using namespace std;
+using namespace ConversionUtilities;
+
+namespace Media {
+
+/// \brief The number of entries decoded at once when iterating over a table.
+static constexpr size_t blockEntryCount = 0x1000;
+
+/*!
+ * \brief Returns a pointer to \a size bytes at the specified \a offset within the specified \a stream.
+ * \returns Returns either a pointer into the memory mapping or into \a buffer.
+ * \remarks BasicFileInfo::fetchData() is used if \a stream is the stream of the specified \a fileInfo.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+static const char *fetchTableData(BasicFileInfo *fileInfo, istream *stream, uint64 offset, size_t size, string &buffer)
+{
+    if(buffer.size() < size) {
+        buffer.resize(size);
+    }
+    if(fileInfo && stream == &fileInfo->stream()) {
+        return fileInfo->fetchData(offset, size, &buffer[0]);
+    }
+    stream->seekg(static_cast<streamoff>(offset));
+    stream->read(&buffer[0], static_cast<streamsize>(size));
+    return buffer.data();
+}
+
+/*!
+ * \class Media::Mp4TableView
+ * \brief The Mp4TableView class is the base for lazy views over the sample tables of MP4 tracks.
+ *
+ * The views only store where the table is located. The entries are decoded on demand when they are accessed, so
+ * parsing a track does not require memory proportional to the number of samples or chunks. The data is read using
+ * BasicFileInfo::fetchData() if the stream is the stream of the file (so the memory mapping, the read cache or the
+ * byte source are used if available). Otherwise it is read from the stream directly (eg. when reading from the backup
+ * file while rewriting).
+ *
+ * The views must not be used anymore when the file is closed or the stream is destroyed. Sample sizes are not read via
+ * a view (see Mp4SampleSizeTable).
+ */
+
+/*!
+ * \brief Constructs an empty view.
+ */
+Mp4TableView::Mp4TableView() :
+    m_fileInfo(nullptr),
+    m_stream(nullptr),
+    m_tableOffset(0),
+    m_entryCount(0)
+{}
+
+/*!
+ * \brief Constructs a view over \a entryCount entries starting at \a tableOffset within the specified \a stream.
+ * \remarks The \a fileInfo might be nullptr.
+ */
+Mp4TableView::Mp4TableView(BasicFileInfo *fileInfo, istream *stream, uint64 tableOffset, uint64 entryCount) :
+    m_fileInfo(fileInfo),
+    m_stream(stream),
+    m_tableOffset(tableOffset),
+    m_entryCount(entryCount)
+{}
+
+/*!
+ * \brief Returns a pointer to \a size bytes at the specified \a offset (relative to the start of the table).
+ * \returns Returns either a pointer into the memory mapping or into \a buffer.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+const char *Mp4TableView::fetch(uint64 offset, size_t size, string &buffer) const
+{
+    return fetchTableData(m_fileInfo, m_stream, m_tableOffset + offset, size, buffer);
+}
+
+/*!
+ * \class Media::Mp4SampleSizeTable
+ * \brief The Mp4SampleSizeTable class holds the sample sizes of an MP4 track ("stsz" or "stz2" atom).
+ *
+ * The sample sizes are decoded once when constructing the table (the whole table needs to be read anyway to determine
+ * the size of the track). Hence the table does not depend on the stream it has been read from and can still be used
+ * after the file has been closed. If all samples have the same size, only the constant size is stored. Sample sizes of
+ * track fragments are appended (see append()).
+ */
+
+/*!
+ * \brief Constructs an empty table.
+ */
+Mp4SampleSizeTable::Mp4SampleSizeTable() :
+    m_constantSize(0),
+    m_fieldSize(32),
+    m_entryCount(0)
+{}
+
+/*!
+ * \brief Constructs a table by decoding \a entryCount sample sizes of \a fieldSize bits starting at \a tableOffset
+ *        within the specified \a stream.
+ * \remarks The \a fileInfo might be nullptr. The data is read using BasicFileInfo::fetchData() if the \a stream is
+ *          the stream of the file.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+Mp4SampleSizeTable::Mp4SampleSizeTable(BasicFileInfo *fileInfo, istream *stream, uint64 tableOffset, uint64 entryCount, byte fieldSize) :
+    m_constantSize(0),
+    m_fieldSize(fieldSize),
+    m_entryCount(entryCount),
+    m_sampleSizes(static_cast<size_t>(entryCount))
+{
+    // decode the table block by block to avoid buffering the whole raw table
+    string buffer;
+    uint32 *sampleSizes = m_sampleSizes.data();
+    for(uint64 first = 0; first < entryCount; first += blockEntryCount) {
+        const uint64 count = min<uint64>(blockEntryCount, entryCount - first);
+        switch(fieldSize) {
+        case 4: {
+            // two sample sizes per byte, the first one in the upper nibble
+            const uint64 firstByte = first / 2;
+            const char *data = fetchTableData(fileInfo, stream, tableOffset + firstByte, static_cast<size_t>((first + count + 1) / 2 - firstByte), buffer);
+            for(uint64 index = first, end = first + count; index != end; ++index) {
+                const auto value = static_cast<byte>(data[index / 2 - firstByte]);
+                *sampleSizes++ = index % 2 ? (value & 0x0F) : (value >> 4);
+            }
+            break;
+        } case 8: {
+            const char *data = fetchTableData(fileInfo, stream, tableOffset + first, static_cast<size_t>(count), buffer);
+            for(const char *end = data + count; data != end; ++data) {
+                *sampleSizes++ = static_cast<byte>(*data);
+            }
+            break;
+        } case 16: {
+            const char *data = fetchTableData(fileInfo, stream, tableOffset + first * 2, static_cast<size_t>(count * 2), buffer);
+            for(const char *end = data + count * 2; data != end; data += 2) {
+                *sampleSizes++ = BE::toUInt16(data);
+            }
+            break;
+        } default: {
+            const char *data = fetchTableData(fileInfo, stream, tableOffset + first * 4, static_cast<size_t>(count * 4), buffer);
+            for(const char *end = data + count * 4; data != end; data += 4) {
+                *sampleSizes++ = BE::toUInt32(data);
+            }
+        }
+        }
+    }
+}
+
+/*!
+ * \brief Returns a table for \a sampleCount samples of the specified \a constantSize.
+ */
+Mp4SampleSizeTable Mp4SampleSizeTable::fromConstantSize(uint32 constantSize, uint64 sampleCount)
+{
+    Mp4SampleSizeTable table;
+    table.m_constantSize = constantSize;
+    table.m_entryCount = sampleCount;
+    table.m_sampleSizes.push_back(constantSize);
+    return table;
+}
+
+/*!
+ * \brief Returns the size of the sample with the specified \a index.
+ * \remarks The \a index must be less than sampleCount() unless the size is constant.
+ */
+uint32 Mp4SampleSizeTable::at(uint64 index) const
+{
+    if(index >= m_entryCount && index - m_entryCount < m_sampleSizes.size() - fragmentBegin()) {
+        return m_sampleSizes[fragmentBegin() + static_cast<size_t>(index - m_entryCount)];
+    }
+    return m_constantSize ? m_constantSize : m_sampleSizes[static_cast<size_t>(index)];
+}
+
+/*!
+ * \brief Returns the sum of the sizes of \a count samples starting at the specified \a first sample.
+ * \remarks The range must be within sampleCount() unless the size is constant.
+ */
+uint64 Mp4SampleSizeTable::accumulate(uint64 first, uint64 count) const
+{
+    if(isConstant()) {
+        return static_cast<uint64>(m_constantSize) * count;
+    }
+    uint64 sum = 0;
+    if(first < m_entryCount) {
+        const uint64 end = min(first + count, m_entryCount);
+        if(m_constantSize) {
+            sum = static_cast<uint64>(m_constantSize) * (end - first);
+        } else {
+            for(auto i = m_sampleSizes.cbegin() + static_cast<ptrdiff_t>(first), last = m_sampleSizes.cbegin() + static_cast<ptrdiff_t>(end); i != last; ++i) {
+                sum += *i;
+            }
+        }
+        count -= end - first;
+        first = end;
+    }
+    const auto fragmentSizes = m_sampleSizes.cbegin() + static_cast<ptrdiff_t>(fragmentBegin() + (first - m_entryCount));
+    for(auto i = fragmentSizes, end = fragmentSizes + static_cast<ptrdiff_t>(count); i != end; ++i) {
+        sum += *i;
+    }
+    return sum;
+}
+
+/*!
+ * \class Media::Mp4ChunkOffsetTable
+ * \brief The Mp4ChunkOffsetTable class provides random access to the chunk offsets of an MP4 track ("stco" or "co64"
+ *        atom) without reading the whole table into memory.
+ */
+
+/*!
+ * \brief Constructs an empty table.
+ */
+Mp4ChunkOffsetTable::Mp4ChunkOffsetTable() :
+    m_entrySize(4)
+{}
+
+/*!
+ * \brief Constructs a view over \a entryCount chunk offsets of \a entrySize bytes starting at \a tableOffset within
+ *        the specified \a stream.
+ */
+Mp4ChunkOffsetTable::Mp4ChunkOffsetTable(BasicFileInfo *fileInfo, istream *stream, uint64 tableOffset, uint64 entryCount, byte entrySize) :
+    Mp4TableView(fileInfo, stream, tableOffset, entryCount),
+    m_entrySize(entrySize)
+{}
+
+/*!
+ * \brief Returns the offset of the chunk with the specified \a index (starting at 0).
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+uint64 Mp4ChunkOffsetTable::at(uint64 index) const
+{
+    uint64 chunkOffset;
+    read(index, 1, &chunkOffset);
+    return chunkOffset;
+}
+
+/*!
+ * \brief Reads \a count chunk offsets starting at the specified \a first entry into \a chunkOffsets.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void Mp4ChunkOffsetTable::read(uint64 first, size_t count, uint64 *chunkOffsets) const
+{
+    string buffer;
+    const char *data = fetch(first * m_entrySize, count * m_entrySize, buffer);
+    if(m_entrySize == 8) {
+        for(const char *end = data + count * 8; data != end; data += 8) {
+            *chunkOffsets++ = BE::toUInt64(data);
+        }
+    } else {
+        for(const char *end = data + count * 4; data != end; data += 4) {
+            *chunkOffsets++ = BE::toUInt32(data);
+        }
+    }
+}
+
+/*!
+ * \brief Returns all chunk offsets.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+vector<uint64> Mp4ChunkOffsetTable::toVector() const
+{
+    vector<uint64> chunkOffsets(static_cast<size_t>(m_entryCount));
+    for(uint64 index = 0; index < m_entryCount; index += blockEntryCount) {
+        read(index, static_cast<size_t>(min<uint64>(blockEntryCount, m_entryCount - index)), chunkOffsets.data() + index);
+    }
+    return chunkOffsets;
+}
+
+/*!
+ * \class Media::Mp4SampleToChunkTable
+ * \brief The Mp4SampleToChunkTable class provides random access to the entries of the "stsc" atom of an MP4 track
+ *        without reading the whole table into memory.
+ */
+
+/*!
+ * \brief Constructs an empty table.
+ */
+Mp4SampleToChunkTable::Mp4SampleToChunkTable()
+{}
+
+/*!
+ * \brief Constructs a view over \a entryCount entries starting at \a tableOffset within the specified \a stream.
+ */
+Mp4SampleToChunkTable::Mp4SampleToChunkTable(BasicFileInfo *fileInfo, istream *stream, uint64 tableOffset, uint64 entryCount) :
+    Mp4TableView(fileInfo, stream, tableOffset, entryCount)
+{}
+
+/*!
+ * \brief Returns the entry with the specified \a index (starting at 0).
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+Mp4SampleToChunkEntry Mp4SampleToChunkTable::at(uint64 index) const
+{
+    Mp4SampleToChunkEntry entry;
+    read(index, 1, &entry);
+    return entry;
+}
+
+/*!
+ * \brief Reads \a count entries starting at the specified \a first entry into \a entries.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void Mp4SampleToChunkTable::read(uint64 first, size_t count, Mp4SampleToChunkEntry *entries) const
+{
+    string buffer;
+    const char *data = fetch(first * 12, count * 12, buffer);
+    for(const char *end = data + count * 12; data != end; data += 12, ++entries) {
+        entries->firstChunk = BE::toUInt32(data);
+        entries->samplesPerChunk = BE::toUInt32(data + 4);
+        entries->sampleDescriptionIndex = BE::toUInt32(data + 8);
+    }
+}
+
+}
@@ -0,0 +1,202 @@
+#ifndef MEDIA_MP4SAMPLETABLE_H
+#define MEDIA_MP4SAMPLETABLE_H
+
+#include "../global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Media {
+
+class BasicFileInfo;
+
+class TAG_PARSER_EXPORT Mp4TableView
+{
+public:
+    uint64 entryCount() const;
+    std::istream *stream() const;
+    void setStream(std::istream *stream);
+
+protected:
+    Mp4TableView();
+    Mp4TableView(BasicFileInfo *fileInfo, std::istream *stream, uint64 tableOffset, uint64 entryCount);
+
+    const char *fetch(uint64 offset, std::size_t size, std::string &buffer) const;
+
+    BasicFileInfo *m_fileInfo;
+    std::istream *m_stream;
+    uint64 m_tableOffset;
+    uint64 m_entryCount;
+};
+
+/*!
+ * \brief Returns the number of entries of the table.
+ */
+inline uint64 Mp4TableView::entryCount() const
+{
+    return m_entryCount;
+}
+
+/*!
+ * \brief Returns the stream the table is read from.
+ */
+inline std::istream *Mp4TableView::stream() const
+{
+    return m_stream;
+}
+
+/*!
+ * \brief Sets the stream the table is read from.
+ * \remarks The table must be located at the same offset within the specified \a stream (eg. when reading from the
+ *          backup file while rewriting).
+ */
+inline void Mp4TableView::setStream(std::istream *stream)
+{
+    m_stream = stream;
+}
+
+class TAG_PARSER_EXPORT Mp4SampleSizeTable
+{
+public:
+    Mp4SampleSizeTable();
+    Mp4SampleSizeTable(BasicFileInfo *fileInfo, std::istream *stream, uint64 tableOffset, uint64 entryCount, byte fieldSize);
+    static Mp4SampleSizeTable fromConstantSize(uint32 constantSize, uint64 sampleCount);
+
+    bool isEmpty() const;
+    bool isConstant() const;
+    uint32 constantSize() const;
+    byte fieldSize() const;
+    uint64 sampleCount() const;
+    uint32 at(uint64 index) const;
+    uint64 accumulate(uint64 first, uint64 count) const;
+    const std::vector<uint32> &sampleSizes() const;
+    void append(uint32 sampleSize);
+
+private:
+    std::size_t fragmentBegin() const;
+
+    uint32 m_constantSize;
+    byte m_fieldSize;
+    uint64 m_entryCount;
+    std::vector<uint32> m_sampleSizes;
+};
+
+/*!
+ * rief Returns whether the table does not denote any sample sizes.
+ */
+inline bool Mp4SampleSizeTable::isEmpty() const
+{
+    return m_sampleSizes.empty();
+}
+
+/*!
+ * rief Returns whether all samples have the same size.
+ * \sa constantSize()
+ */
+inline bool Mp4SampleSizeTable::isConstant() const
+{
+    return m_constantSize && m_sampleSizes.size() == 1;
+}
+
+/*!
+ * rief Returns the size of all samples if the sample size is constant; otherwise returns zero.
+ */
+inline uint32 Mp4SampleSizeTable::constantSize() const
+{
+    return m_constantSize;
+}
+
+/*!
+ * rief Returns the number of bits used to store a sample size (4, 8, 16 or 32).
+ */
+inline byte Mp4SampleSizeTable::fieldSize() const
+{
+    return m_fieldSize;
+}
+
+/*!
+ * rief Returns the number of sample sizes denoted by the table (including sample sizes of fragments).
+ */
+inline uint64 Mp4SampleSizeTable::sampleCount() const
+{
+    return m_entryCount + (m_sampleSizes.size() - fragmentBegin());
+}
+
+/*!
+ * rief Returns all sample sizes.
+ * 
+emarks If the table contains only one size this is the constant sample size. Sample sizes of fragments are
+ *          appended.
+ */
+inline const std::vector<uint32> &Mp4SampleSizeTable::sampleSizes() const
+{
+    return m_sampleSizes;
+}
+
+/*!
+ * rief Appends the specified \a sampleSize.
+ * 
+emarks Used for the sample sizes of track fragments which are spread over several "trun" atoms.
+ */
+inline void Mp4SampleSizeTable::append(uint32 sampleSize)
+{
+    m_sampleSizes.push_back(sampleSize);
+}
+
+/*!
+ * rief Returns the index of the first sample size of fragments within sampleSizes().
+ */
+inline std::size_t Mp4SampleSizeTable::fragmentBegin() const
+{
+    return m_constantSize ? 1 : static_cast<std::size_t>(m_entryCount);
+}
+
+class TAG_PARSER_EXPORT Mp4ChunkOffsetTable : public Mp4TableView
+{
+public:
+    Mp4ChunkOffsetTable();
+    Mp4ChunkOffsetTable(BasicFileInfo *fileInfo, std::istream *stream, uint64 tableOffset, uint64 entryCount, byte entrySize);
+
+    byte entrySize() const;
+    uint64 at(uint64 index) const;
+    void read(uint64 first, std::size_t count, uint64 *chunkOffsets) const;
+    std::vector<uint64> toVector() const;
+
+private:
+    byte m_entrySize;
+};
+
+/*!
+ * \brief Returns the size of a single chunk offset (4 for "stco" and 8 for "co64").
+ */
+inline byte Mp4ChunkOffsetTable::entrySize() const
+{
+    return m_entrySize;
+}
+
+/*!
+ * \brief The Mp4SampleToChunkEntry struct holds an entry of the "stsc" atom.
+ */
+struct TAG_PARSER_EXPORT Mp4SampleToChunkEntry
+{
+    uint32 firstChunk; /**< index of the first chunk the entry applies to (starting at 1) */
+    uint32 samplesPerChunk; /**< number of samples in each of these chunks */
+    uint32 sampleDescriptionIndex; /**< index of the sample description of the samples */
+};
+
+class TAG_PARSER_EXPORT Mp4SampleToChunkTable : public Mp4TableView
+{
+public:
+    Mp4SampleToChunkTable();
+    Mp4SampleToChunkTable(BasicFileInfo *fileInfo, std::istream *stream, uint64 tableOffset, uint64 entryCount);
+
+    Mp4SampleToChunkEntry at(uint64 index) const;
+    void read(uint64 first, std::size_t count, Mp4SampleToChunkEntry *entries) const;
+};
+
+}
+
+#endif // MEDIA_MP4SAMPLETABLE_H
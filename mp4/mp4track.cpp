@@ -9,6 +9,7 @@
 #include "../mpegaudio/mpegaudioframe.h"
 #include "../mpegaudio/mpegaudioframestream.h"
 
+#include "../mediafileinfo.h"
 #include "../exceptions.h"
 #include "../mediaformat.h"
 
@@ -18,7 +19,9 @@
 #include <c++utilities/io/bitreader.h>
 #include <c++utilities/io/catchiofailure.h>
 
+#include <algorithm>
 #include <locale>
+#include <limits>
 #include <cmath>
 
 using namespace std;
@@ -143,7 +146,8 @@ Mp4Track::Mp4Track(Mp4Atom &trakAtom) :
     m_framesPerSample(1),
     m_chunkOffsetSize(4),
     m_chunkCount(0),
-    m_sampleToChunkEntryCount(0)
+    m_sampleToChunkEntryCount(0),
+    m_promoteChunkOffsets(false)
 {}
 
 /*!
@@ -157,6 +161,47 @@ TrackType Mp4Track::type() const
     return TrackType::Mp4Track;
 }
 
+/*!
+ * \brief Returns a lazy view over the chunk offsets of the stco/co64 atom.
+ *
+ * The table is validated (notifications are added if it is truncated) but the chunk offsets are only read when
+ * accessed via the returned view. The view reads from the current input stream.
+ *
+ * \throws Throws InvalidDataException when
+ *          - there is no stream assigned.
+ *          - the header has been considered as invalid when parsing the header information.
+ *          - the stco atom is truncated.
+ * \remarks Returns an empty table if there is no stco atom.
+ */
+Mp4ChunkOffsetTable Mp4Track::chunkOffsetTable()
+{
+    static const string context("reading chunk offset table of MP4 track");
+    if(!isHeaderValid() || !m_istream) {
+        addNotification(NotificationType::Critical, "Track has not been parsed.", context);
+        throw InvalidDataException();
+    }
+    if(!m_stcoAtom) {
+        return Mp4ChunkOffsetTable();
+    }
+    // verify integrity of the chunk offset table
+    uint64 actualTableSize = m_stcoAtom->dataSize();
+    if(actualTableSize < (8 + chunkOffsetSize())) {
+        addNotification(NotificationType::Critical, "The stco atom is truncated. There are no chunk offsets present.", context);
+        throw InvalidDataException();
+    } else {
+        actualTableSize -= 8;
+    }
+    uint32 actualChunkCount = chunkCount();
+    uint64 calculatedTableSize = chunkCount() * chunkOffsetSize();
+    if(calculatedTableSize < actualTableSize) {
+        addNotification(NotificationType::Critical, "The stco atom stores more chunk offsets as denoted. The additional chunk offsets will be ignored.", context);
+    } else if(calculatedTableSize > actualTableSize) {
+        addNotification(NotificationType::Critical, "The stco atom is truncated. It stores less chunk offsets as denoted.", context);
+        actualChunkCount = floor(static_cast<double>(actualTableSize) / static_cast<double>(chunkOffsetSize()));
+    }
+    return Mp4ChunkOffsetTable(&m_trakAtom->container().fileInfo(), m_istream, m_stcoAtom->dataOffset() + 8, actualChunkCount, static_cast<byte>(chunkOffsetSize()));
+}
+
 /*!
  * \brief Reads the chunk offsets from the stco atom.
  * \returns Returns the chunk offset table for the track.
@@ -190,43 +235,8 @@ std::vector<uint64> Mp4Track::readChunkOffsetsSupportingFragments(bool parseFrag
         addNotification(NotificationType::Critical, "Track has not been parsed.", context);
         throw InvalidDataException();
     }
-    vector<uint64> offsets;
-    if(m_stcoAtom) {
-        // verify integrity of the chunk offset table
-        uint64 actualTableSize = m_stcoAtom->dataSize();
-        if(actualTableSize < (8 + chunkOffsetSize())) {
-            addNotification(NotificationType::Critical, "The stco atom is truncated. There are no chunk offsets present.", context);
-            throw InvalidDataException();
-        } else {
-            actualTableSize -= 8;
-        }
-        uint32 actualChunkCount = chunkCount();
-        uint64 calculatedTableSize = chunkCount() * chunkOffsetSize();
-        if(calculatedTableSize < actualTableSize) {
-            addNotification(NotificationType::Critical, "The stco atom stores more chunk offsets as denoted. The additional chunk offsets will be ignored.", context);
-        } else if(calculatedTableSize > actualTableSize) {
-            addNotification(NotificationType::Critical, "The stco atom is truncated. It stores less chunk offsets as denoted.", context);
-            actualChunkCount = floor(static_cast<double>(actualTableSize) / static_cast<double>(chunkOffsetSize()));
-        }
-        // read the table
-        offsets.reserve(actualChunkCount);
-        m_istream->seekg(m_stcoAtom->dataOffset() + 8);
-        switch(chunkOffsetSize()) {
-        case 4:
-            for(uint32 i = 0; i < actualChunkCount; ++i) {
-                offsets.push_back(reader().readUInt32BE());
-            }
-            break;
-        case 8:
-            for(uint32 i = 0; i < actualChunkCount; ++i) {
-                offsets.push_back(reader().readUInt64BE());
-            }
-            break;
-        default:
-            addNotification(NotificationType::Critical, "The determined chunk offset size is invalid.", context);
-            throw InvalidDataException();
-        }
-    }
+    // read the table
+    vector<uint64> offsets = chunkOffsetTable().toVector();
     // read sample offsets of fragments
     if(parseFragments) {
         uint64 totalDuration = 0;
@@ -333,8 +343,9 @@ std::vector<uint64> Mp4Track::readChunkOffsetsSupportingFragments(bool parseFrag
                                                 totalDuration += defaultSampleDuration;
                                             }
                                             if(flags & 0x000200) { // sample-size present
-                                                m_sampleSizes.push_back(reader().readUInt32BE());
-                                                m_size += m_sampleSizes.back();
+                                                const uint32 sampleSize = reader().readUInt32BE();
+                                                m_sampleSizeTable.append(sampleSize);
+                                                m_size += sampleSize;
                                             } else {
                                                 m_size += defaultSampleSize;
                                             }
@@ -348,8 +359,8 @@ std::vector<uint64> Mp4Track::readChunkOffsetsSupportingFragments(bool parseFrag
                                     }
                                 }
                             }
-                            if(m_sampleSizes.empty() && defaultSampleSize) {
-                                m_sampleSizes.push_back(defaultSampleSize);
+                            if(m_sampleSizeTable.isEmpty() && defaultSampleSize) {
+                                m_sampleSizeTable = Mp4SampleSizeTable::fromConstantSize(defaultSampleSize, 0);
                             }
                         }
                     }
@@ -361,20 +372,15 @@ std::vector<uint64> Mp4Track::readChunkOffsetsSupportingFragments(bool parseFrag
 }
 
 /*!
- * \brief Accumulates \a count sample sizes from the specified \a sampleSizeTable starting at the specified \a sampleIndex.
+ * \brief Accumulates \a count sample sizes from the sample size table starting at the specified \a sampleIndex.
  * \remarks This helper function is used by the addChunkSizeEntries() method.
  */
 uint64 Mp4Track::accumulateSampleSizes(size_t &sampleIndex, size_t count)
 {
-    if(sampleIndex + count <= m_sampleSizes.size()) {
-        uint64 sum = 0;
-        for(size_t end = sampleIndex + count; sampleIndex < end; ++sampleIndex) {
-            sum += m_sampleSizes[sampleIndex];
-        }
-        return sum;
-    } else if(m_sampleSizes.size() == 1) {
+    if(m_sampleSizeTable.isConstant() || sampleIndex + count <= m_sampleSizeTable.sampleCount()) {
+        const uint64 sum = m_sampleSizeTable.accumulate(sampleIndex, count);
         sampleIndex += count;
-        return static_cast<uint64>(m_sampleSizes.front()) * count;
+        return sum;
     } else {
         addNotification(NotificationType::Critical, "There are not as many sample size entries as samples.", "reading chunk sizes of MP4 track");
         throw InvalidDataException();
@@ -453,13 +459,17 @@ TrackHeaderInfo Mp4Track::verifyPresentTrackHeader() const
 }
 
 /*!
- * \brief Reads the sample to chunk table.
- * \returns Returns a vector with the table entries wrapped using the tuple container. The first value
- *          is an integer that gives the first chunk that share the same samples count and sample description index.
- *          The second value is sample cound and the third value the sample description index.
- * \remarks The table is not validated.
+ * \brief Returns a lazy view over the entries of the stsc atom.
+ *
+ * The size of the table is validated (notifications are added if it is truncated) but the entries are only read when
+ * accessed via the returned view. The view reads from the current input stream.
+ *
+ * \throws Throws InvalidDataException when
+ *          - there is no stream assigned.
+ *          - the header has been considered as invalid when parsing the header information.
+ *          - the stsc atom is truncated.
  */
-vector<tuple<uint32, uint32, uint32> > Mp4Track::readSampleToChunkTable()
+Mp4SampleToChunkTable Mp4Track::sampleToChunkTable()
 {
     static const string context("reading sample to chunk table of MP4 track");
     if(!isHeaderValid() || !m_istream || !m_stscAtom) {
@@ -482,16 +492,29 @@ vector<tuple<uint32, uint32, uint32> > Mp4Track::readSampleToChunkTable()
         addNotification(NotificationType::Critical, "The stsc atom is truncated. It stores less entries as denoted.", context);
         actualSampleToChunkEntryCount = floor(static_cast<double>(actualTableSize) / 12.0);
     }
-    // prepare reading
+    return Mp4SampleToChunkTable(&m_trakAtom->container().fileInfo(), m_istream, m_stscAtom->dataOffset() + 8, actualSampleToChunkEntryCount);
+}
+
+/*!
+ * \brief Reads the sample to chunk table.
+ * \returns Returns a vector with the table entries wrapped using the tuple container. The first value
+ *          is an integer that gives the first chunk that share the same samples count and sample description index.
+ *          The second value is sample cound and the third value the sample description index.
+ * \remarks The table is not validated. Use sampleToChunkTable() to avoid reading the whole table into memory.
+ */
+vector<tuple<uint32, uint32, uint32> > Mp4Track::readSampleToChunkTable()
+{
+    const Mp4SampleToChunkTable table = sampleToChunkTable();
     vector<tuple<uint32, uint32, uint32> > sampleToChunkTable;
-    sampleToChunkTable.reserve(actualSampleToChunkEntryCount);
-    m_istream->seekg(m_stscAtom->dataOffset() + 8);
-    for(uint32 i = 0; i < actualSampleToChunkEntryCount; ++i) {
-        // read entry
-        uint32 firstChunk = reader().readUInt32BE();
-        uint32 samplesPerChunk = reader().readUInt32BE();
-        uint32 sampleDescriptionIndex = reader().readUInt32BE();
-        sampleToChunkTable.emplace_back(firstChunk, samplesPerChunk, sampleDescriptionIndex);
+    sampleToChunkTable.reserve(static_cast<size_t>(table.entryCount()));
+    Mp4SampleToChunkEntry entries[0x100];
+    for(uint64 index = 0, count = table.entryCount(); index < count; ) {
+        const size_t blockSize = static_cast<size_t>(min<uint64>(0x100, count - index));
+        table.read(index, blockSize, entries);
+        for(const Mp4SampleToChunkEntry *entry = entries, *end = entries + blockSize; entry != end; ++entry) {
+            sampleToChunkTable.emplace_back(entry->firstChunk, entry->samplesPerChunk, entry->sampleDescriptionIndex);
+        }
+        index += blockSize;
     }
     return sampleToChunkTable;
 }
@@ -515,35 +538,36 @@ vector<uint64> Mp4Track::readChunkSizes()
         addNotification(NotificationType::Critical, "Track has not been parsed or is invalid.", context);
         throw InvalidDataException();
     }
-    // read sample to chunk table
-    const auto sampleToChunkTable = readSampleToChunkTable();
-    // accumulate chunk sizes from the table
+    // accumulate chunk sizes from the sample to chunk table which is read block by block
+    const Mp4SampleToChunkTable sampleToChunkTable = this->sampleToChunkTable();
     vector<uint64> chunkSizes;
-    if(!sampleToChunkTable.empty()) {
-        // prepare reading
-        auto tableIterator = sampleToChunkTable.cbegin();
+    if(const uint64 entryCount = sampleToChunkTable.entryCount()) {
         chunkSizes.reserve(m_chunkCount);
-        // read first entry
         size_t sampleIndex = 0;
-        uint32 previousChunkIndex = get<0>(*tableIterator); // the first chunk has the index 1 and not zero!
-        if(previousChunkIndex != 1) {
-            addNotification(NotificationType::Critical, "The first chunk of the first \"sample to chunk\" entry must be 1.", context);
-            previousChunkIndex = 1; // try to read the entry anyway
-        }
-        uint32 samplesPerChunk = get<1>(*tableIterator);
-        // read the following entries
-        ++tableIterator;
-        for(const auto tableEnd = sampleToChunkTable.cend(); tableIterator != tableEnd; ++tableIterator) {
-            uint32 firstChunkIndex = get<0>(*tableIterator);
-            if(firstChunkIndex > previousChunkIndex && firstChunkIndex <= m_chunkCount) {
-                addChunkSizeEntries(chunkSizes, firstChunkIndex - previousChunkIndex, sampleIndex, samplesPerChunk);
-            } else {
-                addNotification(NotificationType::Critical,
-                                "The first chunk index of a \"sample to chunk\" entry must be greather than the first chunk of the previous entry and not greather than the chunk count.", context);
-                throw InvalidDataException();
+        uint32 previousChunkIndex = 0, samplesPerChunk = 0;
+        Mp4SampleToChunkEntry entries[0x100];
+        for(uint64 index = 0; index < entryCount; ) {
+            const size_t blockSize = static_cast<size_t>(min<uint64>(0x100, entryCount - index));
+            sampleToChunkTable.read(index, blockSize, entries);
+            for(const Mp4SampleToChunkEntry *entry = entries, *end = entries + blockSize; entry != end; ++entry, ++index) {
+                if(!index) {
+                    // read first entry
+                    previousChunkIndex = entry->firstChunk; // the first chunk has the index 1 and not zero!
+                    if(previousChunkIndex != 1) {
+                        addNotification(NotificationType::Critical, "The first chunk of the first \"sample to chunk\" entry must be 1.", context);
+                        previousChunkIndex = 1; // try to read the entry anyway
+                    }
+                } else if(entry->firstChunk > previousChunkIndex && entry->firstChunk <= m_chunkCount) {
+                    // read the following entries
+                    addChunkSizeEntries(chunkSizes, entry->firstChunk - previousChunkIndex, sampleIndex, samplesPerChunk);
+                    previousChunkIndex = entry->firstChunk;
+                } else {
+                    addNotification(NotificationType::Critical,
+                                    "The first chunk index of a \"sample to chunk\" entry must be greather than the first chunk of the previous entry and not greather than the chunk count.", context);
+                    throw InvalidDataException();
+                }
+                samplesPerChunk = entry->samplesPerChunk;
             }
-            previousChunkIndex = firstChunkIndex;
-            samplesPerChunk = get<1>(*tableIterator);
         }
         if(m_chunkCount >= previousChunkIndex) {
             addChunkSizeEntries(chunkSizes, m_chunkCount + 1 - previousChunkIndex, sampleIndex, samplesPerChunk);
@@ -866,7 +890,7 @@ std::unique_ptr<Mpeg4VideoSpecificConfig> Mp4Track::parseVideoSpecificConfig(Sta
  *
  * \throws Throws std::ios_base::failure when an IO error occurs.
  *
- * \remarks This method needs to be fixed.
+ * \remarks The table is read, updated and written at once.
  */
 void Mp4Track::updateChunkOffsets(const vector<int64> &oldMdatOffsets, const vector<int64> &newMdatOffsets)
 {
@@ -876,49 +900,64 @@ void Mp4Track::updateChunkOffsets(const vector<int64> &oldMdatOffsets, const vec
     if(oldMdatOffsets.size() == 0 || oldMdatOffsets.size() != newMdatOffsets.size()) {
         throw InvalidDataException();
     }
-    static const unsigned int stcoDataBegin = 8;
-    uint64 startPos = m_stcoAtom->dataOffset() + stcoDataBegin;
-    uint64 endPos = startPos + m_stcoAtom->dataSize() - stcoDataBegin;
-    m_istream->seekg(startPos);
-    m_ostream->seekp(startPos);
-    vector<int64>::size_type i;
-    vector<int64>::size_type size;
-    uint64 currentPos = m_istream->tellg();
     switch(m_stcoAtom->id()) {
-    case Mp4AtomIds::ChunkOffset: {
-        uint32 off;
-        while((currentPos + 4) <= endPos) {
-            off = m_reader.readUInt32BE();
-            for(i = 0, size = oldMdatOffsets.size(); i < size; ++i) {
-                if(off > static_cast<uint64>(oldMdatOffsets[i])) {
-                    off += (newMdatOffsets[i] - oldMdatOffsets[i]);
-                    break;
-                }
-            }
-            m_ostream->seekp(currentPos);
-            m_writer.writeUInt32BE(off);
-            currentPos += m_istream->gcount();
-        }
-        break;
-    } case Mp4AtomIds::ChunkOffset64: {
-        uint64 off;
-        while((currentPos + 8) <= endPos) {
-            off = m_reader.readUInt64BE();
-            for(i = 0, size = oldMdatOffsets.size(); i < size; ++i) {
-                if(off > static_cast<uint64>(oldMdatOffsets[i])) {
-                    off += (newMdatOffsets[i] - oldMdatOffsets[i]);
-                    break;
-                }
-            }
-            m_ostream->seekp(currentPos);
-            m_writer.writeUInt64BE(off);
-            currentPos += m_istream->gcount();
-        }
+    case Mp4AtomIds::ChunkOffset: case Mp4AtomIds::ChunkOffset64:
         break;
-    }
     default:
         throw InvalidDataException();
     }
+    if(m_stcoAtom->dataSize() < 8) {
+        throw InvalidDataException();
+    }
+
+    // read the whole table at once
+    // note: not using chunkOffsetTable() here because the table is read from the stream which is also written to
+    static const unsigned int stcoDataBegin = 8;
+    vector<uint64> chunkOffsets(static_cast<size_t>((m_stcoAtom->dataSize() - stcoDataBegin) / chunkOffsetSize()));
+    const size_t tableSize = chunkOffsets.size() * chunkOffsetSize();
+    auto buffer = make_unique<char[]>(tableSize);
+    m_istream->seekg(m_stcoAtom->dataOffset() + stcoDataBegin);
+    m_istream->read(buffer.get(), static_cast<streamsize>(tableSize));
+    const char *entry = buffer.get();
+    if(chunkOffsetSize() == 8) {
+        for(auto &chunkOffset : chunkOffsets) {
+            chunkOffset = BE::toUInt64(entry);
+            entry += 8;
+        }
+    } else {
+        for(auto &chunkOffset : chunkOffsets) {
+            chunkOffset = BE::toUInt32(entry);
+            entry += 4;
+        }
+    }
+
+    // rebase the chunk offsets: a chunk is moved like the last "mdat"-atom starting before it
+    if(oldMdatOffsets.size() == 1) {
+        // the loop is branch-free so it can be vectorized
+        const auto oldMdatOffset = static_cast<uint64>(oldMdatOffsets.front());
+        const auto shift = static_cast<uint64>(newMdatOffsets.front() - oldMdatOffsets.front());
+        for(auto &chunkOffset : chunkOffsets) {
+            chunkOffset += chunkOffset > oldMdatOffset ? shift : 0;
+        }
+    } else {
+        // sort the "mdat"-atoms by their old offset to find the "mdat"-atom of a chunk via binary search
+        vector<pair<uint64, int64> > shifts;
+        shifts.reserve(oldMdatOffsets.size());
+        for(size_t i = 0, size = oldMdatOffsets.size(); i != size; ++i) {
+            shifts.emplace_back(static_cast<uint64>(oldMdatOffsets[i]), newMdatOffsets[i] - oldMdatOffsets[i]);
+        }
+        sort(shifts.begin(), shifts.end());
+        for(auto &chunkOffset : chunkOffsets) {
+            auto shift = lower_bound(shifts.cbegin(), shifts.cend(), chunkOffset, [] (const pair<uint64, int64> &mdat, uint64 offset) {
+                return mdat.first < offset;
+            });
+            if(shift != shifts.cbegin()) {
+                chunkOffset += static_cast<uint64>((--shift)->second);
+            }
+        }
+    }
+
+    writeChunkOffsets(chunkOffsets);
 }
 
 /*!
@@ -932,6 +971,8 @@ void Mp4Track::updateChunkOffsets(const vector<int64> &oldMdatOffsets, const vec
  *          - the size of \a chunkOffsets does not match chunkCount().
  *          - there is no atom holding these offsets.
  *          - the ID of the atom holding these offsets is not "stco" or "co64".
+ *          - the atom holding these offsets is "stco" and an offset exceeds 32-bit.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
  */
 void Mp4Track::updateChunkOffsets(const std::vector<uint64> &chunkOffsets)
 {
@@ -941,22 +982,46 @@ void Mp4Track::updateChunkOffsets(const std::vector<uint64> &chunkOffsets)
     if(chunkOffsets.size() != chunkCount()) {
         throw InvalidDataException();
     }
-    m_ostream->seekp(m_stcoAtom->dataOffset() + 8);
     switch(m_stcoAtom->id()) {
-    case Mp4AtomIds::ChunkOffset:
-        for(auto offset : chunkOffsets) {
-            m_writer.writeUInt32BE(offset);
-        }
+    case Mp4AtomIds::ChunkOffset: case Mp4AtomIds::ChunkOffset64:
+        writeChunkOffsets(chunkOffsets);
         break;
-    case Mp4AtomIds::ChunkOffset64:
-        for(auto offset : chunkOffsets) {
-            m_writer.writeUInt64BE(offset);
-        }
     default:
         throw InvalidDataException();
     }
 }
 
+/*!
+ * \brief Writes the specified \a chunkOffsets to the "stco"/"co64"-atom using a single write operation.
+ * \throws Throws InvalidDataException when the atom is "stco" and an offset exceeds 32-bit.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void Mp4Track::writeChunkOffsets(const std::vector<uint64> &chunkOffsets)
+{
+    const size_t tableSize = chunkOffsets.size() * chunkOffsetSize();
+    auto buffer = make_unique<char[]>(tableSize);
+    char *entry = buffer.get();
+    if(chunkOffsetSize() == 8) {
+        for(const auto chunkOffset : chunkOffsets) {
+            BE::getBytes(chunkOffset, entry);
+            entry += 8;
+        }
+    } else {
+        uint64 combinedOffsets = 0;
+        for(const auto chunkOffset : chunkOffsets) {
+            combinedOffsets |= chunkOffset;
+            BE::getBytes(static_cast<uint32>(chunkOffset), entry);
+            entry += 4;
+        }
+        if(combinedOffsets > numeric_limits<uint32>::max()) {
+            addNotification(NotificationType::Critical, "The chunk offsets exceed 32-bit but the track uses a \"stco\"-atom.", "updating chunk offsets of MP4 track");
+            throw InvalidDataException();
+        }
+    }
+    m_ostream->seekp(m_stcoAtom->dataOffset() + 8);
+    m_ostream->write(buffer.get(), static_cast<streamsize>(tableSize));
+}
+
 /*!
  * \brief Updates a particular chunk offset.
  * \param chunkIndex Specifies the index of the chunk offset to be updated.
@@ -1102,6 +1167,10 @@ uint64 Mp4Track::requiredSize() const
         }
         if(Mp4Atom *stblAtom = m_minfAtom->childById(Mp4AtomIds::SampleTable)) {
             size += stblAtom->totalSize();
+            // ... size difference of co64 atom (if the stco atom is promoted)
+            if(m_promoteChunkOffsets && m_stcoAtom && m_stcoAtom->id() == Mp4AtomIds::ChunkOffset && m_stcoAtom->parent() == stblAtom) {
+                size = size - m_stcoAtom->totalSize() + promotedChunkOffsetTableSize();
+            }
         }
     }
     if(!dinfAtomWritten) {
@@ -1334,7 +1403,11 @@ void Mp4Track::makeMediaInfo()
     bool stblAtomWritten = false;
     if(m_minfAtom) {
         if(Mp4Atom *stblAtom = m_minfAtom->childById(Mp4AtomIds::SampleTable)) {
-            stblAtom->copyPreferablyFromBuffer(outputStream());
+            if(m_promoteChunkOffsets && m_stcoAtom && m_stcoAtom->id() == Mp4AtomIds::ChunkOffset && m_stcoAtom->parent() == stblAtom) {
+                makeSampleTableWithPromotedChunkOffsets(*stblAtom);
+            } else {
+                stblAtom->copyPreferablyFromBuffer(outputStream());
+            }
             stblAtomWritten = true;
         }
     }
@@ -1345,6 +1418,52 @@ void Mp4Track::makeMediaInfo()
     Mp4Atom::seekBackAndWriteAtomSize(outputStream(), minfStartOffset);
 }
 
+/*!
+ * \brief Returns the total size of the "co64"-atom which replaces the "stco"-atom when promoting the chunk offsets.
+ */
+uint64 Mp4Track::promotedChunkOffsetTableSize() const
+{
+    return m_stcoAtom->dataSize() < 8 ? 16 : 16 + (m_stcoAtom->dataSize() - 8) / 4 * 8;
+}
+
+/*!
+ * \brief Copies the specified \a stblAtom replacing the "stco"-atom with a "co64"-atom holding the same chunk offsets.
+ * \remarks The chunk offsets are supposed to be updated via updateChunkOffsets() after writing the media data.
+ * \sa setPromoteChunkOffsets()
+ */
+void Mp4Track::makeSampleTableWithPromotedChunkOffsets(Mp4Atom &stblAtom)
+{
+    ostream::pos_type stblStartOffset = outputStream().tellp();
+    writer().writeUInt32BE(0); // write size later
+    writer().writeUInt32BE(Mp4AtomIds::SampleTable);
+    for(Mp4Atom *childAtom = stblAtom.firstChild(); childAtom; childAtom = childAtom->nextSibling()) {
+        childAtom->parse();
+        if(childAtom != m_stcoAtom) {
+            childAtom->copyEntirely(outputStream());
+            continue;
+        }
+        // write co64 atom
+        const uint64 co64AtomSize = promotedChunkOffsetTableSize();
+        writer().writeUInt32BE(static_cast<uint32>(co64AtomSize));
+        writer().writeUInt32BE(Mp4AtomIds::ChunkOffset64);
+        if(m_stcoAtom->dataSize() < 8) {
+            writer().writeUInt32BE(0); // version and flags
+            writer().writeUInt32BE(0); // entry count
+            continue;
+        }
+        // -> copy version, flags and entry count and extend the entries to 64-bit
+        const size_t entryCount = static_cast<size_t>((co64AtomSize - 16) / 8);
+        auto buffer = make_unique<char[]>(8 + entryCount * 8);
+        inputStream().seekg(m_stcoAtom->dataOffset());
+        inputStream().read(buffer.get(), static_cast<streamsize>(8 + entryCount * 4));
+        for(size_t i = entryCount; i; --i) {
+            BE::getBytes(static_cast<uint64>(BE::toUInt32(buffer.get() + 8 + (i - 1) * 4)), buffer.get() + 8 + (i - 1) * 8);
+        }
+        outputStream().write(buffer.get(), static_cast<streamsize>(8 + entryCount * 8));
+    }
+    Mp4Atom::seekBackAndWriteAtomSize(outputStream(), stblStartOffset);
+}
+
 /*!
  * \brief Makes the sample table (stbl atom) for the track. The data is written to the assigned output stream
  *        at the current position.
@@ -1728,7 +1847,7 @@ void Mp4Track::internalParseHeader()
     }
 
     // read stsz atom which holds the sample size table
-    m_sampleSizes.clear();
+    m_sampleSizeTable = Mp4SampleSizeTable();
     m_size = m_sampleCount = 0;
     uint64 actualSampleSizeTableSize = m_stszAtom->dataSize();
     if(actualSampleSizeTableSize < 12) {
@@ -1749,7 +1868,7 @@ void Mp4Track::internalParseHeader()
             fieldSize = 32;
         }
         if(constantSize) {
-            m_sampleSizes.push_back(constantSize);
+            m_sampleSizeTable = Mp4SampleSizeTable::fromConstantSize(constantSize, m_sampleCount);
             m_size = constantSize * m_sampleCount;
         } else {
             uint64 actualSampleCount = m_sampleCount;
@@ -1760,38 +1879,14 @@ void Mp4Track::internalParseHeader()
                 addNotification(NotificationType::Critical, "The stsz atom is truncated. It stores less entries as denoted.", context);
                 actualSampleCount = floor(static_cast<double>(actualSampleSizeTableSize) / (0.125 * fieldSize));
             }
-            m_sampleSizes.reserve(actualSampleCount);
-            uint32 i = 1;
             switch(fieldSize) {
             case 4:
-                for(; i <= actualSampleCount; i += 2) {
-                    byte val = reader.readByte();
-                    m_sampleSizes.push_back(val >> 4);
-                    m_sampleSizes.push_back(val & 0xF0);
-                    m_size += (val >> 4) + (val & 0xF0);
-                }
-                if(i <= actualSampleCount + 1) {
-                    m_sampleSizes.push_back(reader.readByte() >> 4);
-                    m_size += m_sampleSizes.back();
-                }
-                break;
             case 8:
-                for(; i <= actualSampleCount; ++i) {
-                    m_sampleSizes.push_back(reader.readByte());
-                    m_size += m_sampleSizes.back();
-                }
-                break;
             case 16:
-                for(; i <= actualSampleCount; ++i) {
-                    m_sampleSizes.push_back(reader.readUInt16BE());
-                    m_size += m_sampleSizes.back();
-                }
-                break;
             case 32:
-                for(; i <= actualSampleCount; ++i) {
-                    m_sampleSizes.push_back(reader.readUInt32BE());
-                    m_size += m_sampleSizes.back();
-                }
+                // decode the sample sizes and accumulate them to determine the size of the track
+                m_sampleSizeTable = Mp4SampleSizeTable(&m_trakAtom->container().fileInfo(), m_istream, m_stszAtom->dataOffset() + 12, actualSampleCount, static_cast<byte>(fieldSize));
+                m_size = m_sampleSizeTable.accumulate(0, actualSampleCount);
                 break;
             default:
                 addNotification(NotificationType::Critical, "The fieldsize used to store the sample sizes is not supported. The sample count and size of the track can not be determined.", context);
@@ -1903,8 +1998,9 @@ void Mp4Track::internalParseHeader()
                                             totalDuration += defaultSampleDuration;
                                         }
                                         if(flags & 0x000200) { // sample-size present
-                                            m_sampleSizes.push_back(reader.readUInt32BE());
-                                            m_size += m_sampleSizes.back();
+                                            const uint32 sampleSize = reader.readUInt32BE();
+                                            m_sampleSizeTable.append(sampleSize);
+                                            m_size += sampleSize;
                                         } else {
                                             m_size += defaultSampleSize;
                                         }
@@ -1918,8 +2014,8 @@ void Mp4Track::internalParseHeader()
                                 }
                             }
                         }
-                        if(m_sampleSizes.empty() && defaultSampleSize) {
-                            m_sampleSizes.push_back(defaultSampleSize);
+                        if(m_sampleSizeTable.isEmpty() && defaultSampleSize) {
+                            m_sampleSizeTable = Mp4SampleSizeTable::fromConstantSize(defaultSampleSize, 0);
                         }
                     }
                 }
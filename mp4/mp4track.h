@@ -1,6 +1,8 @@
 #ifndef MP4TRACK_H
 #define MP4TRACK_H
 
+#include "./mp4sampletable.h"
+
 #include "../abstracttrack.h"
 
 #include <vector>
@@ -127,6 +129,7 @@ public:
     // getter methods specific for MP4 tracks
     Mp4Atom &trakAtom();
     const std::vector<uint32> &sampleSizes() const;
+    const Mp4SampleSizeTable &sampleSizeTable() const;
     unsigned int chunkOffsetSize() const;
     uint32 chunkCount() const;
     uint32 sampleToChunkEntryCount() const;
@@ -139,12 +142,16 @@ public:
     static std::unique_ptr<Mpeg4VideoSpecificConfig> parseVideoSpecificConfig(StatusProvider &statusProvider, IoUtilities::BinaryReader &reader, uint64 startOffset, uint64 size);
 
     // methods to read the "index" (chunk offsets and sizes)
+    Mp4ChunkOffsetTable chunkOffsetTable();
+    Mp4SampleToChunkTable sampleToChunkTable();
     std::vector<uint64> readChunkOffsets();
     std::vector<uint64> readChunkOffsetsSupportingFragments(bool parseFragments = false);
     std::vector<std::tuple<uint32, uint32, uint32> > readSampleToChunkTable();
     std::vector<uint64> readChunkSizes();
 
     // methods to make the track header
+    bool isPromotingChunkOffsets() const;
+    void setPromoteChunkOffsets(bool promoteChunkOffsets);
     void bufferTrackAtoms();
     uint64 requiredSize() const;
     void makeTrack();
@@ -168,6 +175,9 @@ private:
     uint64 accumulateSampleSizes(size_t &sampleIndex, size_t count);
     void addChunkSizeEntries(std::vector<uint64> &chunkSizeTable, size_t count, size_t &sampleIndex, uint32 sampleCount);
     TrackHeaderInfo verifyPresentTrackHeader() const;
+    uint64 promotedChunkOffsetTableSize() const;
+    void makeSampleTableWithPromotedChunkOffsets(Mp4Atom &stblAtom);
+    void writeChunkOffsets(const std::vector<uint64> &chunkOffsets);
 
     Mp4Atom *m_trakAtom;
     Mp4Atom *m_tkhdAtom;
@@ -181,10 +191,11 @@ private:
     Mp4Atom *m_stcoAtom;
     Mp4Atom *m_stszAtom;
     uint16 m_framesPerSample;
-    std::vector<uint32> m_sampleSizes;
+    Mp4SampleSizeTable m_sampleSizeTable;
     unsigned int m_chunkOffsetSize;
     uint32 m_chunkCount;
     uint32 m_sampleToChunkEntryCount;
+    bool m_promoteChunkOffsets;
     std::unique_ptr<Mpeg4ElementaryStreamInfo> m_esInfo;
     std::unique_ptr<AvcConfiguration> m_avcConfig;
 };
@@ -198,15 +209,24 @@ inline Mp4Atom &Mp4Track::trakAtom()
 }
 
 /*!
- * \brief Returns the sample size table for the track.
- * \remarks If the table contains only one size this is the constant
- *          sample size.
- * \remarks The table is empty if the track denotes 64-bit sample sizes.
- * \sa sampleSizes64()
+ * \brief Returns the sample size table of the track.
+ * \remarks The table is populated when parsing the header and can still be used after the file has been closed.
+ * \sa sampleSizes()
+ */
+inline const Mp4SampleSizeTable &Mp4Track::sampleSizeTable() const
+{
+    return m_sampleSizeTable;
+}
+
+/*!
+ * \brief Returns the sample sizes of the track.
+ * \remarks If the table contains only one size this is the constant sample size.
+ * \remarks The sample sizes are read when parsing the header and can still be accessed after the file has been
+ *          closed.
  */
 inline const std::vector<uint32> &Mp4Track::sampleSizes() const
 {
-    return m_sampleSizes;
+    return m_sampleSizeTable.sampleSizes();
 }
 
 /*!
@@ -235,6 +255,28 @@ inline uint32 Mp4Track::sampleToChunkEntryCount() const
     return m_sampleToChunkEntryCount;
 }
 
+/*!
+ * \brief Returns whether the "stco"-atom is going to be replaced by a "co64"-atom when making the track.
+ * \sa setPromoteChunkOffsets()
+ */
+inline bool Mp4Track::isPromotingChunkOffsets() const
+{
+    return m_promoteChunkOffsets;
+}
+
+/*!
+ * \brief Sets whether the "stco"-atom is going to be replaced by a "co64"-atom when making the track.
+ *
+ * This is required when the chunk offsets exceed 32-bit after rewriting the file. The "co64"-atom holds the
+ * original chunk offsets which are supposed to be updated via updateChunkOffsets() after writing the media data.
+ *
+ * \remarks Has no effect if the track already uses a "co64"-atom. Affects requiredSize().
+ */
+inline void Mp4Track::setPromoteChunkOffsets(bool promoteChunkOffsets)
+{
+    m_promoteChunkOffsets = promoteChunkOffsets;
+}
+
 /*!
  * \brief Returns information about the MPEG-4 elementary stream.
  * \remarks
@@ -2,10 +2,14 @@
 #include "./mp4container.h"
 #include "./mp4ids.h"
 
+#include "../mediafileinfo.h"
+
 #include <c++utilities/conversion/stringconversion.h>
 #include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/io/binaryreader.h>
 
+#include <algorithm>
+
 using namespace std;
 using namespace ConversionUtilities;
 
@@ -58,15 +62,22 @@ void Mpeg4Descriptor::internalParse()
         addNotification(NotificationType::Critical, "Descriptor is smaller than 2 byte and hence invalid. The maximum size within the encloding element is " % numberToString(maxTotalSize()) + '.', "parsing MPEG-4 descriptor");
         throw TruncatedDataException();
     }
-    stream().seekg(startOffset());
+    // obtain header (directly from memory mapping or read cache if possible)
+    const uint64 headerBytesAvailable = min<uint64>(maxTotalSize(), 9);
+    char headerBuf[9];
+    const char *const header = fetchData(startOffset(), headerBytesAvailable, headerBuf);
     // read ID
     m_idLength = m_sizeLength = 1;
-    m_id = reader().readByte();
+    m_id = static_cast<byte>(header[0]);
     // read data size
-    byte tmp = reader().readByte();
+    byte tmp = static_cast<byte>(header[1]);
     m_dataSize = tmp & 0x7F;
     while(tmp & 0x80) {
-        m_dataSize = (m_dataSize << 7) | ((tmp = reader().readByte()) & 0x7F);
+        if(m_idLength + m_sizeLength >= headerBytesAvailable) {
+            addNotification(NotificationType::Critical, "Size denotation of descriptor is truncated or too long.", parsingContext());
+            throw TruncatedDataException();
+        }
+        m_dataSize = (m_dataSize << 7) | ((tmp = static_cast<byte>(header[m_idLength + m_sizeLength])) & 0x7F);
         ++m_sizeLength;
     }
     // check whether the denoted data size exceeds the available data size
@@ -74,16 +85,16 @@ void Mpeg4Descriptor::internalParse()
         addNotification(NotificationType::Warning, "The descriptor seems to be truncated; unable to parse siblings of that ", parsingContext());
         m_dataSize = maxTotalSize(); // using max size instead
     }
-    m_firstChild.reset();
+    m_firstChild = nullptr;
     implementationType *sibling = nullptr;
     if(totalSize() < maxTotalSize()) {
         if(parent()) {
-            sibling = new implementationType(*(parent()), startOffset() + totalSize());
+            sibling = createElement(*(parent()), startOffset() + totalSize());
         } else {
-            sibling = new implementationType(container(), startOffset() + totalSize(), maxTotalSize() - totalSize());
+            sibling = createElement(container(), startOffset() + totalSize(), maxTotalSize() - totalSize());
         }
     }
-    m_nextSibling.reset(sibling);
+    m_nextSibling = sibling;
 }
 
 }
@@ -0,0 +1,419 @@
+#include "./mpegaudioframescanner.h"
+
+#include "../basicfileinfo.h"
+#include "../exceptions.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/conversion/stringbuilder.h>
+#include <c++utilities/io/catchiofailure.h>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace ChronoUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/// \brief The bitrates (in kbit/s) by MPEG version (1 or 2/2.5), layer and bitrate index.
+static constexpr uint16 bitrateTable[2][3][15] = {
+    {{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448},
+     {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384},
+     {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320}},
+    {{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256},
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160},
+     {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}}
+};
+
+/// \brief The sampling frequencies of MPEG-1 by sampling frequency index.
+static constexpr uint32 samplingFrequencyTable[3] = {44100, 48000, 32000};
+
+/// \brief The header bits which must not change between the frames of a stream (sync word, version, layer and sampling frequency).
+static constexpr uint32 constantHeaderMask = 0xFFFE0C00u;
+
+/*!
+ * \class Media::MpegAudioFrameScanner
+ * \brief The MpegAudioFrameScanner class determines the exact frame count, duration and bitrate of an MPEG audio stream
+ *        by walking all frames.
+ *
+ * MpegAudioFrameStream::internalParseHeader() only parses the first frame and estimates the duration from the Xing
+ * header or the bitrate of the first frame. This is wrong for VBR files without Xing header and for files containing
+ * junk. This class walks the frame headers instead: Frames are located by searching the sync word (using SSE2 if
+ * available, see findSync()) and are only accepted if the header is valid and followed by another valid header.
+ * Subsequent frames are found by computing the frame length from the header. Invalid data between frames is skipped
+ * (with a warning).
+ *
+ * Big files are split into ranges which are scanned by several threads. Each range is scanned from the first frame
+ * found within it. When the results are merged, the first frame of a range is compared with the end of the preceding
+ * range; if they do not match (e.g. because a worker synchronized to a false sync word) the range is scanned again
+ * starting at the end of the preceding range. Threads read directly from the memory mapping if the file is mapped and
+ * open their own stream otherwise (see RangeWorkers).
+ *
+ * Besides the statistics, a seek table with an entry every seekPointInterval() frames is determined.
+ *
+ * \sa MpegAudioFrameStream::scanFrames()
+ */
+
+/*!
+ * \brief Constructs a new scanner for the frames between \a startOffset and \a endOffset of the specified \a fileInfo.
+ * \remarks The \a endOffset should exclude trailing tags (eg. ID3v1).
+ */
+MpegAudioFrameScanner::MpegAudioFrameScanner(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset) :
+    m_fileInfo(fileInfo),
+    m_startOffset(startOffset),
+    m_endOffset(max(startOffset, endOffset)),
+    m_threadCount(0),
+    m_seekPointInterval(64),
+    m_frameCount(0),
+    m_sampleCount(0),
+    m_dataSize(0),
+    m_samplingFrequency(0),
+    m_maxBitrate(0)
+{}
+
+/*!
+ * \brief Constructs an empty result.
+ */
+MpegAudioFrameScanner::RangeResult::RangeResult() :
+    firstFrameOffset(0),
+    endOffset(0),
+    endsWithFrame(false),
+    firstHeader(0),
+    frameCount(0),
+    sampleCount(0),
+    dataSize(0),
+    maxBitrate(0)
+{}
+
+/*!
+ * \brief Returns the index of the first sync word (11 set bits) within the specified \a data of \a size bytes.
+ * \returns Returns \a size if no sync word could be found. A sync word is only found if both of its bytes are within
+ *          the specified range.
+ */
+size_t MpegAudioFrameScanner::findSync(const char *data, size_t size)
+{
+    size_t index = 0;
+#if defined(__SSE2__)
+    // compare 16 bytes at once: the first byte must be 0xFF and the upper 3 bits of the following byte must be set
+    const __m128i allSet = _mm_set1_epi8(static_cast<char>(0xFF));
+    const __m128i lowerBits = _mm_set1_epi8(0x1F);
+    for(; size - index > 16; index += 16) {
+        const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index));
+        const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + index + 1));
+        const int matches = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, allSet), _mm_cmpeq_epi8(_mm_or_si128(second, lowerBits), allSet)));
+        if(matches) {
+            return index + static_cast<size_t>(__builtin_ctz(static_cast<unsigned int>(matches)));
+        }
+    }
+#endif
+    for(; index + 1 < size; ++index) {
+        if(static_cast<byte>(data[index]) == 0xFF && (static_cast<byte>(data[index + 1]) & 0xE0) == 0xE0) {
+            return index;
+        }
+    }
+    return size;
+}
+
+/*!
+ * \brief Returns the bitrate (in kbit/s) denoted by the specified frame \a header or zero if the header is invalid.
+ * \remarks Free format frames are considered invalid.
+ */
+uint32 MpegAudioFrameScanner::frameBitrate(uint32 header)
+{
+    const uint32 version = (header >> 19) & 0x3, layer = (header >> 17) & 0x3, bitrateIndex = (header >> 12) & 0xF;
+    if((header & 0xFFE00000u) != 0xFFE00000u || version == 1 || layer == 0 || bitrateIndex == 0xF) {
+        return 0;
+    }
+    return bitrateTable[version == 3 ? 0 : 1][3 - layer][bitrateIndex];
+}
+
+/*!
+ * \brief Returns the sampling frequency denoted by the specified frame \a header or zero if the header is invalid.
+ */
+uint32 MpegAudioFrameScanner::frameSamplingFrequency(uint32 header)
+{
+    const uint32 version = (header >> 19) & 0x3, samplingFrequencyIndex = (header >> 10) & 0x3;
+    if(version == 1 || samplingFrequencyIndex == 3) {
+        return 0;
+    }
+    // MPEG-2 uses half and MPEG-2.5 a quarter of the MPEG-1 sampling frequencies
+    return samplingFrequencyTable[samplingFrequencyIndex] >> (version == 3 ? 0 : (version == 2 ? 1 : 2));
+}
+
+/*!
+ * \brief Returns the offset of the Xing/Info header within a layer III frame with the specified \a header.
+ * \remarks The Xing/Info header follows the side information whose size depends on the version and the channel mode.
+ */
+uint32 MpegAudioFrameScanner::xingHeaderOffset(uint32 header)
+{
+    const bool mpeg1 = ((header >> 19) & 0x3) == 3, mono = ((header >> 6) & 0x3) == 3, crc = !((header >> 16) & 0x1);
+    return 4 + (crc ? 2 : 0) + (mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17));
+}
+
+/*!
+ * \brief Returns the number of samples of a frame with the specified \a header.
+ */
+uint32 MpegAudioFrameScanner::frameSampleCount(uint32 header)
+{
+    switch((header >> 17) & 0x3) {
+    case 3: // layer I
+        return 384;
+    case 2: // layer II
+        return 1152;
+    case 1: // layer III
+        return ((header >> 19) & 0x3) == 3 ? 1152 : 576;
+    default:
+        return 0;
+    }
+}
+
+/*!
+ * \brief Returns the size of the frame (including the header) with the specified \a header or zero if the header is
+ *        invalid.
+ */
+uint32 MpegAudioFrameScanner::frameSize(uint32 header)
+{
+    const uint32 bitrate = frameBitrate(header), samplingFrequency = frameSamplingFrequency(header);
+    if(!bitrate || !samplingFrequency || (header & 0x3) == 2) {
+        return 0;
+    }
+    const uint32 padding = (header >> 9) & 0x1;
+    switch((header >> 17) & 0x3) {
+    case 3: // layer I: slots of 4 bytes
+        return (12000 * bitrate / samplingFrequency + padding) * 4;
+    case 2: // layer II
+        return 144000 * bitrate / samplingFrequency + padding;
+    default: // layer III
+        return (((header >> 19) & 0x3) == 3 ? 144000 : 72000) * bitrate / samplingFrequency + padding;
+    }
+}
+
+/*!
+ * \brief Scans all frames and determines the statistics and the seek table.
+ *
+ * Problems are added as notifications. IO errors while scanning are added as critical notifications; the frames
+ * scanned so far are taken into account.
+ */
+void MpegAudioFrameScanner::scan()
+{
+    static const string context("scanning MPEG audio frames");
+    invalidateStatus();
+    m_frameCount = m_sampleCount = m_dataSize = 0;
+    m_samplingFrequency = m_maxBitrate = 0;
+    m_seekTable.clear();
+
+    // scan ranges using several threads
+    const RangeWorkers workers(m_fileInfo, m_startOffset, m_endOffset, m_threadCount);
+    const size_t rangeCount = workers.rangeCount();
+    vector<RangeResult> results(rangeCount);
+    NotificationList workerNotifications;
+    workers.run([&] (RangeReader &reader, size_t rangeIndex) {
+        scanRange(reader, workers.rangeBegin(rangeIndex), workers.rangeBegin(rangeIndex + 1), false, results[rangeIndex]);
+    }, context, workerNotifications);
+    addNotifications(workerNotifications);
+
+    // merge results; re-scan ranges which do not continue where the preceding range ends
+    try {
+        RangeReader reader = workers.reader();
+        const RangeResult *previous = nullptr;
+        uint32 firstHeader = 0;
+        for(size_t rangeIndex = 0; rangeIndex != rangeCount; ++rangeIndex) {
+            RangeResult &result = results[rangeIndex];
+            if(previous && previous->endsWithFrame && (!result.frameCount || result.firstFrameOffset != previous->endOffset)) {
+                const uint64 end = workers.rangeBegin(rangeIndex + 1);
+                result = RangeResult();
+                if(previous->endOffset < end) {
+                    scanRange(reader, previous->endOffset, end, true, result);
+                } else {
+                    // the frames of the preceding range already cover this range
+                    result.endOffset = previous->endOffset;
+                    result.endsWithFrame = true;
+                }
+            }
+            addNotifications(result.notifications);
+            if(result.frameCount) {
+                if(!firstHeader) {
+                    firstHeader = result.firstHeader;
+                    m_samplingFrequency = frameSamplingFrequency(firstHeader);
+                } else if((firstHeader & constantHeaderMask) != (result.firstHeader & constantHeaderMask)) {
+                    addNotification(NotificationType::Warning, argsToString("The MPEG version, layer or sampling frequency changes at ", result.firstFrameOffset, '.'), context);
+                }
+                for(const MpegAudioSeekPoint &seekPoint : result.seekPoints) {
+                    m_seekTable.emplace_back(MpegAudioSeekPoint{seekPoint.offset, m_sampleCount + seekPoint.sampleIndex});
+                }
+                m_frameCount += result.frameCount;
+                m_sampleCount += result.sampleCount;
+                m_dataSize += result.dataSize;
+                m_maxBitrate = max(m_maxBitrate, result.maxBitrate);
+            }
+            previous = &result;
+        }
+    } catch(...) {
+        addNotification(NotificationType::Critical, catchIoFailure(), context);
+    }
+    if(!m_frameCount) {
+        addNotification(NotificationType::Critical, "No MPEG audio frames found.", context);
+    }
+}
+
+/*!
+ * \brief Returns the duration determined by the last scan.
+ */
+TimeSpan MpegAudioFrameScanner::duration() const
+{
+    return m_samplingFrequency ? TimeSpan::fromSeconds(static_cast<double>(m_sampleCount) / m_samplingFrequency) : TimeSpan();
+}
+
+/*!
+ * \brief Returns the average bitrate (in kbit/s) determined by the last scan.
+ */
+double MpegAudioFrameScanner::averageBitrate() const
+{
+    return m_sampleCount && m_samplingFrequency
+            ? static_cast<double>(m_dataSize) * 0.008 / (static_cast<double>(m_sampleCount) / m_samplingFrequency)
+            : 0.0;
+}
+
+/*!
+ * \brief Scans the frames starting within the range from \a begin to \a end.
+ *
+ * If \a synchronized is set, \a begin is expected to be the start of a frame. Otherwise the range is scanned from the
+ * first frame found within it (see findFrame()).
+ *
+ * \remarks This method is called by the workers and must not alter the scanner.
+ */
+void MpegAudioFrameScanner::scanRange(RangeReader &reader, uint64 begin, uint64 end, bool synchronized, RangeResult &result) const
+{
+    static const string context("scanning MPEG audio frames");
+    uint64 offset = begin, invalidDataOffset = begin;
+    uint32 expectedHeader = 0;
+    result.endOffset = begin;
+    while(offset < end) {
+        if(!synchronized) {
+            const uint64 frameOffset = findFrame(reader, offset, end);
+            if(frameOffset >= end) {
+                break;
+            }
+            if(frameOffset != invalidDataOffset && (result.frameCount || invalidDataOffset == m_startOffset)) {
+                result.notifications.emplace_back(NotificationType::Warning, argsToString("Skipped ", frameOffset - invalidDataOffset, " bytes of invalid data at ", invalidDataOffset, '.'), context);
+            }
+            offset = frameOffset;
+            synchronized = true;
+        }
+        const uint32 header = m_endOffset - offset >= 4 ? BE::toUInt32(reader.read(offset, 4)) : 0;
+        const uint32 size = frameSize(header);
+        if(!size || size > m_endOffset - offset || (expectedHeader && (header & constantHeaderMask) != expectedHeader)) {
+            // no (consistent) frame where one is expected -> search for the next frame
+            result.endsWithFrame = synchronized = false;
+            expectedHeader = 0;
+            invalidDataOffset = offset++;
+            continue;
+        }
+        if(!expectedHeader) {
+            expectedHeader = header & constantHeaderMask;
+            if(result.frameCount && expectedHeader != (result.firstHeader & constantHeaderMask)) {
+                result.notifications.emplace_back(NotificationType::Warning, argsToString("The MPEG version, layer or sampling frequency changes at ", offset, '.'), context);
+            }
+        }
+        // skip a leading Xing/Info/VBRI frame (it contains no audio data)
+        if(offset != m_startOffset || !isInfoFrame(reader, offset, header)) {
+            if(!result.frameCount) {
+                result.firstFrameOffset = offset;
+                result.firstHeader = header;
+            }
+            if(result.frameCount % m_seekPointInterval == 0) {
+                result.seekPoints.emplace_back(MpegAudioSeekPoint{offset, result.sampleCount});
+            }
+            ++result.frameCount;
+            result.sampleCount += frameSampleCount(header);
+            result.dataSize += size;
+            result.maxBitrate = max(result.maxBitrate, frameBitrate(header));
+        }
+        result.endOffset = offset += size;
+        result.endsWithFrame = true;
+    }
+}
+
+/*!
+ * \brief Returns the offset of the first frame starting at or after \a offset and before \a end.
+ *
+ * A frame is only considered found if its header is followed by another consistent frame header (or the end of the
+ * stream). This prevents synchronizing to sync words which are part of the frame data.
+ *
+ * \returns Returns \a end if no frame could be found.
+ */
+uint64 MpegAudioFrameScanner::findFrame(RangeReader &reader, uint64 offset, uint64 end) const
+{
+    while(offset < end && m_endOffset - offset >= 4) {
+        // the sync word must start before the end of the range but might end after it
+        const size_t available = static_cast<size_t>(min<uint64>(RangeReader::bufferSize, m_endOffset - offset));
+        const size_t searchSize = static_cast<size_t>(min<uint64>(available, end - offset + 1));
+        const char *const data = reader.read(offset, available);
+        const size_t index = findSync(data, searchSize);
+        if(index == searchSize) {
+            // keep the last byte since it might be the first byte of a sync word
+            offset += max<size_t>(searchSize - 1, 1);
+            continue;
+        }
+        if(isFrameSequence(reader, offset + index)) {
+            return offset + index;
+        }
+        offset += index + 1;
+    }
+    return end;
+}
+
+/*!
+ * \brief Returns whether a valid frame header at the specified \a offset is followed by another consistent frame
+ *        header or the end of the stream.
+ */
+bool MpegAudioFrameScanner::isFrameSequence(RangeReader &reader, uint64 offset) const
+{
+    if(m_endOffset - offset < 4) {
+        return false;
+    }
+    const uint32 header = BE::toUInt32(reader.read(offset, 4));
+    const uint32 size = frameSize(header);
+    if(!size || size > m_endOffset - offset) {
+        return false;
+    }
+    const uint64 nextOffset = offset + size;
+    if(nextOffset == m_endOffset) {
+        return true;
+    }
+    if(m_endOffset - nextOffset < 4) {
+        return false;
+    }
+    const uint32 nextHeader = BE::toUInt32(reader.read(nextOffset, 4));
+    return frameSize(nextHeader) && (header & constantHeaderMask) == (nextHeader & constantHeaderMask);
+}
+
+/*!
+ * \brief Returns whether the layer III frame with the specified \a header at the specified \a offset contains a
+ *        Xing, Info or VBRI header instead of audio data.
+ */
+bool MpegAudioFrameScanner::isInfoFrame(RangeReader &reader, uint64 offset, uint32 header) const
+{
+    if(((header >> 17) & 0x3) != 1) {
+        return false;
+    }
+    const uint64 xingOffset = xingHeaderOffset(header);
+    // the VBRI header is always located 32 bytes after the header
+    const uint64 vbriOffset = 4 + 32;
+    const uint64 available = min<uint64>(frameSize(header), m_endOffset - offset);
+    if(available >= xingOffset + 4) {
+        const char *const data = reader.read(offset + xingOffset, 4);
+        if(!memcmp(data, "Xing", 4) || !memcmp(data, "Info", 4)) {
+            return true;
+        }
+    }
+    return available >= vbriOffset + 4 && !memcmp(reader.read(offset + vbriOffset, 4), "VBRI", 4);
+}
+
+}
@@ -0,0 +1,178 @@
+#ifndef MEDIA_MPEGAUDIOFRAMESCANNER_H
+#define MEDIA_MPEGAUDIOFRAMESCANNER_H
+
+#include "../rangereader.h"
+#include "../statusprovider.h"
+
+#include <c++utilities/chrono/timespan.h>
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Media {
+
+class BasicFileInfo;
+
+/*!
+ * \brief The MpegAudioSeekPoint struct holds the offset of an MPEG audio frame and the number of samples preceding it.
+ */
+struct TAG_PARSER_EXPORT MpegAudioSeekPoint
+{
+    uint64 offset; /**< start offset of the frame */
+    uint64 sampleIndex; /**< number of samples of all frames before the frame */
+};
+
+class TAG_PARSER_EXPORT MpegAudioFrameScanner : public StatusProvider
+{
+public:
+    MpegAudioFrameScanner(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset);
+
+    std::size_t threadCount() const;
+    void setThreadCount(std::size_t threadCount);
+    uint32 seekPointInterval() const;
+    void setSeekPointInterval(uint32 seekPointInterval);
+    void scan();
+    uint64 frameCount() const;
+    uint64 sampleCount() const;
+    uint64 dataSize() const;
+    uint32 samplingFrequency() const;
+    ChronoUtilities::TimeSpan duration() const;
+    double averageBitrate() const;
+    uint32 maxBitrate() const;
+    const std::vector<MpegAudioSeekPoint> &seekTable() const;
+
+    static std::size_t findSync(const char *data, std::size_t size);
+    static uint32 frameSize(uint32 header);
+    static uint32 frameSampleCount(uint32 header);
+    static uint32 frameBitrate(uint32 header);
+    static uint32 frameSamplingFrequency(uint32 header);
+    static uint32 xingHeaderOffset(uint32 header);
+
+private:
+    /// \brief The private RangeResult struct holds the frames found within a range of the file.
+    struct RangeResult
+    {
+        RangeResult();
+        uint64 firstFrameOffset;
+        uint64 endOffset;
+        bool endsWithFrame;
+        uint32 firstHeader;
+        uint64 frameCount;
+        uint64 sampleCount;
+        uint64 dataSize;
+        uint32 maxBitrate;
+        std::vector<MpegAudioSeekPoint> seekPoints;
+        NotificationList notifications;
+    };
+
+    void scanRange(RangeReader &reader, uint64 begin, uint64 end, bool synchronized, RangeResult &result) const;
+    uint64 findFrame(RangeReader &reader, uint64 offset, uint64 end) const;
+    bool isFrameSequence(RangeReader &reader, uint64 offset) const;
+    bool isInfoFrame(RangeReader &reader, uint64 offset, uint32 header) const;
+
+    BasicFileInfo &m_fileInfo;
+    uint64 m_startOffset;
+    uint64 m_endOffset;
+    std::size_t m_threadCount;
+    uint32 m_seekPointInterval;
+    uint64 m_frameCount;
+    uint64 m_sampleCount;
+    uint64 m_dataSize;
+    uint32 m_samplingFrequency;
+    uint32 m_maxBitrate;
+    std::vector<MpegAudioSeekPoint> m_seekTable;
+};
+
+/*!
+ * \brief Returns the number of threads used for scanning.
+ * \remarks Zero (the default) means the number of hardware threads is used.
+ */
+inline std::size_t MpegAudioFrameScanner::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Sets the number of threads used for scanning.
+ * \sa threadCount()
+ */
+inline void MpegAudioFrameScanner::setThreadCount(std::size_t threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+/*!
+ * \brief Returns the number of frames between the entries of the seekTable().
+ * \remarks The default is 64 frames (roughly 1.7 seconds for 1152 samples per frame at 44.1 kHz).
+ */
+inline uint32 MpegAudioFrameScanner::seekPointInterval() const
+{
+    return m_seekPointInterval;
+}
+
+/*!
+ * \brief Sets the number of frames between the entries of the seekTable().
+ * \remarks The interval must not be zero.
+ */
+inline void MpegAudioFrameScanner::setSeekPointInterval(uint32 seekPointInterval)
+{
+    m_seekPointInterval = seekPointInterval ? seekPointInterval : 1;
+}
+
+/*!
+ * \brief Returns the number of audio frames found by the last scan.
+ * \remarks A leading Xing/Info/VBRI frame is not taken into account.
+ */
+inline uint64 MpegAudioFrameScanner::frameCount() const
+{
+    return m_frameCount;
+}
+
+/*!
+ * \brief Returns the number of samples of all frames found by the last scan.
+ */
+inline uint64 MpegAudioFrameScanner::sampleCount() const
+{
+    return m_sampleCount;
+}
+
+/*!
+ * \brief Returns the number of bytes of all frames found by the last scan.
+ */
+inline uint64 MpegAudioFrameScanner::dataSize() const
+{
+    return m_dataSize;
+}
+
+/*!
+ * \brief Returns the sampling frequency of the first frame found by the last scan or zero if no frames have been found.
+ */
+inline uint32 MpegAudioFrameScanner::samplingFrequency() const
+{
+    return m_samplingFrequency;
+}
+
+/*!
+ * \brief Returns the highest bitrate (in kbit/s) of the frames found by the last scan.
+ */
+inline uint32 MpegAudioFrameScanner::maxBitrate() const
+{
+    return m_maxBitrate;
+}
+
+/*!
+ * \brief Returns the seek table determined by the last scan.
+ *
+ * The table contains an entry for the first frame of each interval of seekPointInterval() frames. For multi-threaded
+ * scans the intervals start at the beginning of each range scanned by a worker.
+ */
+inline const std::vector<MpegAudioSeekPoint> &MpegAudioFrameScanner::seekTable() const
+{
+    return m_seekTable;
+}
+
+}
+
+#endif // MEDIA_MPEGAUDIOFRAMESCANNER_H
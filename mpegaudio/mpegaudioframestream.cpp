@@ -29,6 +29,36 @@ void MpegAudioFrameStream::addInfo(const MpegAudioFrame &frame, AbstractTrack &t
     track.m_samplingFrequency = frame.samplingFrequency();
 }
 
+/*!
+ * \brief Determines the exact sample count, duration and bitrate by walking all frames of the stream.
+ *
+ * The header must have been parsed before. The frames between the start offset and the end of the stream (excluding
+ * an ID3v1 tag) of the specified \a fileInfo are scanned using \a threadCount threads (zero means the number of
+ * hardware threads). This also determines the seekTable().
+ *
+ * Problems are added as notifications. The values determined when parsing the header are kept if no frames could be
+ * found.
+ *
+ * \sa MpegAudioFrameScanner
+ */
+void MpegAudioFrameStream::scanFrames(BasicFileInfo &fileInfo, std::size_t threadCount)
+{
+    MpegAudioFrameScanner scanner(fileInfo, m_startOffset, m_startOffset + m_size);
+    scanner.setThreadCount(threadCount);
+    scanner.scan();
+    addNotifications(scanner);
+    if(!scanner.frameCount()) {
+        return;
+    }
+    m_sampleCount = scanner.sampleCount();
+    m_size = scanner.dataSize();
+    m_duration = scanner.duration();
+    m_bitrate = scanner.averageBitrate();
+    m_maxBitrate = scanner.maxBitrate();
+    m_bytesPerSecond = static_cast<uint32>(m_bitrate * 125);
+    m_seekTable = scanner.seekTable();
+}
+
 void MpegAudioFrameStream::internalParseHeader()
 {
     static const string context("parsing MPEG audio frame header");
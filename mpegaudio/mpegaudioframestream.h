@@ -2,14 +2,18 @@
 #define MPEGAUDIOFRAMESTREAM_H
 
 #include "./mpegaudioframe.h"
+#include "./mpegaudioframescanner.h"
 
 #include "../abstracttrack.h"
 
 #include <list>
+#include <vector>
 
 namespace Media
 {
 
+class BasicFileInfo;
+
 class TAG_PARSER_EXPORT MpegAudioFrameStream : public AbstractTrack
 {
 public:
@@ -17,6 +21,8 @@ public:
     ~MpegAudioFrameStream();
 
     TrackType type() const;
+    void scanFrames(BasicFileInfo &fileInfo, std::size_t threadCount = 0);
+    const std::vector<MpegAudioSeekPoint> &seekTable() const;
 
     static void addInfo(const MpegAudioFrame &frame, AbstractTrack &track);
 
@@ -25,6 +31,7 @@ protected:
 
 private:
     std::list<MpegAudioFrame> m_frames;
+    std::vector<MpegAudioSeekPoint> m_seekTable;
 };
 
 /*!
@@ -44,6 +51,15 @@ inline TrackType MpegAudioFrameStream::type() const
     return TrackType::MpegAudioFrameStream;
 }
 
+/*!
+ * \brief Returns the seek table determined by the last call of scanFrames().
+ * \sa MpegAudioFrameScanner::seekTable()
+ */
+inline const std::vector<MpegAudioSeekPoint> &MpegAudioFrameStream::seekTable() const
+{
+    return m_seekTable;
+}
+
 }
 
 #endif // MPEGAUDIOFRAMESTREAM_H
@@ -0,0 +1,360 @@
+#include "./mpegaudioxingheadermaker.h"
+#include "./mpegaudioframescanner.h"
+
+#include "../exceptions.h"
+
+#include <c++utilities/conversion/binaryconversion.h>
+#include <c++utilities/io/copy.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/// \brief The header bits which must not change between the frames of a stream (sync word, version, layer and sampling frequency).
+static constexpr uint32 constantHeaderMask = 0xFFFE0C00u;
+
+/// \brief The number of bytes at the beginning of the stream which are searched for the first frame.
+static constexpr uint64 probeSize = 0x10000;
+
+/// \brief The number of bytes copied at once.
+static constexpr size_t copyBufferSize = 0x10000;
+
+/// \brief The size of the frame count, byte count and TOC fields following the Xing/Info tag and the flags.
+static constexpr uint32 fieldsSize = 4 + 4 + 100;
+
+/// \brief The maximum number of frame offsets kept to compute the TOC (every n-th frame is recorded).
+static constexpr size_t maxFrameOffsetCount = 0x2000;
+
+/*!
+ * \class Media::MpegAudioXingHeaderMaker
+ * \brief The MpegAudioXingHeaderMaker class copies an MPEG audio stream and writes a Xing/Info frame computed from the
+ *        frames actually present.
+ *
+ * Players rely on the Xing header (frame count, byte count and the TOC with the byte position of each percent of the
+ * duration) to compute the duration of VBR streams and to seek. If it is missing or outdated they either show a wrong
+ * duration or need to read the whole stream to seek.
+ *
+ * The frame headers are walked while copying the stream (see make()) so no additional pass over the data is needed.
+ * An existing Xing/Info frame containing all fields is updated in place (a following LAME tag is kept and its CRC is
+ * updated). Otherwise, a new frame is written instead of an existing Xing/Info/VBRI frame or in front of the first
+ * audio frame.
+ *
+ * Only layer III streams are supported.
+ */
+
+/*!
+ * \brief Constructs a new maker; prepare() must be called before make().
+ */
+MpegAudioXingHeaderMaker::MpegAudioXingHeaderMaker() :
+    m_streamOffset(0),
+    m_streamSize(0),
+    m_leadingDataSize(0),
+    m_sourceFrameSize(0),
+    m_fieldsOffset(0),
+    m_lameTagOffset(0),
+    m_constantHeader(0),
+    m_nextFrameOffset(0),
+    m_frameEndOffset(0),
+    m_skippedSize(0),
+    m_frameCount(0),
+    m_byteCount(0),
+    m_bitrateIndex(0),
+    m_constantBitrate(true),
+    m_frameOffsetInterval(1),
+    m_toc{}
+{}
+
+/*!
+ * \brief Locates the first frame of the MPEG audio stream of \a streamSize bytes at \a streamOffset within the
+ *        specified \a stream and prepares the Xing frame.
+ *
+ * If the first frame is a Xing/Info or VBRI frame it will be replaced by the frame written by make().
+ *
+ * \throws Throws InvalidDataException if no frame could be found.
+ * \throws Throws NotImplementedException if the stream is no layer III stream.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void MpegAudioXingHeaderMaker::prepare(istream &stream, uint64 streamOffset, uint64 streamSize)
+{
+    static const string context("preparing Xing header");
+    m_streamOffset = streamOffset;
+    m_streamSize = streamSize;
+    m_sourceFrameSize = m_lameTagOffset = 0;
+
+    // read the beginning of the stream
+    string buffer(static_cast<size_t>(min(streamSize, probeSize)), '\0');
+    stream.seekg(static_cast<streamoff>(streamOffset));
+    stream.read(&buffer[0], static_cast<streamsize>(buffer.size()));
+
+    // locate the first frame which is followed by another frame of the same stream
+    uint32 header, frameSize;
+    for(size_t index = 0; ; ++index) {
+        index += MpegAudioFrameScanner::findSync(buffer.data() + index, buffer.size() - index);
+        if(index + 4 > buffer.size()) {
+            addNotification(NotificationType::Critical, "Unable to find an MPEG audio frame at the beginning of the stream.", context);
+            throw InvalidDataException();
+        }
+        header = BE::toUInt32(buffer.data() + index);
+        if(!(frameSize = MpegAudioFrameScanner::frameSize(header))) {
+            continue;
+        }
+        if(index + frameSize + 4 <= buffer.size()) {
+            const uint32 nextHeader = BE::toUInt32(buffer.data() + index + frameSize);
+            if(!MpegAudioFrameScanner::frameSize(nextHeader) || (nextHeader & constantHeaderMask) != (header & constantHeaderMask)) {
+                continue;
+            }
+        }
+        m_leadingDataSize = index;
+        break;
+    }
+    if(((header >> 17) & 0x3) != 1) {
+        addNotification(NotificationType::Warning, "The Xing header can only be written for layer III streams.", context);
+        throw NotImplementedException();
+    }
+    m_constantHeader = header & constantHeaderMask;
+
+    // check whether the first frame is a Xing/Info or VBRI frame
+    const char *const frame = buffer.data() + m_leadingDataSize;
+    const uint64 available = min<uint64>(frameSize, buffer.size() - m_leadingDataSize);
+    const uint32 xingOffset = MpegAudioFrameScanner::xingHeaderOffset(header);
+    if(available == frameSize && frameSize >= xingOffset + 8 && (!memcmp(frame + xingOffset, "Xing", 4) || !memcmp(frame + xingOffset, "Info", 4))) {
+        m_sourceFrameSize = frameSize;
+        const uint32 flags = BE::toUInt32(frame + xingOffset + 4);
+        const uint32 fieldsEnd = xingOffset + 8 + (flags & 0x1 ? 4 : 0) + (flags & 0x2 ? 4 : 0) + (flags & 0x4 ? 100 : 0) + (flags & 0x8 ? 4 : 0);
+        if(fieldsEnd > frameSize) {
+            addNotification(NotificationType::Warning, "The existing Xing header is truncated and will be replaced.", context);
+            prepareFrame(header, 0);
+        } else if((flags & 0x7) == 0x7) {
+            // all fields are present: update the existing frame in place
+            m_frame.assign(frame, frameSize);
+            m_fieldsOffset = xingOffset + 8;
+            m_lameTagOffset = fieldsEnd;
+        } else {
+            // rebuild the frame, keeping the quality indicator and the data following the fields (eg. a LAME tag)
+            const char *const trailingData = frame + fieldsEnd;
+            size_t trailingSize = frameSize - fieldsEnd;
+            for(; trailingSize && !trailingData[trailingSize - 1]; --trailingSize);
+            const uint32 qualitySize = flags & 0x8 ? 4 : 0;
+            prepareFrame(header, qualitySize + static_cast<uint32>(trailingSize));
+            if(m_frame.size() < m_fieldsOffset + fieldsSize + qualitySize + trailingSize) {
+                addNotification(NotificationType::Warning, "The data following the existing Xing header does not fit into the new Xing frame and will be discarded.", context);
+                prepareFrame(header, qualitySize);
+                trailingSize = 0;
+            }
+            char *const fields = &m_frame[m_fieldsOffset];
+            BE::getBytes(static_cast<uint32>(0x7 | (flags & 0x8)), fields - 4);
+            copy(frame + fieldsEnd - qualitySize, frame + fieldsEnd + trailingSize, fields + fieldsSize);
+            if(trailingSize) {
+                m_lameTagOffset = m_fieldsOffset + fieldsSize + qualitySize;
+            }
+        }
+    } else if(available == frameSize && frameSize >= 4 + 32 + 4 && !memcmp(frame + 4 + 32, "VBRI", 4)) {
+        // replace the VBRI frame
+        m_sourceFrameSize = frameSize;
+        prepareFrame(header, 0);
+    } else {
+        // insert a new frame in front of the first audio frame
+        prepareFrame(header, 0);
+    }
+}
+
+/*!
+ * \brief Prepares a new Xing frame based on the specified \a header which provides \a additionalSize bytes after the
+ *        Xing fields.
+ *
+ * The bitrate of the specified \a header is kept if the frame is big enough; otherwise the lowest sufficient bitrate
+ * is used. If no bitrate is sufficient the frame is as big as possible.
+ */
+void MpegAudioXingHeaderMaker::prepareFrame(uint32 header, uint32 additionalSize)
+{
+    // neither use CRC protection nor padding
+    header = (header & ~0x200u) | 0x10000u;
+    const uint32 xingOffset = MpegAudioFrameScanner::xingHeaderOffset(header);
+    const uint32 minSize = xingOffset + 8 + fieldsSize + additionalSize;
+    if(MpegAudioFrameScanner::frameSize(header) < minSize) {
+        uint32 bitrateIndex = 1;
+        for(; bitrateIndex < 14 && MpegAudioFrameScanner::frameSize((header & ~0xF000u) | (bitrateIndex << 12)) < minSize; ++bitrateIndex);
+        header = (header & ~0xF000u) | (bitrateIndex << 12);
+    }
+    m_frame.assign(MpegAudioFrameScanner::frameSize(header), '\0');
+    BE::getBytes(header, &m_frame[0]);
+    m_fieldsOffset = xingOffset + 8;
+    BE::getBytes(static_cast<uint32>(0x7), &m_frame[m_fieldsOffset - 4]);
+    m_lameTagOffset = 0;
+}
+
+/*!
+ * \brief Copies the stream from \a input to the current position of \a output, writing the Xing frame computed from
+ *        the frames found while copying.
+ *
+ * Data in front of the first frame is copied as-is, followed by the Xing frame and the remaining frames. The frame
+ * written at first is only a placeholder which is overwritten when all frames have been copied. After returning, the
+ * write position of \a output is at the end of the copied stream.
+ *
+ * \remarks If the operation has been aborted, this method returns before all data has been copied. The caller is
+ *          expected to check for that.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void MpegAudioXingHeaderMaker::make(istream &input, ostream &output)
+{
+    static const string context("making Xing header");
+    m_nextFrameOffset = m_frameEndOffset = m_skippedSize = m_frameCount = 0;
+    m_constantBitrate = true;
+    m_frameOffsets.clear();
+    m_frameOffsetInterval = 1;
+
+    // copy the data in front of the first frame and write a placeholder for the Xing frame
+    input.seekg(static_cast<streamoff>(m_streamOffset));
+    CopyHelper<0x4000> copyHelper;
+    copyHelper.copy(input, output, m_leadingDataSize);
+    const auto frameOffset = output.tellp();
+    output.write(m_frame.data(), static_cast<streamsize>(m_frame.size()));
+
+    // copy the frames, keeping the last bytes of a buffer if a frame header crosses the buffer boundary
+    const uint64 dataSize = m_streamSize - m_leadingDataSize - m_sourceFrameSize;
+    m_byteCount = m_frame.size() + dataSize;
+    input.seekg(static_cast<streamoff>(m_sourceFrameSize), ios_base::cur);
+    string buffer(copyBufferSize + 3, '\0');
+    size_t keptSize = 0;
+    uint64 bufferOffset = 0;
+    for(uint64 bytesCopied = 0; bytesCopied < dataSize; ) {
+        if(isAborted()) {
+            return;
+        }
+        const size_t count = static_cast<size_t>(min<uint64>(dataSize - bytesCopied, copyBufferSize));
+        input.read(&buffer[keptSize], static_cast<streamsize>(count));
+        output.write(&buffer[keptSize], static_cast<streamsize>(count));
+        bytesCopied += count;
+        const size_t available = keptSize + count;
+        const size_t processed = walkFrames(buffer.data(), available, bufferOffset);
+        keptSize = available - processed;
+        bufferOffset += processed;
+        memmove(&buffer[0], buffer.data() + processed, keptSize);
+        updatePercentage(static_cast<double>(bytesCopied) / dataSize);
+    }
+
+    if(!m_frameCount) {
+        addNotification(NotificationType::Warning, "No MPEG audio frames could be found. The written Xing header is empty.", context);
+    }
+    if(m_skippedSize) {
+        addNotification(NotificationType::Warning, "The stream contains invalid data between the frames which has been copied as-is.", context);
+    }
+
+    // write the final Xing frame
+    finalizeFrame();
+    const auto endOffset = output.tellp();
+    output.seekp(frameOffset);
+    output.write(m_frame.data(), static_cast<streamsize>(m_frame.size()));
+    output.seekp(endOffset);
+}
+
+/*!
+ * \brief Walks the frames within the specified \a data of \a size bytes at the specified \a offset (relative to the
+ *        data following the Xing frame).
+ * \returns Returns the number of bytes which have been processed. The remaining bytes (at most 3) contain an incomplete
+ *          frame header and must be passed again.
+ */
+size_t MpegAudioXingHeaderMaker::walkFrames(const char *data, size_t size, uint64 offset)
+{
+    for(;;) {
+        if(m_nextFrameOffset >= offset + size) {
+            return size;
+        }
+        const size_t index = static_cast<size_t>(m_nextFrameOffset - offset);
+        if(index + 4 > size) {
+            return index;
+        }
+        const uint32 header = BE::toUInt32(data + index);
+        const uint32 frameSize = MpegAudioFrameScanner::frameSize(header);
+        if(frameSize && (header & constantHeaderMask) == m_constantHeader) {
+            m_skippedSize += m_nextFrameOffset - m_frameEndOffset;
+            addFrame(m_nextFrameOffset, header);
+            m_frameEndOffset = m_nextFrameOffset += frameSize;
+            continue;
+        }
+        // lost sync: search for the next sync word (a trailing 0xFF might be the first byte of it)
+        size_t syncIndex = index + 1 + MpegAudioFrameScanner::findSync(data + index + 1, size - index - 1);
+        if(syncIndex == size && static_cast<byte>(data[size - 1]) == 0xFF) {
+            syncIndex = size - 1;
+        }
+        m_nextFrameOffset = offset + syncIndex;
+    }
+}
+
+/*!
+ * \brief Records the frame with the specified \a header at the specified \a offset.
+ *
+ * Only the offset of every n-th frame is recorded. If too many offsets have been recorded, every second offset is
+ * discarded and n is doubled. So the memory usage is constant regardless of the length of the stream while the
+ * recorded offsets are still much more fine-grained than the TOC.
+ */
+void MpegAudioXingHeaderMaker::addFrame(uint64 offset, uint32 header)
+{
+    const uint32 bitrateIndex = (header >> 12) & 0xF;
+    if(!m_frameCount) {
+        m_bitrateIndex = bitrateIndex;
+    } else if(bitrateIndex != m_bitrateIndex) {
+        m_constantBitrate = false;
+    }
+    if(!(m_frameCount % m_frameOffsetInterval)) {
+        m_frameOffsets.push_back(offset);
+        if(m_frameOffsets.size() == maxFrameOffsetCount) {
+            for(size_t index = 1; index != maxFrameOffsetCount / 2; ++index) {
+                m_frameOffsets[index] = m_frameOffsets[index * 2];
+            }
+            m_frameOffsets.resize(maxFrameOffsetCount / 2);
+            m_frameOffsetInterval *= 2;
+        }
+    }
+    ++m_frameCount;
+}
+
+/*!
+ * \brief Computes the TOC and writes the fields to the Xing frame.
+ */
+void MpegAudioXingHeaderMaker::finalizeFrame()
+{
+    // compute the TOC assuming the duration of all frames is equal
+    const uint64 frameSize = m_frame.size();
+    for(uint64 percent = 0; percent != 100; ++percent) {
+        if(m_frameOffsets.empty()) {
+            m_toc[percent] = 0;
+            continue;
+        }
+        const uint64 frameIndex = percent * m_frameCount / 100;
+        const uint64 position = frameSize + m_frameOffsets[min<uint64>(frameIndex / m_frameOffsetInterval, m_frameOffsets.size() - 1)];
+        m_toc[percent] = static_cast<byte>(min<uint64>(position * 256 / m_byteCount, 255));
+    }
+
+    // write the fields
+    char *const fields = &m_frame[m_fieldsOffset];
+    memcpy(fields - 8, m_constantBitrate ? "Info" : "Xing", 4);
+    BE::getBytes(static_cast<uint32>(min<uint64>(m_frameCount, 0xFFFFFFFFu)), fields);
+    BE::getBytes(static_cast<uint32>(min<uint64>(m_byteCount, 0xFFFFFFFFu)), fields + 4);
+    copy(m_toc, m_toc + 100, fields + 8);
+
+    // update the CRC of a LAME tag (CRC-16 of the frame up to the CRC field)
+    if(!m_lameTagOffset || m_lameTagOffset + 36 > m_frame.size()) {
+        return;
+    }
+    const char *const lameTag = m_frame.data() + m_lameTagOffset;
+    if(memcmp(lameTag, "LAME", 4) && memcmp(lameTag, "Lavf", 4) && memcmp(lameTag, "Lavc", 4)) {
+        return;
+    }
+    uint16 crc = 0;
+    for(const char *i = m_frame.data(), *end = lameTag + 34; i != end; ++i) {
+        crc ^= static_cast<byte>(*i);
+        for(byte bit = 0; bit != 8; ++bit) {
+            crc = crc & 1 ? static_cast<uint16>((crc >> 1) ^ 0xA001) : static_cast<uint16>(crc >> 1);
+        }
+    }
+    BE::getBytes(crc, &m_frame[m_lameTagOffset + 34]);
+}
+
+}
@@ -0,0 +1,90 @@
+#ifndef MEDIA_MPEGAUDIOXINGHEADERMAKER_H
+#define MEDIA_MPEGAUDIOXINGHEADERMAKER_H
+
+#include "../statusprovider.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT MpegAudioXingHeaderMaker : public StatusProvider
+{
+public:
+    MpegAudioXingHeaderMaker();
+
+    void prepare(std::istream &stream, uint64 streamOffset, uint64 streamSize);
+    uint32 requiredSize() const;
+    void make(std::istream &input, std::ostream &output);
+    uint64 frameCount() const;
+    uint64 byteCount() const;
+    const byte *toc() const;
+
+private:
+    void prepareFrame(uint32 header, uint32 minSize);
+    std::size_t walkFrames(const char *data, std::size_t size, uint64 offset);
+    void addFrame(uint64 offset, uint32 header);
+    void finalizeFrame();
+
+    uint64 m_streamOffset;
+    uint64 m_streamSize;
+    uint64 m_leadingDataSize;
+    uint32 m_sourceFrameSize;
+    std::string m_frame;
+    uint32 m_fieldsOffset;
+    uint32 m_lameTagOffset;
+    uint32 m_constantHeader;
+    uint64 m_nextFrameOffset;
+    uint64 m_frameEndOffset;
+    uint64 m_skippedSize;
+    uint64 m_frameCount;
+    uint64 m_byteCount;
+    uint32 m_bitrateIndex;
+    bool m_constantBitrate;
+    std::vector<uint64> m_frameOffsets;
+    uint64 m_frameOffsetInterval;
+    byte m_toc[100];
+};
+
+/*!
+ * \brief Returns the size of the Xing frame which will be written by make().
+ * \remarks Only valid after calling prepare().
+ */
+inline uint32 MpegAudioXingHeaderMaker::requiredSize() const
+{
+    return static_cast<uint32>(m_frame.size());
+}
+
+/*!
+ * \brief Returns the number of audio frames found when calling make().
+ * \remarks The Xing frame itself is not taken into account.
+ */
+inline uint64 MpegAudioXingHeaderMaker::frameCount() const
+{
+    return m_frameCount;
+}
+
+/*!
+ * \brief Returns the number of bytes of the stream written by make() (starting with the Xing frame).
+ */
+inline uint64 MpegAudioXingHeaderMaker::byteCount() const
+{
+    return m_byteCount;
+}
+
+/*!
+ * \brief Returns the 100 entries of the TOC computed when calling make().
+ *
+ * Entry i denotes the position of the frame at i percent of the duration as fraction of byteCount() in 1/256 units.
+ */
+inline const byte *MpegAudioXingHeaderMaker::toc() const
+{
+    return m_toc;
+}
+
+}
+
+#endif // MEDIA_MPEGAUDIOXINGHEADERMAKER_H
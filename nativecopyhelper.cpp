@@ -0,0 +1,217 @@
+#include "./nativecopyhelper.h"
+
+#include <c++utilities/io/copy.h>
+
+#include <algorithm>
+#include <iostream>
+
+#ifdef PLATFORM_LINUX
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/sendfile.h>
+#endif
+
+using namespace std;
+using namespace IoUtilities;
+
+namespace Media {
+
+/*!
+ * \class Media::NativeCopyHelper
+ * \brief The NativeCopyHelper class copies data between files without passing it through user space if possible.
+ *
+ * Writers use this class to copy media data (eg. "Cluster"-elements or "mdat"-atoms) from the original file to the
+ * new file when rewriting a file. To allow native copying, open() must be called with the streams used for reading
+ * and writing and the paths of the related files. The copy methods use native copying only if they are called with
+ * exactly these streams and at least minimumSize() bytes are requested. Otherwise (or if native copying is not
+ * supported) data is copied using a buffer as usual.
+ *
+ * On Linux, copy_file_range() is tried first. If it is not supported (eg. kernel too old or copying across file
+ * systems) sendfile() is used. If the C library does not provide copy_file_range() (eg. glibc older than 2.27),
+ * sendfile() is used right away. Other platforms always use the buffered copy.
+ *
+ * Data is copied in chunks so isAborted() and the progress callback are still checked/called regularly.
+ */
+
+/*!
+ * \brief Specifies the number of bytes copied natively before isAborted() is checked and the progress callback is called.
+ */
+constexpr std::size_t nativeCopyChunkSize = 0x800000;
+
+/*!
+ * \brief Constructs a new copy helper.
+ * \remarks The helper is not open initially and will hence only perform buffered copies.
+ */
+NativeCopyHelper::NativeCopyHelper() :
+    m_inputStream(nullptr),
+    m_outputStream(nullptr),
+    m_inputFd(-1),
+    m_outputFd(-1),
+    m_minimumSize(0x10000),
+    m_bytesCopiedNatively(0),
+    m_copyFileRangeSupported(false),
+    m_sendFileSupported(false),
+    m_suspended(false)
+{}
+
+/*!
+ * \brief Destroys the copy helper closing the file descriptors if open.
+ */
+NativeCopyHelper::~NativeCopyHelper()
+{
+    close();
+}
+
+/*!
+ * \brief Opens file descriptors for the specified files to allow native copying.
+ * \param inputStream Specifies the stream which is used to read from the file at \a inputPath.
+ * \param inputPath Specifies the path of the file to copy data from.
+ * \param outputStream Specifies the stream which is used to write to the file at \a outputPath.
+ * \param outputPath Specifies the path of the file to copy data to.
+ * \remarks
+ * - If the files can not be opened, the helper remains closed so buffered copies are used.
+ * - The streams must not be reopened with other files while the helper is open.
+ */
+void NativeCopyHelper::open(istream &inputStream, const string &inputPath, ostream &outputStream, const string &outputPath)
+{
+    close();
+#ifdef PLATFORM_LINUX
+    if((m_inputFd = ::open(inputPath.data(), O_RDONLY | O_CLOEXEC)) < 0) {
+        return;
+    }
+    if((m_outputFd = ::open(outputPath.data(), O_WRONLY | O_CLOEXEC)) < 0) {
+        close();
+        return;
+    }
+    m_inputStream = &inputStream;
+    m_outputStream = &outputStream;
+#ifdef HAVE_COPY_FILE_RANGE
+    m_copyFileRangeSupported = true;
+#endif
+    m_sendFileSupported = true;
+#else
+    VAR_UNUSED(inputStream)
+    VAR_UNUSED(inputPath)
+    VAR_UNUSED(outputStream)
+    VAR_UNUSED(outputPath)
+#endif
+}
+
+/*!
+ * \brief Closes the file descriptors opened via open().
+ * \remarks Resets bytesCopiedNatively() and the suspension (see setSuspended()) as well.
+ */
+void NativeCopyHelper::close()
+{
+#ifdef PLATFORM_LINUX
+    if(m_inputFd >= 0) {
+        ::close(m_inputFd);
+    }
+    if(m_outputFd >= 0) {
+        ::close(m_outputFd);
+    }
+#endif
+    m_inputFd = m_outputFd = -1;
+    m_inputStream = nullptr;
+    m_outputStream = nullptr;
+    m_suspended = false;
+    m_bytesCopiedNatively = 0;
+    m_copyFileRangeSupported = m_sendFileSupported = false;
+}
+
+/*!
+ * \brief Copies \a count bytes from \a input to \a output.
+ *
+ * Reading starts at the current read position of \a input and writing at the current write position of \a output.
+ * After copying, both positions are advanced by the number of bytes copied.
+ *
+ * \param isAborted Specifies a function to check whether the operation has been aborted; might be empty.
+ * \param callback Specifies a function to be called with the progress percentage; might be empty.
+ * \remarks If the operation has been aborted, this method returns before all data has been copied. The caller
+ *          is expected to check for that.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+void NativeCopyHelper::callbackCopy(istream &input, ostream &output, uint64 count, const std::function<bool (void)> &isAborted, const std::function<void (double)> &callback)
+{
+    uint64 bytesCopied = 0;
+    if(!m_suspended && count >= m_minimumSize && &input == m_inputStream && &output == m_outputStream) {
+        bytesCopied = nativeCopy(input, output, count, isAborted, callback);
+        if(bytesCopied == count || (isAborted && isAborted())) {
+            return;
+        }
+    }
+
+    // copy (remaining) data using a buffer
+    const uint64 bytesRemaining = count - bytesCopied;
+    CopyHelper<0x4000> copyHelper;
+    if(isAborted && callback) {
+        copyHelper.callbackCopy(input, output, bytesRemaining, isAborted, [&] (double percentage) {
+            callback((bytesCopied + percentage * bytesRemaining) / count);
+        });
+    } else {
+        copyHelper.copy(input, output, bytesRemaining);
+    }
+}
+
+/*!
+ * \brief Copies up to \a count bytes natively.
+ * \returns Returns the number of bytes copied. This is less than \a count if native copying is not supported, an error
+ *          occurred or the operation has been aborted.
+ */
+uint64 NativeCopyHelper::nativeCopy(istream &input, ostream &output, uint64 count, const std::function<bool (void)> &isAborted, const std::function<void (double)> &callback)
+{
+    uint64 bytesCopied = 0;
+#ifdef PLATFORM_LINUX
+    if(!m_copyFileRangeSupported && !m_sendFileSupported) {
+        return bytesCopied;
+    }
+
+    // ensure everything written so far is visible to the output file descriptor
+    output.flush();
+    loff_t inputOffset = static_cast<loff_t>(input.tellg());
+    loff_t outputOffset = static_cast<loff_t>(output.tellp());
+
+    while(bytesCopied < count && !(isAborted && isAborted())) {
+        const size_t chunkSize = static_cast<size_t>(min<uint64>(count - bytesCopied, nativeCopyChunkSize));
+        ssize_t res = -1;
+#ifdef HAVE_COPY_FILE_RANGE
+        if(m_copyFileRangeSupported) {
+            if((res = ::copy_file_range(m_inputFd, &inputOffset, m_outputFd, &outputOffset, chunkSize, 0)) < 0) {
+                m_copyFileRangeSupported = false;
+            }
+        }
+#endif
+        if(res < 0 && m_sendFileSupported) {
+            off_t sendFileOffset = inputOffset;
+            if(::lseek(m_outputFd, outputOffset, SEEK_SET) < 0 || (res = ::sendfile(m_outputFd, m_inputFd, &sendFileOffset, chunkSize)) < 0) {
+                m_sendFileSupported = false;
+            } else {
+                inputOffset = sendFileOffset;
+                outputOffset += res;
+            }
+        }
+        if(res <= 0) {
+            // native copying not supported or end of input reached (let the buffered copy handle that case)
+            break;
+        }
+        bytesCopied += static_cast<uint64>(res);
+        if(callback) {
+            callback(static_cast<double>(bytesCopied) / count);
+        }
+    }
+
+    // advance stream positions
+    input.seekg(inputOffset);
+    output.seekp(outputOffset);
+    m_bytesCopiedNatively += bytesCopied;
+#else
+    VAR_UNUSED(input)
+    VAR_UNUSED(output)
+    VAR_UNUSED(count)
+    VAR_UNUSED(isAborted)
+    VAR_UNUSED(callback)
+#endif
+    return bytesCopied;
+}
+
+}
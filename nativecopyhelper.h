@@ -0,0 +1,115 @@
+#ifndef MEDIA_NATIVECOPYHELPER_H
+#define MEDIA_NATIVECOPYHELPER_H
+
+#include "./global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT NativeCopyHelper
+{
+public:
+    NativeCopyHelper();
+    NativeCopyHelper(const NativeCopyHelper &) = delete;
+    NativeCopyHelper &operator=(const NativeCopyHelper &) = delete;
+    ~NativeCopyHelper();
+
+    void open(std::istream &inputStream, const std::string &inputPath, std::ostream &outputStream, const std::string &outputPath);
+    void close();
+    bool isOpen() const;
+    bool isSuspended() const;
+    void setSuspended(bool suspended);
+    uint64 minimumSize() const;
+    void setMinimumSize(uint64 minimumSize);
+    uint64 bytesCopiedNatively() const;
+    void copy(std::istream &input, std::ostream &output, uint64 count);
+    void callbackCopy(std::istream &input, std::ostream &output, uint64 count, const std::function<bool (void)> &isAborted, const std::function<void (double)> &callback);
+
+private:
+    uint64 nativeCopy(std::istream &input, std::ostream &output, uint64 count, const std::function<bool (void)> &isAborted, const std::function<void (double)> &callback);
+
+    std::istream *m_inputStream;
+    std::ostream *m_outputStream;
+    int m_inputFd;
+    int m_outputFd;
+    uint64 m_minimumSize;
+    uint64 m_bytesCopiedNatively;
+    bool m_copyFileRangeSupported;
+    bool m_sendFileSupported;
+    bool m_suspended;
+};
+
+/*!
+ * \brief Returns whether file descriptors for native copying are open.
+ * \remarks If not, copy() and callbackCopy() just use a buffered copy.
+ */
+inline bool NativeCopyHelper::isOpen() const
+{
+    return m_inputStream != nullptr;
+}
+
+/*!
+ * \brief Returns whether native copying is suspended.
+ * \sa setSuspended()
+ */
+inline bool NativeCopyHelper::isSuspended() const
+{
+    return m_suspended;
+}
+
+/*!
+ * \brief Sets whether native copying is suspended.
+ *
+ * While suspended, copy() and callbackCopy() use a buffered copy even if the helper is open. This is required when
+ * all data written to the output stream must pass its buffer (eg. to compute a checksum while writing).
+ */
+inline void NativeCopyHelper::setSuspended(bool suspended)
+{
+    m_suspended = suspended;
+}
+
+/*!
+ * \brief Returns the minimum number of bytes required to use native copying.
+ *
+ * Copying less data is done using a buffered copy because the overhead of flushing the output stream and syncing
+ * the stream positions outweighs the advantage of native copying in this case.
+ */
+inline uint64 NativeCopyHelper::minimumSize() const
+{
+    return m_minimumSize;
+}
+
+/*!
+ * \brief Sets the minimum number of bytes required to use native copying.
+ * \sa minimumSize()
+ */
+inline void NativeCopyHelper::setMinimumSize(uint64 minimumSize)
+{
+    m_minimumSize = minimumSize;
+}
+
+/*!
+ * \brief Returns the number of bytes which have been copied natively (without passing user space) since opening.
+ */
+inline uint64 NativeCopyHelper::bytesCopiedNatively() const
+{
+    return m_bytesCopiedNatively;
+}
+
+/*!
+ * \brief Copies \a count bytes from \a input to \a output.
+ * \sa callbackCopy()
+ */
+inline void NativeCopyHelper::copy(std::istream &input, std::ostream &output, uint64 count)
+{
+    callbackCopy(input, output, count, nullptr, nullptr);
+}
+
+}
+
+#endif // MEDIA_NATIVECOPYHELPER_H
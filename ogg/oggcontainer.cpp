@@ -1,5 +1,6 @@
 
 #include "./oggcontainer.h"
+#include "./oggpagelocator.h"
 
 #include "../flac/flacmetadata.h"
 
@@ -10,7 +11,10 @@
 #include <c++utilities/io/copy.h>
 #include <c++utilities/io/catchiofailure.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <unordered_set>
 
 using namespace std;
 using namespace IoUtilities;
@@ -49,7 +53,9 @@ OggContainer::OggContainer(MediaFileInfo &fileInfo, uint64 startOffset) :
     GenericContainer<MediaFileInfo, OggVorbisComment, OggStream, OggPage>(fileInfo, startOffset),
     m_iterator(fileInfo.stream(), startOffset, fileInfo.size()),
     m_validateChecksums(false)
-{}
+{
+    m_iterator.setReadSource(&fileInfo);
+}
 
 OggContainer::~OggContainer()
 {}
@@ -188,6 +194,18 @@ void OggContainer::internalParseHeader()
     static const string context("parsing OGG bitstream header");
     bool pagesSkipped = false;
 
+    // the parse index might denote the end of the header pages and the start of the last pages of all streams
+    const ParseIndex &parseIndex = fileInfo().parseIndex();
+    const vector<uint64> *const indexedPages = parseIndex.isIdentified() && !fileInfo().isForcingFullParse() ? parseIndex.entry("ogg.pages") : nullptr;
+    const vector<uint64> *const indexedStreams = indexedPages ? parseIndex.entry("ogg.streams") : nullptr;
+    const bool useParseIndex = indexedPages && indexedStreams && indexedPages->size() == 2 && indexedStreams->size() % 2 == 0;
+    bool parseIndexUsed = false;
+
+    // the pages in the middle of a big file might be skipped once the header pages of all streams have been read
+    // (which is assumed when each stream has a page with a granule position)
+    unordered_set<uint32> streamsWithGranulePosition;
+    bool lastPagesLocated = false;
+
     // iterate through pages using OggIterator helper class
     try {
         // ensure iterator is setup properly
@@ -197,7 +215,6 @@ void OggContainer::internalParseHeader()
                 addNotification(NotificationType::Warning, argsToString("The denoted checksum of the OGG page at ", m_iterator.currentSegmentOffset(), " does not match the computed checksum."), context);
             }
             OggStream *stream;
-            uint64 lastNewStreamOffset = 0;
             try {
                 stream = m_tracks[m_streamsBySerialNo.at(page.streamSerialNumber())].get();
                 stream->m_size += page.dataSize();
@@ -206,7 +223,9 @@ void OggContainer::internalParseHeader()
                 m_streamsBySerialNo[page.streamSerialNumber()] = m_tracks.size();
                 m_tracks.emplace_back(make_unique<OggStream>(*this, m_iterator.currentPageIndex()));
                 stream = m_tracks.back().get();
-                lastNewStreamOffset = page.startOffset();
+            }
+            if(page.absoluteGranulePosition() && page.absoluteGranulePosition() != numeric_limits<uint64>::max()) {
+                streamsWithGranulePosition.insert(page.streamSerialNumber());
             }
             if(stream->m_currentSequenceNumber != page.sequenceNumber()) {
                 if(stream->m_currentSequenceNumber) {
@@ -217,17 +236,41 @@ void OggContainer::internalParseHeader()
                 ++stream->m_currentSequenceNumber;
             }
 
-            // skip pages in the middle of a big file (still more than 100 MiB to parse) if no new track has been seen since the last 20 MiB
-            if(!fileInfo().isForcingFullParse()
+            if(useParseIndex) {
+                // skip pages between the header pages and the last pages denoted by the parse index
+                const uint64 pageEnd = page.startOffset() + page.totalSize();
+                if(!parseIndexUsed && pageEnd >= indexedPages->front() && indexedPages->back() > pageEnd) {
+                    if(!m_iterator.resyncAt(indexedPages->back()) || m_iterator.currentPage().startOffset() != indexedPages->back()) {
+                        addNotification(NotificationType::Critical, "Unable to re-sync at the OGG page denoted by the parse index.", context);
+                        return;
+                    }
+                    // prevent warnings about missing pages
+                    for(auto &stream : m_tracks) {
+                        stream->m_currentSequenceNumber = 0;
+                    }
+                    parseIndexUsed = true;
+                }
+            // skip pages in the middle of a big file (still more than 100 MiB to parse) once the header pages of all streams have been read
+            // -> continue with the last pages of the streams which are located by only reading the end of the file
+            } else if(!lastPagesLocated && !fileInfo().isForcingFullParse()
                     && (fileInfo().size() - page.startOffset()) > (100 * 0x100000)
-                    && (page.startOffset() - lastNewStreamOffset) > (20 * 0x100000)) {
-                if(m_iterator.resyncAt(fileInfo().size() - (20 * 0x100000))) {
+                    && streamsWithGranulePosition.size() == m_tracks.size()) {
+                lastPagesLocated = true;
+                const uint64 pageEnd = page.startOffset() + page.totalSize();
+                const uint64 lastPagesOffset = locateLastPages(pageEnd);
+                if(lastPagesOffset <= pageEnd || lastPagesOffset >= fileInfo().size()) {
+                    // the last pages follow directly or could not be located -> just go on with the next page
+                    continue;
+                }
+                if(m_iterator.resyncAt(lastPagesOffset)) {
                     const OggPage &resyncedPage = m_iterator.currentPage();
-                    // prevent warning about missing pages
-                    stream->m_currentSequenceNumber = resyncedPage.sequenceNumber() + 1;
+                    // prevent warnings about missing pages
+                    for(auto &stream : m_tracks) {
+                        stream->m_currentSequenceNumber = 0;
+                    }
                     pagesSkipped = true;
                     addNotification(NotificationType::Information,
-                                    argsToString("Pages in the middle of the file (", dataSizeToString(resyncedPage.startOffset() - page.startOffset()) ,") have been skipped to improve parsing speed. Hence track sizes can not be computed. Maybe not even all tracks could be detected. Force a full parse to prevent this."),
+                                    argsToString("Pages in the middle of the file (", dataSizeToString(resyncedPage.startOffset() - pageEnd) ,") have been skipped to improve parsing speed. Hence track sizes can not be computed. Maybe not even all tracks could be detected. Force a full parse to prevent this."),
                                     context);
                 } else {
                     // abort if skipping pages didn't work
@@ -244,12 +287,92 @@ void OggContainer::internalParseHeader()
         addNotification(NotificationType::Critical, argsToString("Capture pattern \"OggS\" at ", m_iterator.currentSegmentOffset(), " expected."), context);
     }
 
-    // invalidate stream sizes in case pages have been skipped
-    if(pagesSkipped) {
+    if(parseIndexUsed) {
+        // take stream sizes from the parse index because pages have been skipped
         for(auto &stream : m_tracks) {
             stream->m_size = 0;
         }
+        for(auto i = indexedStreams->cbegin(), end = indexedStreams->cend(); i != end; i += 2) {
+            const auto streamIndex = m_streamsBySerialNo.find(static_cast<uint32>(i[0]));
+            if(streamIndex != m_streamsBySerialNo.cend()) {
+                m_tracks[streamIndex->second]->m_size = i[1];
+            }
+        }
+    } else if(pagesSkipped) {
+        // invalidate stream sizes in case pages have been skipped
+        for(auto &stream : m_tracks) {
+            stream->m_size = 0;
+        }
+    } else {
+        updateParseIndex();
+    }
+}
+
+/*!
+ * \brief Returns the start offset of the earliest page among the last pages of all streams.
+ *
+ * The last pages are located by only reading the page headers at the end of the file (see
+ * OggPageLocator::findLastPage()). Streams without pages after the specified \a offset are not considered.
+ *
+ * \returns Returns the file size if no such page could be located.
+ */
+uint64 OggContainer::locateLastPages(uint64 offset)
+{
+    OggPageLocator locator(fileInfo().stream(), offset, fileInfo().size());
+    locator.setReadSource(&fileInfo());
+    uint64 lastPagesOffset = fileInfo().size();
+    OggPage lastPage;
+    for(const auto &stream : m_streamsBySerialNo) {
+        if(locator.findLastPage(stream.first, lastPage)) {
+            lastPagesOffset = min(lastPagesOffset, lastPage.startOffset());
+        }
+    }
+    return lastPagesOffset;
+}
+
+/*!
+ * \brief Records the end of the header pages, the start of the last pages and the sizes of all streams in the parse
+ *        index of the file.
+ *
+ * This private method is called when parsing the header after all pages have been read. When parsing the file again,
+ * the pages between the header pages (needed to parse the tracks and tags) and the last pages (needed to compute the
+ * duration) can be skipped without losing information.
+ *
+ * Nothing is recorded if the index is not used, critical errors occurred or a stream has no page with a granule
+ * position.
+ */
+void OggContainer::updateParseIndex()
+{
+    ParseIndex &parseIndex = fileInfo().parseIndex();
+    if(!parseIndex.isIdentified() || !m_iterator.areAllPagesFetched() || hasCriticalNotifications()) {
+        return;
+    }
+    const auto &pages = m_iterator.pages();
+    uint64 headerEnd = 0, lastPagesOffset = fileInfo().size();
+    vector<uint64> streams;
+    streams.reserve(m_tracks.size() * 2);
+    for(const auto &stream : m_tracks) {
+        const auto serialNumber = static_cast<uint32>(stream->id());
+        // the first page of a stream with a granule position is the first page after the header pages
+        size_t firstPageWithGranulePosition = 0;
+        for(const size_t pageCount = pages.size(); firstPageWithGranulePosition != pageCount; ++firstPageWithGranulePosition) {
+            if(pages.matchesStreamSerialNumber(firstPageWithGranulePosition, serialNumber)
+                    && pages.absoluteGranulePosition(firstPageWithGranulePosition)
+                    && pages.absoluteGranulePosition(firstPageWithGranulePosition) != numeric_limits<uint64>::max()) {
+                break;
+            }
+        }
+        const size_t lastPage = pages.findLast(serialNumber);
+        if(firstPageWithGranulePosition == pages.size() || lastPage == pages.size()) {
+            return;
+        }
+        headerEnd = max<uint64>(headerEnd, pages.startOffset(firstPageWithGranulePosition) + pages.totalSize(firstPageWithGranulePosition));
+        lastPagesOffset = min<uint64>(lastPagesOffset, pages.startOffset(lastPage));
+        streams.push_back(serialNumber);
+        streams.push_back(stream->size());
     }
+    parseIndex.setEntry("ogg.pages", {headerEnd, lastPagesOffset});
+    parseIndex.setEntry("ogg.streams", move(streams));
 }
 
 void OggContainer::internalParseTags()
@@ -149,6 +149,8 @@ protected:
     void internalMakeFile();
 
 private:
+    void updateParseIndex();
+    uint64 locateLastPages(uint64 offset);
     void announceComment(std::size_t pageIndex, std::size_t segmentIndex, bool lastMetaDataBlock, GeneralMediaFormat mediaFormat = GeneralMediaFormat::Vorbis);
     void makeVorbisCommentSegment(std::stringstream &buffer, IoUtilities::CopyHelper<65307> &copyHelper, std::vector<uint32> &newSegmentSizes, VorbisComment *comment, OggParameter *params);
 
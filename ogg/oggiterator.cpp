@@ -1,11 +1,14 @@
 #include "./oggiterator.h"
 
+#include "../basicfileinfo.h"
 #include "../exceptions.h"
 
 #include <c++utilities/io/binaryreader.h>
 
 #include <iostream>
 #include <limits>
+#include <cstring>
+#include <algorithm>
 
 using namespace std;
 using namespace IoUtilities;
@@ -22,7 +25,8 @@ namespace Media {
  *
  * To go on call the appropriate methods. Parsing exceptions and IO exceptions might occur during iteration.
  *
- * The internal buffer of OGG pages might be accessed using the pages() method.
+ * The header values of the fetched OGG pages might be accessed using the pages() method. Only the current page
+ * is kept as OggPage object (see currentPage()); it is read again from the file when moving to another page.
  */
 
 /*!
@@ -35,6 +39,7 @@ void OggIterator::clear(istream &stream, uint64 startOffset, uint64 streamSize)
     m_startOffset = startOffset;
     m_streamSize = streamSize;
     m_pages.clear();
+    m_loadedPage = static_cast<size_t>(-1);
 }
 
 /*!
@@ -46,16 +51,30 @@ void OggIterator::clear(istream &stream, uint64 startOffset, uint64 streamSize)
 void OggIterator::reset()
 {
     for(m_page = m_segment =  m_offset = 0; m_page < m_pages.size() || fetchNextPage(); ++m_page) {
-        const OggPage &page = m_pages[m_page];
-        if(!page.segmentSizes().empty() && matchesFilter(page)) {
+        if(m_pages.segmentTableSize(m_page) && matchesFilter(m_page)) {
             // page is not empty and matches ID filter if set
-            m_offset = page.startOffset() + page.headerSize();
+            loadPage(m_page);
+            m_offset = m_pages.startOffset(m_page) + m_pages.headerSize(m_page);
             break;
         }
     }
     // no matching page found -> iterator is invalid
 }
 
+/*!
+ * \brief Sets the current page index.
+ * \remarks This method should never be called with an \a index out of range (which is defined by the number of fetched
+ *          pages), since this would cause undefined behaviour.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws Failure when a parsing error occurs.
+ */
+void OggIterator::setPageIndex(size_t index)
+{
+    loadPage(m_page = index);
+    m_segment = 0;
+    m_offset = m_pages.startOffset(index) + m_pages.headerSize(index);
+}
+
 /*!
  * \brief Increases the current position by one page.
  * \remarks The iterator must be valid. The iterator might be invalidated.
@@ -63,11 +82,11 @@ void OggIterator::reset()
 void OggIterator::nextPage()
 {
     while(++m_page < m_pages.size() || fetchNextPage()) {
-        const OggPage &page = m_pages[m_page];
-        if(!page.segmentSizes().empty() && matchesFilter(page)) {
+        if(m_pages.segmentTableSize(m_page) && matchesFilter(m_page)) {
             // page is not empty and matches ID filter if set
+            loadPage(m_page);
             m_segment = m_bytesRead = 0;
-            m_offset = page.startOffset() + page.headerSize();
+            m_offset = m_pages.startOffset(m_page) + m_pages.headerSize(m_page);
             return;
         }
     }
@@ -80,11 +99,10 @@ void OggIterator::nextPage()
  */
 void OggIterator::nextSegment()
 {
-    const OggPage &page = m_pages[m_page];
-    if(matchesFilter(page) && ++m_segment < page.segmentSizes().size()) {
+    if(matchesFilter(m_page) && ++m_segment < m_currentPage.segmentSizes().size()) {
         // current page has next segment
         m_bytesRead = 0;
-        m_offset += page.segmentSizes()[m_segment - 1];
+        m_offset += m_currentPage.segmentSizes()[m_segment - 1];
     } else {
         // next (matching) page has next segment
         nextPage();
@@ -98,9 +116,9 @@ void OggIterator::nextSegment()
 void OggIterator::previousPage()
 {
     while(m_page) {
-        const OggPage &page = m_pages[--m_page];
-        if(matchesFilter(page)) {
-            m_offset = page.dataOffset(m_segment = page.segmentSizes().size() - 1);
+        if(matchesFilter(--m_page)) {
+            loadPage(m_page);
+            m_offset = m_currentPage.dataOffset(m_segment = m_currentPage.segmentSizes().size() - 1);
             return;
         }
     }
@@ -112,9 +130,8 @@ void OggIterator::previousPage()
  */
 void OggIterator::previousSegment()
 {
-    const OggPage &page = m_pages[m_page];
-    if(m_segment && matchesFilter(page)) {
-        m_offset -= page.segmentSizes()[m_segment--];
+    if(m_segment && matchesFilter(m_page)) {
+        m_offset -= m_currentPage.segmentSizes()[m_segment--];
     } else {
         previousPage();
     }
@@ -136,13 +153,12 @@ void OggIterator::read(char *buffer, size_t count)
     size_t bytesRead = 0;
     while(*this && count) {
         const uint32 available = currentSegmentSize() - m_bytesRead;
-        stream().seekg(currentCharacterOffset());
         if(count <= available) {
-            stream().read(buffer + bytesRead, count);
+            readCurrent(buffer + bytesRead, count);
             m_bytesRead += count;
             return;
         } else {
-            stream().read(buffer + bytesRead, available);
+            readCurrent(buffer + bytesRead, available);
             nextSegment();
             bytesRead += available;
             count -= available;
@@ -171,13 +187,12 @@ size_t OggIterator::readAll(char *buffer, size_t max)
     size_t bytesRead = 0;
     while(*this && max) {
         const uint32 available = currentSegmentSize() - m_bytesRead;
-        stream().seekg(currentCharacterOffset());
         if(max <= available) {
-            stream().read(buffer + bytesRead, max);
+            readCurrent(buffer + bytesRead, max);
             m_bytesRead += max;
             return bytesRead + max;
         } else {
-            stream().read(buffer + bytesRead, available);
+            readCurrent(buffer + bytesRead, available);
             nextSegment();
             bytesRead += available;
             max -= available;
@@ -238,14 +253,35 @@ void OggIterator::ignore(size_t count)
 bool OggIterator::resyncAt(uint64 offset)
 {
     // check whether offset is valid
-    if(offset >= streamSize() || offset < (m_pages.empty() ? m_startOffset : m_pages.back().startOffset() + m_pages.back().totalSize())) {
+    if(offset >= streamSize() || offset < fetchedEndOffset()) {
         return false;
     }
 
-    // find capture pattern 'OggS'
+    // parse into a separate page so the current page remains intact if no page can be found
+    OggPage page;
+
+    // find capture pattern 'OggS' (directly within the memory mapping if possible)
+    if(const char *const data = mappedData(offset, streamSize() - offset)) {
+        const char *const end = data + (streamSize() - offset);
+        for(const char *i = data; end - i >= 27; ++i) {
+            if(memcmp(i, "OggS", 4)) {
+                continue;
+            }
+            // capture pattern found
+            // -> try to parse an OGG page at this position
+            const uint64 bytesAvailable = static_cast<uint64>(end - i);
+            try {
+                page.parseHeader(i, offset + static_cast<uint64>(i - data), bytesAvailable > numeric_limits<int32>::max() ? numeric_limits<int32>::max() : static_cast<int32>(bytesAvailable));
+                appendPage(move(page));
+                return true;
+            } catch (const Failure &) {
+            }
+        }
+        return false;
+    }
     stream().seekg(offset);
     byte lettersFound = 0;
-    for(uint64 bytesAvailable = max<uint64>(streamSize() - offset, 65307ul); bytesAvailable >= 27; --bytesAvailable) {
+    for(uint64 bytesAvailable = streamSize() - offset, bytesToSearch = min<uint64>(bytesAvailable, 65307ul); bytesToSearch >= 27; --bytesAvailable, --bytesToSearch) {
         switch(static_cast<char>(stream().get())) {
         case 'O':
             lettersFound = 1;
@@ -259,8 +295,8 @@ bool OggIterator::resyncAt(uint64 offset)
                 const auto currentOffset = stream().tellg();
                 // -> try to parse an OGG page at this position
                 try {
-                    m_pages.emplace_back(stream(), static_cast<uint64>(stream().tellg()) - 4, bytesAvailable > numeric_limits<int32>::max() ? numeric_limits<int32>::max() : static_cast<int32>(bytesAvailable));
-                    setPageIndex(m_pages.size() - 1);
+                    page.parseHeader(stream(), static_cast<uint64>(stream().tellg()) - 4, bytesAvailable > numeric_limits<int32>::max() ? numeric_limits<int32>::max() : static_cast<int32>(bytesAvailable));
+                    appendPage(move(page));
                     return true;
                 } catch (const Failure &) {
                     stream().seekg(currentOffset);
@@ -287,14 +323,105 @@ bool OggIterator::resyncAt(uint64 offset)
 bool OggIterator::fetchNextPage()
 {
     if(m_page == m_pages.size()) { // can only fetch the next page if the current page is the last page
-        m_offset = m_pages.empty() ? m_startOffset : m_pages.back().startOffset() + m_pages.back().totalSize();
+        m_offset = fetchedEndOffset();
         if(m_offset < m_streamSize) {
             const uint64 bytesAvailable = m_streamSize - m_offset;
-            m_pages.emplace_back(*m_stream, m_offset, bytesAvailable > numeric_limits<int32>::max() ? numeric_limits<int32>::max() : static_cast<int32>(bytesAvailable));
+            const int32 maxSize = bytesAvailable > numeric_limits<int32>::max() ? numeric_limits<int32>::max() : static_cast<int32>(bytesAvailable);
+            char headerBuffer[27 + 0xFF];
+            // parse directly into the current page to reuse its segment size buffer
+            m_loadedPage = static_cast<size_t>(-1);
+            if(const char *data = fetchData(m_offset, min<size_t>(static_cast<size_t>(maxSize), sizeof(headerBuffer)), headerBuffer)) {
+                m_currentPage.parseHeader(data, m_offset, maxSize);
+            } else {
+                m_currentPage.parseHeader(*m_stream, m_offset, maxSize);
+            }
+            m_loadedPage = m_pages.size();
+            m_pages.append(m_currentPage);
             return true;
         }
     }
     return false;
 }
 
+/*!
+ * \brief Makes the page with the specified \a index the current page (without altering the position within the page).
+ *
+ * The page header is read again from the file unless the page is already loaded. Only the header values of the
+ * pages are kept in pages() so the segment table is decoded only for the page the iterator is currently pointing at.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \throws Throws Failure when a parsing error occurs.
+ */
+void OggIterator::loadPage(size_t index)
+{
+    if(m_loadedPage == index) {
+        return;
+    }
+    m_loadedPage = static_cast<size_t>(-1);
+    const uint64 offset = m_pages.startOffset(index);
+    const auto maxSize = static_cast<int32>(m_pages.totalSize(index));
+    char headerBuffer[27 + 0xFF];
+    if(const char *data = fetchData(offset, m_pages.headerSize(index), headerBuffer)) {
+        m_currentPage.parseHeader(data, offset, maxSize);
+    } else {
+        m_currentPage.parseHeader(*m_stream, offset, maxSize);
+    }
+    m_loadedPage = index;
+}
+
+/*!
+ * \brief Appends the specified \a page to pages() and sets the iterator position to its first segment.
+ */
+void OggIterator::appendPage(OggPage &&page)
+{
+    m_pages.append(page);
+    m_currentPage = move(page);
+    m_loadedPage = m_page = m_pages.size() - 1;
+    m_segment = m_bytesRead = 0;
+    m_offset = m_currentPage.startOffset() + m_currentPage.headerSize();
+}
+
+/*!
+ * \brief Returns a pointer to \a count bytes at the specified \a offset within the memory mapping of the read source.
+ * \returns Returns nullptr if there is no (usable) memory mapping for the requested range.
+ * \sa setReadSource()
+ */
+const char *OggIterator::mappedData(uint64 offset, uint64 count) const
+{
+    return m_readSource && m_stream == static_cast<const istream *>(&m_readSource->stream())
+            ? m_readSource->mappedData(offset, count)
+            : nullptr;
+}
+
+/*!
+ * \brief Returns a pointer to \a count bytes at the specified \a offset using the memory mapping, the byte source or the
+ *        read cache of the read source.
+ * \returns Returns either a pointer into the memory mapping or \a buffer; returns nullptr if neither the memory mapping
+ *          nor the byte source nor the read cache is usable.
+ * \sa setReadSource()
+ */
+const char *OggIterator::fetchData(uint64 offset, size_t count, char *buffer)
+{
+    if(m_readSource && m_stream == static_cast<istream *>(&m_readSource->stream())
+            && (m_readSource->isMemoryMapped() || m_readSource->byteSource() || m_readSource->readCache().isActive())) {
+        return m_readSource->fetchData(offset, count, buffer);
+    }
+    return nullptr;
+}
+
+/*!
+ * \brief Reads \a count bytes at the current character offset without altering the iterator position.
+ */
+void OggIterator::readCurrent(char *buffer, size_t count)
+{
+    if(const char *data = fetchData(currentCharacterOffset(), count, buffer)) {
+        if(data != buffer) {
+            memcpy(buffer, data, count);
+        }
+    } else {
+        stream().seekg(currentCharacterOffset());
+        stream().read(buffer, count);
+    }
+}
+
 }
@@ -2,12 +2,15 @@
 #define MEDIA_OGGITERATOR_H
 
 #include "./oggpage.h"
+#include "./oggpageindex.h"
 
 #include <iosfwd>
 #include <vector>
 
 namespace Media {
 
+class BasicFileInfo;
+
 class TAG_PARSER_EXPORT OggIterator
 {
 public:
@@ -16,6 +19,8 @@ public:
     void clear(std::istream &stream, uint64 startOffset, uint64 streamSize);
     std::istream &stream();
     void setStream(std::istream &stream);
+    BasicFileInfo *readSource() const;
+    void setReadSource(BasicFileInfo *fileInfo);
     uint64 startOffset() const;
     uint64 streamSize() const;
     void reset();
@@ -23,11 +28,11 @@ public:
     void nextSegment();
     void previousPage();
     void previousSegment();
-    const std::vector<OggPage> &pages() const;
+    const OggPageIndex &pages() const;
     const OggPage &currentPage() const;
     uint64 currentPageOffset() const;
-    std::vector<OggPage>::size_type currentPageIndex() const;
-    void setPageIndex(std::vector<OggPage>::size_type index);
+    std::size_t currentPageIndex() const;
+    void setPageIndex(std::size_t index);
     void setSegmentIndex(std::vector<uint32>::size_type index);
     std::vector<uint32>::size_type currentSegmentIndex() const;
     uint64 currentSegmentOffset() const;
@@ -51,13 +56,22 @@ public:
 
 private:
     bool fetchNextPage();
-    bool matchesFilter(const OggPage &page);
+    void loadPage(std::size_t index);
+    void appendPage(OggPage &&page);
+    uint64 fetchedEndOffset() const;
+    bool matchesFilter(std::size_t index) const;
+    const char *mappedData(uint64 offset, uint64 count) const;
+    const char *fetchData(uint64 offset, std::size_t count, char *buffer);
+    void readCurrent(char *buffer, std::size_t count);
 
     std::istream *m_stream;
+    BasicFileInfo *m_readSource;
     uint64 m_startOffset;
     uint64 m_streamSize;
-    std::vector<OggPage> m_pages;
-    std::vector<OggPage>::size_type m_page;
+    OggPageIndex m_pages;
+    OggPage m_currentPage;
+    std::size_t m_loadedPage;
+    std::size_t m_page;
     std::vector<uint32>::size_type m_segment;
     uint64 m_offset;
     uint32 m_bytesRead;
@@ -70,8 +84,10 @@ private:
  */
 inline OggIterator::OggIterator(std::istream &stream, uint64 startOffset, uint64 streamSize) :
     m_stream(&stream),
+    m_readSource(nullptr),
     m_startOffset(startOffset),
     m_streamSize(streamSize),
+    m_loadedPage(static_cast<std::size_t>(-1)),
     m_page(0),
     m_segment(0),
     m_offset(0),
@@ -100,6 +116,30 @@ inline void OggIterator::setStream(std::istream &stream)
     m_stream = &stream;
 }
 
+/*!
+ * \brief Returns the file info whose memory mapping, byte source or read cache is used to read pages if present.
+ * \sa setReadSource()
+ */
+inline BasicFileInfo *OggIterator::readSource() const
+{
+    return m_readSource;
+}
+
+/*!
+ * \brief Sets the file info whose memory mapping, byte source or read cache should be used to read pages.
+ *
+ * The memory mapping, the byte source and the read cache of the specified \a fileInfo are only used when stream() is
+ * the stream of \a fileInfo and the file is actually mapped, a byte source is assigned or the read cache is active (see
+ * BasicFileInfo::setMemoryMappingEnabled(), BasicFileInfo::setByteSource() and BasicFileInfo::setReadCacheEnabled()).
+ * Otherwise stream() is used directly.
+ *
+ * Setting nullptr disables the usage of a memory mapping and read cache.
+ */
+inline void OggIterator::setReadSource(BasicFileInfo *fileInfo)
+{
+    m_readSource = fileInfo;
+}
+
 /*!
  * \brief Returns the start offset (which has been specified when constructing the iterator).
  */
@@ -117,20 +157,26 @@ inline uint64 OggIterator::streamSize() const
 }
 
 /*!
- * \brief Returns a vector of containing the OGG pages that have been fetched yet.
+ * \brief Returns the index of the OGG pages that have been fetched yet.
+ * \remarks The index only holds the header values of the pages. The segment sizes are only available for the
+ *          current page (see currentPage()).
  */
-inline const std::vector<OggPage> &OggIterator::pages() const
+inline const OggPageIndex &OggIterator::pages() const
 {
     return m_pages;
 }
 
 /*!
  * \brief Returns the current OGG page.
+ *
+ * The page (including its segment sizes) is read again from the file when the iterator moves to a page
+ * so the returned reference is only valid until the iterator is moved to another page.
+ *
  * \remarks Calling this method when the iterator is invalid causes undefined behaviour.
  */
 inline const OggPage &OggIterator::currentPage() const
 {
-    return m_pages[m_page];
+    return m_currentPage;
 }
 
 /*!
@@ -139,7 +185,7 @@ inline const OggPage &OggIterator::currentPage() const
  */
 inline uint64 OggIterator::currentPageOffset() const
 {
-    return m_pages[m_page].startOffset();
+    return m_pages.startOffset(m_page);
 }
 
 /*!
@@ -154,28 +200,17 @@ inline uint64 OggIterator::currentPageOffset() const
  */
 inline OggIterator::operator bool() const
 {
-    return m_page < m_pages.size() && m_segment < m_pages[m_page].segmentSizes().size();
+    return m_page < m_pages.size() && m_segment < m_currentPage.segmentSizes().size();
 }
 
 /*!
  * \brief Returns the index of the current page if the iterator is valid; otherwise an undefined index is returned.
  */
-inline std::vector<OggPage>::size_type OggIterator::currentPageIndex() const
+inline std::size_t OggIterator::currentPageIndex() const
 {
     return m_page;
 }
 
-/*!
- * \brief Sets the current page index.
- * \remarks This method should never be called with an \a index out of range (which is defined by the number of fetched pages), since this would cause undefined behaviour.
- */
-inline void OggIterator::setPageIndex(std::vector<OggPage>::size_type index)
-{
-    const OggPage &page = m_pages[m_page = index];
-    m_segment = 0;
-    m_offset = page.startOffset() + page.headerSize();
-}
-
 /*!
  * \brief Sets the current segment index.
  *
@@ -183,8 +218,7 @@ inline void OggIterator::setPageIndex(std::vector<OggPage>::size_type index)
  */
 inline void OggIterator::setSegmentIndex(std::vector<uint32>::size_type index)
 {
-    const OggPage &page = m_pages[m_page];
-    m_offset = page.dataOffset(m_segment = index);
+    m_offset = m_currentPage.dataOffset(m_segment = index);
 }
 
 /*!
@@ -228,7 +262,7 @@ inline uint64 OggIterator::tellg() const
  */
 inline uint32 OggIterator::currentSegmentSize() const
 {
-    return m_pages[m_page].segmentSizes()[m_segment];
+    return m_currentPage.segmentSizes()[m_segment];
 }
 
 /*!
@@ -258,7 +292,7 @@ inline void OggIterator::removeFilter()
  * \brief Returns an indication whether all pages have been fetched.
  *
  * This means that for each page in the stream in the specified range (stream and range have been specified when
- * constructing the iterator) an OggPage instance has been created and pushed to pages(). This is independend from
+ * constructing the iterator) the page has been added to pages(). This is independend from
  * the current iterator position. Fetched pages remain after resetting the iterator.
  *
  * \remarks This is also true if pages in the middle of the file have been omitted because it is actually just checked
@@ -267,7 +301,7 @@ inline void OggIterator::removeFilter()
  */
 inline bool OggIterator::areAllPagesFetched() const
 {
-    return (m_pages.empty() ? m_startOffset : m_pages.back().startOffset() + m_pages.back().totalSize()) >= m_streamSize;
+    return fetchedEndOffset() >= m_streamSize;
 }
 
 /*!
@@ -317,11 +351,19 @@ inline OggIterator OggIterator::operator--(int)
 }
 
 /*!
- * \brief Returns whether the specified \a page matches the current filter.
+ * \brief Returns the end offset of the last fetched page or the start offset if no pages have been fetched yet.
+ */
+inline uint64 OggIterator::fetchedEndOffset() const
+{
+    return m_pages.empty() ? m_startOffset : m_pages.startOffset(m_pages.size() - 1) + m_pages.totalSize(m_pages.size() - 1);
+}
+
+/*!
+ * \brief Returns whether the page with the specified \a index matches the current filter.
  */
-inline bool OggIterator::matchesFilter(const OggPage &page)
+inline bool OggIterator::matchesFilter(std::size_t index) const
 {
-    return !m_hasIdFilter || m_idFilter == page.streamSerialNumber();
+    return !m_hasIdFilter || m_pages.matchesStreamSerialNumber(index, m_idFilter);
 }
 
 }
@@ -1,10 +1,13 @@
 #include "./oggpage.h"
 
 #include "../exceptions.h"
+#include "../crc32.h"
 
 #include <c++utilities/io/binaryreader.h>
 #include <c++utilities/conversion/binaryconversion.h>
 
+#include <algorithm>
+
 using namespace std;
 using namespace IoUtilities;
 using namespace ConversionUtilities;
@@ -68,6 +71,63 @@ void OggPage::parseHeader(istream &stream, uint64 startOffset, int32 maxSize)
     }
 }
 
+/*!
+ * \brief Parses the header read from the specified \a buffer.
+ *
+ * This is the same as parseHeader(istream &, uint64, int32) but reads the header from memory, eg. from the
+ * memory mapping of the file (see BasicFileInfo::setMemoryMappingEnabled()).
+ *
+ * \param buffer Specifies the beginning of the page; must hold at least \a maxSize bytes or the whole header (27 bytes
+ *               plus segment table).
+ * \param startOffset Specifies the offset of the page within the file.
+ * \param maxSize Specifies the maximum size of the page.
+ * \throws Throws InvalidDataException if the capture pattern is not present.
+ * \throws Throws TruncatedDataException if the header is truncated (according to \a maxSize).
+ */
+void OggPage::parseHeader(const char *buffer, uint64 startOffset, int32 maxSize)
+{
+    if(maxSize < 27) {
+        throw TruncatedDataException();
+    } else {
+        maxSize -= 27;
+    }
+    // read header values
+    if(LE::toUInt32(buffer) != 0x5367674f) {
+        throw InvalidDataException();
+    }
+    m_startOffset = startOffset;
+    m_streamStructureVersion = static_cast<byte>(buffer[4]);
+    m_headerTypeFlag = static_cast<byte>(buffer[5]);
+    m_absoluteGranulePosition = LE::toUInt64(buffer + 6);
+    m_streamSerialNumber = LE::toUInt32(buffer + 14);
+    m_sequenceNumber = LE::toUInt32(buffer + 18);
+    m_checksum = LE::toUInt32(buffer + 22);
+    m_segmentCount = static_cast<byte>(buffer[26]);
+    m_segmentSizes.clear();
+    if(m_segmentCount > 0) {
+        if(maxSize < m_segmentCount) {
+            throw TruncatedDataException();
+        } else {
+            maxSize -= m_segmentCount;
+        }
+        // read segment size tabe
+        const char *segmentTable = buffer + 27;
+        m_segmentSizes.push_back(0);
+        for(byte i = 0; i < m_segmentCount;) {
+            byte entry = static_cast<byte>(segmentTable[i]);
+            maxSize -= entry;
+            m_segmentSizes.back() += entry;
+            if(++i < m_segmentCount && entry < 0xff) {
+                m_segmentSizes.push_back(0);
+            }
+        }
+        // check whether the maximum size is exceeded
+        if(maxSize < 0) {
+            throw TruncatedDataException();
+        }
+    }
+}
+
 /*!
  * \brief Computes the actual checksum of the page read from the specified \a stream
  *        at the specified \a startOffset.
@@ -75,31 +135,23 @@ void OggPage::parseHeader(istream &stream, uint64 startOffset, int32 maxSize)
 uint32 OggPage::computeChecksum(istream &stream, uint64 startOffset)
 {
     stream.seekg(startOffset);
-    uint32 crc = 0x0;
-    byte value, segmentTableSize = 0, segmentTableIndex = 0;
-    for(uint32 i = 0, segmentLength = 27; i != segmentLength; ++i) {
-        switch(i) {
-        case 22:
-            // bytes 22, 23, 24, 25 hold denoted checksum and must be set to zero
-            stream.seekg(4, ios_base::cur);
-        case 23: case 24: case 25:
-            value = 0;
-            break;
-        case 26:
-            // byte 26 holds the number of segment sizes
-            segmentLength += (segmentTableSize = (value = stream.get()));
-            break;
-        default:
-            value = stream.get();
-            if(i > 26 && segmentTableIndex < segmentTableSize) {
-                // bytes 27 to (27 + segment size count) hold page size
-                segmentLength += value;
-                ++segmentTableIndex;
-            }
-        }
-        crc = (crc << 8) ^ BinaryReader::crc32Table[((crc >> 24) & 0xFF) ^ value];
+    Crc32 crc(Crc32::Variant::Ogg);
+    // read header and segment table
+    char buffer[27 + 0xFF];
+    stream.read(buffer, 27);
+    // bytes 22, 23, 24, 25 hold denoted checksum and must be set to zero
+    fill(buffer + 22, buffer + 26, 0);
+    // byte 26 holds the number of segment sizes
+    const auto segmentTableSize = static_cast<byte>(buffer[26]);
+    stream.read(buffer + 27, segmentTableSize);
+    crc.update(buffer, 27 + segmentTableSize);
+    // bytes 27 to (27 + segment size count) hold page size
+    uint64 dataSize = 0;
+    for(const char *segmentSize = buffer + 27, *end = segmentSize + segmentTableSize; segmentSize != end; ++segmentSize) {
+        dataSize += static_cast<byte>(*segmentSize);
     }
-    return crc;
+    crc.update(stream, dataSize);
+    return crc.value();
 }
 
 /*!
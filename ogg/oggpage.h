@@ -16,8 +16,10 @@ class TAG_PARSER_EXPORT OggPage
 public:
     OggPage();
     OggPage(std::istream &stream, uint64 startOffset, int32 maxSize);
+    OggPage(const char *buffer, uint64 startOffset, int32 maxSize);
 
     void parseHeader(std::istream &stream, uint64 startOffset, int32 maxSize);
+    void parseHeader(const char *buffer, uint64 startOffset, int32 maxSize);
     static uint32 computeChecksum(std::istream &stream, uint64 startOffset);
     static void updateChecksum(std::iostream &stream, uint64 startOffset);
 
@@ -76,6 +78,16 @@ inline OggPage::OggPage(std::istream &stream, uint64 startOffset, int32 maxSize)
     parseHeader(stream, startOffset, maxSize);
 }
 
+/*!
+ * \brief Constructs a new OggPage and instantly parses the header read from the specified \a buffer.
+ * \remarks The \a buffer must hold at least \a maxSize bytes or the whole header (27 bytes plus segment table).
+ */
+inline OggPage::OggPage(const char *buffer, uint64 startOffset, int32 maxSize) :
+    OggPage()
+{
+    parseHeader(buffer, startOffset, maxSize);
+}
+
 /*!
  * \brief Returns the start offset of the page.
  *
@@ -0,0 +1,91 @@
+#include "./oggpageindex.h"
+#include "./oggpage.h"
+
+using namespace std;
+
+namespace Media {
+
+/*!
+ * \class Media::OggPageIndex
+ * \brief The OggPageIndex class holds the header values of the OGG pages fetched by an OggIterator.
+ *
+ * The values are stored in separate vectors per field (rather than a vector of OggPage objects) so a page takes
+ * only 32 bytes and no additional heap allocation. The segment table is not stored at all; the OggIterator decodes
+ * it from the file when it moves to a page (see OggIterator::currentPage()).
+ *
+ * Pages are identified by their index which corresponds to the order they have been fetched.
+ */
+
+/*!
+ * \brief Removes all pages from the index.
+ */
+void OggPageIndex::clear()
+{
+    m_startOffsets.clear();
+    m_absoluteGranulePositions.clear();
+    m_streamSerialNumbers.clear();
+    m_sequenceNumbers.clear();
+    m_checksums.clear();
+    m_dataSizes.clear();
+    m_segmentTableSizes.clear();
+    m_headerTypeFlags.clear();
+}
+
+/*!
+ * \brief Appends the header values of the specified \a page to the index.
+ */
+void OggPageIndex::append(const OggPage &page)
+{
+    m_startOffsets.push_back(page.startOffset());
+    m_absoluteGranulePositions.push_back(page.absoluteGranulePosition());
+    m_streamSerialNumbers.push_back(page.streamSerialNumber());
+    m_sequenceNumbers.push_back(page.sequenceNumber());
+    m_checksums.push_back(page.checksum());
+    // the data size of a page can not exceed 255 * 255 bytes
+    m_dataSizes.push_back(static_cast<uint16>(page.dataSize()));
+    m_segmentTableSizes.push_back(page.segmentTableSize());
+    m_headerTypeFlags.push_back(page.headerTypeFlag());
+}
+
+/*!
+ * \brief Returns the index of the first page with the specified \a streamSerialNumber or size() if there is no such page.
+ */
+std::size_t OggPageIndex::findFirst(uint32 streamSerialNumber) const
+{
+    for(size_t index = 0, size = this->size(); index != size; ++index) {
+        if(m_streamSerialNumbers[index] == streamSerialNumber) {
+            return index;
+        }
+    }
+    return size();
+}
+
+/*!
+ * \brief Returns the index of the last page with the specified \a streamSerialNumber or size() if there is no such page.
+ */
+std::size_t OggPageIndex::findLast(uint32 streamSerialNumber) const
+{
+    for(size_t index = size(); index; --index) {
+        if(m_streamSerialNumbers[index - 1] == streamSerialNumber) {
+            return index - 1;
+        }
+    }
+    return size();
+}
+
+/*!
+ * \brief Returns the number of bytes allocated by the index.
+ */
+std::size_t OggPageIndex::memoryUsage() const
+{
+    return m_startOffsets.capacity() * sizeof(uint64)
+            + m_absoluteGranulePositions.capacity() * sizeof(uint64)
+            + m_streamSerialNumbers.capacity() * sizeof(uint32)
+            + m_sequenceNumbers.capacity() * sizeof(uint32)
+            + m_checksums.capacity() * sizeof(uint32)
+            + m_dataSizes.capacity() * sizeof(uint16)
+            + m_segmentTableSizes.capacity() * sizeof(byte)
+            + m_headerTypeFlags.capacity() * sizeof(byte);
+}
+
+}
@@ -0,0 +1,172 @@
+#ifndef MEDIA_OGGPAGEINDEX_H
+#define MEDIA_OGGPAGEINDEX_H
+
+#include "../global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <vector>
+
+namespace Media {
+
+class OggPage;
+
+class TAG_PARSER_EXPORT OggPageIndex
+{
+public:
+    OggPageIndex();
+
+    std::size_t size() const;
+    bool empty() const;
+    void clear();
+    void append(const OggPage &page);
+
+    uint64 startOffset(std::size_t index) const;
+    byte headerTypeFlag(std::size_t index) const;
+    uint64 absoluteGranulePosition(std::size_t index) const;
+    uint32 streamSerialNumber(std::size_t index) const;
+    bool matchesStreamSerialNumber(std::size_t index, uint32 streamSerialNumber) const;
+    uint32 sequenceNumber(std::size_t index) const;
+    uint32 checksum(std::size_t index) const;
+    byte segmentTableSize(std::size_t index) const;
+    uint32 headerSize(std::size_t index) const;
+    uint32 dataSize(std::size_t index) const;
+    uint32 totalSize(std::size_t index) const;
+    std::size_t findFirst(uint32 streamSerialNumber) const;
+    std::size_t findLast(uint32 streamSerialNumber) const;
+    std::size_t memoryUsage() const;
+
+private:
+    std::vector<uint64> m_startOffsets;
+    std::vector<uint64> m_absoluteGranulePositions;
+    std::vector<uint32> m_streamSerialNumbers;
+    std::vector<uint32> m_sequenceNumbers;
+    std::vector<uint32> m_checksums;
+    std::vector<uint16> m_dataSizes;
+    std::vector<byte> m_segmentTableSizes;
+    std::vector<byte> m_headerTypeFlags;
+};
+
+/*!
+ * \brief Constructs an empty index.
+ */
+inline OggPageIndex::OggPageIndex()
+{}
+
+/*!
+ * \brief Returns the number of pages in the index.
+ */
+inline std::size_t OggPageIndex::size() const
+{
+    return m_startOffsets.size();
+}
+
+/*!
+ * \brief Returns whether the index contains no pages.
+ */
+inline bool OggPageIndex::empty() const
+{
+    return m_startOffsets.empty();
+}
+
+/*!
+ * \brief Returns the start offset of the page with the specified \a index.
+ * \sa OggPage::startOffset()
+ */
+inline uint64 OggPageIndex::startOffset(std::size_t index) const
+{
+    return m_startOffsets[index];
+}
+
+/*!
+ * \brief Returns the header type flag of the page with the specified \a index.
+ * \sa OggPage::headerTypeFlag()
+ */
+inline byte OggPageIndex::headerTypeFlag(std::size_t index) const
+{
+    return m_headerTypeFlags[index];
+}
+
+/*!
+ * \brief Returns the absolute granule position of the page with the specified \a index.
+ * \sa OggPage::absoluteGranulePosition()
+ */
+inline uint64 OggPageIndex::absoluteGranulePosition(std::size_t index) const
+{
+    return m_absoluteGranulePositions[index];
+}
+
+/*!
+ * \brief Returns the stream serial number of the page with the specified \a index.
+ * \sa OggPage::streamSerialNumber()
+ */
+inline uint32 OggPageIndex::streamSerialNumber(std::size_t index) const
+{
+    return m_streamSerialNumbers[index];
+}
+
+/*!
+ * \brief Returns whether the stream serial number of the page with the specified \a index matches the specified one.
+ */
+inline bool OggPageIndex::matchesStreamSerialNumber(std::size_t index, uint32 streamSerialNumber) const
+{
+    return m_streamSerialNumbers[index] == streamSerialNumber;
+}
+
+/*!
+ * \brief Returns the page sequence number of the page with the specified \a index.
+ * \sa OggPage::sequenceNumber()
+ */
+inline uint32 OggPageIndex::sequenceNumber(std::size_t index) const
+{
+    return m_sequenceNumbers[index];
+}
+
+/*!
+ * \brief Returns the denoted checksum of the page with the specified \a index.
+ * \sa OggPage::checksum()
+ */
+inline uint32 OggPageIndex::checksum(std::size_t index) const
+{
+    return m_checksums[index];
+}
+
+/*!
+ * \brief Returns the size of the segment table of the page with the specified \a index.
+ * \sa OggPage::segmentTableSize()
+ */
+inline byte OggPageIndex::segmentTableSize(std::size_t index) const
+{
+    return m_segmentTableSizes[index];
+}
+
+/*!
+ * \brief Returns the header size of the page with the specified \a index.
+ * \sa OggPage::headerSize()
+ */
+inline uint32 OggPageIndex::headerSize(std::size_t index) const
+{
+    return 27u + m_segmentTableSizes[index];
+}
+
+/*!
+ * \brief Returns the data size of the page with the specified \a index.
+ * \sa OggPage::dataSize()
+ */
+inline uint32 OggPageIndex::dataSize(std::size_t index) const
+{
+    return m_dataSizes[index];
+}
+
+/*!
+ * \brief Returns the total size of the page with the specified \a index.
+ * \sa OggPage::totalSize()
+ */
+inline uint32 OggPageIndex::totalSize(std::size_t index) const
+{
+    return headerSize(index) + dataSize(index);
+}
+
+}
+
+#endif // MEDIA_OGGPAGEINDEX_H
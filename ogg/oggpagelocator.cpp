@@ -0,0 +1,151 @@
+#include "./oggpagelocator.h"
+
+#include "../exceptions.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace Media {
+
+/// \brief The size of the range at the end of the stream which is searched first for the last page of a stream.
+static constexpr uint64 initialTailSize = 0x10000;
+
+/// \brief The size of the range below which the bisection continues with walking the pages.
+static constexpr uint64 bisectionThreshold = 0x40000;
+
+/*!
+ * \class Media::OggPageLocator
+ * \brief The OggPageLocator class finds particular pages of an OGG bitstream without walking all pages.
+ *
+ * Pages are located by re-syncing at arbitrary offsets using OggIterator::resyncAt(). Only the page headers (and the
+ * page the iterator re-synced to for validating its checksum) are read. This allows to
+ * - determine the last page of a logical stream by only reading the end of the file (see findLastPage()).
+ * - seek to a granule position by bisection (see findPage()).
+ *
+ * The granule positions of the pages of a logical stream are expected to increase monotonically.
+ */
+
+/*!
+ * \brief Finds the last page of the stream with the specified \a streamSerialNumber which denotes a granule position.
+ *
+ * The range searched is extended from the end of the stream towards the start offset until such a page is found. So
+ * usually only the page headers within the last few KiB of the stream need to be read.
+ *
+ * \returns Returns whether a page could be found. In this case the page is assigned to \a page.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+bool OggPageLocator::findLastPage(uint32 streamSerialNumber, OggPage &page)
+{
+    for(uint64 tailSize = initialTailSize; ; tailSize *= 2) {
+        const uint64 offset = m_streamSize - m_startOffset > tailSize ? m_streamSize - tailSize : m_startOffset;
+        if(syncAt(offset)) {
+            // fetch all remaining pages (only the header values are kept)
+            try {
+                for(m_iterator.removeFilter(); m_iterator.currentPageIndex() < m_iterator.pages().size(); m_iterator.nextPage());
+            } catch(const Failure &) {
+                // just consider the pages which could be fetched
+            }
+            const OggPageIndex &pages = m_iterator.pages();
+            for(size_t index = pages.size(); index; --index) {
+                if(pages.matchesStreamSerialNumber(index - 1, streamSerialNumber)
+                        && pages.absoluteGranulePosition(index - 1) != numeric_limits<uint64>::max()) {
+                    m_iterator.setPageIndex(index - 1);
+                    page = m_iterator.currentPage();
+                    return true;
+                }
+            }
+        }
+        if(offset == m_startOffset) {
+            return false;
+        }
+    }
+}
+
+/*!
+ * \brief Finds the first page of the stream with the specified \a streamSerialNumber whose granule position is at least
+ *        the specified \a granulePosition.
+ *
+ * The page is located by bisecting the byte range of the stream. Once the range is small enough, the pages within
+ * the range are walked.
+ *
+ * \returns Returns whether a page could be found. In this case the page is assigned to \a page.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+bool OggPageLocator::findPage(uint32 streamSerialNumber, uint64 granulePosition, OggPage &page)
+{
+    uint64 low = m_startOffset, high = m_streamSize;
+    while(high - low > bisectionThreshold) {
+        const uint64 middle = low + (high - low) / 2;
+        if(!syncAt(middle) || !findGranulePage(streamSerialNumber, 0, high, nullptr)) {
+            // no page of the stream within the upper half
+            high = middle;
+            continue;
+        }
+        const OggPageIndex &pages = m_iterator.pages();
+        const size_t index = m_iterator.currentPageIndex();
+        if(pages.absoluteGranulePosition(index) < granulePosition) {
+            low = pages.startOffset(index) + pages.totalSize(index);
+        } else {
+            high = middle;
+        }
+    }
+    return syncAt(low) && findGranulePage(streamSerialNumber, granulePosition, m_streamSize, &page);
+}
+
+/*!
+ * \brief Re-syncs at the first page at or after the specified \a offset whose checksum is valid.
+ * \remarks Checking the checksum prevents syncing to a capture pattern which is actually part of the packet data.
+ */
+bool OggPageLocator::syncAt(uint64 offset)
+{
+    for(;;) {
+        m_pagesFetched += m_iterator.pages().size();
+        m_iterator.clear(m_iterator.stream(), offset, m_streamSize);
+        if(!m_iterator.resyncAt(offset)) {
+            return false;
+        }
+        const OggPage &page = m_iterator.currentPage();
+        if(OggPage::computeChecksum(m_iterator.stream(), page.startOffset()) == page.checksum()) {
+            return true;
+        }
+        offset = page.startOffset() + 1;
+    }
+}
+
+/*!
+ * \brief Walks the pages starting at the current page until a page of the stream with the specified
+ *        \a streamSerialNumber with a granule position of at least \a minGranulePosition is found.
+ *
+ * Pages starting at or after \a endOffset are not considered. If a page is found the iterator points to it and it is
+ * assigned to \a page (unless \a page is nullptr).
+ *
+ * \returns Returns whether a page could be found.
+ */
+bool OggPageLocator::findGranulePage(uint32 streamSerialNumber, uint64 minGranulePosition, uint64 endOffset, OggPage *page)
+{
+    const OggPageIndex &pages = m_iterator.pages();
+    try {
+        for(m_iterator.removeFilter(); m_iterator.currentPageIndex() < pages.size(); m_iterator.nextPage()) {
+            const size_t index = m_iterator.currentPageIndex();
+            if(pages.startOffset(index) >= endOffset) {
+                return false;
+            }
+            const uint64 pageGranulePosition = pages.absoluteGranulePosition(index);
+            if(pages.matchesStreamSerialNumber(index, streamSerialNumber)
+                    && pageGranulePosition != numeric_limits<uint64>::max()
+                    && pageGranulePosition >= minGranulePosition) {
+                if(page) {
+                    m_iterator.setPageIndex(index);
+                    *page = m_iterator.currentPage();
+                }
+                return true;
+            }
+        }
+    } catch(const Failure &) {
+        // consider the end of the stream reached when a page can not be parsed
+    }
+    return false;
+}
+
+}
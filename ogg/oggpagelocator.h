@@ -0,0 +1,69 @@
+#ifndef MEDIA_OGGPAGELOCATOR_H
+#define MEDIA_OGGPAGELOCATOR_H
+
+#include "./oggiterator.h"
+
+namespace Media {
+
+class TAG_PARSER_EXPORT OggPageLocator
+{
+public:
+    OggPageLocator(std::istream &stream, uint64 startOffset, uint64 streamSize);
+
+    BasicFileInfo *readSource() const;
+    void setReadSource(BasicFileInfo *fileInfo);
+    std::size_t pagesFetched() const;
+    bool findLastPage(uint32 streamSerialNumber, OggPage &page);
+    bool findPage(uint32 streamSerialNumber, uint64 granulePosition, OggPage &page);
+
+private:
+    bool syncAt(uint64 offset);
+    bool findGranulePage(uint32 streamSerialNumber, uint64 minGranulePosition, uint64 endOffset, OggPage *page);
+
+    OggIterator m_iterator;
+    uint64 m_startOffset;
+    uint64 m_streamSize;
+    std::size_t m_pagesFetched;
+};
+
+/*!
+ * \brief Constructs a new locator for the pages of the specified \a stream of \a streamSize bytes at the
+ *        specified \a startOffset.
+ */
+inline OggPageLocator::OggPageLocator(std::istream &stream, uint64 startOffset, uint64 streamSize) :
+    m_iterator(stream, startOffset, streamSize),
+    m_startOffset(startOffset),
+    m_streamSize(streamSize),
+    m_pagesFetched(0)
+{}
+
+/*!
+ * \brief Returns the file info whose memory mapping, byte source or read cache is used to read pages if present.
+ * \sa OggIterator::readSource()
+ */
+inline BasicFileInfo *OggPageLocator::readSource() const
+{
+    return m_iterator.readSource();
+}
+
+/*!
+ * \brief Sets the file info whose memory mapping, byte source or read cache should be used to read pages.
+ * \sa OggIterator::setReadSource()
+ */
+inline void OggPageLocator::setReadSource(BasicFileInfo *fileInfo)
+{
+    m_iterator.setReadSource(fileInfo);
+}
+
+/*!
+ * \brief Returns the number of page headers which have been read so far.
+ * \remarks Useful to estimate the amount of IO caused by the locator.
+ */
+inline std::size_t OggPageLocator::pagesFetched() const
+{
+    return m_pagesFetched + m_iterator.pages().size();
+}
+
+}
+
+#endif // MEDIA_OGGPAGELOCATOR_H
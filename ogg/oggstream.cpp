@@ -1,5 +1,6 @@
 #include "./oggstream.h"
 #include "./oggcontainer.h"
+#include "./oggpagelocator.h"
 
 #include "../vorbis/vorbispackagetypes.h"
 #include "../vorbis/vorbisidentificationheader.h"
@@ -15,10 +16,8 @@
 #include <c++utilities/chrono/timespan.h>
 
 #include <iostream>
-#include <functional>
 
 using namespace std;
-using namespace std::placeholders;
 using namespace ChronoUtilities;
 
 namespace Media {
@@ -31,11 +30,12 @@ namespace Media {
 /*!
  * \brief Constructs a new track for the \a stream at the specified \a startOffset.
  */
-OggStream::OggStream(OggContainer &container, vector<OggPage>::size_type startPage) :
-    AbstractTrack(container.stream(), container.m_iterator.pages()[startPage].startOffset()),
+OggStream::OggStream(OggContainer &container, std::size_t startPage) :
+    AbstractTrack(container.stream(), container.m_iterator.pages().startOffset(startPage)),
     m_startPage(startPage),
     m_container(container),
-    m_currentSequenceNumber(0)
+    m_currentSequenceNumber(0),
+    m_preSkip(0)
 {}
 
 /*!
@@ -50,13 +50,12 @@ void OggStream::internalParseHeader()
 
     // read basic information from first page
     OggIterator &iterator = m_container.m_iterator;
-    const OggPage &firstPage = iterator.pages()[m_startPage];
-    m_version = firstPage.streamStructureVersion();
-    m_id = firstPage.streamSerialNumber();
-
     // ensure iterator is setup properly
-    iterator.setFilter(firstPage.streamSerialNumber());
+    iterator.setFilter(iterator.pages().streamSerialNumber(m_startPage));
     iterator.setPageIndex(m_startPage);
+    const OggPage &firstPage = iterator.currentPage();
+    m_version = firstPage.streamStructureVersion();
+    m_id = firstPage.streamSerialNumber();
 
     // iterate through segments using OggIterator
     for(bool hasIdentificationHeader = false, hasCommentHeader = false; iterator && (!hasIdentificationHeader || !hasCommentHeader); ++iterator) {
@@ -139,7 +138,8 @@ void OggStream::internalParseHeader()
                     m_version = ind.version();
                     m_channelCount = ind.channels();
                     m_samplingFrequency = ind.sampleRate();
-                    calculateDurationViaSampleCount(ind.preSkip());
+                    m_preSkip = ind.preSkip();
+                    calculateDurationViaSampleCount(m_preSkip);
                     hasIdentificationHeader = true;
                 } else {
                     addNotification(NotificationType::Critical, "Opus identification header appears more than once. Oversupplied occurrence will be ignored.", context);
@@ -277,19 +277,50 @@ void OggStream::internalParseHeader()
     m_headerValid = true;
 }
 
-void OggStream::calculateDurationViaSampleCount(uint16 preSkip)
+/*!
+ * \brief Finds the page of the stream which contains the sample at the specified \a time.
+ *
+ * The page is located by bisecting the file (see OggPageLocator::findPage()) so only a few page headers need to be
+ * read, regardless of the size of the file. This is only supported for audio streams (Vorbis, Opus and FLAC) whose
+ * granule position is the sample number.
+ *
+ * \returns Returns whether a page could be found. In this case the page is assigned to \a page.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \remarks The header must have been parsed before (see parseHeader()).
+ */
+bool OggStream::findPage(const TimeSpan &time, OggPage &page)
 {
-    // define predicate for finding pages of this stream by its stream serial number
-    const auto pred = bind(&OggPage::matchesStreamSerialNumber, _1, m_id);
+    double granuleRate;
+    switch(m_format.general) {
+    case GeneralMediaFormat::Opus:
+        // the granule position of Opus streams is always based on 48 kHz
+        granuleRate = 48000.0;
+        break;
+    case GeneralMediaFormat::Vorbis:
+    case GeneralMediaFormat::Flac:
+        granuleRate = m_samplingFrequency;
+        break;
+    default:
+        return false;
+    }
+    if(granuleRate == 0.0 || time.isNegative()) {
+        return false;
+    }
+    OggPageLocator locator(m_container.fileInfo().stream(), m_container.startOffset(), m_container.fileInfo().size());
+    locator.setReadSource(&m_container.fileInfo());
+    return locator.findPage(static_cast<uint32>(m_id), static_cast<uint64>(time.totalSeconds() * granuleRate) + m_preSkip, page);
+}
 
+void OggStream::calculateDurationViaSampleCount(uint16 preSkip)
+{
     // determine sample count
     const auto &iterator = m_container.m_iterator;
     if(!m_sampleCount && iterator.areAllPagesFetched()) {
         const auto &pages = iterator.pages();
-        const auto firstPage = find_if(pages.cbegin(), pages.cend(), pred);
-        const auto lastPage = find_if(pages.crbegin(), pages.crend(), pred);
-        if(firstPage != pages.cend() && lastPage != pages.crend()) {
-            m_sampleCount = lastPage->absoluteGranulePosition() - firstPage->absoluteGranulePosition();
+        const auto firstPage = pages.findFirst(static_cast<uint32>(m_id));
+        const auto lastPage = pages.findLast(static_cast<uint32>(m_id));
+        if(firstPage != pages.size() && lastPage != pages.size()) {
+            m_sampleCount = pages.absoluteGranulePosition(lastPage) - pages.absoluteGranulePosition(firstPage);
             // must apply "pre-skip" here to calculate effective sample count and duration?
             if(m_sampleCount > preSkip) {
                 m_sampleCount -= preSkip;
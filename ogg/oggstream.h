@@ -15,11 +15,12 @@ class TAG_PARSER_EXPORT OggStream : public AbstractTrack
     friend class OggContainer;
 
 public:
-    OggStream(OggContainer &container, std::vector<OggPage>::size_type startPage);
+    OggStream(OggContainer &container, std::size_t startPage);
     ~OggStream();
 
     TrackType type() const;
     std::size_t startPage() const;
+    bool findPage(const ChronoUtilities::TimeSpan &time, OggPage &page);
 
 protected:
     void internalParseHeader();
@@ -30,6 +31,7 @@ private:
     std::size_t m_startPage;
     OggContainer &m_container;
     uint32 m_currentSequenceNumber;
+    uint16 m_preSkip;
 };
 
 inline std::size_t OggStream::startPage() const
@@ -0,0 +1,268 @@
+#include "./parseindex.h"
+
+#include <c++utilities/conversion/stringconversion.h>
+#include <c++utilities/io/binaryreader.h>
+#include <c++utilities/io/binarywriter.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+
+using namespace std;
+using namespace ConversionUtilities;
+using namespace IoUtilities;
+
+namespace Media {
+
+/*!
+ * \class Media::ParseIndex
+ * \brief The ParseIndex class holds the locations of relevant structures within a file so they can be found
+ *        again without walking the file.
+ *
+ * Container implementations store the offsets they determined when parsing a file as entries of the index (see
+ * MediaFileInfo::parseIndex()). The index is saved within a cache directory and loaded again when the same file is
+ * parsed the next time (see MediaFileInfo::setIndexCacheDirectory()). Container implementations must verify entries
+ * they rely on (eg. by checking the IDs of elements at cached offsets) and fall back to regular parsing otherwise.
+ *
+ * An index belongs to a file identified by its path, size, modification time and a fingerprint of its first and
+ * last bytes. A saved index is only loaded when all of these values match so changed files are parsed regularly.
+ *
+ * The entries are lists of unsigned integers identified by keys. Keys are prefixed with the name of the container
+ * format (eg. "matroska.elements").
+ */
+
+/// \brief The magic number which introduces saved indices.
+static const char parseIndexMagic[] = {'T', 'P', 'I', 'X'};
+
+/// \brief The version of the format of saved indices; indices of other versions are ignored.
+static const uint16 parseIndexVersion = 1;
+
+/// \brief The number of bytes at the beginning and the end of a file which are considered by the fingerprint.
+static const uint64 parseIndexFingerprintSize = 0x1000;
+
+/// \brief Computes the FNV-1a hash of the specified \a data continuing the specified \a hash.
+static uint64 fnv1a(const char *data, size_t size, uint64 hash = 0xCBF29CE484222325ul)
+{
+    for(const char *end = data + size; data != end; ++data) {
+        hash ^= static_cast<byte>(*data);
+        hash *= 0x100000001B3ul;
+    }
+    return hash;
+}
+
+/*!
+ * \brief Constructs a new, empty index.
+ */
+ParseIndex::ParseIndex() :
+    m_fileSize(0),
+    m_modificationTime(0),
+    m_fingerprint(0),
+    m_identified(false),
+    m_modified(false)
+{}
+
+/*!
+ * \brief Determines the identity of the file with the specified \a path and \a fileSize.
+ *
+ * The specified \a stream is used to read the bytes the fingerprint is computed from. Entries are cleared if the
+ * identity differs from the previous one.
+ *
+ * \throws Throws std::ios_base::failure when the modification time can not be determined or an IO error occurs.
+ */
+void ParseIndex::identify(const std::string &path, std::istream &stream, uint64 fileSize)
+{
+    struct stat fileStat;
+    if(stat(path.data(), &fileStat) != 0) {
+        throw ios_base::failure("Unable to determine the modification time of the file.");
+    }
+    const uint64 fingerprint = computeFingerprint(stream, fileSize);
+    if(!m_identified || path != m_path || fileSize != m_fileSize
+            || static_cast<int64>(fileStat.st_mtime) != m_modificationTime || fingerprint != m_fingerprint) {
+        m_entries.clear();
+        m_modified = false;
+    }
+    m_path = path;
+    m_fileSize = fileSize;
+    m_modificationTime = static_cast<int64>(fileStat.st_mtime);
+    m_fingerprint = fingerprint;
+    m_identified = true;
+}
+
+/*!
+ * \brief Sets the \a values of the entry with the specified \a key.
+ * \remarks Marks the index as modified if the values differ from the present ones.
+ */
+void ParseIndex::setEntry(const std::string &key, std::vector<uint64> values)
+{
+    auto &entry = m_entries[key];
+    if(entry != values) {
+        entry = move(values);
+        m_modified = true;
+    }
+}
+
+/*!
+ * \brief Removes all entries and the identity.
+ */
+void ParseIndex::clear()
+{
+    m_path.clear();
+    m_fileSize = 0;
+    m_modificationTime = 0;
+    m_fingerprint = 0;
+    m_identified = false;
+    m_modified = false;
+    m_entries.clear();
+}
+
+/*!
+ * \brief Returns the path of the file the index is saved to within the specified \a directory.
+ *
+ * The file name is derived from the path of the indexed file.
+ */
+string ParseIndex::cacheFilePath(const std::string &directory) const
+{
+    string cacheFilePath(directory);
+    if(!cacheFilePath.empty() && cacheFilePath.back() != '/' && cacheFilePath.back() != '\\') {
+        cacheFilePath += '/';
+    }
+    cacheFilePath += numberToString(fnv1a(m_path.data(), m_path.size()), 16);
+    cacheFilePath += ".tpidx";
+    return cacheFilePath;
+}
+
+/*!
+ * \brief Loads the index saved within the specified \a directory.
+ *
+ * The entries are only loaded if the saved identity matches the current identity.
+ *
+ * \returns Returns whether the entries have been loaded. If not, the entries are cleared.
+ * \throws Throws std::ios_base::failure when an IO error occurs, eg. the saved index is truncated.
+ * \remarks identify() must have been called before.
+ */
+bool ParseIndex::load(const std::string &directory)
+{
+    m_entries.clear();
+    m_modified = false;
+    if(!m_identified) {
+        return false;
+    }
+
+    ifstream file;
+    file.open(cacheFilePath(directory), ios_base::in | ios_base::binary);
+    if(!file.is_open()) {
+        return false;
+    }
+    file.exceptions(ios_base::failbit | ios_base::badbit);
+    BinaryReader reader(&file);
+
+    // check header and identity
+    char magic[sizeof(parseIndexMagic)];
+    reader.read(magic, sizeof(magic));
+    if(!equal(magic, magic + sizeof(magic), parseIndexMagic) || reader.readUInt16BE() != parseIndexVersion) {
+        return false;
+    }
+    if(reader.readLengthPrefixedString() != m_path
+            || reader.readUInt64BE() != m_fileSize
+            || reader.readInt64BE() != m_modificationTime
+            || reader.readUInt64BE() != m_fingerprint) {
+        return false;
+    }
+
+    // read entries
+    try {
+        for(uint32 entryCount = reader.readUInt32BE(); entryCount; --entryCount) {
+            const string key = reader.readLengthPrefixedString();
+            const uint32 valueCount = reader.readUInt32BE();
+            if(valueCount > (m_fileSize / sizeof(uint64) + 0x100)) {
+                // the number of values can not reasonably exceed this limit
+                throw ios_base::failure("The saved index is corrupted.");
+            }
+            vector<uint64> values;
+            values.reserve(valueCount);
+            for(uint32 i = 0; i != valueCount; ++i) {
+                values.emplace_back(reader.readUInt64BE());
+            }
+            m_entries[key] = move(values);
+        }
+    } catch(...) {
+        m_entries.clear();
+        throw;
+    }
+    return true;
+}
+
+/*!
+ * \brief Saves the index within the specified \a directory.
+ *
+ * The index is written to a temporary file first which is renamed afterwards so concurrent loads never see
+ * a partially written index.
+ *
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ * \remarks identify() must have been called before.
+ */
+void ParseIndex::save(const std::string &directory)
+{
+    if(!m_identified) {
+        throw ios_base::failure("Unable to save an index of an unidentified file.");
+    }
+    const string path = cacheFilePath(directory), temporaryPath = path + ".tmp";
+    {
+        ofstream file;
+        file.exceptions(ios_base::failbit | ios_base::badbit);
+        file.open(temporaryPath, ios_base::out | ios_base::trunc | ios_base::binary);
+        BinaryWriter writer(&file);
+        writer.write(parseIndexMagic, sizeof(parseIndexMagic));
+        writer.writeUInt16BE(parseIndexVersion);
+        writer.writeLengthPrefixedString(m_path);
+        writer.writeUInt64BE(m_fileSize);
+        writer.writeInt64BE(m_modificationTime);
+        writer.writeUInt64BE(m_fingerprint);
+        writer.writeUInt32BE(static_cast<uint32>(m_entries.size()));
+        for(const auto &entry : m_entries) {
+            writer.writeLengthPrefixedString(entry.first);
+            writer.writeUInt32BE(static_cast<uint32>(entry.second.size()));
+            for(const uint64 value : entry.second) {
+                writer.writeUInt64BE(value);
+            }
+        }
+        file.close();
+    }
+    if(rename(temporaryPath.data(), path.data()) != 0) {
+        // renaming fails on some platforms if the target already exists
+        remove(path.data());
+        if(rename(temporaryPath.data(), path.data()) != 0) {
+            remove(temporaryPath.data());
+            throw ios_base::failure("Unable to move the index to the cache directory.");
+        }
+    }
+    m_modified = false;
+}
+
+/*!
+ * \brief Computes a fingerprint of the first and last bytes of the specified \a stream which has the specified
+ *        \a fileSize.
+ *
+ * Taggers usually only modify the beginning or the end of a file. Hence the fingerprint detects modifications which
+ * do not alter the size and the modification time (eg. when the modification time has been restored).
+ */
+uint64 ParseIndex::computeFingerprint(std::istream &stream, uint64 fileSize)
+{
+    char buffer[parseIndexFingerprintSize];
+    const auto headSize = static_cast<streamsize>(min(fileSize, parseIndexFingerprintSize));
+    stream.seekg(0);
+    stream.read(buffer, headSize);
+    uint64 hash = fnv1a(buffer, static_cast<size_t>(headSize));
+    if(fileSize > parseIndexFingerprintSize) {
+        const auto tailSize = static_cast<streamsize>(min(fileSize - parseIndexFingerprintSize, parseIndexFingerprintSize));
+        stream.seekg(static_cast<streamoff>(fileSize) - tailSize);
+        stream.read(buffer, tailSize);
+        hash = fnv1a(buffer, static_cast<size_t>(tailSize), hash);
+    }
+    return hash;
+}
+
+}
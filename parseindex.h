@@ -0,0 +1,117 @@
+#ifndef MEDIA_PARSEINDEX_H
+#define MEDIA_PARSEINDEX_H
+
+#include "./global.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <iosfwd>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Media {
+
+class TAG_PARSER_EXPORT ParseIndex
+{
+public:
+    ParseIndex();
+
+    const std::string &path() const;
+    uint64 fileSize() const;
+    int64 modificationTime() const;
+    uint64 fingerprint() const;
+    bool isIdentified() const;
+    void identify(const std::string &path, std::istream &stream, uint64 fileSize);
+
+    bool isEmpty() const;
+    bool isModified() const;
+    const std::vector<uint64> *entry(const std::string &key) const;
+    void setEntry(const std::string &key, std::vector<uint64> values);
+    void clear();
+
+    std::string cacheFilePath(const std::string &directory) const;
+    bool load(const std::string &directory);
+    void save(const std::string &directory);
+
+    static uint64 computeFingerprint(std::istream &stream, uint64 fileSize);
+
+private:
+    std::string m_path;
+    uint64 m_fileSize;
+    int64 m_modificationTime;
+    uint64 m_fingerprint;
+    bool m_identified;
+    bool m_modified;
+    std::map<std::string, std::vector<uint64> > m_entries;
+};
+
+/*!
+ * \brief Returns the path of the file the index belongs to.
+ */
+inline const std::string &ParseIndex::path() const
+{
+    return m_path;
+}
+
+/*!
+ * \brief Returns the size of the file the index belongs to.
+ */
+inline uint64 ParseIndex::fileSize() const
+{
+    return m_fileSize;
+}
+
+/*!
+ * \brief Returns the modification time of the file the index belongs to (in seconds since the epoch).
+ */
+inline int64 ParseIndex::modificationTime() const
+{
+    return m_modificationTime;
+}
+
+/*!
+ * \brief Returns the fingerprint of the first and last bytes of the file the index belongs to.
+ * \sa computeFingerprint()
+ */
+inline uint64 ParseIndex::fingerprint() const
+{
+    return m_fingerprint;
+}
+
+/*!
+ * \brief Returns whether identify() has been called.
+ */
+inline bool ParseIndex::isIdentified() const
+{
+    return m_identified;
+}
+
+/*!
+ * \brief Returns whether the index contains no entries.
+ */
+inline bool ParseIndex::isEmpty() const
+{
+    return m_entries.empty();
+}
+
+/*!
+ * \brief Returns whether entries have been set since the index has been loaded or saved.
+ */
+inline bool ParseIndex::isModified() const
+{
+    return m_modified;
+}
+
+/*!
+ * \brief Returns the values of the entry with the specified \a key or nullptr if there is no such entry.
+ */
+inline const std::vector<uint64> *ParseIndex::entry(const std::string &key) const
+{
+    const auto entry = m_entries.find(key);
+    return entry != m_entries.cend() ? &entry->second : nullptr;
+}
+
+}
+
+#endif // MEDIA_PARSEINDEX_H
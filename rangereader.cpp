@@ -0,0 +1,143 @@
+#include "./rangereader.h"
+#include "./basicfileinfo.h"
+
+#include <c++utilities/io/catchiofailure.h>
+#include <c++utilities/io/nativefilestream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <istream>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace IoUtilities;
+
+namespace Media {
+
+/// \brief The minimum size of the ranges scanned by the workers.
+static constexpr uint64 minimumRangeSize = 0x100000;
+
+/// \brief The number of ranges per thread (more ranges than threads balance the work if the data rate varies).
+static constexpr uint64 rangesPerThread = 4;
+
+constexpr size_t RangeReader::bufferSize;
+
+/*!
+ * \class Media::RangeReader
+ * \brief The RangeReader class provides access to the data of a file via the memory mapping or a buffered stream.
+ *
+ * Reading from the stream is buffered: bufferSize bytes are read ahead so subsequent requests for nearby data are
+ * served from the buffer. This suits scanning frames one after another. Since a reader only uses the specified
+ * stream, several readers with their own streams can be used concurrently (see RangeWorkers).
+ */
+
+/*!
+ * \brief Returns a pointer to \a count bytes at the specified \a offset which is valid until the next read.
+ * \remarks The specified range must not exceed the end offset.
+ * \throws Throws std::ios_base::failure when an IO error occurs.
+ */
+const char *RangeReader::read(uint64 offset, size_t count)
+{
+    if(m_mappedData) {
+        return m_mappedData + offset;
+    }
+    if(offset < m_bufferOffset || offset + count > m_bufferOffset + m_buffer.size()) {
+        // read ahead to serve subsequent requests from the buffer
+        m_buffer.resize(static_cast<size_t>(min<uint64>(max(count, bufferSize), m_endOffset - offset)));
+        m_stream->seekg(static_cast<streamoff>(offset));
+        m_stream->read(&m_buffer[0], static_cast<streamsize>(m_buffer.size()));
+        m_bufferOffset = offset;
+    }
+    return m_buffer.data() + (offset - m_bufferOffset);
+}
+
+/*!
+ * \class Media::RangeWorkers
+ * \brief The RangeWorkers class splits the data between two offsets of a file into ranges which are processed by
+ *        several threads.
+ *
+ * Each worker takes the next range until all ranges have been processed. There are more ranges than threads to
+ * balance the work if the data rate varies. Workers read directly from the memory mapping if the file is mapped and
+ * open their own stream otherwise; the calling thread uses the stream of the file. Only one thread is used if the
+ * file is read from a byte source since it can only be read using the stream of the file.
+ */
+
+/*!
+ * \brief Constructs new workers for the data between \a startOffset and \a endOffset of the specified \a fileInfo.
+ * \remarks If \a threadCount is zero, the number of hardware threads is used.
+ */
+RangeWorkers::RangeWorkers(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset, size_t threadCount) :
+    m_fileInfo(fileInfo),
+    m_startOffset(startOffset),
+    m_endOffset(max(startOffset, endOffset)),
+    m_mappedData(fileInfo.mappedData(0, m_endOffset)),
+    m_threadCount(threadCount ? threadCount : max<size_t>(thread::hardware_concurrency(), 1))
+{
+    if(!m_mappedData && m_fileInfo.byteSource()) {
+        m_threadCount = 1;
+    }
+    const uint64 size = m_endOffset - m_startOffset;
+    m_rangeSize = max(minimumRangeSize, (size + m_threadCount * rangesPerThread - 1) / (m_threadCount * rangesPerThread));
+    m_rangeCount = static_cast<size_t>(max<uint64>((size + m_rangeSize - 1) / m_rangeSize, 1));
+    m_threadCount = max<size_t>(min(m_threadCount, m_rangeCount), 1);
+}
+
+/*!
+ * \brief Returns a reader using the stream of the file (eg. for re-scanning ranges after run()).
+ */
+RangeReader RangeWorkers::reader() const
+{
+    return RangeReader(m_mappedData, &m_fileInfo.stream(), m_endOffset);
+}
+
+/*!
+ * \brief Invokes \a scanRange for each range.
+ *
+ * The \a scanRange function is invoked concurrently and must only alter the results of the specified range. Exceptions
+ * thrown by a worker are added to the specified \a notifications using the specified \a context; the worker stops
+ * taking ranges in this case.
+ */
+void RangeWorkers::run(const function<void (RangeReader &, size_t)> &scanRange, const string &context, NotificationList &notifications) const
+{
+    vector<NotificationList> workerNotifications(m_threadCount);
+    atomic<size_t> nextRange(0);
+    const auto worker = [&] (size_t workerIndex) {
+        try {
+            unique_ptr<NativeFileStream> ownStream;
+            istream *stream = &m_fileInfo.stream();
+            if(!m_mappedData && workerIndex) {
+                ownStream = make_unique<NativeFileStream>();
+                ownStream->exceptions(ios_base::failbit | ios_base::badbit);
+                ownStream->open(m_fileInfo.path(), ios_base::in | ios_base::binary);
+                stream = ownStream.get();
+            }
+            RangeReader reader(m_mappedData, stream, m_endOffset);
+            for(size_t rangeIndex; (rangeIndex = nextRange.fetch_add(1)) < m_rangeCount; ) {
+                scanRange(reader, rangeIndex);
+            }
+        } catch(...) {
+            workerNotifications[workerIndex].emplace_back(NotificationType::Critical, catchIoFailure(), context);
+        }
+    };
+    vector<thread> threads;
+    threads.reserve(m_threadCount - 1);
+    try {
+        for(size_t i = 1; i < m_threadCount; ++i) {
+            threads.emplace_back(worker, i);
+        }
+    } catch(const system_error &) {
+        // continue with the threads created so far
+    }
+    worker(0);
+    for(thread &thread : threads) {
+        thread.join();
+    }
+    for(NotificationList &workerNotification : workerNotifications) {
+        notifications.splice(notifications.end(), workerNotification);
+    }
+}
+
+}
@@ -0,0 +1,103 @@
+#ifndef MEDIA_RANGEREADER_H
+#define MEDIA_RANGEREADER_H
+
+#include "./global.h"
+#include "./notification.h"
+
+#include <c++utilities/conversion/types.h>
+
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
+#include <string>
+
+namespace Media {
+
+class BasicFileInfo;
+
+class TAG_PARSER_EXPORT RangeReader
+{
+public:
+    RangeReader(const char *mappedData, std::istream *stream, uint64 endOffset);
+
+    const char *read(uint64 offset, std::size_t count);
+
+    static constexpr std::size_t bufferSize = 0x10000;
+
+private:
+    const char *m_mappedData;
+    std::istream *m_stream;
+    uint64 m_endOffset;
+    uint64 m_bufferOffset;
+    std::string m_buffer;
+};
+
+/*!
+ * \brief Constructs a new reader; the \a stream is only used if no \a mappedData is specified.
+ */
+inline RangeReader::RangeReader(const char *mappedData, std::istream *stream, uint64 endOffset) :
+    m_mappedData(mappedData),
+    m_stream(stream),
+    m_endOffset(endOffset),
+    m_bufferOffset(0)
+{}
+
+class TAG_PARSER_EXPORT RangeWorkers
+{
+public:
+    RangeWorkers(BasicFileInfo &fileInfo, uint64 startOffset, uint64 endOffset, std::size_t threadCount);
+
+    const char *mappedData() const;
+    std::size_t threadCount() const;
+    std::size_t rangeCount() const;
+    uint64 rangeBegin(std::size_t rangeIndex) const;
+    RangeReader reader() const;
+    void run(const std::function<void (RangeReader &reader, std::size_t rangeIndex)> &scanRange, const std::string &context, NotificationList &notifications) const;
+
+private:
+    BasicFileInfo &m_fileInfo;
+    uint64 m_startOffset;
+    uint64 m_endOffset;
+    const char *m_mappedData;
+    std::size_t m_threadCount;
+    uint64 m_rangeSize;
+    std::size_t m_rangeCount;
+};
+
+/*!
+ * \brief Returns the memory mapping of the file up to the end offset or nullptr if the file is not mapped.
+ */
+inline const char *RangeWorkers::mappedData() const
+{
+    return m_mappedData;
+}
+
+/*!
+ * \brief Returns the number of threads used by run().
+ */
+inline std::size_t RangeWorkers::threadCount() const
+{
+    return m_threadCount;
+}
+
+/*!
+ * \brief Returns the number of ranges the data has been split into.
+ */
+inline std::size_t RangeWorkers::rangeCount() const
+{
+    return m_rangeCount;
+}
+
+/*!
+ * \brief Returns the start offset of the range with the specified \a rangeIndex.
+ * \remarks Returns the end offset if \a rangeIndex is rangeCount().
+ */
+inline uint64 RangeWorkers::rangeBegin(std::size_t rangeIndex) const
+{
+    const uint64 begin = rangeIndex * m_rangeSize;
+    return m_startOffset + (begin < m_endOffset - m_startOffset ? begin : m_endOffset - m_startOffset);
+}
+
+}
+
+#endif // MEDIA_RANGEREADER_H
@@ -1,9 +1,12 @@
 #include "./helper.h"
 
 #include "../mediafileinfo.h"
+#include "../mediabatchscanner.h"
 #include "../abstracttrack.h"
 #include "../tag.h"
+#include "../exceptions.h"
 
+#include <c++utilities/conversion/stringbuilder.h>
 #include <c++utilities/io/catchiofailure.h>
 #include <c++utilities/tests/testutils.h>
 using namespace TestUtilities;
@@ -12,10 +15,13 @@ using namespace TestUtilities;
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <cstdio>
+#include <fstream>
+#include <stdexcept>
 
 using namespace std;
 using namespace Media;
 using namespace IoUtilities;
+using namespace ConversionUtilities;
 using namespace TestUtilities::Literals;
 
 using namespace CPPUNIT_NS;
@@ -30,6 +36,11 @@ class MediaFileInfoTests : public TestFixture {
     CPPUNIT_TEST(testFileSystemMethods);
     CPPUNIT_TEST(testParsingUnsupportedFile);
     CPPUNIT_TEST(testFullParseAndFurtherProperties);
+    CPPUNIT_TEST(testParsingWithMemoryMapping);
+    CPPUNIT_TEST(testParsingWithReadCache);
+    CPPUNIT_TEST(testParsingFromByteSource);
+    CPPUNIT_TEST(testBatchScanning);
+    CPPUNIT_TEST(testParsingWithParseIndex);
     CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -42,10 +53,53 @@ public:
     void testPartialParsingAndTagCreationOfMp4File();
 
     void testFullParseAndFurtherProperties();
+    void testParsingWithMemoryMapping();
+    void testParsingWithReadCache();
+    void testParsingFromByteSource();
+    void testBatchScanning();
+    void testParsingWithParseIndex();
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(MediaFileInfoTests);
 
+/*!
+ * \brief The TestByteSource class reads from a file and counts the requests to simulate a remote source.
+ */
+class TestByteSource : public ByteSource
+{
+public:
+    TestByteSource(const string &path) :
+        m_requestCount(0)
+    {
+        m_file.exceptions(ios_base::failbit | ios_base::badbit);
+        m_file.open(path, ios_base::in | ios_base::binary);
+        m_file.seekg(0, ios_base::end);
+        m_size = static_cast<uint64>(m_file.tellg());
+    }
+
+    uint64 size() const override
+    {
+        return m_size;
+    }
+
+    void readAt(uint64 offset, char *buffer, size_t count) override
+    {
+        ++m_requestCount;
+        m_file.seekg(static_cast<streamoff>(offset));
+        m_file.read(buffer, static_cast<streamsize>(count));
+    }
+
+    uint64 requestCount() const
+    {
+        return m_requestCount;
+    }
+
+private:
+    fstream m_file;
+    uint64 m_size;
+    uint64 m_requestCount;
+};
+
 void MediaFileInfoTests::setUp()
 {
 }
@@ -202,3 +256,212 @@ void MediaFileInfoTests::testFullParseAndFurtherProperties()
     CPPUNIT_ASSERT_EQUAL("ID: 3653291187, type: Audio, language: \"eng\""s, file.tracks()[1]->label());
     CPPUNIT_ASSERT_EQUAL("MS-MPEG-4-480p / MP3-2ch-eng"s, file.technicalSummary());
 }
+
+void MediaFileInfoTests::testParsingWithMemoryMapping()
+{
+    MediaFileInfo file(testFilePath("matroska_wave1/test1.mkv"));
+    CPPUNIT_ASSERT(!file.isMemoryMappingEnabled());
+    file.setMemoryMappingEnabled(true);
+    CPPUNIT_ASSERT(!file.isMemoryMapped());
+    file.open(true);
+    CPPUNIT_ASSERT(file.isMemoryMapped());
+    CPPUNIT_ASSERT(file.mappedData(0, file.size()));
+    CPPUNIT_ASSERT(!file.mappedData(1, file.size()));
+    file.parseEverything();
+    file.close();
+    CPPUNIT_ASSERT(!file.isMemoryMapped());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.containerParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tracksParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, file.containerFormat());
+    CPPUNIT_ASSERT(!file.hasNotifications());
+    CPPUNIT_ASSERT(!file.haveRelatedObjectsNotifications());
+    CPPUNIT_ASSERT_EQUAL(2_st, file.trackCount());
+    CPPUNIT_ASSERT_EQUAL("ID: 2422994868, type: Video"s, file.tracks()[0]->label());
+
+    // opening the file for writing must not map it
+    file.open(false);
+    CPPUNIT_ASSERT(!file.isMemoryMapped());
+    file.close();
+}
+
+void MediaFileInfoTests::testParsingWithReadCache()
+{
+    MediaFileInfo file(testFilePath("matroska_wave1/test1.mkv"));
+    CPPUNIT_ASSERT(!file.isReadCacheEnabled());
+    file.setReadCacheEnabled(true);
+    file.readCache().setBlockSize(0x200);
+    file.open(true);
+    CPPUNIT_ASSERT(file.readCache().isActive());
+    file.parseEverything();
+    CPPUNIT_ASSERT(file.readCache().hits() > 0);
+    file.close();
+    CPPUNIT_ASSERT(!file.readCache().isActive());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.containerParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tracksParsingStatus());
+    CPPUNIT_ASSERT(!file.hasNotifications());
+    CPPUNIT_ASSERT(!file.haveRelatedObjectsNotifications());
+    CPPUNIT_ASSERT_EQUAL(2_st, file.trackCount());
+    CPPUNIT_ASSERT_EQUAL("ID: 2422994868, type: Video"s, file.tracks()[0]->label());
+
+    // opening the file for writing must not activate the read cache
+    file.open(false);
+    CPPUNIT_ASSERT(!file.readCache().isActive());
+    file.close();
+}
+
+void MediaFileInfoTests::testParsingFromByteSource()
+{
+    TestByteSource source(testFilePath("matroska_wave1/test1.mkv"));
+    CachingByteSource cache(source, 0x1000);
+    MediaFileInfo file("test1.mkv");
+    CPPUNIT_ASSERT(!file.byteSource());
+    file.setByteSource(&cache);
+    CPPUNIT_ASSERT_EQUAL(static_cast<ByteSource *>(&cache), file.byteSource());
+    file.open();
+    CPPUNIT_ASSERT(file.isOpen());
+    CPPUNIT_ASSERT(file.isReadOnly());
+    CPPUNIT_ASSERT_EQUAL(source.size(), file.size());
+    file.parseEverything();
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.containerParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tagsParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, file.tracksParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, file.containerFormat());
+    CPPUNIT_ASSERT(!file.hasNotifications());
+    CPPUNIT_ASSERT(!file.haveRelatedObjectsNotifications());
+    CPPUNIT_ASSERT_EQUAL(2_st, file.trackCount());
+    CPPUNIT_ASSERT_EQUAL("ID: 2422994868, type: Video"s, file.tracks()[0]->label());
+
+    // small reads are coalesced and the same data is never requested twice
+    CPPUNIT_ASSERT(cache.requestCount() > 0);
+    CPPUNIT_ASSERT_EQUAL(cache.requestCount(), source.requestCount());
+    CPPUNIT_ASSERT(cache.bytesRequested() <= source.size());
+    CPPUNIT_ASSERT(cache.rangeCount() <= cache.requestCount());
+
+    // applying changes is not supported
+    CPPUNIT_ASSERT_THROW(file.applyChanges(), NotImplementedException);
+
+    file.close();
+    CPPUNIT_ASSERT(!file.isOpen());
+    file.setByteSource(nullptr);
+    CPPUNIT_ASSERT(!file.byteSource());
+}
+
+/*!
+ * \brief Returns a string summarizing the parsing results of the specified \a file for comparison.
+ */
+static string parsingResults(const MediaFileInfo &file)
+{
+    return argsToString(file.containerFormatName(), '|', file.technicalSummary(), '|', file.tags().size(), '|',
+                        file.chapters().size(), '|', file.attachments().size(), '|', static_cast<int>(file.worstNotificationTypeIncludingRelatedObjects()));
+}
+
+void MediaFileInfoTests::testBatchScanning()
+{
+    // scan each file several times so the files are processed concurrently
+    vector<string> paths;
+    for(size_t i = 0; i != 4; ++i) {
+        for(const char *file : {"matroska_wave1/test1.mkv", "matroska_wave1/test2.mkv", "mtx-test-data/mp4/10-DanseMacabreOp.40.m4a",
+                "mtx-test-data/mp3/id3-tag-and-xing-header.mp3", "mtx-test-data/ogg/qt4dance_medium.ogg", "flac/test.flac", "unsupported.bin"}) {
+            paths.emplace_back(testFilePath(file));
+        }
+    }
+
+    // parse files serially to get the expected results
+    vector<string> expectedResults;
+    for(const string &path : paths) {
+        MediaFileInfo file(path);
+        file.open(true);
+        file.parseEverything();
+        file.close();
+        expectedResults.emplace_back(parsingResults(file));
+    }
+
+    // parse files using the batch scanner
+    MediaBatchScanner scanner;
+    scanner.setThreadCount(4);
+    scanner.setMaximumOpenFiles(3);
+    CPPUNIT_ASSERT_EQUAL(3_st, scanner.workerCount(paths.size()));
+    CPPUNIT_ASSERT_EQUAL(1_st, scanner.workerCount(1));
+    scanner.setMaximumOpenFiles(16);
+    vector<string> results(paths.size());
+    scanner.scan(paths, [&results] (size_t index, MediaFileInfo &file) {
+        CPPUNIT_ASSERT(!file.isOpen());
+        CPPUNIT_ASSERT_EQUAL(1_st, file.threadCount());
+        CPPUNIT_ASSERT(results[index].empty());
+        results[index] = parsingResults(file);
+    });
+    CPPUNIT_ASSERT(!scanner.isAborted());
+    CPPUNIT_ASSERT_EQUAL(paths.size(), scanner.filesScanned());
+    for(size_t i = 0; i != paths.size(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(expectedResults[i], results[i]);
+    }
+
+    // abort scanning from the callback
+    scanner.scan(paths, [&scanner] (size_t, MediaFileInfo &) {
+        scanner.abort();
+    });
+    CPPUNIT_ASSERT(scanner.isAborted());
+    CPPUNIT_ASSERT(scanner.filesScanned() <= scanner.workerCount(paths.size()));
+
+    // exceptions thrown by the callback are forwarded
+    CPPUNIT_ASSERT_THROW(scanner.scan(paths, [] (size_t, MediaFileInfo &) {
+        throw runtime_error("callback failed");
+    }), runtime_error);
+    CPPUNIT_ASSERT(scanner.isAborted());
+}
+
+void MediaFileInfoTests::testParsingWithParseIndex()
+{
+    const string cacheFile = workingCopyPathMode("parseindex/cache", WorkingCopyMode::NoCopy);
+    const string cacheDirectory = cacheFile.substr(0, cacheFile.rfind('/'));
+    for(const auto &test : {make_pair("matroska_wave1/test1.mkv", "matroska.segment"), make_pair("mtx-test-data/ogg/qt4dance_medium.ogg", "ogg.pages")}) {
+        // parse without index
+        MediaFileInfo file(testFilePath(test.first));
+        file.open(true);
+        file.parseEverything();
+        file.close();
+        CPPUNIT_ASSERT(!file.parseIndex().isIdentified());
+        const string expectedResults = parsingResults(file);
+
+        // parse with index cache: index is recorded and saved
+        MediaFileInfo firstFile(testFilePath(test.first));
+        firstFile.setIndexCacheDirectory(cacheDirectory);
+        firstFile.open(true);
+        firstFile.parseEverything();
+        firstFile.close();
+        CPPUNIT_ASSERT_EQUAL(expectedResults, parsingResults(firstFile));
+        const ParseIndex &firstIndex = firstFile.parseIndex();
+        CPPUNIT_ASSERT(firstIndex.isIdentified());
+        CPPUNIT_ASSERT_EQUAL(firstFile.size(), firstIndex.fileSize());
+        CPPUNIT_ASSERT(firstIndex.entry(test.second));
+        CPPUNIT_ASSERT(!firstIndex.isModified());
+        const string indexPath = firstIndex.cacheFilePath(cacheDirectory);
+        CPPUNIT_ASSERT(ifstream(indexPath).is_open());
+
+        // parse again: index is loaded and yields the same results
+        MediaFileInfo secondFile(testFilePath(test.first));
+        secondFile.setIndexCacheDirectory(cacheDirectory);
+        secondFile.open(true);
+        secondFile.parseContainerFormat();
+        CPPUNIT_ASSERT(secondFile.parseIndex().entry(test.second));
+        CPPUNIT_ASSERT(*firstIndex.entry(test.second) == *secondFile.parseIndex().entry(test.second));
+        secondFile.parseEverything();
+        secondFile.close();
+        CPPUNIT_ASSERT_EQUAL(expectedResults, parsingResults(secondFile));
+        CPPUNIT_ASSERT(!secondFile.parseIndex().isModified());
+
+        // corrupted index is ignored (with a warning) and replaced
+        ofstream(indexPath, ios_base::trunc | ios_base::binary) << "TPIX";
+        MediaFileInfo thirdFile(testFilePath(test.first));
+        thirdFile.setIndexCacheDirectory(cacheDirectory);
+        thirdFile.open(true);
+        thirdFile.parseEverything();
+        thirdFile.close();
+        CPPUNIT_ASSERT_EQUAL(NotificationType::Warning, thirdFile.worstNotificationType());
+        CPPUNIT_ASSERT(thirdFile.parseIndex().entry(test.second));
+        CPPUNIT_ASSERT(!thirdFile.parseIndex().isModified());
+        remove(indexPath.data());
+    }
+}
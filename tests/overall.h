@@ -13,6 +13,7 @@ using namespace TestUtilities;
 
 #include <string>
 #include <queue>
+#include <vector>
 
 using namespace std;
 using namespace ConversionUtilities;
@@ -49,6 +50,15 @@ class OverallTests : public TestFixture
     CPPUNIT_TEST(testOggParsing);
     CPPUNIT_TEST(testFlacParsing);
     CPPUNIT_TEST(testMkvParsing);
+    CPPUNIT_TEST(testMkvScanning);
+    CPPUNIT_TEST(testMkvCopyingClusters);
+    CPPUNIT_TEST(testMkvUpdatingCues);
+    CPPUNIT_TEST(testMp4SampleTables);
+    CPPUNIT_TEST(testMp4CopyingChunks);
+    CPPUNIT_TEST(testMp3FrameScanning);
+    CPPUNIT_TEST(testAdtsFrameScanning);
+    CPPUNIT_TEST(testOggPageLookup);
+    CPPUNIT_TEST(testFlacFrameScanning);
 #ifdef PLATFORM_UNIX
     CPPUNIT_TEST(testMp4Making);
     CPPUNIT_TEST(testMp3Making);
@@ -56,6 +66,12 @@ class OverallTests : public TestFixture
     CPPUNIT_TEST(testFlacMaking);
     CPPUNIT_TEST(testMkvMakingWithDifferentSettings);
     CPPUNIT_TEST(testMkvMakingNestedTags);
+    CPPUNIT_TEST(testMkvMakingTagsInPlace);
+    CPPUNIT_TEST(testMkvTakingWrittenElements);
+    CPPUNIT_TEST(testMp4UpdatingChunkOffsets);
+    CPPUNIT_TEST(testMp4PromotingChunkOffsets);
+    CPPUNIT_TEST(testMp3RegeneratingXingHeader);
+    CPPUNIT_TEST(testFlacRegeneratingSeekTable);
 #endif
     CPPUNIT_TEST_SUITE_END();
 
@@ -79,6 +95,11 @@ private:
     void checkMkvTestfileNestedTags();
     void checkMkvTestMetaData();
     void checkMkvConstraints();
+    void checkMkvBlockStatistics();
+    void checkMkvIndex();
+    void checkMkvCues();
+    void checkMkvTagsInPlace();
+    void checkMkvTakingWrittenElements();
 
     void checkMp4Testfile1();
     void checkMp4Testfile2();
@@ -88,17 +109,28 @@ private:
     void checkMp4Testfile6();
     void checkMp4TestMetaData();
     void checkMp4Constraints();
+    void checkMp4SampleTables();
+    void checkMp4ChunkOffsets();
+    void checkMp4PromotedChunkOffsets();
 
     void checkMp3Testfile1();
     void checkMp3TestMetaData();
     void checkMp3PaddingConstraints();
+    void checkMp3Frames();
+    void checkMp3XingHeader();
+    void checkAdtsFrames();
 
     void checkOggTestfile1();
     void checkOggTestfile2();
     void checkOggTestMetaData();
+    void checkOggPageIndex();
+    void checkOggPageLocator();
 
     void checkFlacTestfile1();
     void checkFlacTestfile2();
+    void checkFlacFramesNotScanned();
+    void checkFlacFrames();
+    void checkFlacSeekTable();
 
     void setMkvTestMetaData();
     void setMp4TestMetaData();
@@ -109,6 +141,11 @@ private:
     void createMkvWithNestedTags();
     void alterMp4Tracks();
     void removeSecondTrack();
+    void shortenMkvTitle();
+    void moveMp4MediaData();
+    void promoteMp4ChunkOffsets();
+    void regenerateXingHeader();
+    void regenerateFlacSeekTable();
 
 public:
     void testMkvParsing();
@@ -116,13 +153,28 @@ public:
     void testMp3Parsing();
     void testOggParsing();
     void testFlacParsing();
+    void testMkvScanning();
+    void testMkvCopyingClusters();
+    void testMkvUpdatingCues();
+    void testMp4SampleTables();
+    void testMp4CopyingChunks();
+    void testMp3FrameScanning();
+    void testAdtsFrameScanning();
+    void testOggPageLookup();
+    void testFlacFrameScanning();
 #ifdef PLATFORM_UNIX
     void testMkvMakingWithDifferentSettings();
     void testMkvMakingNestedTags();
+    void testMkvMakingTagsInPlace();
+    void testMkvTakingWrittenElements();
     void testMp4Making();
+    void testMp4UpdatingChunkOffsets();
+    void testMp4PromotingChunkOffsets();
     void testMp3Making();
+    void testMp3RegeneratingXingHeader();
     void testOggMaking();
     void testFlacMaking();
+    void testFlacRegeneratingSeekTable();
 #endif
 
 private:
@@ -143,6 +195,11 @@ private:
     uint16 m_mode;
     ElementPosition m_expectedTagPos;
     ElementPosition m_expectedIndexPos;
+    uint64 m_expectedSampleCount;
+    uint64 m_expectedOffset;
+    string m_expectedData;
+    vector<uint64> m_expectedOffsets;
+    vector<uint32> m_expectedChunkBeginnings;
 };
 
 #endif // TAGPARSER_OVERALL_TESTS_H
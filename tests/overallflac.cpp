@@ -2,6 +2,9 @@
 
 #include "../tag.h"
 #include "../abstracttrack.h"
+#include "../flac/flacframescanner.h"
+#include "../flac/flacmetadata.h"
+#include "../flac/flacstream.h"
 
 /*!
  * \brief Checks "flac/test.flac" (converted from "mtx-test-data/alac/othertest-itunes.m4a" via ffmpeg).
@@ -93,6 +96,73 @@ void OverallTests::checkFlacTestfile2()
     }
 }
 
+/*!
+ * \brief Checks whether the frames of "flac/test.flac" have not been walked without a full parse.
+ * \remarks The sample count is recorded to compare it with the one determined by walking the frames.
+ */
+void OverallTests::checkFlacFramesNotScanned()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    m_expectedSampleCount = m_fileInfo.tracks().front()->sampleCount();
+    CPPUNIT_ASSERT(static_cast<FlacStream *>(m_fileInfo.tracks().front())->seekTable().empty());
+}
+
+/*!
+ * \brief Checks whether the frames of "flac/test.flac" have been walked.
+ */
+void OverallTests::checkFlacFrames()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    const auto *track = static_cast<FlacStream *>(m_fileInfo.tracks().front());
+    CPPUNIT_ASSERT_EQUAL(m_expectedSampleCount, track->sampleCount());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0), track->corruptedFrameCount());
+    CPPUNIT_ASSERT(!track->seekTable().empty());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0), track->seekTable().front().offset);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0), track->seekTable().front().sampleNumber);
+}
+
+/*!
+ * \brief Checks whether exactly one "SEEKTABLE"-block has been written (see regenerateFlacSeekTable()).
+ */
+void OverallTests::checkFlacSeekTable()
+{
+    checkFlacFrames();
+    const auto *track = static_cast<FlacStream *>(m_fileInfo.tracks().front());
+    CPPUNIT_ASSERT_EQUAL(m_expectedOffsets.size(), track->seekTable().size());
+    bool seekTableFound = false;
+    char buffer[4];
+    m_fileInfo.stream().seekg(static_cast<streamoff>(track->startOffset() + 4));
+    for(FlacMetaDataBlockHeader blockHeader; !blockHeader.isLast(); ) {
+        m_fileInfo.stream().read(buffer, 4);
+        blockHeader.parseHeader(buffer);
+        if(blockHeader.type() == FlacMetaDataBlockType::SeekTable) {
+            CPPUNIT_ASSERT(!seekTableFound);
+            CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(m_expectedOffsets.size() * 18), blockHeader.dataSize());
+            seekTableFound = true;
+        }
+        m_fileInfo.stream().seekg(blockHeader.dataSize(), ios_base::cur);
+    }
+    CPPUNIT_ASSERT(seekTableFound);
+}
+
+/*!
+ * \brief Enables regenerating the "SEEKTABLE"-block.
+ * \remarks The sample count and the offsets of the seek points determined by walking the frames are recorded to
+ *          check the written block (see checkFlacSeekTable()).
+ */
+void OverallTests::regenerateFlacSeekTable()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    const auto *track = static_cast<FlacStream *>(m_fileInfo.tracks().front());
+    m_expectedSampleCount = track->sampleCount();
+    m_expectedOffsets.clear();
+    for(const auto &seekPoint : track->seekTable()) {
+        m_expectedOffsets.push_back(seekPoint.offset);
+    }
+    CPPUNIT_ASSERT(!m_expectedOffsets.empty());
+    m_fileInfo.setRegenerateFlacSeekTable(true);
+}
+
 /*!
  * \brief Tests the FLAC parser via MediaFileInfo.
  */
@@ -105,6 +175,34 @@ void OverallTests::testFlacParsing()
     parseFile(TestUtilities::testFilePath("flac/test.ogg"), &OverallTests::checkFlacTestfile2);
 }
 
+/*!
+ * \brief Tests walking the frames of FLAC streams via FlacFrameScanner.
+ */
+void OverallTests::testFlacFrameScanning()
+{
+    // checksums and frame header parsing
+    CPPUNIT_ASSERT_EQUAL(static_cast<byte>(0xF4), FlacFrameScanner::computeCrc8("123456789", 9));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint16>(0xFEE8), FlacFrameScanner::updateCrc16(0, "123456789", 9));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint16>(0xFEE8), FlacFrameScanner::updateCrc16(FlacFrameScanner::updateCrc16(0, "1234", 4), "56789", 5));
+    const char header[] = "\xFF\xF8\xC9\x18\xC4\x80\x70";
+    FlacFrameHeader frameHeader;
+    CPPUNIT_ASSERT_EQUAL(static_cast<byte>(7), FlacFrameScanner::readHeader(header, 7, frameHeader));
+    CPPUNIT_ASSERT(!frameHeader.variableBlockSize);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(256), frameHeader.number);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(4096), frameHeader.blockSize);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(44100), frameHeader.samplingFrequency);
+    CPPUNIT_ASSERT_EQUAL(static_cast<byte>(2), frameHeader.channelCount);
+    CPPUNIT_ASSERT_EQUAL(static_cast<byte>(0), FlacFrameScanner::readHeader("\xFF\xF8\xC9\x18\xC4\x80\x71", 7, frameHeader));
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(0), FlacFrameScanner::findSync(header, 7));
+
+    // the frames are only walked when a full parse is forced
+    cerr << endl << "FLAC frame scanner" << endl;
+    m_fileInfo.setForceFullParse(false);
+    parseFile(TestUtilities::testFilePath("flac/test.flac"), &OverallTests::checkFlacFramesNotScanned);
+    m_fileInfo.setForceFullParse(true);
+    parseFile(TestUtilities::testFilePath("flac/test.flac"), &OverallTests::checkFlacFrames);
+}
+
 #ifdef PLATFORM_UNIX
 /*!
  * \brief Tests the FLAC maker via MediaFileInfo.
@@ -137,4 +235,15 @@ void OverallTests::testFlacMaking()
         makeFile(TestUtilities::workingCopyPath("flac/test.ogg"), modifyRoutine, &OverallTests::checkFlacTestfile2);
     }
 }
+
+/*!
+ * \brief Tests regenerating the "SEEKTABLE"-block when rewriting a FLAC file.
+ */
+void OverallTests::testFlacRegeneratingSeekTable()
+{
+    cerr << endl << "FLAC maker - regenerate seek table" << endl;
+    m_mode = 0;
+    m_fileInfo.setForceFullParse(true);
+    makeFile(TestUtilities::workingCopyPath("flac/test.flac"), &OverallTests::regenerateFlacSeekTable, &OverallTests::checkFlacSeekTable);
+}
 #endif
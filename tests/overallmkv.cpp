@@ -4,6 +4,14 @@
 #include "../mpegaudio/mpegaudioframe.h"
 #include "../mp4/mp4ids.h"
 #include "../matroska/matroskacontainer.h"
+#include "../matroska/matroskablockscanner.h"
+#include "../matroska/matroskaclustercopier.h"
+#include "../matroska/matroskacues.h"
+#include "../matroska/matroskaid.h"
+#include "../matroska/matroskaindexvalidator.h"
+#include "../matroska/matroskaseekinfo.h"
+#include "../matroska/ebmlreader.h"
+#include "../nativecopyhelper.h"
 
 #include <c++utilities/conversion/binaryconversion.h>
 #include <c++utilities/conversion/stringconversion.h>
@@ -11,6 +19,8 @@
 
 #include <fstream>
 #include <cstring>
+#include <limits>
+#include <sstream>
 
 namespace MkvTestFlags {
 enum TestFlag
@@ -564,6 +574,189 @@ void OverallTests::checkMkvConstraints()
     }
 }
 
+/*!
+ * \brief Reads the first "Cluster"-element of the specified Matroska \a fileInfo.
+ * \returns Returns the data of the element; \a clusterOffset is set to its start offset.
+ */
+static string readFirstMkvCluster(MediaFileInfo &fileInfo, uint64 &clusterOffset)
+{
+    EbmlElement *segmentElement = static_cast<MatroskaContainer *>(fileInfo.container())->firstElement();
+    segmentElement = segmentElement->siblingById(MatroskaIds::Segment, true);
+    CPPUNIT_ASSERT(segmentElement);
+    EbmlElement *clusterElement = segmentElement->childById(MatroskaIds::Cluster);
+    CPPUNIT_ASSERT(clusterElement);
+    string cluster(static_cast<size_t>(clusterElement->totalSize()), '\0');
+    fileInfo.stream().seekg(static_cast<streamoff>(clusterOffset = clusterElement->startOffset()));
+    fileInfo.stream().read(&cluster[0], static_cast<streamsize>(cluster.size()));
+    return cluster;
+}
+
+/*!
+ * \brief Checks whether scanning the blocks of "matroska_wave1/test1.mkv" with several threads yields the same results
+ *        as scanning them with a single thread.
+ */
+void OverallTests::checkMkvBlockStatistics()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    auto *const container = static_cast<MatroskaContainer *>(m_fileInfo.container());
+
+    // determine statistics with a single thread
+    MatroskaBlockScanner scanner(*container);
+    scanner.setThreadCount(1);
+    scanner.scan();
+    CPPUNIT_ASSERT(!scanner.hasCriticalNotifications());
+    CPPUNIT_ASSERT(scanner.clusterCount() > 0);
+    const auto expectedStatistics = scanner.statistics();
+    CPPUNIT_ASSERT_EQUAL(2_st, expectedStatistics.size());
+    for(const auto &statistics : expectedStatistics) {
+        CPPUNIT_ASSERT(statistics.second.frameCount >= statistics.second.blockCount);
+        CPPUNIT_ASSERT(statistics.second.size > 0);
+        // the duration of the tracks should roughly match the duration of the segment
+        CPPUNIT_ASSERT(statistics.second.duration.totalSeconds() > container->duration().totalSeconds() - 1.0);
+        CPPUNIT_ASSERT(statistics.second.duration.totalSeconds() < container->duration().totalSeconds() + 1.0);
+    }
+
+    // several threads yield the same results
+    scanner.setThreadCount(4);
+    scanner.scan();
+    CPPUNIT_ASSERT(!scanner.hasCriticalNotifications());
+    for(const auto &statistics : scanner.statistics()) {
+        const MatroskaBlockStatistics &expected = expectedStatistics.at(statistics.first);
+        CPPUNIT_ASSERT_EQUAL(expected.blockCount, statistics.second.blockCount);
+        CPPUNIT_ASSERT_EQUAL(expected.frameCount, statistics.second.frameCount);
+        CPPUNIT_ASSERT_EQUAL(expected.size, statistics.second.size);
+        CPPUNIT_ASSERT_EQUAL(expected.duration.totalTicks(), statistics.second.duration.totalTicks());
+    }
+
+    // the statistics are assigned to the tracks
+    container->readTrackStatisticsFromBlocks(4);
+    CPPUNIT_ASSERT(!container->hasCriticalNotifications());
+    for(const auto &track : container->tracks()) {
+        const MatroskaBlockStatistics &expected = expectedStatistics.at(track->trackNumber());
+        CPPUNIT_ASSERT_EQUAL(expected.size, track->size());
+        CPPUNIT_ASSERT_EQUAL(expected.frameCount, track->sampleCount());
+        CPPUNIT_ASSERT_EQUAL(expected.duration.totalTicks(), track->duration().totalTicks());
+        CPPUNIT_ASSERT(track->bitrate() > 0.0);
+    }
+}
+
+/*!
+ * \brief Checks whether validating the index of "matroska_wave1/test1.mkv" with several threads yields the same
+ *        results as validating it with a single thread.
+ */
+void OverallTests::checkMkvIndex()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    auto *const container = static_cast<MatroskaContainer *>(m_fileInfo.container());
+    MatroskaIndexValidator validator(*container);
+    validator.setThreadCount(1);
+    validator.validate();
+    CPPUNIT_ASSERT(!validator.hasCriticalNotifications());
+    CPPUNIT_ASSERT(validator.hasIndex());
+    CPPUNIT_ASSERT(validator.cueReferenceCount() > 0);
+    CPPUNIT_ASSERT(validator.clusterCount() > 0);
+    CPPUNIT_ASSERT_EQUAL(1.0, validator.currentPercentage());
+    const auto notificationCount = validator.notifications().size();
+
+    // several threads yield the same results
+    validator.setThreadCount(4);
+    validator.validate();
+    CPPUNIT_ASSERT(!validator.hasCriticalNotifications());
+    CPPUNIT_ASSERT_EQUAL(notificationCount, validator.notifications().size());
+    container->validateIndex(4);
+    CPPUNIT_ASSERT(!container->hasCriticalNotifications());
+}
+
+/*!
+ * \brief Checks whether the "Cues"-element of "matroska_wave1/test1.mkv" is reproduced and updated by the MatroskaCuePositionUpdater.
+ */
+void OverallTests::checkMkvCues()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    EbmlElement *segmentElement = static_cast<MatroskaContainer *>(m_fileInfo.container())->firstElement()->siblingById(MatroskaIds::Segment, true);
+    CPPUNIT_ASSERT(segmentElement);
+    EbmlElement *cuesElement = segmentElement->childById(MatroskaIds::Cues);
+    CPPUNIT_ASSERT(cuesElement);
+    EbmlElement *cueTrackPositionsElement = cuesElement->childById(MatroskaIds::CuePoint)->childById(MatroskaIds::CueTrackPositions);
+    CPPUNIT_ASSERT(cueTrackPositionsElement);
+    const uint64 clusterPosition = cueTrackPositionsElement->childById(MatroskaIds::CueClusterPosition)->readUInteger();
+
+    // the unchanged "Cues"-element is reproduced
+    MatroskaCuePositionUpdater updater;
+    updater.parse(cuesElement);
+    const uint64 originalSize = updater.totalSize();
+    stringstream unchanged;
+    updater.make(unchanged);
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(originalSize), unchanged.str().size());
+    CPPUNIT_ASSERT(!updater.updateOffsets(clusterPosition, clusterPosition));
+    CPPUNIT_ASSERT(!updater.updateOffsets(numeric_limits<uint64>::max(), 0x10));
+
+    // updating an offset with a longer value grows the "Cues"-element
+    CPPUNIT_ASSERT(updater.updateOffsets(clusterPosition, 0x1122334455));
+    CPPUNIT_ASSERT(updater.totalSize() > originalSize);
+    stringstream updated;
+    updater.make(updated);
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(updater.totalSize()), updated.str().size());
+    CPPUNIT_ASSERT(updated.str().find(string("\xF1\x85\x11\x22\x33\x44\x55", 7)) != string::npos);
+
+    // restoring the offset restores the original "Cues"-element
+    updater.updateOffsets(clusterPosition, clusterPosition);
+    stringstream restored;
+    updater.make(restored);
+    CPPUNIT_ASSERT_EQUAL(unchanged.str(), restored.str());
+}
+
+/*!
+ * \brief Checks whether the title has been shortened without touching the clusters (see shortenMkvTitle()).
+ */
+void OverallTests::checkMkvTagsInPlace()
+{
+    const auto tags = m_fileInfo.tags();
+    CPPUNIT_ASSERT_EQUAL(1_st, tags.size());
+    CPPUNIT_ASSERT_EQUAL("Big Buck Bunny"s, tags.front()->value(KnownField::Title).toString());
+    uint64 clusterOffset;
+    CPPUNIT_ASSERT(m_expectedData == readFirstMkvCluster(m_fileInfo, clusterOffset));
+    CPPUNIT_ASSERT_EQUAL(m_expectedOffset, clusterOffset);
+}
+
+/*!
+ * \brief Makes the file using the container directly and checks whether the written elements have been taken
+ *        without reparsing the header.
+ */
+void OverallTests::checkMkvTakingWrittenElements()
+{
+    CPPUNIT_ASSERT_EQUAL(ContainerFormat::Matroska, m_fileInfo.containerFormat());
+    auto *const container = static_cast<MatroskaContainer *>(m_fileInfo.container());
+    CPPUNIT_ASSERT(!m_fileInfo.isVerifyingOutput());
+    container->makeFile();
+
+    // the written elements have been taken
+    CPPUNIT_ASSERT(container->isHeaderParsed());
+    CPPUNIT_ASSERT_EQUAL(1_st, container->segmentCount());
+    CPPUNIT_ASSERT_EQUAL(ElementPosition::BeforeData, container->determineTagPosition());
+    const vector<string> titles = container->titles();
+    const auto duration = container->duration();
+    vector<uint64> seekHeadOffsets;
+    for(const auto &seekInfo : container->seekInfos()) {
+        seekHeadOffsets.push_back(seekInfo->seekHeadElement()->startOffset());
+    }
+    CPPUNIT_ASSERT(!seekHeadOffsets.empty());
+    container->parseTags();
+    CPPUNIT_ASSERT_EQUAL(1_st, container->tagCount());
+    CPPUNIT_ASSERT_EQUAL("Big Buck Bunny - test 1"s, container->tag(0)->value(KnownField::Title).toString());
+
+    // reparsing the header yields the same results
+    container->reset();
+    container->parseHeader();
+    CPPUNIT_ASSERT_EQUAL(ElementPosition::BeforeData, container->determineTagPosition());
+    CPPUNIT_ASSERT(titles == container->titles());
+    CPPUNIT_ASSERT(duration == container->duration());
+    CPPUNIT_ASSERT_EQUAL(seekHeadOffsets.size(), container->seekInfos().size());
+    for(size_t i = 0; i != seekHeadOffsets.size(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(seekHeadOffsets[i], container->seekInfos()[i]->seekHeadElement()->startOffset());
+    }
+}
+
 /*!
  * \brief Creates a tag targeting the first track with some test meta data.
  */
@@ -641,6 +834,19 @@ void OverallTests::createMkvWithNestedTags()
 #endif
 }
 
+/*!
+ * \brief Shortens the title of "matroska_wave1/test1.mkv" so the new tags fit into the space of the old tags.
+ * \remarks The first cluster is recorded to check whether it has not been touched (see checkMkvTagsInPlace()).
+ */
+void OverallTests::shortenMkvTitle()
+{
+    m_expectedData = readFirstMkvCluster(m_fileInfo, m_expectedOffset);
+    const auto tags = m_fileInfo.tags();
+    CPPUNIT_ASSERT_EQUAL(1_st, tags.size());
+    CPPUNIT_ASSERT_EQUAL("Big Buck Bunny - test 1"s, tags.front()->value(KnownField::Title).toString());
+    tags.front()->setValue(KnownField::Title, TagValue("Big Buck Bunny"s));
+}
+
 /*!
  * \brief Tests the Matroska parser via MediaFileInfo.
  */
@@ -664,6 +870,71 @@ void OverallTests::testMkvParsing()
     }
 }
 
+/*!
+ * \brief Tests scanning the blocks and validating the index of Matroska files with several threads.
+ */
+void OverallTests::testMkvScanning()
+{
+    cerr << endl << "Matroska block scanner and index validator" << endl;
+    m_fileInfo.setForceFullParse(false);
+    for(const bool memoryMapping : {false, true}) {
+        m_fileInfo.setMemoryMappingEnabled(memoryMapping);
+        parseFile(TestUtilities::testFilePath("matroska_wave1/test1.mkv"), &OverallTests::checkMkvBlockStatistics);
+        parseFile(TestUtilities::testFilePath("matroska_wave1/test1.mkv"), &OverallTests::checkMkvIndex);
+    }
+    m_fileInfo.setMemoryMappingEnabled(false);
+}
+
+/*!
+ * \brief Tests copying the children of "Cluster"-elements range-wise via MatroskaClusterCopier.
+ */
+void OverallTests::testMkvCopyingClusters()
+{
+    // cluster data: CRC-32, Timecode, Position, 2 SimpleBlocks, Void, SimpleBlock
+    const string crc32("\xBF\x84\x01\x02\x03\x04", 6), timecode("\xE7\x81\x05", 3), position("\xA7\x82\x12\x34", 4);
+    const string blocks("\xA3\x83\x81\x00\x00\xA3\x82\x81\x00", 9), voidElement("\xEC\x82\x00\x00", 4), block("\xA3\x84\x81\x00\x00\x80", 6);
+    const string clusterData = crc32 + timecode + position + blocks + voidElement + block;
+    stringstream input("head" + clusterData), output;
+
+    // the children are coalesced to ranges skipping "Void"- and "CRC-32"-elements
+    EbmlReader reader(nullptr, &input);
+    MatroskaClusterCopier clusterCopier;
+    vector<pair<uint64, uint64> > childOffsets;
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(3 + 3 + 9 + 6), clusterCopier.addCluster(m_fileInfo, reader, 4, clusterData.size(), 0x56, [&childOffsets] (uint64 originalOffset, uint64 newOffset) {
+        childOffsets.emplace_back(originalOffset, newOffset);
+    }));
+    CPPUNIT_ASSERT_EQUAL(1_st, clusterCopier.clusters().size());
+    CPPUNIT_ASSERT_EQUAL(4_st, clusterCopier.ranges().size());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0), clusterCopier.ranges()[1].size);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(9), clusterCopier.ranges()[2].size);
+    const vector<pair<uint64, uint64> > expectedChildOffsets{{0, 0}, {6, 0}, {9, 3}, {13, 6}, {18, 11}, {22, 15}, {26, 15}};
+    CPPUNIT_ASSERT(expectedChildOffsets == childOffsets);
+
+    // the "Position"-element is replaced
+    NativeCopyHelper copyHelper;
+    clusterCopier.copyCluster(0, 0x56, input, output, copyHelper, nullptr);
+    CPPUNIT_ASSERT_EQUAL(string("\x1F\x43\xB6\x75\x95", 5) + timecode + string("\xA7\x81\x56", 3) + blocks + block, output.str());
+
+    // a child exceeding the cluster is truncated to the end of the cluster
+    const string truncatedBlock("\xA3\x88\x81\x00\x00", 5);
+    stringstream truncatedInput(timecode + truncatedBlock);
+    EbmlReader truncatedReader(nullptr, &truncatedInput);
+    CPPUNIT_ASSERT(!m_fileInfo.hasNotifications());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(3 + 5), clusterCopier.addCluster(m_fileInfo, truncatedReader, 0, 3 + 5, 0, function<void (uint64, uint64)>()));
+    CPPUNIT_ASSERT_EQUAL(NotificationType::Warning, m_fileInfo.worstNotificationType());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(3 + 5), clusterCopier.ranges().back().size);
+}
+
+/*!
+ * \brief Tests updating the "Cues"-element via MatroskaCuePositionUpdater.
+ */
+void OverallTests::testMkvUpdatingCues()
+{
+    cerr << endl << "Matroska cue position updater" << endl;
+    m_fileInfo.setForceFullParse(false);
+    parseFile(TestUtilities::testFilePath("matroska_wave1/test1.mkv"), &OverallTests::checkMkvCues);
+}
+
 #ifdef PLATFORM_UNIX
 /*!
  * \brief Tests the Matroska maker via MediaFileInfo.
@@ -767,4 +1038,52 @@ void OverallTests::testMkvMakingNestedTags()
         makeFile(m_nestedTagsMkvPath, &OverallTests::noop, &OverallTests::checkMkvTestfileNestedTags);
     }
 }
+
+/*!
+ * \brief Tests updating the tags of a Matroska file in-place without touching the clusters.
+ */
+void OverallTests::testMkvMakingTagsInPlace()
+{
+    cerr << endl << "Matroska maker - update tags in-place" << endl;
+    m_mode = 0;
+    m_fileInfo.setForceFullParse(false);
+    m_fileInfo.setForceRewrite(false);
+    m_fileInfo.setMinPadding(0);
+    m_fileInfo.setMaxPadding(0x1000);
+    makeFile(workingCopyPath("matroska_wave1/test1.mkv"), &OverallTests::shortenMkvTitle, &OverallTests::checkMkvTagsInPlace);
+}
+
+/*!
+ * \brief Tests whether MatroskaContainer takes the elements it has written instead of reparsing the header.
+ * \remarks The file is opened for writing because the container is used directly to make it.
+ */
+void OverallTests::testMkvTakingWrittenElements()
+{
+    cerr << endl << "Matroska maker - take written elements" << endl;
+    const string path = workingCopyPath("matroska_wave1/test1.mkv");
+    cerr << "- testing " << path << endl;
+    m_fileInfo.setForceFullParse(false);
+    m_fileInfo.setForceRewrite(true);
+    m_fileInfo.setTagPosition(ElementPosition::BeforeData);
+    m_fileInfo.setForceTagPosition(true);
+    m_fileInfo.setPreferredPadding(0x100);
+    m_fileInfo.setPath(path);
+    m_fileInfo.reopen(false);
+    m_fileInfo.parseEverything();
+    checkMkvTakingWrittenElements();
+
+    // applying changes via MediaFileInfo keeps the container which has taken the written elements
+    const auto *const container = m_fileInfo.container();
+    m_fileInfo.tags().front()->setValue(KnownField::Title, TagValue("Big Buck Bunny - test 2"s));
+    m_fileInfo.applyChanges();
+    CPPUNIT_ASSERT_EQUAL(container, static_cast<const AbstractContainer *>(m_fileInfo.container()));
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::Ok, m_fileInfo.containerParsingStatus());
+    CPPUNIT_ASSERT_EQUAL(ParsingStatus::NotParsedYet, m_fileInfo.tagsParsingStatus());
+    m_fileInfo.parseEverything();
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.tags().size());
+    CPPUNIT_ASSERT_EQUAL("Big Buck Bunny - test 2"s, m_fileInfo.tags().front()->value(KnownField::Title).toString());
+    m_fileInfo.close();
+    remove(path.c_str());
+    remove((path + ".bak").c_str());
+}
 #endif
@@ -3,9 +3,18 @@
 
 #include "../abstracttrack.h"
 #include "../mpegaudio/mpegaudioframe.h"
+#include "../mpegaudio/mpegaudioframescanner.h"
+#include "../mpegaudio/mpegaudioframestream.h"
+#include "../adts/adtsframescanner.h"
+#include "../adts/adtsstream.h"
 #include "../id3/id3v1tag.h"
 #include "../id3/id3v2tag.h"
 
+#include <c++utilities/io/binaryreader.h>
+
+#include <cstdio>
+#include <fstream>
+
 namespace Mp3TestFlags {
 enum TestFlag
 {
@@ -170,6 +179,72 @@ void OverallTests::checkMp3PaddingConstraints()
     // TODO: check rewriting behaviour
 }
 
+/*!
+ * \brief Checks whether the frames of "mtx-test-data/mp3/id3-tag-and-xing-header.mp3" have been walked and whether
+ *        splitting the file into ranges yields the same results.
+ */
+void OverallTests::checkMp3Frames()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    const auto *track = static_cast<MpegAudioFrameStream *>(m_fileInfo.tracks().front());
+    CPPUNIT_ASSERT(track->sampleCount() > 0);
+    CPPUNIT_ASSERT(track->duration().totalSeconds() > 0.0);
+    CPPUNIT_ASSERT(track->maxBitrate() >= track->bitrate());
+    CPPUNIT_ASSERT(!track->seekTable().empty());
+    CPPUNIT_ASSERT(track->seekTable().front().offset >= track->startOffset());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0), track->seekTable().front().sampleIndex);
+
+    MpegAudioFrameScanner scanner(m_fileInfo, track->startOffset(), m_fileInfo.size());
+    scanner.setThreadCount(1);
+    scanner.scan();
+    const uint64 frameCount = scanner.frameCount(), sampleCount = scanner.sampleCount();
+    CPPUNIT_ASSERT_EQUAL(track->sampleCount(), sampleCount);
+    scanner.setThreadCount(4);
+    scanner.scan();
+    CPPUNIT_ASSERT_EQUAL(frameCount, scanner.frameCount());
+    CPPUNIT_ASSERT_EQUAL(sampleCount, scanner.sampleCount());
+}
+
+/*!
+ * \brief Checks whether the Xing header denotes the frames actually present (see regenerateXingHeader()).
+ */
+void OverallTests::checkMp3XingHeader()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    const AbstractTrack *track = m_fileInfo.tracks().front();
+    CPPUNIT_ASSERT_EQUAL(m_expectedSampleCount, track->sampleCount());
+    MpegAudioFrame frame;
+    BinaryReader reader(&m_fileInfo.stream());
+    m_fileInfo.stream().seekg(static_cast<streamoff>(track->startOffset()));
+    frame.parseHeader(reader);
+    CPPUNIT_ASSERT(frame.isXingFramefieldPresent());
+    CPPUNIT_ASSERT(frame.isXingTocFieldPresent());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(m_expectedSampleCount / frame.sampleCount()), frame.xingFrameCount());
+}
+
+/*!
+ * \brief Checks the ADTS file written by testAdtsFrameScanning().
+ */
+void OverallTests::checkAdtsFrames()
+{
+    CPPUNIT_ASSERT(m_fileInfo.containerFormat() == ContainerFormat::Adts);
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    const auto *track = static_cast<AdtsStream *>(m_fileInfo.tracks().front());
+    CPPUNIT_ASSERT_EQUAL(m_expectedSampleCount, track->sampleCount());
+    CPPUNIT_ASSERT_DOUBLES_EQUAL(static_cast<double>(m_expectedSampleCount) / 44100.0, track->duration().totalSeconds(), 0.001);
+    CPPUNIT_ASSERT(track->maxBitrate() >= track->bitrate());
+    CPPUNIT_ASSERT(track->seekTable().size() > 4000 / 64);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0), track->seekTable().front().offset);
+
+    // splitting the file into ranges yields the same results
+    AdtsFrameScanner scanner(m_fileInfo, 0, m_fileInfo.size());
+    scanner.setThreadCount(4);
+    scanner.scan();
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(4000), scanner.frameCount());
+    CPPUNIT_ASSERT_EQUAL(m_expectedSampleCount, scanner.sampleCount());
+    CPPUNIT_ASSERT_EQUAL(NotificationType::Warning, scanner.worstNotificationType());
+}
+
 void OverallTests::setMp3TestMetaData()
 {
     using namespace Mp3TestFlags;
@@ -205,6 +280,18 @@ void OverallTests::setMp3TestMetaData()
     }
 }
 
+/*!
+ * \brief Enables regenerating the Xing header.
+ * \remarks The sample count is recorded to check whether the Xing header denotes it (see checkMp3XingHeader()).
+ */
+void OverallTests::regenerateXingHeader()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    m_expectedSampleCount = m_fileInfo.tracks().front()->sampleCount();
+    CPPUNIT_ASSERT(m_expectedSampleCount > 0);
+    m_fileInfo.setRegenerateXingHeader(true);
+}
+
 /*!
  * \brief Tests the MP3 parser via MediaFileInfo.
  */
@@ -216,6 +303,73 @@ void OverallTests::testMp3Parsing()
     parseFile(TestUtilities::testFilePath("mtx-test-data/mp3/id3-tag-and-xing-header.mp3"), &OverallTests::checkMp3Testfile1);
 }
 
+/*!
+ * \brief Tests walking the frames of MP3 files via MpegAudioFrameScanner.
+ */
+void OverallTests::testMp3FrameScanning()
+{
+    // sync search and frame length arithmetic
+    char buffer[80] = {0};
+    buffer[20] = '\xFF', buffer[21] = '\x0F';
+    buffer[50] = '\xFF', buffer[51] = '\xFB';
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(50), MpegAudioFrameScanner::findSync(buffer, sizeof(buffer)));
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(51), MpegAudioFrameScanner::findSync(buffer, 51));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(417), MpegAudioFrameScanner::frameSize(0xFFFB9000));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(418), MpegAudioFrameScanner::frameSize(0xFFFB9200));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(1152), MpegAudioFrameScanner::frameSampleCount(0xFFFB9000));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(128), MpegAudioFrameScanner::frameBitrate(0xFFFB9000));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(44100), MpegAudioFrameScanner::frameSamplingFrequency(0xFFFB9000));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(0), MpegAudioFrameScanner::frameSize(0xFFFBF000));
+
+    // the frames are only walked when a full parse is forced
+    cerr << endl << "MPEG audio frame scanner" << endl;
+    m_fileInfo.setForceFullParse(true);
+    parseFile(TestUtilities::testFilePath("mtx-test-data/mp3/id3-tag-and-xing-header.mp3"), &OverallTests::checkMp3Frames);
+}
+
+/*!
+ * \brief Tests walking the frames of ADTS files via AdtsFrameScanner.
+ */
+void OverallTests::testAdtsFrameScanning()
+{
+    // AAC LC, 44.1 kHz, stereo, no CRC; the frame length and the number of raw data blocks are filled in below
+    const uint64 header = (0xFFFull << 44) | (1ull << 40) | (1ull << 38) | (4ull << 34) | (2ull << 30) | (0x7FFull << 2);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(0), AdtsFrameScanner::frameSize(header | (6ull << 13)));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(300), AdtsFrameScanner::frameSize(header | (300ull << 13)));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(2048), AdtsFrameScanner::frameSampleCount(header | 1));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(44100), AdtsFrameScanner::frameSamplingFrequency(header));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(0), AdtsFrameScanner::frameSamplingFrequency(header | (0xFull << 34)));
+
+    // write a stream with frames of varying size and some junk in the middle
+    const string path = workingCopyPathMode("adts/frames.aac", WorkingCopyMode::NoCopy);
+    m_expectedSampleCount = 0;
+    {
+        ofstream stream;
+        stream.exceptions(ios_base::failbit | ios_base::badbit);
+        stream.open(path, ios_base::out | ios_base::trunc | ios_base::binary);
+        for(uint64 frameIndex = 0; frameIndex != 4000; ++frameIndex) {
+            if(frameIndex == 1000) {
+                stream << "junk";
+            }
+            const uint64 frameSize = 100 + (frameIndex * 37) % 500, blocks = frameIndex % 8 ? 0 : 1;
+            const uint64 frameHeader = header | (frameSize << 13) | blocks;
+            char buffer[7];
+            for(size_t index = 0; index != 7; ++index) {
+                buffer[index] = static_cast<char>(frameHeader >> (48 - 8 * index));
+            }
+            stream.write(buffer, 7);
+            stream << string(frameSize - 7, '\0');
+            m_expectedSampleCount += 1024 * (blocks + 1);
+        }
+    }
+
+    // the frames are only walked when a full parse is forced
+    cerr << endl << "ADTS frame scanner" << endl;
+    m_fileInfo.setForceFullParse(true);
+    parseFile(path, &OverallTests::checkAdtsFrames);
+    remove(path.data());
+}
+
 #ifdef PLATFORM_UNIX
 /*!
  * \brief Tests the MP3 maker via MediaFileInfo.
@@ -275,4 +429,15 @@ void OverallTests::testMp3Making()
         makeFile(TestUtilities::workingCopyPath("mtx-test-data/mp3/id3-tag-and-xing-header.mp3"), modifyRoutine, &OverallTests::checkMp3Testfile1);
     }
 }
+
+/*!
+ * \brief Tests regenerating the Xing header when rewriting an MP3 file.
+ */
+void OverallTests::testMp3RegeneratingXingHeader()
+{
+    cerr << endl << "MP3 maker - regenerate Xing header" << endl;
+    m_mode = 0;
+    m_fileInfo.setForceFullParse(true);
+    makeFile(TestUtilities::workingCopyPath("mtx-test-data/mp3/id3-tag-and-xing-header.mp3"), &OverallTests::regenerateXingHeader, &OverallTests::checkMp3XingHeader);
+}
 #endif
@@ -5,6 +5,14 @@
 #include "../mp4/mp4ids.h"
 #include "../mp4/mp4tag.h"
 #include "../mp4/mp4container.h"
+#include "../mp4/mp4chunkcopier.h"
+#include "../mp4/mp4sampletable.h"
+#include "../mp4/mp4track.h"
+#include "../nativecopyhelper.h"
+
+#include <c++utilities/io/binaryreader.h>
+
+#include <sstream>
 
 namespace Mp4TestFlags {
 enum TestFlag
@@ -387,6 +395,80 @@ void OverallTests::checkMp4Constraints()
     }
 }
 
+/*!
+ * \brief Reads the first 4 bytes of each chunk of the specified \a track.
+ */
+static vector<uint32> readMp4ChunkBeginnings(MediaFileInfo &fileInfo, Mp4Track *track)
+{
+    vector<uint32> chunkBeginnings;
+    for(const auto chunkOffset : track->readChunkOffsets()) {
+        fileInfo.stream().seekg(static_cast<streamoff>(chunkOffset));
+        chunkBeginnings.emplace_back(BinaryReader(&fileInfo.stream()).readUInt32BE());
+    }
+    return chunkBeginnings;
+}
+
+/*!
+ * \brief Checks whether the sample table views of "mtx-test-data/mp4/10-DanseMacabreOp.40.m4a" yield the same values
+ *        as reading the whole tables.
+ */
+void OverallTests::checkMp4SampleTables()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    auto *track = static_cast<Mp4Track *>(m_fileInfo.tracks().front());
+    const vector<uint32> sampleSizes = track->sampleSizes();
+    const Mp4SampleSizeTable &sampleSizeTable = track->sampleSizeTable();
+    CPPUNIT_ASSERT(!sampleSizes.empty());
+    uint64 totalSize = 0;
+    for(size_t i = 0; i != sampleSizes.size(); ++i) {
+        CPPUNIT_ASSERT_EQUAL(sampleSizes[i], sampleSizeTable.at(i));
+        totalSize += sampleSizes[i];
+    }
+    CPPUNIT_ASSERT_EQUAL(totalSize, track->size());
+    const Mp4ChunkOffsetTable chunkOffsetTable = track->chunkOffsetTable();
+    const vector<uint64> chunkOffsets = track->readChunkOffsets();
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(chunkOffsets.size()), chunkOffsetTable.entryCount());
+    CPPUNIT_ASSERT_EQUAL(chunkOffsets.back(), chunkOffsetTable.at(chunkOffsets.size() - 1));
+    const Mp4SampleToChunkTable sampleToChunkTable = track->sampleToChunkTable();
+    const auto sampleToChunkEntries = track->readSampleToChunkTable();
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(sampleToChunkEntries.size()), sampleToChunkTable.entryCount());
+    CPPUNIT_ASSERT_EQUAL(get<1>(sampleToChunkEntries.front()), sampleToChunkTable.at(0).samplesPerChunk);
+    CPPUNIT_ASSERT_EQUAL(static_cast<size_t>(track->chunkCount()), track->readChunkSizes().size());
+}
+
+/*!
+ * \brief Checks whether the chunk offset table has been updated after moving the media data (see moveMp4MediaData()).
+ */
+void OverallTests::checkMp4ChunkOffsets()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    auto *track = static_cast<Mp4Track *>(m_fileInfo.tracks().front());
+    CPPUNIT_ASSERT_EQUAL(4u, track->chunkOffsetSize());
+    CPPUNIT_ASSERT(m_expectedOffsets != track->readChunkOffsets());
+    CPPUNIT_ASSERT(m_expectedChunkBeginnings == readMp4ChunkBeginnings(m_fileInfo, track));
+}
+
+/*!
+ * \brief Checks whether the "stco"-atom has been replaced by a "co64"-atom holding the updated chunk offsets (see
+ *        promoteMp4ChunkOffsets()).
+ */
+void OverallTests::checkMp4PromotedChunkOffsets()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    auto *track = static_cast<Mp4Track *>(m_fileInfo.tracks().front());
+    CPPUNIT_ASSERT_EQUAL(8u, track->chunkOffsetSize());
+    Mp4Atom *stblAtom = track->trakAtom().subelementByPath({Mp4AtomIds::Track, Mp4AtomIds::Media, Mp4AtomIds::MediaInformation, Mp4AtomIds::SampleTable});
+    CPPUNIT_ASSERT(stblAtom);
+    CPPUNIT_ASSERT(!stblAtom->childById(Mp4AtomIds::ChunkOffset));
+    Mp4Atom *co64Atom = stblAtom->childById(Mp4AtomIds::ChunkOffset64);
+    CPPUNIT_ASSERT(co64Atom);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(16 + m_expectedOffsets.size() * 8), co64Atom->totalSize());
+    const vector<uint64> chunkOffsets = track->readChunkOffsets();
+    CPPUNIT_ASSERT_EQUAL(m_expectedOffsets.size(), chunkOffsets.size());
+    CPPUNIT_ASSERT(m_expectedOffsets != chunkOffsets);
+    CPPUNIT_ASSERT(m_expectedChunkBeginnings == readMp4ChunkBeginnings(m_fileInfo, track));
+}
+
 /*!
  * \brief Sets test meta data in the file to be tested.
  */
@@ -436,6 +518,35 @@ void OverallTests::alterMp4Tracks()
     secondTrack->setName("test");
 }
 
+/*!
+ * \brief Moves the media data of "mtx-test-data/mp4/10-DanseMacabreOp.40.m4a" by putting the tag before the data.
+ * \remarks The beginning of each chunk is recorded to check whether the chunk offset table has been updated
+ *          accordingly (see checkMp4ChunkOffsets()).
+ */
+void OverallTests::moveMp4MediaData()
+{
+    CPPUNIT_ASSERT_EQUAL(1_st, m_fileInfo.trackCount());
+    auto *track = static_cast<Mp4Track *>(m_fileInfo.tracks().front());
+    m_expectedChunkBeginnings = readMp4ChunkBeginnings(m_fileInfo, track);
+    m_expectedOffsets = track->readChunkOffsets();
+    CPPUNIT_ASSERT(!m_expectedChunkBeginnings.empty());
+    CPPUNIT_ASSERT(!track->isPromotingChunkOffsets());
+    m_fileInfo.setForceRewrite(true);
+    m_fileInfo.setPreferredPadding(0x1000);
+    m_fileInfo.setTagPosition(ElementPosition::BeforeData);
+    m_fileInfo.setForceTagPosition(true);
+}
+
+/*!
+ * \brief Moves the media data like moveMp4MediaData() but forces the "stco"-atom to be promoted to a "co64"-atom by
+ *        lowering the promotion threshold.
+ */
+void OverallTests::promoteMp4ChunkOffsets()
+{
+    moveMp4MediaData();
+    static_cast<Mp4Container *>(m_fileInfo.container())->setChunkOffsetPromotionThreshold(0);
+}
+
 /*!
  * \brief Tests the MP4 parser via MediaFileInfo.
  */
@@ -451,6 +562,78 @@ void OverallTests::testMp4Parsing()
     parseFile(TestUtilities::testFilePath("mtx-test-data/aac/he-aacv2-ps.m4a"), &OverallTests::checkMp4Testfile5);
 }
 
+/*!
+ * \brief Tests reading the sample tables of MP4 tracks via Mp4SampleSizeTable, Mp4ChunkOffsetTable and Mp4SampleToChunkTable.
+ */
+void OverallTests::testMp4SampleTables()
+{
+    // decoding of the different field sizes
+    stringstream table(string("\x12\x3F\x00\x80\xFF\x00\x01\x00\x02\x00\x10\x00\x00\x00\x20", 15));
+    const Mp4SampleSizeTable nibbles(nullptr, &table, 0, 3, 4);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(1), nibbles.at(0));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(2), nibbles.at(1));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint32>(3), nibbles.at(2));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(5), nibbles.accumulate(1, 2));
+    const Mp4SampleSizeTable bytes(nullptr, &table, 2, 3, 8);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0x17F), bytes.accumulate(0, 3));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(0x10002), Mp4ChunkOffsetTable(nullptr, &table, 5, 1, 4).at(0));
+    Mp4SampleSizeTable constant = Mp4SampleSizeTable::fromConstantSize(100, 10);
+    CPPUNIT_ASSERT(constant.isConstant());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(1000), constant.accumulate(0, 10));
+    CPPUNIT_ASSERT(vector<uint32>{100} == constant.sampleSizes());
+    constant.append(50);
+    CPPUNIT_ASSERT(!constant.isConstant());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(11), constant.sampleCount());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(150), constant.accumulate(9, 2));
+
+    // the views yield the same values as reading the whole tables
+    cerr << endl << "MP4 sample tables" << endl;
+    m_fileInfo.setForceFullParse(false);
+    parseFile(TestUtilities::testFilePath("mtx-test-data/mp4/10-DanseMacabreOp.40.m4a"), &OverallTests::checkMp4SampleTables);
+
+    // the sample sizes can still be accessed after the file has been closed
+    CPPUNIT_ASSERT(!m_fileInfo.isOpen());
+    const auto *track = static_cast<const Mp4Track *>(m_fileInfo.tracks().front());
+    const vector<uint32> &sampleSizes = track->sampleSizes();
+    CPPUNIT_ASSERT(!sampleSizes.empty());
+    CPPUNIT_ASSERT_EQUAL(sampleSizes.back(), track->sampleSizeTable().at(sampleSizes.size() - 1));
+    CPPUNIT_ASSERT_EQUAL(track->size(), track->sampleSizeTable().accumulate(0, sampleSizes.size()));
+}
+
+/*!
+ * \brief Tests copying chunks run-wise via Mp4ChunkCopier.
+ */
+void OverallTests::testMp4CopyingChunks()
+{
+    string source;
+    for(char c = 0; c != 100; ++c) {
+        source.push_back(c);
+    }
+    stringstream input(source), output;
+    output << "head";
+
+    // chunks which are contiguous within the source are coalesced to runs
+    Mp4ChunkCopier chunkCopier(4);
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(4), chunkCopier.addChunk(&input, 0, 10));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(14), chunkCopier.addChunk(&input, 10, 5));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(19), chunkCopier.addChunk(&input, 60, 20));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(39), chunkCopier.addChunk(&input, 30, 7));
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(46), chunkCopier.addChunk(&input, 37, 3));
+    CPPUNIT_ASSERT_EQUAL(3_st, chunkCopier.runs().size());
+    CPPUNIT_ASSERT_EQUAL(5_st, chunkCopier.chunkCount());
+    CPPUNIT_ASSERT_EQUAL(static_cast<uint64>(45), chunkCopier.totalSize());
+
+    // the output layout is preserved although the runs are read ordered by their source offset
+    NativeCopyHelper copyHelper;
+    chunkCopier.setBufferSize(32);
+    double percentage = 0.0;
+    chunkCopier.copy(output, copyHelper, nullptr, [&percentage] (double p) {
+        percentage = p;
+    });
+    CPPUNIT_ASSERT_EQUAL("head" + source.substr(0, 15) + source.substr(60, 20) + source.substr(30, 10), output.str());
+    CPPUNIT_ASSERT_EQUAL(1.0, percentage);
+}
+
 #ifdef PLATFORM_UNIX
 /*!
  * \brief Tests the MP4 maker via MediaFileInfo.
@@ -519,4 +702,26 @@ void OverallTests::testMp4Making()
         makeFile(TestUtilities::workingCopyPath("mtx-test-data/mp4/1080p-DTS-HD-7.1.mp4"), modifyRoutine, &OverallTests::checkMp4Testfile6);
     }
 }
+
+/*!
+ * \brief Tests updating the chunk offset table when rewriting an MP4 file moves the media data.
+ */
+void OverallTests::testMp4UpdatingChunkOffsets()
+{
+    cerr << endl << "MP4 maker - update chunk offsets" << endl;
+    m_mode = 0;
+    m_fileInfo.setForceFullParse(false);
+    makeFile(TestUtilities::workingCopyPath("mtx-test-data/mp4/10-DanseMacabreOp.40.m4a"), &OverallTests::moveMp4MediaData, &OverallTests::checkMp4ChunkOffsets);
+}
+
+/*!
+ * \brief Tests promoting the chunk offset table ("stco"-atom to "co64"-atom) when rewriting an MP4 file.
+ */
+void OverallTests::testMp4PromotingChunkOffsets()
+{
+    cerr << endl << "MP4 maker - promote chunk offsets" << endl;
+    m_mode = 0;
+    m_fileInfo.setForceFullParse(false);
+    makeFile(TestUtilities::workingCopyPath("mtx-test-data/mp4/10-DanseMacabreOp.40.m4a"), &OverallTests::promoteMp4ChunkOffsets, &OverallTests::checkMp4PromotedChunkOffsets);
+}
 #endif
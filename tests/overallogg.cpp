@@ -4,6 +4,10 @@
 #include "../tag.h"
 #include "../abstracttrack.h"
 #include "../vorbis/vorbiscomment.h"
+#include "../ogg/oggiterator.h"
+#include "../ogg/oggpagelocator.h"
+
+#include <limits>
 
 /*!
  * \brief Checks "mtx-test-data/ogg/qt4dance_medium.ogg"
@@ -124,6 +128,86 @@ void OverallTests::setOggTestMetaData()
     // TODO: set more fields
 }
 
+/*!
+ * \brief Checks whether the page index of "mtx-test-data/ogg/qt4dance_medium.ogg" holds the same values as the pages
+ *        read directly from the file.
+ */
+void OverallTests::checkOggPageIndex()
+{
+    // fetch all pages from the stream
+    OggIterator iterator(m_fileInfo.stream(), 0, m_fileInfo.size());
+    size_t nonEmptyPages = 0;
+    for(iterator.reset(); iterator; iterator.nextPage(), ++nonEmptyPages) {
+        CPPUNIT_ASSERT_EQUAL(iterator.pages().startOffset(iterator.currentPageIndex()), iterator.currentPage().startOffset());
+    }
+    CPPUNIT_ASSERT(iterator.areAllPagesFetched());
+    const OggPageIndex &pages = iterator.pages();
+    CPPUNIT_ASSERT(pages.size() > 2);
+    CPPUNIT_ASSERT(nonEmptyPages <= pages.size());
+
+    // the index holds the same values as the pages read directly from the file
+    for(size_t index = 0; index != pages.size(); ++index) {
+        const OggPage page(m_fileInfo.stream(), pages.startOffset(index), static_cast<int32>(m_fileInfo.size() - pages.startOffset(index)));
+        CPPUNIT_ASSERT_EQUAL(page.absoluteGranulePosition(), pages.absoluteGranulePosition(index));
+        CPPUNIT_ASSERT_EQUAL(page.streamSerialNumber(), pages.streamSerialNumber(index));
+        CPPUNIT_ASSERT_EQUAL(page.sequenceNumber(), pages.sequenceNumber(index));
+        CPPUNIT_ASSERT_EQUAL(page.checksum(), pages.checksum(index));
+        CPPUNIT_ASSERT_EQUAL(page.headerTypeFlag(), pages.headerTypeFlag(index));
+        CPPUNIT_ASSERT_EQUAL(page.totalSize(), pages.totalSize(index));
+        CPPUNIT_ASSERT(index + 1 == pages.size() || pages.startOffset(index) + pages.totalSize(index) == pages.startOffset(index + 1));
+    }
+    CPPUNIT_ASSERT_EQUAL(0_st, pages.findFirst(pages.streamSerialNumber(0)));
+    CPPUNIT_ASSERT(pages.findLast(pages.streamSerialNumber(0)) < pages.size());
+
+    // the segment sizes are decoded again when moving back to a page
+    iterator.setPageIndex(1);
+    const OggPage secondPage(m_fileInfo.stream(), pages.startOffset(1), static_cast<int32>(pages.totalSize(1)));
+    CPPUNIT_ASSERT(secondPage.segmentSizes() == iterator.currentPage().segmentSizes());
+    CPPUNIT_ASSERT_EQUAL(secondPage.dataOffset(), iterator.currentSegmentOffset());
+}
+
+/*!
+ * \brief Checks whether the OggPageLocator finds the same pages in "mtx-test-data/ogg/qt4dance_medium.ogg" as walking
+ *        all pages does.
+ * \remarks The memory mapping is used when enabled.
+ */
+void OverallTests::checkOggPageLocator()
+{
+    // walk all pages to determine the expected results
+    OggIterator iterator(m_fileInfo.stream(), 0, m_fileInfo.size());
+    for(iterator.reset(); iterator; iterator.nextPage());
+    const OggPageIndex &pages = iterator.pages();
+    const uint32 serialNumber = pages.streamSerialNumber(0);
+    size_t lastPage = pages.size();
+    vector<size_t> pagesWithGranulePosition;
+    for(size_t index = 0; index != pages.size(); ++index) {
+        if(pages.matchesStreamSerialNumber(index, serialNumber) && pages.absoluteGranulePosition(index) != numeric_limits<uint64>::max()) {
+            pagesWithGranulePosition.push_back(lastPage = index);
+        }
+    }
+    CPPUNIT_ASSERT(pagesWithGranulePosition.size() > 2);
+
+    // the last page is found by only reading the end of the file
+    OggPageLocator locator(m_fileInfo.stream(), 0, m_fileInfo.size());
+    locator.setReadSource(&m_fileInfo);
+    OggPage page;
+    CPPUNIT_ASSERT(locator.findLastPage(serialNumber, page));
+    CPPUNIT_ASSERT_EQUAL(pages.startOffset(lastPage), page.startOffset());
+    CPPUNIT_ASSERT_EQUAL(pages.absoluteGranulePosition(lastPage), page.absoluteGranulePosition());
+    CPPUNIT_ASSERT(locator.pagesFetched() < pages.size());
+    if(pages.findFirst(serialNumber + 1) == pages.size()) {
+        CPPUNIT_ASSERT(!locator.findLastPage(serialNumber + 1, page));
+    }
+
+    // the first page with at least the requested granule position is found via bisection
+    const size_t middlePage = pagesWithGranulePosition[pagesWithGranulePosition.size() / 2];
+    CPPUNIT_ASSERT(locator.findPage(serialNumber, pages.absoluteGranulePosition(middlePage), page));
+    CPPUNIT_ASSERT_EQUAL(pages.startOffset(middlePage), page.startOffset());
+    CPPUNIT_ASSERT(locator.findPage(serialNumber, 0, page));
+    CPPUNIT_ASSERT_EQUAL(pages.startOffset(pagesWithGranulePosition.front()), page.startOffset());
+    CPPUNIT_ASSERT(!locator.findPage(serialNumber, pages.absoluteGranulePosition(lastPage) + 1, page));
+}
+
 /*!
  * \brief Tests the Ogg parser via MediaFileInfo.
  * \remarks FLAC in Ogg is tested in testFlacParsing().
@@ -137,6 +221,21 @@ void OverallTests::testOggParsing()
     parseFile(TestUtilities::testFilePath("mtx-test-data/opus/v-opus.ogg"), &OverallTests::checkOggTestfile2);
 }
 
+/*!
+ * \brief Tests looking up Ogg pages via OggPageIndex and OggPageLocator.
+ */
+void OverallTests::testOggPageLookup()
+{
+    cerr << endl << "OGG page index and locator" << endl;
+    m_fileInfo.setForceFullParse(false);
+    parseFile(TestUtilities::testFilePath("mtx-test-data/ogg/qt4dance_medium.ogg"), &OverallTests::checkOggPageIndex);
+    for(const bool memoryMapping : {false, true}) {
+        m_fileInfo.setMemoryMappingEnabled(memoryMapping);
+        parseFile(TestUtilities::testFilePath("mtx-test-data/ogg/qt4dance_medium.ogg"), &OverallTests::checkOggPageLocator);
+    }
+    m_fileInfo.setMemoryMappingEnabled(false);
+}
+
 #ifdef PLATFORM_UNIX
 /*!
  * \brief Tests the Ogg maker via MediaFileInfo.
@@ -10,6 +10,11 @@
 #include "../mediafileinfo.h"
 #include "../exceptions.h"
 #include "../backuphelper.h"
+#include "../blockcache.h"
+#include "../elementarena.h"
+#include "../nativecopyhelper.h"
+#include "../crc32.h"
+#include "../crc32streambuffer.h"
 
 #include <c++utilities/io/catchiofailure.h>
 #include <c++utilities/tests/testutils.h>
@@ -19,6 +24,7 @@ using namespace TestUtilities;
 #include <cppunit/extensions/HelperMacros.h>
 
 #include <cstdio>
+#include <sstream>
 
 using namespace std;
 using namespace Media;
@@ -52,6 +58,11 @@ class UtilitiesTests : public TestFixture {
     CPPUNIT_TEST(testMargin);
     CPPUNIT_TEST(testAspectRatio);
     CPPUNIT_TEST(testMediaFormat);
+    CPPUNIT_TEST(testBlockCache);
+    CPPUNIT_TEST(testElementArena);
+    CPPUNIT_TEST(testNativeCopyHelper);
+    CPPUNIT_TEST(testCrc32);
+    CPPUNIT_TEST(testCrc32StreamBuffer);
 #ifdef PLATFORM_UNIX
     CPPUNIT_TEST(testBackupFile);
 #endif
@@ -68,6 +79,11 @@ public:
     void testMargin();
     void testAspectRatio();
     void testMediaFormat();
+    void testBlockCache();
+    void testElementArena();
+    void testNativeCopyHelper();
+    void testCrc32();
+    void testCrc32StreamBuffer();
 #ifdef PLATFORM_UNIX
     void testBackupFile();
 #endif
@@ -250,6 +266,238 @@ void UtilitiesTests::testMediaFormat()
     CPPUNIT_ASSERT_EQUAL("Spectral Band Replication / HE-AAC"s, string(aac.extensionName()));
 }
 
+void UtilitiesTests::testBlockCache()
+{
+    stringstream stream(ios_base::in | ios_base::binary);
+    stream.exceptions(ios_base::failbit | ios_base::badbit);
+    stream.str("0123456789abcdefghij");
+    BlockCache cache(8, 2);
+    CPPUNIT_ASSERT(!cache.isActive());
+    cache.setStream(&stream, 20);
+    CPPUNIT_ASSERT(cache.isActive());
+
+    // read within first block
+    char buffer[9] = {0};
+    cache.read(1, buffer, 3);
+    CPPUNIT_ASSERT_EQUAL("123"s, string(buffer, 3));
+    CPPUNIT_ASSERT_EQUAL(0ul, cache.hits());
+    CPPUNIT_ASSERT_EQUAL(1ul, cache.misses());
+    cache.read(4, buffer, 4);
+    CPPUNIT_ASSERT_EQUAL("4567"s, string(buffer, 4));
+    CPPUNIT_ASSERT_EQUAL(1ul, cache.hits());
+
+    // read spanning first and second block
+    cache.read(6, buffer, 4);
+    CPPUNIT_ASSERT_EQUAL("6789"s, string(buffer, 4));
+    CPPUNIT_ASSERT_EQUAL(2ul, cache.hits());
+    CPPUNIT_ASSERT_EQUAL(2ul, cache.misses());
+    CPPUNIT_ASSERT_EQUAL(2_st, cache.blockCount());
+
+    // read last (incomplete) block evicting the least recently used block
+    cache.read(16, buffer, 4);
+    CPPUNIT_ASSERT_EQUAL("ghij"s, string(buffer, 4));
+    CPPUNIT_ASSERT_EQUAL(2_st, cache.blockCount());
+    cache.read(0, buffer, 1);
+    CPPUNIT_ASSERT_EQUAL(4ul, cache.misses());
+
+    // reads larger than the block size bypass the cache
+    cache.read(2, buffer, 9);
+    CPPUNIT_ASSERT_EQUAL("23456789a"s, string(buffer, 9));
+    CPPUNIT_ASSERT_EQUAL(5ul, cache.misses());
+
+    // reads exceeding the stream size bypass the cache as well
+    CPPUNIT_ASSERT_THROW(cache.read(18, buffer, 4), ios_base::failure);
+
+    cache.resetCounters();
+    CPPUNIT_ASSERT_EQUAL(0ul, cache.hits() + cache.misses());
+    cache.setStream(nullptr, 0);
+    CPPUNIT_ASSERT(!cache.isActive());
+    CPPUNIT_ASSERT_EQUAL(0_st, cache.blockCount());
+}
+
+/*!
+ * \brief The ArenaTestObject struct records its destruction to test the ElementArena class.
+ */
+struct ArenaTestObject
+{
+    ArenaTestObject(vector<int> &destroyed, int id) :
+        destroyed(destroyed),
+        id(id)
+    {}
+    ~ArenaTestObject()
+    {
+        destroyed.push_back(id);
+    }
+
+    vector<int> &destroyed;
+    int id;
+    alignas(16) char data[40];
+};
+
+void UtilitiesTests::testElementArena()
+{
+    vector<int> destroyed;
+    ElementArena arena(0x100);
+    CPPUNIT_ASSERT_EQUAL(0_st, arena.blockCount());
+
+    // create objects within the arena
+    for(int id = 0; id != 10; ++id) {
+        void *const memory = arena.allocate(sizeof(ArenaTestObject), alignof(ArenaTestObject));
+        CPPUNIT_ASSERT_EQUAL(0_st, reinterpret_cast<size_t>(memory) % alignof(ArenaTestObject));
+        arena.registerObject(new(memory) ArenaTestObject(destroyed, id));
+        // small allocations in between must not break the alignment
+        arena.allocate(3, 1);
+    }
+    CPPUNIT_ASSERT_EQUAL(10_st, arena.objectCount());
+    CPPUNIT_ASSERT(arena.blockCount() > 1);
+    CPPUNIT_ASSERT(arena.blockCount() < 10);
+
+    // large allocations get a dedicated block
+    const size_t blockCount = arena.blockCount();
+    CPPUNIT_ASSERT(arena.allocate(0x200, 8));
+    CPPUNIT_ASSERT_EQUAL(blockCount + 1, arena.blockCount());
+
+    // objects are destroyed in reverse order when clearing
+    CPPUNIT_ASSERT(destroyed.empty());
+    arena.clear();
+    CPPUNIT_ASSERT_EQUAL(vector<int>({9, 8, 7, 6, 5, 4, 3, 2, 1, 0}), destroyed);
+    CPPUNIT_ASSERT_EQUAL(0_st, arena.objectCount());
+    CPPUNIT_ASSERT_EQUAL(0_st, arena.blockCount());
+}
+
+void UtilitiesTests::testNativeCopyHelper()
+{
+    const string inputPath(testFilePath("matroska_wave1/test1.mkv")), outputPath(workingCopyPath("unsupported.bin"));
+    NativeFileStream input, output;
+    input.exceptions(ios_base::failbit | ios_base::badbit);
+    output.exceptions(ios_base::failbit | ios_base::badbit);
+    input.open(inputPath, ios_base::in | ios_base::binary);
+    output.open(outputPath, ios_base::out | ios_base::binary | ios_base::trunc);
+    NativeCopyHelper copyHelper;
+    copyHelper.setMinimumSize(0x100);
+    copyHelper.open(input, inputPath, output, outputPath);
+
+    // copy data natively (if supported) after some data which is still buffered by the output stream
+    output << "test";
+    input.seekg(0x10);
+    double percentage = 0.0;
+    copyHelper.callbackCopy(input, output, 0x1000, [] { return false; }, [&percentage] (double p) { percentage = p; });
+    CPPUNIT_ASSERT_EQUAL(1.0, percentage);
+    CPPUNIT_ASSERT_EQUAL(static_cast<streamoff>(0x1010), static_cast<streamoff>(input.tellg()));
+    CPPUNIT_ASSERT_EQUAL(static_cast<streamoff>(0x1004), static_cast<streamoff>(output.tellp()));
+
+    // copy data which is below the minimum size
+    copyHelper.copy(input, output, 0x10);
+
+    // copy data using a buffer while native copying is suspended
+    const uint64 bytesCopiedNatively = copyHelper.bytesCopiedNatively();
+    copyHelper.setSuspended(true);
+    copyHelper.copy(input, output, 0x200);
+    CPPUNIT_ASSERT_EQUAL(bytesCopiedNatively, copyHelper.bytesCopiedNatively());
+    copyHelper.close();
+    CPPUNIT_ASSERT(!copyHelper.isSuspended());
+    output.close();
+
+    // check whether the output file has the expected contents
+    input.seekg(0x10);
+    string expectedData(0x1210, '\0');
+    input.read(&expectedData[0], 0x1210);
+    expectedData.insert(0, "test");
+    output.open(outputPath, ios_base::in | ios_base::binary);
+    string actualData(0x1214, '\0');
+    output.read(&actualData[0], 0x1214);
+    CPPUNIT_ASSERT(expectedData == actualData);
+    CPPUNIT_ASSERT_EQUAL(static_cast<int>(char_traits<char>::eof()), output.peek());
+}
+
+void UtilitiesTests::testCrc32()
+{
+    // check values
+    CPPUNIT_ASSERT_EQUAL(0x89A1897Fu, Crc32::compute(Crc32::Variant::Ogg, "123456789", 9));
+    CPPUNIT_ASSERT_EQUAL(0xCBF43926u, Crc32::compute(Crc32::Variant::Ebml, "123456789", 9));
+    CPPUNIT_ASSERT_EQUAL(0u, Crc32::compute(Crc32::Variant::Ebml, nullptr, 0));
+
+    // compare all implementations to a bitwise computation for various sizes and alignments
+    string data(0x1000, '\0');
+    for(size_t i = 0; i != data.size(); ++i) {
+        data[i] = static_cast<char>((i * 0x9E3779B1u) >> 13);
+    }
+    const auto bitwise = [] (Crc32::Variant variant, const char *data, size_t size) {
+        uint32 crc = variant == Crc32::Variant::Ebml ? 0xFFFFFFFF : 0;
+        for(const char *end = data + size; data != end; ++data) {
+            if(variant == Crc32::Variant::Ebml) {
+                crc ^= static_cast<byte>(*data);
+                for(int bit = 0; bit != 8; ++bit) {
+                    crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+                }
+            } else {
+                crc ^= static_cast<uint32>(static_cast<byte>(*data)) << 24;
+                for(int bit = 0; bit != 8; ++bit) {
+                    crc = crc & 0x80000000 ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+                }
+            }
+        }
+        return variant == Crc32::Variant::Ebml ? ~crc : crc;
+    };
+    for(const bool accelerated : {false, true}) {
+        Crc32::setHardwareAccelerationEnabled(accelerated);
+        for(const auto variant : {Crc32::Variant::Ogg, Crc32::Variant::Ebml}) {
+            for(size_t offset = 0; offset != 16; ++offset) {
+                for(size_t size : {0, 1, 7, 8, 15, 16, 63, 64, 65, 127, 128, 200, 0x1000 - 16}) {
+                    CPPUNIT_ASSERT_EQUAL(bitwise(variant, data.data() + offset, size), Crc32::compute(variant, data.data() + offset, size));
+                }
+            }
+
+            // update incrementally and from stream
+            Crc32 crc(variant);
+            crc.update(data.data(), 100);
+            crc.update(data.data() + 100, data.size() - 100);
+            CPPUNIT_ASSERT_EQUAL(bitwise(variant, data.data(), data.size()), crc.value());
+            stringstream stream(data);
+            CPPUNIT_ASSERT_EQUAL(crc.value(), Crc32::compute(variant, stream, data.size()));
+            crc.reset();
+            CPPUNIT_ASSERT_EQUAL(Crc32::compute(variant, nullptr, 0), crc.value());
+        }
+    }
+    Crc32::setHardwareAccelerationEnabled(true);
+}
+
+void UtilitiesTests::testCrc32StreamBuffer()
+{
+    string data(0x1000, '\0');
+    for(size_t i = 0; i != data.size(); ++i) {
+        data[i] = static_cast<char>((i * 0x9E3779B1u) >> 13);
+    }
+    stringstream stream(ios_base::in | ios_base::out | ios_base::binary);
+    stream.exceptions(ios_base::failbit | ios_base::badbit);
+    stream << "head";
+
+    // checksums of (nested) ranges are computed while writing; writes exceeding the buffer are forwarded directly
+    uint32 outerCrc, innerCrc;
+    {
+        Crc32StreamBuffer buffer(stream, 0x10);
+        stream.write(data.data(), 5);
+        buffer.beginRange();
+        stream.write(data.data() + 5, 10);
+        CPPUNIT_ASSERT_EQUAL(static_cast<streamoff>(19), static_cast<streamoff>(stream.tellp()));
+        buffer.beginRange();
+        CPPUNIT_ASSERT_EQUAL(2_st, buffer.rangeCount());
+        stream.write(data.data() + 15, 0x800);
+        stream.put(data[0x80F]);
+        innerCrc = buffer.endRange();
+        stream.write(data.data() + 0x810, 3);
+        outerCrc = buffer.endRange();
+        CPPUNIT_ASSERT_EQUAL(0_st, buffer.rangeCount());
+        buffer.detach();
+    }
+    CPPUNIT_ASSERT_EQUAL(Crc32::compute(Crc32::Variant::Ebml, data.data() + 15, 0x801), innerCrc);
+    CPPUNIT_ASSERT_EQUAL(Crc32::compute(Crc32::Variant::Ebml, data.data() + 5, 0x80E), outerCrc);
+
+    // the original buffer has been restored
+    stream << "tail";
+    CPPUNIT_ASSERT_EQUAL("head" + data.substr(0, 0x813) + "tail", stream.str());
+}
+
 #ifdef PLATFORM_UNIX
 void UtilitiesTests::testBackupFile()
 {
@@ -363,6 +611,22 @@ void UtilitiesTests::testBackupFile()
     CPPUNIT_ASSERT_EQUAL("The original file has been restored."s, file.notifications().back().message());
     file.invalidateNotifications();
 
+    // create backup preferring reflinks (falls back to renaming if not supported by the file system)
+    backupStrategy() = BackupStrategy::Reflink;
+    createBackupFile(file.path(), backupPath1, file.stream(), backupStream1);
+    CPPUNIT_ASSERT_EQUAL(workingDir + "/unsupported.bin.bak", backupPath1);
+    backupStream1.seekg(0, ios_base::end);
+    CPPUNIT_ASSERT_EQUAL(41_st, static_cast<size_t>(backupStream1.tellg()));
+    restoreOriginalFileFromBackupFile(file.path(), backupPath1, file.stream(), backupStream1);
+    file.open(true);
+    file.stream().seekg(0x1D);
+    CPPUNIT_ASSERT_EQUAL(static_cast<ios::int_type>(0x34), file.stream().get());
+    file.close();
+    backupStrategy() = BackupStrategy::Rename;
+
+    // cloning must not override existing files
+    CPPUNIT_ASSERT(!cloneFile(file.path(), file.path()));
+
     remove(file.path().data());
 }
 #endif